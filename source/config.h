@@ -488,6 +488,11 @@ constexpr int MAX_PLY_NUM = 246;
 #define NO_PREFETCH
 // #define USE_DEEP_DFPN
 // #define USE_TT_SAVE_AND_LOAD
+// pn/dn を 32 bit 整数で持つ。探索結果や局面展開のメモリが減るが、pn/dn の上限が小さくなる。
+// 置換表スナップショットや共有メモリの置換表は、この設定が異なるビルドの間では使い回せない。
+// #define USE_32BIT_PNDN
+// 探索の終了時に、訪問や再展開がどの初手・局面・深さに集中したかを info string で出力する。探索が少し遅くなる。
+// #define USE_SEARCH_PROFILER
 #endif
 
 // --------------------
@@ -4,8 +4,12 @@
 #include "local_expansion.hpp"
 #include "transposition_table.hpp"
 
+using komori::BitSet64;
 using komori::kDepthMaxMateLen;
+using komori::kInfinitePnDn;
 using komori::LocalExpansion;
+using komori::MoveHistory;
+using komori::PnDn;
 using komori::SearchResult;
 using komori::UnknownData;
 using komori::tt::TranspositionTable;
@@ -14,11 +18,12 @@ namespace {
 void LocalExpansionConstruction(benchmark::State& state) {
   TestNode node{"1pG1B4/Gs+P6/pP7/n1ls5/3k5/nL4+r1b/1+p1p+R4/1S7/2N6 b SP2gn2l11p 1", true};
   TranspositionTable tt;
+  MoveHistory move_history;
   tt.Resize(19 * 5 * 5 + 1);
   const auto first_search = false;
 
   for (auto _ : state) {
-    const LocalExpansion local_expansion{tt, *node, kDepthMaxMateLen, first_search};
+    const LocalExpansion local_expansion{tt, move_history, *node, kDepthMaxMateLen, first_search, 1};
     benchmark::DoNotOptimize(local_expansion);
   }
 }
@@ -26,15 +31,39 @@ void LocalExpansionConstruction(benchmark::State& state) {
 void LocalExpansionConstruction2(benchmark::State& state) {
   TestNode node{"1pG6/Gs+P6/pP7/n1lsS4/1k6R/n7b/1N+Bp5/1S7/9 w Pr2gn3l12p 14", false};
   TranspositionTable tt;
+  MoveHistory move_history;
   tt.Resize(19 * 5 * 5 + 1);
   const auto first_search = state.range() != 0;
 
   for (auto _ : state) {
-    const LocalExpansion local_expansion{tt, *node, kDepthMaxMateLen, first_search};
+    const LocalExpansion local_expansion{tt, move_history, *node, kDepthMaxMateLen, first_search, 1};
     benchmark::DoNotOptimize(local_expansion);
   }
 }
+
+void LocalExpansionUpdate(benchmark::State& state) {
+  // 王手の多い局面。子の個数が多いほど δ 値の再計算が重くなる。
+  TestNode node{"4k4/9/9/9/9/9/9/9/4K4 b 2R2B4G4S4N4L18P 1", true};
+  TranspositionTable tt;
+  MoveHistory move_history;
+  tt.Resize(19 * 5 * 5 + 1);
+  // Arg(0): δ値を和で計上する, Arg(1): δ値を最大値で計上する
+  const auto sum_mask = state.range() == 0 ? BitSet64::Full() : BitSet64{};
+  LocalExpansion local_expansion{tt, move_history, *node, kDepthMaxMateLen, false, 1, sum_mask};
+
+  // 最善の子の探索結果を適当に悪くして書き戻す操作を繰り返す
+  std::uint64_t seed = 334;
+  for (auto _ : state) {
+    seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    const auto& front = local_expansion.FrontResult();
+    const auto pn = front.Pn() + 1 + static_cast<PnDn>(seed >> 60);
+    const auto dn = 1 + static_cast<PnDn>(seed >> 56);
+    local_expansion.UpdateBestChild(SearchResult::MakeUnknown(pn, dn, kDepthMaxMateLen, 1, sum_mask));
+    benchmark::DoNotOptimize(local_expansion.FrontPnDnThresholds(kInfinitePnDn, kInfinitePnDn));
+  }
+}
 }  // namespace
 
 BENCHMARK(LocalExpansionConstruction);
 BENCHMARK(LocalExpansionConstruction2)->Arg(0)->Arg(1);
+BENCHMARK(LocalExpansionUpdate)->Arg(0)->Arg(1);
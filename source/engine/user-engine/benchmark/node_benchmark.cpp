@@ -1,11 +1,14 @@
 #include <benchmark/benchmark.h>
 
+#include <deque>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "../../../thread.h"
 #include "../../../usi.h"
 #include "node.hpp"
+#include "path_keys.hpp"
 
 using komori::Node;
 
@@ -130,6 +133,33 @@ void Node_Microcosmos(benchmark::State& state) {
     RollBack(node, moves);
   }
 }
+
+/// 1 手ごとに、局面展開で子局面の経路ハッシュ値を計算するのと同じ要領で全合法手に対して `PathKeyAfter()` を呼ぶ
+void PathKey_Microcosmos(benchmark::State& state) {
+  const auto [pos, moves] = GetMicrocosmos();
+  std::deque<StateInfo> st;
+  std::vector<std::vector<Move>> children;
+  for (const auto move : moves) {
+    auto& list = children.emplace_back();
+    for (const auto& child : MoveList<LEGAL_ALL>(*pos)) {
+      list.push_back(child.move);
+    }
+    pos->do_move(move, st.emplace_back());
+  }
+
+  for (auto _ : state) {
+    Key path_key = 0;
+    for (std::size_t i = 0; i < moves.size(); ++i) {
+      const auto depth = static_cast<Depth>(i);
+      for (const auto child : children[i]) {
+        benchmark::DoNotOptimize(komori::PathKeyAfter(path_key, child, depth));
+      }
+      path_key = komori::PathKeyAfter(path_key, moves[i], depth);
+    }
+    benchmark::DoNotOptimize(path_key);
+  }
+}
 }  // namespace
 
 BENCHMARK(Node_Microcosmos);
+BENCHMARK(PathKey_Microcosmos);
@@ -12,14 +12,18 @@ using komori::KomoringHeights;
 namespace {
 const std::unordered_map<std::string, std::string> kMateProblems{
     {"mate3-0000000", "ln1gkg1nl/6+P2/2sppps1p/2p3p2/p8/P1P1P3P/2NP1PP2/3s1KSR1/L1+b2G1NL w R2Pbgp 42"},
-    {"mate5-0000000", "l2gkg2l/2s3s2/p1nppp1pp/2p3p2/P4P1P1/4n3P/1PPPG1N2/1BKS2+s2/LN3+r3 w RBgl3p 72"}};
+    {"mate5-0000000", "l2gkg2l/2s3s2/p1nppp1pp/2p3p2/P4P1P1/4n3P/1PPPG1N2/1BKS2+s2/LN3+r3 w RBgl3p 72"},
+    {"mate11-0000000", "1ss6/9/N1k6/9/2G6/9/9/9/9 b RB 1"},
+    {"mate17-0000000", "8B/5n3/5k3/4P3g/2l6/3g5/9/9/9 b RG 1"},
+    {"mate31-0000000", "5k3/4b3B/7P1/7P1/9/9/9/9/9 b RB 1"}};
 StateInfo g_si;
 
-std::unique_ptr<KomoringHeights> MakeEngine() {
+std::unique_ptr<KomoringHeights> MakeEngine(Depth frontier_mate_ply = 1) {
   EngineOption option{};
   option.Reload(Options);
   option.pv_interval = 0;
   option.silent = true;
+  option.frontier_mate_ply = frontier_mate_ply;
 
   auto kh = std::make_unique<KomoringHeights>();
   kh->Init(option, 1);
@@ -49,7 +53,27 @@ void MateBenchmark(benchmark::State& state) {
     benchmark::DoNotOptimize(kh->Search(*pos, true));
   }
 }
+
+/// 初訪問の OR node で調べる奇数手詰めの手数（`state.range(0)`）ごとに、手数の異なる問題を解く
+void FrontierMateBenchmark(benchmark::State& state) {
+  const auto kh = MakeEngine(static_cast<Depth>(state.range(0)));
+  const auto problem_name = state.name().substr(0, state.name().find('/'));
+  const auto pos = GetPosition(problem_name);
+
+  for (auto _ : state) {
+    state.PauseTiming();
+    kh->Clear();
+    state.ResumeTiming();
+    kh->NewSearch(*pos, true);
+
+    benchmark::DoNotOptimize(kh->Search(*pos, true));
+  }
+}
 }  // namespace
 
 BENCHMARK(MateBenchmark)->Name("mate3-0000000");
 BENCHMARK(MateBenchmark)->Name("mate5-0000000");
+
+BENCHMARK(FrontierMateBenchmark)->Name("mate11-0000000")->Arg(1)->Arg(3)->Arg(5)->Unit(benchmark::kMillisecond);
+BENCHMARK(FrontierMateBenchmark)->Name("mate17-0000000")->Arg(1)->Arg(3)->Arg(5)->Unit(benchmark::kMillisecond);
+BENCHMARK(FrontierMateBenchmark)->Name("mate31-0000000")->Arg(1)->Arg(3)->Arg(5)->Unit(benchmark::kMillisecond);
@@ -0,0 +1,37 @@
+#include <benchmark/benchmark.h>
+
+#include <random>
+
+#include "regular_table.hpp"
+
+using komori::MemoryPlacement;
+using komori::NumaPolicy;
+using komori::tt::RegularTable;
+
+namespace {
+/// TLB に収まらないよう、1 GB 程度の通常テーブルを使う
+constexpr std::uint64_t kNumEntries = (std::uint64_t{1} << 30) / sizeof(komori::tt::Entry);
+/// 1 回の計測で引くエントリ数
+constexpr int kProbeCount = 10000;
+
+/// 通常テーブルをランダムに引く。`state.range(0)` が 1 なら Huge Pages、`state.range(1)` が NUMA 配置を表す
+void RegularTable_RandomProbe(benchmark::State& state) {
+  RegularTable table{};
+  table.SetPlacement(MemoryPlacement{state.range(0) != 0, static_cast<NumaPolicy>(state.range(1))});
+  table.Resize(kNumEntries);
+
+  std::mt19937_64 mt(334);
+  for (auto _ : state) {
+    for (int i = 0; i < kProbeCount; ++i) {
+      benchmark::DoNotOptimize(table.PointerOf(mt())->IsNull());
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * kProbeCount);
+}
+}  // namespace
+
+BENCHMARK(RegularTable_RandomProbe)
+    ->Args({0, static_cast<int>(NumaPolicy::kNone)})
+    ->Args({1, static_cast<int>(NumaPolicy::kNone)})
+    ->Args({1, static_cast<int>(NumaPolicy::kInterleave)})
+    ->Args({1, static_cast<int>(NumaPolicy::kFirstTouch)});
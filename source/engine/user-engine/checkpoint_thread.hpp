@@ -0,0 +1,96 @@
+/**
+ * @file checkpoint_thread.hpp
+ */
+#ifndef KOMORI_CHECKPOINT_THREAD_HPP_
+#define KOMORI_CHECKPOINT_THREAD_HPP_
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace komori {
+/**
+ * @brief 一定間隔で処理を実行するバックグラウンドスレッド
+ *
+ * 探索中の置換表スナップショットの書き出しに用いる。探索スレッドとは独立したスレッドで `task` を呼び出すので、
+ * 探索スレッドは書き出しの完了を待つ必要がない。
+ *
+ * `Stop()` は実行中の `task` の完了を待ってからスレッドを終了させる。待機中であれば即座に終了する。
+ */
+class CheckpointThread {
+ public:
+  /// Default constructor(default)
+  CheckpointThread() = default;
+  /// Copy constructor(delete)
+  CheckpointThread(const CheckpointThread&) = delete;
+  /// Move constructor(delete)
+  CheckpointThread(CheckpointThread&&) = delete;
+  /// Copy assign operator(delete)
+  CheckpointThread& operator=(const CheckpointThread&) = delete;
+  /// Move assign operator(delete)
+  CheckpointThread& operator=(CheckpointThread&&) = delete;
+  /// Destructor。スレッドが起動中なら停止させる。
+  ~CheckpointThread() { Stop(); }
+
+  /**
+   * @brief スレッドを起動し、`interval_ms` ごとに `task` を呼び出す
+   * @param interval_ms 呼び出し間隔[ms]
+   * @param task        呼び出す処理
+   *
+   * すでにスレッドが起動中の場合、いったん停止させてから起動し直す。
+   * 最初の `task` 呼び出しは起動から `interval_ms` 経過後である。
+   */
+  void Start(std::uint64_t interval_ms, std::function<void()> task) {
+    Stop();
+
+    stop_ = false;
+    task_ = std::move(task);
+    thread_ = std::thread([this, interval_ms]() { Run(std::chrono::milliseconds{interval_ms}); });
+  }
+
+  /**
+   * @brief スレッドを停止する
+   *
+   * `task` の実行中に呼ばれた場合は `task` の完了を待つ。スレッドが起動していなければ何もしない。
+   */
+  void Stop() {
+    if (!thread_.joinable()) {
+      return;
+    }
+
+    {
+      const std::lock_guard lock(mutex_);
+      stop_ = true;
+    }
+    cv_.notify_all();
+    thread_.join();
+  }
+
+  /// スレッドが起動中かどうか
+  bool IsRunning() const noexcept { return thread_.joinable(); }
+
+ private:
+  /// スレッド本体。`Stop()` が呼ばれるまで `interval` ごとに `task_` を呼び出す。
+  void Run(std::chrono::milliseconds interval) {
+    std::unique_lock lock(mutex_);
+    while (!cv_.wait_for(lock, interval, [this]() { return stop_; })) {
+      // task_ の実行中に Stop() がブロックしないよう、ロックを外してから呼び出す
+      lock.unlock();
+      task_();
+      lock.lock();
+    }
+  }
+
+  std::thread thread_;          ///< バックグラウンドスレッド
+  std::mutex mutex_;            ///< `stop_` を保護する mutex
+  std::condition_variable cv_;  ///< `Stop()` の通知用
+  bool stop_{false};            ///< 停止要求フラグ
+  std::function<void()> task_;  ///< 定期的に呼び出す処理
+};
+}  // namespace komori
+
+#endif  // KOMORI_CHECKPOINT_THREAD_HPP_
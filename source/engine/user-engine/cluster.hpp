@@ -0,0 +1,913 @@
+/**
+ * @file cluster.hpp
+ */
+#ifndef KOMORI_CLUSTER_HPP_
+#define KOMORI_CLUSTER_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <variant>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif  // !defined(_WIN32)
+
+#include "typedefs.hpp"
+
+namespace komori {
+namespace detail {
+/// クラスタの通信で 1 行に許す最大の長さ。これより長い行を受け取ったら接続を切る。
+inline constexpr std::size_t kClusterMaxLineLength = 4096;
+/// 結果が出なかったジョブを再送するとき、探索時間を最大で何回まで倍にするか
+inline constexpr std::uint32_t kClusterMaxRetryShift = 6;
+/// 再送で倍にしていく探索時間の上限[ms]。`go mate infinite` でも 1 回のジョブが長くなりすぎないようにする。
+inline constexpr std::uint64_t kClusterMaxRetryTimeMs = 10 * 1000;
+/// ワーカーの結果を待つ間隔。この間隔で探索中断の要否を確認する。
+inline constexpr auto kClusterWaitInterval = std::chrono::milliseconds{100};
+/// コーディネータがワーカーに探索の打ち切りを伝える行
+inline constexpr char kClusterCancelLine[] = "cancel";
+/// Unix ドメインソケットのアドレスにつける接頭辞
+inline constexpr char kClusterUnixPrefix[] = "unix:";
+/// ポート番号だけが指定されたときに使うホスト名
+inline constexpr char kClusterDefaultHost[] = "127.0.0.1";
+
+/**
+ * @brief クラスタのアドレス `address` を分解する
+ * @param address アドレス。`unix:<path>`、`<host>:<port>`、`<port>` のいずれか。
+ * @param[out] host ホスト名。Unix ドメインソケットの場合はソケットファイルのパス。
+ * @param[out] port ポート番号。Unix ドメインソケットの場合は空。
+ * @return Unix ドメインソケットなら `true`
+ */
+inline bool SplitClusterAddress(const std::string& address, std::string& host, std::string& port) {
+  if (address.rfind(kClusterUnixPrefix, 0) == 0) {
+    host = address.substr(std::strlen(kClusterUnixPrefix));
+    port.clear();
+    return true;
+  }
+
+  if (const auto colon = address.rfind(':'); colon != std::string::npos) {
+    host = address.substr(0, colon);
+    port = address.substr(colon + 1);
+  } else {
+    host = kClusterDefaultHost;
+    port = address;
+  }
+  return false;
+}
+
+#if !defined(_WIN32)
+/**
+ * @brief `address` に対応するソケットを作り、接続または待ち受けを開始する
+ * @param address アドレス（`SplitClusterAddress()` を参照）
+ * @param listen  `true` なら待ち受け、`false` なら接続する
+ * @return ソケットのファイルディスクリプタ。失敗したら -1。
+ */
+inline int OpenClusterSocket(const std::string& address, bool listen) {
+  std::string host;
+  std::string port;
+  if (SplitClusterAddress(address, host, port)) {
+    sockaddr_un addr{};
+    if (host.empty() || host.size() >= sizeof(addr.sun_path)) {
+      return -1;
+    }
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, host.c_str(), host.size() + 1);
+
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+      return -1;
+    }
+
+    const auto* const sa = reinterpret_cast<const sockaddr*>(&addr);
+    if (listen) {
+      // 前回のワーカーが残したソケットファイルがあると bind できないので消しておく
+      ::unlink(host.c_str());
+      if (::bind(fd, sa, sizeof(addr)) == 0 && ::listen(fd, SOMAXCONN) == 0) {
+        return fd;
+      }
+    } else if (::connect(fd, sa, sizeof(addr)) == 0) {
+      return fd;
+    }
+    ::close(fd);
+    return -1;
+  }
+
+  addrinfo hints{};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo* result = nullptr;
+  if (::getaddrinfo(host.c_str(), port.c_str(), &hints, &result) != 0) {
+    return -1;
+  }
+
+  int fd = -1;
+  for (const auto* ai = result; ai != nullptr; ai = ai->ai_next) {
+    fd = ::socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+    if (fd < 0) {
+      continue;
+    }
+
+    if (listen) {
+      const int yes = 1;
+      ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+      if (::bind(fd, ai->ai_addr, ai->ai_addrlen) == 0 && ::listen(fd, SOMAXCONN) == 0) {
+        break;
+      }
+    } else if (::connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+      break;
+    }
+    ::close(fd);
+    fd = -1;
+  }
+  ::freeaddrinfo(result);
+  return fd;
+}
+#endif  // !defined(_WIN32)
+}  // namespace detail
+
+/**
+ * @brief コーディネータからワーカーへ渡す探索依頼
+ *
+ * 通信路上では `job <id> <time_ms> <or|and> <sfen>` の 1 行で表す。探索中のワーカーに `cancel` の 1 行を送ると、
+ * その探索を打ち切らせることができる。
+ */
+struct ClusterJob {
+  std::uint64_t id;       ///< ジョブ番号。結果との対応付けに使う。
+  std::uint64_t time_ms;  ///< 探索時間の上限[ms]
+  bool or_node;           ///< 局面が OR node かどうか
+  std::string sfen;       ///< 探索する局面
+};
+
+/**
+ * @brief ワーカーからコーディネータへ返す探索結果
+ *
+ * 通信路上では `result <id> <pn> <dn> <hand> <len> <amount>` の 1 行で表す。`pn == 0` なら詰み、`dn == 0` なら
+ * 不詰で、このとき `hand` と `len` はそれぞれ証明駒／反証駒と詰み手数／不詰手数を表す。どちらでもなければ
+ * 時間内に結果が出なかったことを表し、`pn` と `dn` は打ち切った時点の値である。
+ */
+struct ClusterResult {
+  std::uint64_t id;     ///< ジョブ番号
+  PnDn pn;              ///< 証明数
+  PnDn dn;              ///< 反証数
+  Hand hand;            ///< 証明駒（詰み）または反証駒（不詰）
+  std::uint32_t len;    ///< 詰み手数（詰み）または不詰手数（不詰）
+  SearchAmount amount;  ///< 結果を得るのにかかった探索量
+};
+
+/// `job` を通信路上の 1 行に変換する
+inline std::string FormatClusterJob(const ClusterJob& job) {
+  std::ostringstream oss;
+  oss << "job " << job.id << " " << job.time_ms << " " << (job.or_node ? "or" : "and") << " " << job.sfen;
+  return oss.str();
+}
+
+/// 通信路上の 1 行 `line` を `ClusterJob` に変換する。形式が正しくなければ `std::nullopt`。
+inline std::optional<ClusterJob> ParseClusterJob(const std::string& line) {
+  std::istringstream iss(line);
+  std::string token;
+  std::string node_type;
+  ClusterJob job{};
+  if (!(iss >> token >> job.id >> job.time_ms >> node_type) || token != "job" ||
+      (node_type != "or" && node_type != "and")) {
+    return std::nullopt;
+  }
+  job.or_node = node_type == "or";
+
+  std::getline(iss >> std::ws, job.sfen);
+  if (job.sfen.empty()) {
+    return std::nullopt;
+  }
+  return job;
+}
+
+/// `result` を通信路上の 1 行に変換する
+inline std::string FormatClusterResult(const ClusterResult& result) {
+  std::ostringstream oss;
+  oss << "result " << result.id << " " << result.pn << " " << result.dn << " " << static_cast<std::uint32_t>(result.hand)
+      << " " << result.len << " " << result.amount;
+  return oss.str();
+}
+
+/// 通信路上の 1 行 `line` を `ClusterResult` に変換する。形式が正しくなければ `std::nullopt`。
+inline std::optional<ClusterResult> ParseClusterResult(const std::string& line) {
+  std::istringstream iss(line);
+  std::string token;
+  std::uint32_t hand{};
+  // pn/dn の幅が異なるビルドが混在しても読めるように、64 bit で読んでから丸める
+  std::uint64_t pn{};
+  std::uint64_t dn{};
+  ClusterResult result{};
+  if (!(iss >> token >> result.id >> pn >> dn >> hand >> result.len >> result.amount) || token != "result") {
+    return std::nullopt;
+  }
+  result.pn = static_cast<PnDn>(std::min<std::uint64_t>(pn, kInfinitePnDn));
+  result.dn = static_cast<PnDn>(std::min<std::uint64_t>(dn, kInfinitePnDn));
+  result.hand = static_cast<Hand>(hand);
+  return result;
+}
+
+/**
+ * @brief カンマ区切りのワーカー一覧 `list` をアドレスごとに分割する
+ * @param list ワーカー一覧（例: `192.168.0.2:4091,unix:/tmp/kh.sock`）
+ * @return アドレスの一覧。空白は取り除き、空の要素は無視する。
+ */
+inline std::vector<std::string> ParseClusterWorkers(const std::string& list) {
+  std::vector<std::string> addresses;
+  std::istringstream iss(list);
+  std::string address;
+  while (std::getline(iss, address, ',')) {
+    address.erase(std::remove_if(address.begin(), address.end(), [](unsigned char c) { return std::isspace(c) != 0; }),
+                  address.end());
+    if (!address.empty()) {
+      addresses.push_back(std::move(address));
+    }
+  }
+  return addresses;
+}
+
+/**
+ * @brief クラスタの通信路。ソケット上で 1 行ずつ読み書きする。
+ */
+class ClusterConnection {
+ public:
+  /// Default constructor。どこにもつながっていない状態になる。
+  ClusterConnection() = default;
+  /// 接続済みのソケット `fd` の所有権を受け取る
+  explicit ClusterConnection(int fd) noexcept : fd_{fd} {}
+  /// Copy constructor(delete)
+  ClusterConnection(const ClusterConnection&) = delete;
+  /// Move constructor
+  ClusterConnection(ClusterConnection&& rhs) noexcept
+      : fd_{rhs.fd_}, eof_{rhs.eof_}, buffer_{std::move(rhs.buffer_)} {
+    rhs.fd_ = -1;
+    rhs.eof_ = false;
+  }
+  /// Copy assign operator(delete)
+  ClusterConnection& operator=(const ClusterConnection&) = delete;
+  /// Move assign operator
+  ClusterConnection& operator=(ClusterConnection&& rhs) noexcept {
+    if (this != &rhs) {
+      Close();
+      fd_ = rhs.fd_;
+      eof_ = rhs.eof_;
+      buffer_ = std::move(rhs.buffer_);
+      rhs.fd_ = -1;
+      rhs.eof_ = false;
+    }
+    return *this;
+  }
+  /// Destructor。接続を閉じる。
+  ~ClusterConnection() { Close(); }
+
+  /**
+   * @brief `address` へ接続する
+   * @param address 接続先（`unix:<path>`、`<host>:<port>`、`<port>` のいずれか）
+   * @return 接続できたら `true`
+   */
+  bool Connect(const std::string& address) {
+    Close();
+#if !defined(_WIN32)
+    fd_ = detail::OpenClusterSocket(address, false);
+#endif  // !defined(_WIN32)
+    return IsOpen();
+  }
+
+  /// 接続しているかどうか
+  bool IsOpen() const noexcept { return fd_ >= 0; }
+
+  /**
+   * @brief 1 行書き込む
+   * @param line 書き込む内容。末尾に改行を付け足して送る。
+   * @return 書き込めたら `true`
+   */
+  bool WriteLine(const std::string& line) {
+#if !defined(_WIN32)
+    const auto data = line + '\n';
+    std::size_t written = 0;
+    while (IsOpen() && written < data.size()) {
+#if defined(MSG_NOSIGNAL)
+      const auto ret = ::send(fd_, data.data() + written, data.size() - written, MSG_NOSIGNAL);
+#else
+      const auto ret = ::send(fd_, data.data() + written, data.size() - written, 0);
+#endif  // defined(MSG_NOSIGNAL)
+      if (ret <= 0) {
+        return false;
+      }
+      written += static_cast<std::size_t>(ret);
+    }
+    return written == data.size();
+#else
+    static_cast<void>(line);
+    return false;
+#endif  // !defined(_WIN32)
+  }
+
+  /**
+   * @brief 1 行読み込む
+   * @return 読み込んだ行（改行は含まない）。接続が切れたか行が長すぎる場合は `std::nullopt`。
+   */
+  std::optional<std::string> ReadLine() {
+#if !defined(_WIN32)
+    for (;;) {
+      if (const auto newline = buffer_.find('\n'); newline != std::string::npos) {
+        auto line = buffer_.substr(0, newline);
+        buffer_.erase(0, newline + 1);
+        return line;
+      }
+      if (!IsOpen() || eof_ || buffer_.size() > detail::kClusterMaxLineLength || !Receive()) {
+        return std::nullopt;
+      }
+    }
+#else
+    return std::nullopt;
+#endif  // !defined(_WIN32)
+  }
+
+  /**
+   * @brief 1 行読めるようになるまで最大 `timeout` だけ待つ
+   * @param timeout 待つ時間の上限
+   * @return `ReadLine()` がすぐに返る状態になったら `true`。接続が切れた場合も `true`。タイムアウトしたら `false`。
+   */
+  bool WaitLine(std::chrono::milliseconds timeout) {
+#if !defined(_WIN32)
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    for (;;) {
+      if (buffer_.find('\n') != std::string::npos || !IsOpen() || eof_ ||
+          buffer_.size() > detail::kClusterMaxLineLength) {
+        return true;
+      }
+
+      const auto rest =
+          std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+      pollfd pfd{fd_, POLLIN, 0};
+      const auto ret = ::poll(&pfd, 1, static_cast<int>(std::max<std::int64_t>(rest.count(), 0)));
+      if (ret == 0) {
+        return false;
+      } else if (ret < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        eof_ = true;
+      } else if (!Receive()) {
+        eof_ = true;
+      }
+    }
+#else
+    static_cast<void>(timeout);
+    return true;
+#endif  // !defined(_WIN32)
+  }
+
+  /**
+   * @brief 読み書きを打ち切る
+   *
+   * 別スレッドで `ReadLine()` を待っている場合、その呼び出しは `std::nullopt` を返す。ソケットは閉じないので、
+   * 他のスレッドから呼び出してもよい。
+   */
+  void Shutdown() noexcept {
+#if !defined(_WIN32)
+    if (IsOpen()) {
+      ::shutdown(fd_, SHUT_RDWR);
+    }
+#endif  // !defined(_WIN32)
+  }
+
+  /// 接続を閉じる
+  void Close() noexcept {
+#if !defined(_WIN32)
+    if (IsOpen()) {
+      ::close(fd_);
+    }
+#endif  // !defined(_WIN32)
+    fd_ = -1;
+    eof_ = false;
+    buffer_.clear();
+  }
+
+ private:
+  /// 受信したデータを `buffer_` に追記する。接続が切れていたら `false`。
+  bool Receive() {
+#if !defined(_WIN32)
+    char chunk[512];
+    const auto ret = ::recv(fd_, chunk, sizeof(chunk), 0);
+    if (ret <= 0) {
+      return false;
+    }
+    buffer_.append(chunk, static_cast<std::size_t>(ret));
+    return true;
+#else
+    return false;
+#endif  // !defined(_WIN32)
+  }
+
+  int fd_{-1};          ///< ソケットのファイルディスクリプタ。接続していなければ -1。
+  bool eof_{false};     ///< `WaitLine()` で接続が切れたことを検出したかどうか
+  std::string buffer_;  ///< 受信したがまだ行として取り出していないデータ
+};
+
+/**
+ * @brief コーディネータが root 付近を展開して作る AND/OR 木
+ *
+ * 葉がワーカーへ配る局面に対応する。葉の結果を受け取るたびに df-pn と同じ規則で pn/dn を root まで計算し直し、
+ * 次に配る葉を選ぶ。葉は most-proving node からの近さの順に選ぶ。すなわち、root から葉までの経路上で、
+ * OR node では pn が、AND node では dn が最小の子からどれだけ離れているかの総和が小さい葉から配る。
+ * 探索中（ワーカーに配っている最中）の葉は選ばない。
+ *
+ * 詰み／不詰が確定したノードの子孫は、それ以上調べる必要がないので配らない。
+ */
+class ClusterFrontier {
+ public:
+  /// 親がいないことを表すノード番号
+  static constexpr std::uint32_t kNoParent = std::numeric_limits<std::uint32_t>::max();
+
+  /**
+   * @brief ノードを追加する
+   * @param parent  親のノード番号。root なら `kNoParent`。
+   * @param or_node OR node かどうか
+   * @param pn      葉の証明数。子を追加したノードではこの値は使わない。
+   * @param dn      葉の反証数。子を追加したノードではこの値は使わない。
+   * @return 追加したノードの番号
+   * @pre 親は子より先に追加する
+   */
+  std::uint32_t AddNode(std::uint32_t parent, bool or_node, PnDn pn, PnDn dn) {
+    const auto index = static_cast<std::uint32_t>(nodes_.size());
+    nodes_.push_back({parent, {}, or_node, false, pn, dn});
+    if (parent != kNoParent) {
+      nodes_[parent].children.push_back(index);
+    }
+    return index;
+  }
+
+  /// ノード数
+  std::size_t Size() const noexcept { return nodes_.size(); }
+  /// `index` が葉かどうか
+  bool IsLeaf(std::uint32_t index) const { return nodes_[index].children.empty(); }
+  /// `index` の証明数。`Next()` または `Update()` を呼んだ時点の値。
+  PnDn Pn(std::uint32_t index) const { return nodes_[index].pn; }
+  /// `index` の反証数。`Next()` または `Update()` を呼んだ時点の値。
+  PnDn Dn(std::uint32_t index) const { return nodes_[index].dn; }
+  /// 配っている最中の葉があるかどうか
+  bool HasInFlight() const noexcept { return in_flight_count_ > 0; }
+
+  /// root の状態（詰み／不詰／不明）
+  NodeState RootState() const {
+    if (nodes_.empty()) {
+      return NodeState::kUnknown;
+    }
+    return StateOf(nodes_.front());
+  }
+
+  /**
+   * @brief 次に配る葉を選び、配っている最中の状態にする
+   * @return 葉のノード番号。配るべき葉がなければ `std::nullopt`。
+   */
+  std::optional<std::uint32_t> Next() {
+    Recompute();
+    if (nodes_.empty() || RootState() != NodeState::kUnknown) {
+      return std::nullopt;
+    }
+
+    // root からの距離（most-proving node なら 0）を上から順に計算する
+    std::vector<std::optional<PnDn>> cost(nodes_.size());
+    cost[0] = 0;
+    std::optional<std::uint32_t> best;
+    for (std::uint32_t i = 0; i < nodes_.size(); ++i) {
+      const auto& node = nodes_[i];
+      if (!cost[i] || StateOf(node) != NodeState::kUnknown) {
+        continue;
+      }
+
+      if (node.children.empty()) {
+        if (!node.in_flight && (!best || *cost[i] < *cost[*best])) {
+          best = i;
+        }
+        continue;
+      }
+
+      for (const auto child : node.children) {
+        const auto& c = nodes_[child];
+        const auto delta = node.or_node ? c.pn - node.pn : c.dn - node.dn;
+        cost[child] = std::min(*cost[i] + delta, kInfinitePnDn);
+      }
+    }
+
+    if (best) {
+      nodes_[*best].in_flight = true;
+      in_flight_count_++;
+    }
+    return best;
+  }
+
+  /**
+   * @brief 葉 `leaf` の結果を設定する
+   * @param leaf 葉のノード番号
+   * @param pn   証明数。0 なら詰み。
+   * @param dn   反証数。0 なら不詰。
+   *
+   * `leaf` が配っている最中なら、その状態を解除する。詰みでも不詰でもなければ、`leaf` は再び配る対象になる。
+   */
+  void Update(std::uint32_t leaf, PnDn pn, PnDn dn) {
+    auto& node = nodes_[leaf];
+    node.pn = pn;
+    node.dn = dn;
+    Release(leaf);
+    Recompute();
+  }
+
+  /**
+   * @brief 葉 `leaf` の配っている最中の状態を解除する
+   * @param leaf 葉のノード番号
+   *
+   * ワーカーとの接続が切れて結果を受け取れなかったときに呼ぶ。pn/dn は変えない。
+   */
+  void Release(std::uint32_t leaf) {
+    auto& node = nodes_[leaf];
+    if (node.in_flight) {
+      node.in_flight = false;
+      in_flight_count_--;
+    }
+  }
+
+ private:
+  /**
+   * @brief `ClusterFrontier` のノード
+   */
+  struct FrontierNode {
+    std::uint32_t parent;                ///< 親のノード番号
+    std::vector<std::uint32_t> children;  ///< 子のノード番号
+    bool or_node;                        ///< OR node かどうか
+    bool in_flight;                      ///< ワーカーに配っている最中かどうか
+    PnDn pn;                             ///< 証明数
+    PnDn dn;                             ///< 反証数
+  };
+
+  /// ノード `node` の状態
+  static NodeState StateOf(const FrontierNode& node) noexcept {
+    if (node.pn == 0) {
+      return NodeState::kProven;
+    } else if (node.dn == 0) {
+      return NodeState::kDisproven;
+    }
+    return NodeState::kUnknown;
+  }
+
+  /// 葉以外のノードの pn/dn を下から順に計算し直す
+  void Recompute() {
+    for (auto i = nodes_.size(); i-- > 0;) {
+      auto& node = nodes_[i];
+      if (node.children.empty()) {
+        continue;
+      }
+
+      PnDn min = kInfinitePnDn;
+      PnDn sum = 0;
+      for (const auto child : node.children) {
+        const auto& c = nodes_[child];
+        min = std::min(min, node.or_node ? c.pn : c.dn);
+        sum = std::min(sum + (node.or_node ? c.dn : c.pn), kInfinitePnDn);
+      }
+      node.pn = node.or_node ? min : sum;
+      node.dn = node.or_node ? sum : min;
+    }
+  }
+
+  std::vector<FrontierNode> nodes_;     ///< ノード一覧。親は子より前に並ぶ。
+  std::uint32_t in_flight_count_{0};  ///< 配っている最中の葉の数
+};
+
+/**
+ * @brief クラスタモードのワーカー。コーディネータからの探索依頼を待ち受けて解く。
+ *
+ * 同時に処理する接続は 1 つだけで、接続が切れたら次の接続を待つ。`Stop()` を呼ぶまで待ち受けを続ける。
+ * 探索依頼を解いている間も接続を見張り、`cancel` を受け取るか接続が切れたら探索を打ち切らせる。
+ */
+class ClusterWorker {
+ public:
+  /// 探索依頼 `job` を解いて結果を返す関数
+  using SolveFunc = std::function<ClusterResult(const ClusterJob& job)>;
+  /// 解いている最中の探索依頼を打ち切らせる関数。`SolveFunc` とは別のスレッドから呼ばれる。
+  using CancelFunc = std::function<void()>;
+
+  /// Default constructor(default)
+  ClusterWorker() = default;
+  /// Copy constructor(delete)
+  ClusterWorker(const ClusterWorker&) = delete;
+  /// Move constructor(delete)
+  ClusterWorker(ClusterWorker&&) = delete;
+  /// Copy assign operator(delete)
+  ClusterWorker& operator=(const ClusterWorker&) = delete;
+  /// Move assign operator(delete)
+  ClusterWorker& operator=(ClusterWorker&&) = delete;
+  /// Destructor。待ち受けをやめる。
+  ~ClusterWorker() { Close(); }
+
+  /**
+   * @brief `address` で待ち受けを開始する
+   * @param address 待ち受けアドレス（`unix:<path>`、`<host>:<port>`、`<port>` のいずれか）。ポート番号に 0 を
+   *                指定すると空いているポートを使う。
+   * @return 待ち受けを開始できたら `true`
+   */
+  bool Listen(const std::string& address) {
+    Close();
+#if !defined(_WIN32)
+    listen_fd_ = detail::OpenClusterSocket(address, true);
+    if (listen_fd_ < 0) {
+      return false;
+    }
+
+    std::string host;
+    std::string port;
+    if (detail::SplitClusterAddress(address, host, port)) {
+      address_ = address;
+      unix_path_ = host;
+    } else {
+      sockaddr_storage addr{};
+      socklen_t len = sizeof(addr);
+      ::getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&addr), &len);
+      char service[NI_MAXSERV];
+      ::getnameinfo(reinterpret_cast<sockaddr*>(&addr), len, nullptr, 0, service, sizeof(service), NI_NUMERICSERV);
+      address_ = host + ":" + service;
+    }
+    stop_ = false;
+    return true;
+#else
+    static_cast<void>(address);
+    return false;
+#endif  // !defined(_WIN32)
+  }
+
+  /// 待ち受けているアドレス。ポート番号 0 で待ち受けた場合は実際に割り当てられたポート番号になる。
+  const std::string& Address() const noexcept { return address_; }
+
+  /**
+   * @brief 探索依頼を待ち受けて `solve` で解く
+   * @param solve  探索依頼を解く関数
+   * @param cancel 探索の打ち切りを求められたときに呼ぶ関数。打ち切りを求められている間は繰り返し呼ぶ。
+   *
+   * `Stop()` が呼ばれるまで返らない。
+   */
+  void Serve(const SolveFunc& solve, const CancelFunc& cancel = {}) {
+#if !defined(_WIN32)
+    while (!stop_ && listen_fd_ >= 0) {
+      const int fd = ::accept(listen_fd_, nullptr, nullptr);
+      if (fd < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        break;
+      }
+
+      {
+        const std::lock_guard lock(mutex_);
+        connection_ = ClusterConnection{fd};
+        if (stop_) {
+          break;
+        }
+      }
+
+      while (auto line = connection_.ReadLine()) {
+        if (*line == detail::kClusterCancelLine) {
+          // 解き終えた後に届いた打ち切り要求なので、何もしなくてよい
+          continue;
+        }
+
+        const auto job = ParseClusterJob(*line);
+        if (!job) {
+          break;
+        }
+
+        // 解いている間の打ち切り要求を見張る。接続を読むのは見張りのスレッドだけなので、排他は要らない。
+        std::atomic_bool solved{false};
+        std::thread watcher([&]() {
+          bool cancelled = false;
+          while (!solved) {
+            if (cancelled) {
+              // 打ち切りを伝えた後に探索が始まった場合に備えて、解き終えるまで伝え続ける
+              if (cancel) {
+                cancel();
+              }
+              std::this_thread::sleep_for(detail::kClusterWaitInterval);
+            } else if (connection_.WaitLine(detail::kClusterWaitInterval)) {
+              const auto cancel_line = connection_.ReadLine();
+              cancelled = !cancel_line || *cancel_line == detail::kClusterCancelLine;
+            }
+          }
+        });
+        const auto result = solve(*job);
+        solved = true;
+        watcher.join();
+
+        if (!connection_.WriteLine(FormatClusterResult(result))) {
+          break;
+        }
+      }
+
+      const std::lock_guard lock(mutex_);
+      connection_.Close();
+    }
+#else
+    static_cast<void>(solve);
+#endif  // !defined(_WIN32)
+  }
+
+  /**
+   * @brief 待ち受けをやめる
+   *
+   * 他のスレッドから呼び出すと、`Serve()` は処理中の探索依頼を打ち切らせ、その探索が終わってから返る。
+   */
+  void Stop() {
+    stop_ = true;
+#if !defined(_WIN32)
+    const std::lock_guard lock(mutex_);
+    if (listen_fd_ >= 0) {
+      ::shutdown(listen_fd_, SHUT_RDWR);
+    }
+    connection_.Shutdown();
+#endif  // !defined(_WIN32)
+  }
+
+ private:
+  /// 待ち受けソケットを閉じる
+  void Close() {
+#if !defined(_WIN32)
+    if (listen_fd_ >= 0) {
+      ::close(listen_fd_);
+      listen_fd_ = -1;
+    }
+    if (!unix_path_.empty()) {
+      ::unlink(unix_path_.c_str());
+      unix_path_.clear();
+    }
+#endif  // !defined(_WIN32)
+    address_.clear();
+  }
+
+  int listen_fd_{-1};              ///< 待ち受けソケット
+  std::string address_;            ///< 待ち受けているアドレス
+  std::string unix_path_;          ///< Unix ドメインソケットのファイル名。TCP なら空。
+  std::atomic_bool stop_{false};   ///< 待ち受けをやめるかどうか
+  std::mutex mutex_;               ///< `connection_` の付け替えと `Stop()` を排他する
+  ClusterConnection connection_;  ///< 処理中の接続
+};
+
+/**
+ * @brief クラスタモードのコーディネータ。`ClusterFrontier` の葉をワーカーへ配り、結果を集める。
+ *
+ * ワーカー 1 つにつきスレッドを 1 つ立て、各スレッドは「葉を選ぶ → ジョブを送る → 結果を待つ」を繰り返す。
+ * 葉の選択、ジョブの作成、結果の反映、中断要否の確認はすべて 1 つの mutex の下で行うので、コールバックの中で
+ * 排他を取る必要はない。
+ */
+class ClusterCoordinator {
+ public:
+  /**
+   * @brief 葉 `leaf` の `trial` 回目（0-indexed）の探索依頼を作る関数
+   *
+   * 手元ですでに結果が分かっている場合は、依頼の代わりにその結果を返す。
+   */
+  using MakeJobFunc = std::function<std::variant<ClusterJob, ClusterResult>(std::uint32_t leaf, std::uint32_t trial)>;
+  /// 葉 `leaf` についてワーカーから受け取った結果 `result` を反映する関数
+  using ResultFunc = std::function<void(std::uint32_t leaf, const ClusterResult& result)>;
+  /// 配るのをやめるべきなら `true` を返す関数
+  using StopFunc = std::function<bool()>;
+
+  /**
+   * @brief ワーカー `address` へ接続する
+   * @param address ワーカーのアドレス
+   * @return 接続できたら `true`
+   */
+  bool Connect(const std::string& address) {
+    ClusterConnection connection;
+    if (!connection.Connect(address)) {
+      return false;
+    }
+    connections_.push_back(std::move(connection));
+    return true;
+  }
+
+  /// 接続しているワーカーの数
+  std::size_t Size() const noexcept { return connections_.size(); }
+
+  /**
+   * @brief `frontier` の root の詰み／不詰が分かるまで葉をワーカーへ配る
+   * @param frontier    配る葉を持つ AND/OR 木
+   * @param make_job    探索依頼を作る関数
+   * @param on_result   ワーカーから受け取った結果を反映する関数
+   * @param should_stop 配るのをやめるべきかどうかを返す関数
+   * @return ワーカーから受け取った結果の数
+   *
+   * root の詰み／不詰が分かるか、配る葉がなくなるか、`should_stop` が `true` を返すまで続ける。
+   * 通信に失敗したワーカーは切り離し、そのワーカーに配っていた葉は他のワーカーに配り直す。
+   *
+   * 結果を待っている間も `detail::kClusterWaitInterval` ごとに `should_stop` を確認し、`true` になったら
+   * ワーカーに `cancel` を送って接続を閉じる。そのため、ジョブの探索時間が長くてもすぐに返る。
+   */
+  std::uint64_t Run(ClusterFrontier& frontier,
+                    const MakeJobFunc& make_job,
+                    const ResultFunc& on_result,
+                    const StopFunc& should_stop) {
+    std::vector<std::uint32_t> trials(frontier.Size());
+    std::uint64_t received = 0;
+    std::uint64_t next_id = 0;
+
+    std::vector<std::thread> threads;
+    threads.reserve(connections_.size());
+    for (auto& connection : connections_) {
+      threads.emplace_back([&]() {
+        std::unique_lock lock(mutex_);
+        while (!should_stop() && frontier.RootState() == NodeState::kUnknown) {
+          const auto leaf = frontier.Next();
+          if (!leaf) {
+            if (!frontier.HasInFlight()) {
+              break;
+            }
+            cv_.wait_for(lock, detail::kClusterWaitInterval);
+            continue;
+          }
+
+          auto job_or_result = make_job(*leaf, trials[*leaf]++);
+          if (const auto* known = std::get_if<ClusterResult>(&job_or_result)) {
+            frontier.Update(*leaf, known->pn, known->dn);
+            continue;
+          }
+          auto& job = *std::get_if<ClusterJob>(&job_or_result);
+          job.id = next_id++;
+
+          lock.unlock();
+          std::optional<ClusterResult> result;
+          bool stopped = false;
+          if (connection.WriteLine(FormatClusterJob(job))) {
+            while (!connection.WaitLine(detail::kClusterWaitInterval)) {
+              lock.lock();
+              stopped = should_stop();
+              lock.unlock();
+              if (stopped) {
+                break;
+              }
+            }
+            if (!stopped) {
+              if (const auto line = connection.ReadLine()) {
+                result = ParseClusterResult(*line);
+              }
+            }
+          }
+          lock.lock();
+
+          if (stopped) {
+            // 結果は待たずに、ワーカーの探索を打ち切らせて抜ける
+            connection.WriteLine(detail::kClusterCancelLine);
+            frontier.Release(*leaf);
+            connection.Close();
+            cv_.notify_all();
+            break;
+          } else if (!result || result->id != job.id) {
+            // このワーカーとは通信できないので、配っていた葉を他のワーカーに任せて抜ける
+            frontier.Release(*leaf);
+            connection.Close();
+            cv_.notify_all();
+            break;
+          }
+
+          received++;
+          on_result(*leaf, *result);
+          frontier.Update(*leaf, result->pn, result->dn);
+          cv_.notify_all();
+        }
+      });
+    }
+
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    connections_.erase(std::remove_if(connections_.begin(), connections_.end(),
+                                      [](const ClusterConnection& connection) { return !connection.IsOpen(); }),
+                       connections_.end());
+    return received;
+  }
+
+ private:
+  std::vector<ClusterConnection> connections_;  ///< ワーカーとの接続
+  std::mutex mutex_;                            ///< 葉の選択と結果の反映を排他する
+  std::condition_variable cv_;                  ///< 配っている葉の結果が返ってきたことを通知する
+};
+}  // namespace komori
+
+#endif  // KOMORI_CLUSTER_HPP_
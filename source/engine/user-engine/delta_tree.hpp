@@ -0,0 +1,134 @@
+/**
+ * @file delta_tree.hpp
+ */
+#ifndef KOMORI_DELTA_TREE_HPP_
+#define KOMORI_DELTA_TREE_HPP_
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+
+#include "typedefs.hpp"
+
+namespace komori {
+/**
+ * @brief 子局面のδ値の和と最大値を差分更新するためのデータ構造
+ * @tparam kMaxSize 要素数の最大値（`kMaxSize`>0）
+ *
+ * 各要素は「和で計上するδ値」と「最大値で計上するδ値」の組を持つ。和は全要素の合計を差分更新し、最大値は
+ * segment tree で管理する。1要素の書き換えと特定の1要素を除いた全要素の和・最大値の計算は O(log n)、
+ * 全要素の和・最大値の取得は O(1) で行える。
+ *
+ * 和で計上するδ値は `kInfinitePnDn / kMaxSize` 未満でなければならない。こうしておけば合計がオーバーフローしないので、
+ * 1要素を書き換えたときに合計を引き算で差分更新できる。
+ *
+ * 使う前に必ず `Reset()` を呼ぶこと。`Reset()` の後、`SetLeaf()` で要素を一通り書き込んでから `Build()` を呼ぶと
+ * O(n) で構築できる。構築後は `Update()` で要素を書き換える。
+ */
+template <std::size_t kMaxSize>
+class DeltaTree {
+ public:
+  static_assert(kMaxSize > 0, "kMaxSize shall be greater than 0");
+
+  /// δ値の和と最大値の組
+  struct Aggregate {
+    PnDn sum;  ///< 和で計上するδ値の和
+    PnDn max;  ///< 最大値で計上するδ値の最大値
+  };
+
+  /**
+   * @brief 要素数を `size` にして、すべての要素を 0 にする
+   * @param size 要素数（`size` <= `kMaxSize`）
+   */
+  constexpr void Reset(std::size_t size) {
+    leaves_ = 1;
+    while (leaves_ < size) {
+      leaves_ *= 2;
+    }
+    sum_ = 0;
+    std::fill(sums_.begin(), sums_.begin() + leaves_, 0);
+    std::fill(maxs_.begin() + 1, maxs_.begin() + 2 * leaves_, 0);
+  }
+
+  /**
+   * @brief 最大値の木を更新せずに `i` 番目の要素を書き込む。すべて書き込んだら `Build()` を呼ぶこと。
+   * @param i         要素の添字
+   * @param sum_delta 和で計上するδ値
+   * @param max_delta 最大値で計上するδ値
+   * @pre `i` 番目の要素は 0 であること
+   */
+  constexpr void SetLeaf(std::size_t i, PnDn sum_delta, PnDn max_delta) {
+    sums_[i] = sum_delta;
+    sum_ += sum_delta;
+    maxs_[leaves_ + i] = max_delta;
+  }
+
+  /// `SetLeaf()` で書き込んだ要素から最大値の木をすべて計算し直す
+  constexpr void Build() {
+    for (std::size_t k = leaves_ - 1; k > 0; --k) {
+      maxs_[k] = Max(maxs_[2 * k], maxs_[2 * k + 1]);
+    }
+  }
+
+  /**
+   * @brief `i` 番目の要素を書き換える
+   * @param i         要素の添字
+   * @param sum_delta 和で計上するδ値
+   * @param max_delta 最大値で計上するδ値
+   */
+  constexpr void Update(std::size_t i, PnDn sum_delta, PnDn max_delta) {
+    sum_ = sum_ - sums_[i] + sum_delta;
+    sums_[i] = sum_delta;
+
+    auto k = leaves_ + i;
+    maxs_[k] = max_delta;
+    for (k /= 2; k > 0; k /= 2) {
+      const auto new_max = Max(maxs_[2 * k], maxs_[2 * k + 1]);
+      if (maxs_[k] == new_max) {
+        // これより上の値は変わらない
+        break;
+      }
+      maxs_[k] = new_max;
+    }
+  }
+
+  /// 全要素の和と最大値
+  constexpr Aggregate Total() const { return {std::min(sum_, kInfinitePnDn), maxs_[1]}; }
+
+  /**
+   * @brief `i` 番目を除いた全要素の和と最大値
+   * @param i 除く要素の添字
+   */
+  constexpr Aggregate TotalExcept(std::size_t i) const {
+    PnDn max = 0;
+    for (auto k = leaves_ + i; k > 1; k /= 2) {
+      max = Max(max, maxs_[k ^ 1]);
+    }
+    return {std::min(sum_ - sums_[i], kInfinitePnDn), max};
+  }
+
+ private:
+  /// 分岐予測の外れを避けるために、条件付き代入で最大値を求める
+  static constexpr PnDn Max(PnDn lhs, PnDn rhs) { return lhs < rhs ? rhs : lhs; }
+
+  /// `kMaxSize` 以上の最小の2冪
+  static constexpr std::size_t kMaxLeaves = [] {
+    std::size_t leaves = 1;
+    while (leaves < kMaxSize) {
+      leaves *= 2;
+    }
+    return leaves;
+  }();
+
+  /// 葉の個数。`maxs_[leaves_ + i]` が `i` 番目の要素、`maxs_[1]` が根。
+  std::size_t leaves_{1};
+  /// 和で計上するδ値の合計
+  PnDn sum_{0};
+  /// 各要素の和で計上するδ値。`Reset()` するまでは不定値。
+  std::array<PnDn, kMaxLeaves> sums_;
+  /// 最大値の木の各ノードの値。`maxs_[k]` の子は `maxs_[2 * k]` と `maxs_[2 * k + 1]`。`Reset()` するまでは不定値。
+  std::array<PnDn, 2 * kMaxLeaves> maxs_;
+};
+}  // namespace komori
+
+#endif  // KOMORI_DELTA_TREE_HPP_
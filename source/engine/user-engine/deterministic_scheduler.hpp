@@ -0,0 +1,120 @@
+/**
+ * @file deterministic_scheduler.hpp
+ */
+#ifndef KOMORI_DETERMINISTIC_SCHEDULER_HPP_
+#define KOMORI_DETERMINISTIC_SCHEDULER_HPP_
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace komori {
+/**
+ * @brief 複数スレッドの探索を決まった順番で1スレッドずつ進めるスケジューラ
+ *
+ * 複数スレッドで置換表を共有すると、どのスレッドの書き込みが先に起こるかが OS のスケジューリングで変わるので、
+ * 探索局面数が実行ごとにばらつく。このクラスを使うと、探索スレッドは番号順に1つずつ `quantum` 局面ずつ
+ * 交代で探索するようになる。スレッドの交代が時間ではなく局面数で決まるので、同じ入力からは必ず同じ探索結果と
+ * 探索局面数が得られる。ビルド間で探索局面数を比較するベンチマーク用であり、探索は1スレッド分の速さになる。
+ *
+ * 各探索スレッドは探索開始時に `Enter()`、局面を訪れるたびに `Tick()`、探索終了時に `Leave()` を呼ぶ。
+ * `quantum` が 0 のときは何もしない。
+ */
+class DeterministicScheduler {
+ public:
+  /**
+   * @brief 新しい探索の準備をする
+   * @param num_threads 探索スレッド数。番号が `num_threads` 以上のスレッドは順番を待たずに動く。
+   * @param quantum     1 回の順番で探索する局面数。0 なら順番を決めない（通常の探索）。
+   * @pre 探索スレッドが動いていないこと
+   */
+  void Start(std::uint32_t num_threads, std::uint64_t quantum) {
+    const std::lock_guard lock(mutex_);
+    quantum_ = quantum;
+    remain_ = quantum;
+    active_.assign(quantum > 0 ? num_threads : 0, true);
+    turn_ = 0;
+  }
+
+  /// 順番を決めて探索するかどうか
+  bool IsEnabled() const { return quantum_ > 0; }
+
+  /**
+   * @brief 探索を始める。スレッド `id` の順番が来るまで待つ。
+   * @param id スレッド番号
+   */
+  void Enter(std::uint32_t id) {
+    if (!IsEnabled()) {
+      return;
+    }
+
+    std::unique_lock lock(mutex_);
+    cv_.wait(lock, [&]() { return id >= active_.size() || turn_ == id; });
+  }
+
+  /**
+   * @brief 局面を1つ訪れたことを報告する。`quantum` 局面ごとに次のスレッドへ順番を譲り、再び順番が来るまで待つ。
+   * @param id スレッド番号
+   */
+  void Tick(std::uint32_t id) {
+    if (quantum_ == 0 || --remain_ > 0) {
+      return;
+    }
+
+    std::unique_lock lock(mutex_);
+    remain_ = quantum_;
+    if (id >= active_.size() || !active_[id]) {
+      return;
+    }
+
+    PassTurn(id);
+    cv_.notify_all();
+    cv_.wait(lock, [&]() { return turn_ == id; });
+  }
+
+  /**
+   * @brief 探索を終える。以後スレッド `id` には順番を回さない。
+   * @param id スレッド番号
+   */
+  void Leave(std::uint32_t id) {
+    if (!IsEnabled()) {
+      return;
+    }
+
+    const std::lock_guard lock(mutex_);
+    if (id >= active_.size() || !active_[id]) {
+      return;
+    }
+
+    active_[id] = false;
+    if (turn_ == id) {
+      remain_ = quantum_;
+      PassTurn(id);
+    }
+    cv_.notify_all();
+  }
+
+ private:
+  /// `id` の次に探索を続けているスレッドへ順番を回す。他に探索中のスレッドがなければ何もしない。
+  void PassTurn(std::uint32_t id) {
+    const auto num_threads = static_cast<std::uint32_t>(active_.size());
+    for (std::uint32_t i = 1; i < num_threads; ++i) {
+      const auto next = (id + i) % num_threads;
+      if (active_[next]) {
+        turn_ = next;
+        return;
+      }
+    }
+  }
+
+  std::mutex mutex_;             ///< `active_` と `turn_` を守るロック
+  std::condition_variable cv_;   ///< 順番が変わったことを通知する
+  std::uint64_t quantum_{0};     ///< 1 回の順番で探索する局面数
+  std::uint64_t remain_{0};      ///< 現在の順番で探索できる残りの局面数。順番を持つスレッドだけが書き換える。
+  std::vector<bool> active_;     ///< 各スレッドが探索中かどうか
+  std::uint32_t turn_{0};        ///< 現在順番を持っているスレッドの番号
+};
+}  // namespace komori
+
+#endif  // KOMORI_DETERMINISTIC_SCHEDULER_HPP_
@@ -1,6 +1,6 @@
 #include "../../extra/all.h"
 
-void user_test(Position&, std::istringstream&) {}
+void user_test(Position&, std::istringstream&, StateListPtr&) {}
 void USI::extra_option(USI::OptionsMap&) {}
 void Search::init() {}
 void Search::clear() {}
@@ -9,6 +9,7 @@
 #include <string>
 
 #include "../../usi.h"
+#include "table_memory.hpp"
 
 namespace komori {
 /**
@@ -108,6 +109,17 @@ inline const DefaultOrderedMap<std::string, PostSearchLevel> post_search_level{
     },
 };
 
+/// 置換表の NUMA 配置 `NumaPolicy` 用の Combo 定義。
+inline const DefaultOrderedMap<std::string, NumaPolicy> numa_policy_option{
+    "None",
+    NumaPolicy::kNone,
+    {
+        {"None", NumaPolicy::kNone},
+        {"Interleave", NumaPolicy::kInterleave},
+        {"FirstTouch", NumaPolicy::kFirstTouch},
+    },
+};
+
 /**
  * @brief オプション `o` から `name` の値を読み込む
  * @tparam OutType 出力値の型。`s64` や `std::string` など。デフォルト値は `s64`。
@@ -150,6 +162,12 @@ struct EngineOption {
   std::uint64_t hash_mb;   ///< ハッシュサイズ[MB]
   int threads;             ///< スレッド数
   std::uint32_t multi_pv;  ///< MultiPV
+  /// プロセス全体のメモリ予算[MB]。0 ならば予算を設けず、`hash_mb` をそのまま置換表サイズとする。
+  std::uint64_t memory_budget_mb;
+  /// 通常テーブルを置く POSIX 共有メモリの名前。空ならプロセス内に確保する。
+  std::string shared_hash_name;
+  /// 置換表の配置方針（Huge Pages、NUMA）。NUMA 配置を使う場合は探索スレッドもノードに固定する。
+  MemoryPlacement memory_placement;
 
   std::uint64_t nodes_limit;         ///< 探索局面数制限。探索量に制限がないとき、2^64-1。
   std::uint64_t pv_interval;         ///< 探索進捗を表示する間隔[ms]。0 ならば全く出力しない。
@@ -161,6 +179,25 @@ struct EngineOption {
   std::string tt_read_path;   ///< TTを読み込むファイル名
   std::string tt_write_path;  ///< TTを書き込むファイル名
 
+  std::string estimation_param_path;  ///< 初期評価パラメータファイル名。空なら組み込みのデフォルト値を使う。
+  Depth frontier_mate_ply;            ///< 初訪問の OR node で調べる奇数手詰めの手数
+  bool move_history;                  ///< 攻め方の手の履歴を子の並び順に使うかどうか
+
+  std::string tt_snapshot_path;        ///< 探索中に置換表スナップショットを書き出すファイル名
+  std::uint64_t tt_snapshot_interval;  ///< 置換表スナップショットを書き出す間隔[ms]。0 ならば書き出さない。
+
+  std::string proof_tree_path;     ///< 詰みを見つけたときに証明木を書き出すファイル名。空なら書き出さない。
+  std::string known_results_path;  ///< 探索をまたいで詰み／不詰の結果を保存するファイル名。空なら使わない。
+
+  std::string cluster_workers;     ///< クラスタモードのワーカー一覧（カンマ区切り）。空ならクラスタを使わない。
+  Depth cluster_split_ply;         ///< クラスタモードでワーカーへ配る局面を作るために root から展開する手数
+  std::uint64_t cluster_job_time;  ///< クラスタモードでワーカーへ配る探索依頼 1 回あたりの探索時間[ms]
+
+  /// 詰みを見つけた後、詰み手順から外れた応手をバックグラウンドで先読みする時間[ms]。0 ならば先読みしない。
+  std::uint64_t pre_solve_time;
+  /// 0 でなければ、探索スレッドが番号順にこの局面数ずつ交代で探索する。探索局面数を実行間で比較するベンチマーク用。
+  std::uint64_t deterministic_quantum;
+
   /// 探索結果を info string で出さない。ベンチマーク用のため `USI::OptionsMap` には登録しない
   bool silent{false};
 
@@ -175,6 +212,10 @@ struct EngineOption {
    * @param[out] o エンジンオプション
    */
   static void Init(USI::OptionsMap& o) {
+    o["MemoryBudget"] << USI::Option(0, 0, 1024 * 1024);
+    o["SharedHashName"] << USI::Option("");
+    o["HashLargePages"] << USI::Option(false);
+    o["HashNumaPolicy"] << USI::Option(detail::numa_policy_option.Keys(), detail::numa_policy_option.DefaultKey());
     o["NodesLimit"] << USI::Option(0, 0, INT64_MAX);
     o["PvInterval"] << USI::Option(1000, 0, 1000000);
 
@@ -188,6 +229,18 @@ struct EngineOption {
     o["ScoreCalculation"] << USI::Option(detail::score_caluclation_option.Keys(),
                                          detail::score_caluclation_option.DefaultKey());
     o["PostSearchLevel"] << USI::Option(detail::post_search_level.Keys(), detail::post_search_level.DefaultKey());
+    o["EstimationParamPath"] << USI::Option("");
+    o["FrontierMatePly"] << USI::Option(1, 1, 7);
+    o["MoveHistory"] << USI::Option(false);
+    o["TTSnapshotPath"] << USI::Option("");
+    o["TTSnapshotInterval"] << USI::Option(0, 0, 86400);
+    o["ProofTreePath"] << USI::Option("");
+    o["KnownResultsPath"] << USI::Option("");
+    o["ClusterWorkers"] << USI::Option("");
+    o["ClusterSplitPly"] << USI::Option(2, 0, 6);
+    o["ClusterJobTime"] << USI::Option(1000, 1, 3600 * 1000);
+    o["PreSolveTime"] << USI::Option(0, 0, 3600 * 1000);
+    o["DeterministicQuantum"] << USI::Option(0, 0, INT64_MAX);
 
 #if defined(USE_TT_SAVE_AND_LOAD)
     o["TTReadPath"] << USI::Option("");
@@ -203,6 +256,10 @@ struct EngineOption {
     hash_mb = detail::ReadOption(o, "USI_Hash");
     threads = static_cast<int>(detail::ReadOption(o, "Threads"));
     multi_pv = static_cast<std::uint32_t>(detail::MakeInfIfNotPositive(detail::ReadOption(o, "MultiPV")));
+    memory_budget_mb = static_cast<std::uint64_t>(detail::ReadOption(o, "MemoryBudget"));
+    shared_hash_name = detail::ReadOption<std::string>(o, "SharedHashName");
+    memory_placement.huge_pages = (detail::ReadOption(o, "HashLargePages") != 0);
+    memory_placement.numa = detail::numa_policy_option.Get(detail::ReadOption<std::string>(o, "HashNumaPolicy"));
 
     nodes_limit = detail::MakeInfIfNotPositive(detail::ReadOption(o, "NodesLimit"));
     pv_interval = detail::MakeInfIfNotPositive(detail::ReadOption(o, "PvInterval"));
@@ -221,6 +278,18 @@ struct EngineOption {
 
     score_method = detail::score_caluclation_option.Get(detail::ReadOption<std::string>(o, "ScoreCalculation"));
     post_search_level = detail::post_search_level.Get(detail::ReadOption<std::string>(o, "PostSearchLevel"));
+    estimation_param_path = detail::ReadOption<std::string>(o, "EstimationParamPath");
+    frontier_mate_ply = static_cast<Depth>(detail::ReadOption(o, "FrontierMatePly"));
+    move_history = (detail::ReadOption(o, "MoveHistory") != 0);
+    tt_snapshot_path = detail::ReadOption<std::string>(o, "TTSnapshotPath");
+    tt_snapshot_interval = static_cast<std::uint64_t>(detail::ReadOption(o, "TTSnapshotInterval")) * 1000;
+    proof_tree_path = detail::ReadOption<std::string>(o, "ProofTreePath");
+    known_results_path = detail::ReadOption<std::string>(o, "KnownResultsPath");
+    cluster_workers = detail::ReadOption<std::string>(o, "ClusterWorkers");
+    cluster_split_ply = static_cast<Depth>(detail::ReadOption(o, "ClusterSplitPly"));
+    cluster_job_time = static_cast<std::uint64_t>(detail::ReadOption(o, "ClusterJobTime"));
+    pre_solve_time = static_cast<std::uint64_t>(detail::ReadOption(o, "PreSolveTime"));
+    deterministic_quantum = static_cast<std::uint64_t>(detail::ReadOption(o, "DeterministicQuantum"));
 
 #if defined(USE_TT_SAVE_AND_LOAD)
     tt_read_path = detail::ReadOption<std::string>(o, "TTReadPath");
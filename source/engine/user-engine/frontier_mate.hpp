@@ -0,0 +1,158 @@
+/**
+ * @file frontier_mate.hpp
+ */
+#ifndef KOMORI_FRONTIER_MATE_HPP_
+#define KOMORI_FRONTIER_MATE_HPP_
+
+#include <algorithm>
+#include <optional>
+#include <utility>
+
+#include "hands.hpp"
+#include "mate_len.hpp"
+#include "move_picker.hpp"
+#include "node.hpp"
+#include "typedefs.hpp"
+
+namespace komori {
+namespace detail {
+/**
+ * @brief 奇数手詰め探索の成功率に応じて探索頻度を調整するカウンタ
+ *
+ * 3 手以上の詰め探索は 1 手詰めと比べて何倍も重い。詰みがほとんど見つからない問題で毎回探索すると、探索速度が
+ * 落ちるだけで得るものがない。そこで、直近 `kWindow` 回の成功率が `1 / kMinHitRatio` を下回ったら探索の間隔を
+ * 広げ、上回ったら間隔を狭める。
+ */
+class FrontierMateGate {
+ public:
+  /// 成功率を評価する探索回数
+  static constexpr std::uint32_t kWindow = 128;
+  /// 成功率の下限の逆数
+  static constexpr std::uint32_t kMinHitRatio = 3;
+  /// 探索を間引く最大間隔
+  static constexpr std::uint32_t kMaxInterval = 63;
+
+  /// 今回の局面で探索すべきかどうか
+  constexpr bool ShouldProbe() noexcept {
+    if (skip_ > 0) {
+      --skip_;
+      return false;
+    }
+    skip_ = interval_;
+    return true;
+  }
+
+  /**
+   * @brief 探索結果を記録する
+   * @param found 詰みが見つかったら `true`
+   */
+  constexpr void Record(bool found) noexcept {
+    ++tries_;
+    hits_ += found ? 1 : 0;
+    if (tries_ >= kWindow) {
+      if (hits_ * kMinHitRatio < tries_) {
+        interval_ = std::min(2 * interval_ + 1, kMaxInterval);
+      } else {
+        interval_ /= 2;
+      }
+      tries_ = hits_ = 0;
+    }
+  }
+
+  /// 現在の探索間隔。`interval` 回に 1 回だけ探索する。
+  constexpr std::uint32_t Interval() const noexcept { return interval_ + 1; }
+
+ private:
+  std::uint32_t tries_{0};     ///< 現在の評価区間での探索回数
+  std::uint32_t hits_{0};      ///< 現在の評価区間で詰みが見つかった回数
+  std::uint32_t interval_{0};  ///< 探索を見送る回数
+  std::uint32_t skip_{0};      ///< 次に探索するまでに見送る残り回数
+};
+
+/// スレッドごとの奇数手詰め探索の頻度調整カウンタ
+thread_local inline FrontierMateGate tl_frontier_mate_gate{};
+
+inline std::optional<std::pair<Hand, MateLen>> CheckMatedEvenPly(Node& n, Depth ply);
+
+/**
+ * @brief OR node `n` が `ply` 手以内に詰むかどうかを調べる
+ * @param n   現局面（OR node）
+ * @param ply 最大手数（奇数）
+ * @return 詰むなら証明駒と詰み手数。詰みが見つからなければ `std::nullopt`。
+ */
+inline std::optional<std::pair<Hand, MateLen>> CheckMateOddPly(Node& n, Depth ply) {
+  if (const auto [move, proof_hand] = CheckMate1Ply(n); proof_hand != kNullHand) {
+    return std::make_pair(proof_hand, MateLen{1});
+  }
+
+  if (ply < 3 || n.GetDepth() + ply >= kDepthMax || !DoesHaveMatePossibility(n.Pos())) {
+    return std::nullopt;
+  }
+
+  for (const auto& move : MovePicker{n}) {
+    n.DoMove(move.move);
+    const auto child = CheckMatedEvenPly(n, ply - 1);
+    n.UndoMove();
+
+    if (child) {
+      const auto [child_hand, child_len] = *child;
+      return std::make_pair(BeforeHand(n.Pos(), move.move, child_hand), child_len + 1);
+    }
+  }
+
+  return std::nullopt;
+}
+
+/**
+ * @brief AND node `n` が `ply` 手以内に詰むかどうかを調べる
+ * @param n   現局面（AND node）
+ * @param ply 最大手数（偶数）
+ * @return 詰むなら証明駒と詰み手数。詰みが見つからなければ `std::nullopt`。
+ */
+inline std::optional<std::pair<Hand, MateLen>> CheckMatedEvenPly(Node& n, Depth ply) {
+  HandSet proof_hand{ProofHandTag{}};
+  MateLen len = kZeroMateLen;
+  for (const auto& move : MovePicker{n}) {
+    n.DoMove(move.move);
+    const auto child = CheckMateOddPly(n, ply - 1);
+    n.UndoMove();
+
+    if (!child) {
+      return std::nullopt;
+    }
+
+    const auto [child_hand, child_len] = *child;
+    proof_hand.Update(child_hand);
+    len = std::max(len, child_len + 1);
+  }
+
+  return std::make_pair(proof_hand.Get(n.Pos()), len);
+}
+}  // namespace detail
+
+/**
+ * @brief 初訪問の OR node `n` で `len` 手以内の奇数手詰めを調べる
+ * @param n       現局面（OR node）
+ * @param len     残り手数
+ * @param max_ply 調べる最大手数（エンジンオプション `FrontierMatePly`）。偶数なら 1 小さい奇数に切り下げる。
+ * @return 詰むなら証明駒と詰み手数。詰みが見つからないか、探索を見送った場合は `std::nullopt`。
+ * @pre `n` は 1 手詰めではない
+ *
+ * df-pn で短い詰みを探そうとすると、しきい値を少しずつ広げながら何度も同じ局面を展開し直すことになる。
+ * 探索木の末端で短手数の詰みを直接調べることで、長手数の詰将棋の最後の数手を一気に解決できる。
+ * 探索頻度は `detail::tl_frontier_mate_gate` で調整される。`max_ply` が 3 未満なら何もしない。
+ */
+inline std::optional<std::pair<Hand, MateLen>> CheckFrontierMate(Node& n, MateLen len, Depth max_ply) {
+  auto ply = std::min<Depth>(max_ply, static_cast<Depth>(len.Len()));
+  ply -= (ply % 2 == 0 ? 1 : 0);
+  if (ply < 3 || !detail::tl_frontier_mate_gate.ShouldProbe()) {
+    return std::nullopt;
+  }
+
+  const auto result = detail::CheckMateOddPly(n, ply);
+  detail::tl_frontier_mate_gate.Record(result.has_value());
+  return result;
+}
+}  // namespace komori
+
+#endif  // KOMORI_FRONTIER_MATE_HPP_
@@ -16,7 +16,7 @@ void DeepDfpnInit(Depth d, double e) {
   g_pndn_tbl.clear();
   g_pndn_tbl.reserve(g_d);
   for (Depth di = 0; di < d; ++di) {
-    PnDn val = static_cast<PnDn>(std::pow(e, d - di));
+    PnDn val = ScalePnDn(1, std::pow(e, d - di));
     g_pndn_tbl.push_back(val);
   }
 }
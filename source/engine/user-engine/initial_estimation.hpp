@@ -4,7 +4,11 @@
 #ifndef KOMORI_PNDN_ESTIMATION_HPP_
 #define KOMORI_PNDN_ESTIMATION_HPP_
 
+#include <array>
+#include <istream>
 #include <random>
+#include <sstream>
+#include <string>
 #include <utility>
 
 #include "node.hpp"
@@ -12,10 +16,14 @@
 
 namespace komori {
 namespace detail {
-/// 駒のざっくりとした価値。スレッドごとに微妙に乱数を加えたいので thread_local にしている。
-thread_local inline int tl_pt_values[] = {
+/// 駒のざっくりとした価値のデフォルト値
+constexpr inline std::array<int, 16> kDefaultPtValues = {
     0, 10, 20, 20, 30, 50, 50, 50, 80, 50, 50, 50, 50, 80, 80, 80,
 };
+/// 駒のざっくりとした価値の基準値。`LoadEstimationParameters()` で上書きされる。
+inline std::array<int, 16> g_pt_values = kDefaultPtValues;
+/// 駒のざっくりとした価値。スレッドごとに微妙に乱数を加えたいので thread_local にしている。
+thread_local inline std::array<int, 16> tl_pt_values = kDefaultPtValues;
 
 /// df-pn+ で用いるパラメータたち
 struct DfpnPlusParameters {
@@ -37,15 +45,127 @@ struct DfpnPlusParameters {
   PnDn and_bad_dn = 2 * kPnDnUnit;      ///< AND node で悪い手の場合の dn
 };
 
+/// df-pn+ で用いるパラメータの基準値。`LoadEstimationParameters()` で上書きされる。
+inline DfpnPlusParameters g_dfpn_plus_parameters;
 /// df-pn+ で用いるパラメータ。スレッドごとに微妙に乱数を加えたいので thread_local にしている。
 thread_local inline DfpnPlusParameters tl_dfpn_plus_parameters;
+
+/**
+ * @brief パラメータファイル中の名前から `DfpnPlusParameters` のメンバへのポインタを得る
+ * @param name パラメータ名（`or_pn_base` など）
+ * @return `name` に対応するメンバへのポインタ。存在しなければ `nullptr`。
+ */
+inline PnDn DfpnPlusParameters::*FindDfpnPlusParameter(const std::string& name) {
+  // clang-format off
+  constexpr std::pair<const char*, PnDn DfpnPlusParameters::*> kParams[] = {
+      {"or_pn_base", &DfpnPlusParameters::or_pn_base},
+      {"or_dn_base", &DfpnPlusParameters::or_dn_base},
+      {"or_defense", &DfpnPlusParameters::or_defense},
+      {"or_support", &DfpnPlusParameters::or_support},
+      {"or_capture_gold_silver", &DfpnPlusParameters::or_capture_gold_silver},
+      {"or_capture_others", &DfpnPlusParameters::or_capture_others},
+      {"or_others", &DfpnPlusParameters::or_others},
+      {"and_capture_pn", &DfpnPlusParameters::and_capture_pn},
+      {"and_capture_dn", &DfpnPlusParameters::and_capture_dn},
+      {"and_king_pn", &DfpnPlusParameters::and_king_pn},
+      {"and_king_dn", &DfpnPlusParameters::and_king_dn},
+      {"and_good_pn", &DfpnPlusParameters::and_good_pn},
+      {"and_good_dn", &DfpnPlusParameters::and_good_dn},
+      {"and_bad_pn", &DfpnPlusParameters::and_bad_pn},
+      {"and_bad_dn", &DfpnPlusParameters::and_bad_dn},
+  };
+  // clang-format on
+
+  for (const auto& [key, member] : kParams) {
+    if (name == key) {
+      return member;
+    }
+  }
+  return nullptr;
+}
 }  // namespace detail
 
+/**
+ * @brief 初期評価パラメータの基準値をデフォルト値に戻す
+ *
+ * 次回 `InitBriefEvaluation()` を呼び出したタイミングで各スレッドのパラメータへ反映される。
+ */
+inline void ResetEstimationParameters() {
+  detail::g_pt_values = detail::kDefaultPtValues;
+  detail::g_dfpn_plus_parameters = detail::DfpnPlusParameters{};
+}
+
+/**
+ * @brief パラメータファイルを読み込み、初期評価パラメータの基準値を上書きする
+ * @param is 入力ストリーム
+ * @return 読み込みに成功したら `true`
+ *
+ * パラメータファイルは 1 行に 1 つ `<name> <value>` を並べたテキストファイルである。`#` 以降と空行は無視する。
+ * `<name>` には `DfpnPlusParameters` のメンバ名（`or_pn_base` など）か、駒の価値 `pt_value_<PieceType>` を指定する。
+ * ファイルに書かれていないパラメータはデフォルト値のままになる。
+ *
+ * 不正な行が含まれていた場合は `false` を返し、基準値はデフォルト値のままとなる。
+ *
+ * このファイルは `tools/tune_estimation.py` が出力することを想定している。
+ */
+inline bool LoadEstimationParameters(std::istream& is) {
+  ResetEstimationParameters();
+
+  auto pt_values = detail::kDefaultPtValues;
+  detail::DfpnPlusParameters params{};
+
+  const std::string pt_prefix = "pt_value_";
+  std::string line;
+  while (std::getline(is, line)) {
+    if (const auto comment_pos = line.find('#'); comment_pos != std::string::npos) {
+      line.erase(comment_pos);
+    }
+
+    std::istringstream line_stream(line);
+    std::string name;
+    if (!(line_stream >> name)) {
+      // 空行
+      continue;
+    }
+
+    std::int64_t value{};
+    std::string rest;
+    if (!(line_stream >> value) || (line_stream >> rest)) {
+      return false;
+    }
+
+    if (name.compare(0, pt_prefix.size(), pt_prefix) == 0) {
+      std::istringstream index_stream(name.substr(pt_prefix.size()));
+      std::size_t index{};
+      if (!(index_stream >> index) || !index_stream.eof() || index >= pt_values.size()) {
+        return false;
+      }
+      pt_values[index] = static_cast<int>(value);
+    } else if (auto member = detail::FindDfpnPlusParameter(name); member != nullptr) {
+      // pn/dn の初期値が 0 や巨大な値になると探索が壊れるので、常識的な範囲に収まっているものだけ受け付ける
+      if (value <= 0 || value > static_cast<std::int64_t>(kInfinitePnDn / 1024)) {
+        return false;
+      }
+      params.*member = static_cast<PnDn>(value);
+    } else {
+      return false;
+    }
+  }
+
+  detail::g_pt_values = pt_values;
+  detail::g_dfpn_plus_parameters = params;
+  return true;
+}
+
 /**
  * @brief 初期評価値を乱数でずらす
  * @param thread_id スレッド番号
  */
 inline void InitBriefEvaluation(std::uint32_t thread_id) {
+  // 前回の探索で加えた乱数が積み重ならないように、毎回基準値から作り直す
+  detail::tl_pt_values = detail::g_pt_values;
+  detail::tl_dfpn_plus_parameters = detail::g_dfpn_plus_parameters;
+
   // デフォルトで設定しているパラメータはシングルスレッド版の（ほぼ）最適値なので、乱数を加える必要はない
   if (thread_id != 0) {
     std::mt19937 mt(thread_id);
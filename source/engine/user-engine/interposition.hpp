@@ -0,0 +1,158 @@
+/**
+ * @file interposition.hpp
+ */
+#ifndef KOMORI_INTERPOSITION_HPP_
+#define KOMORI_INTERPOSITION_HPP_
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <utility>
+
+#include "board_key_hand_pair.hpp"
+#include "node.hpp"
+#include "search_result.hpp"
+#include "transposition_table.hpp"
+
+namespace komori {
+namespace detail {
+/// 玉と王手している駒の間にあるマスの最大数
+inline constexpr std::size_t kMaxInterpositionSquares = 7;
+/// 合駒を取り返す手の最大数（成／不成）
+inline constexpr std::size_t kMaxRecaptures = 2;
+}  // namespace detail
+
+/**
+ * @brief 飛び駒の王手に対する合駒を、取り返した後の局面の置換表エントリを使ってまとめて証明する
+ *
+ * AND node がマス c の飛び駒で王手されているとき、玉と c の間のマス s への合駒 X は、王手している駒で s の駒を
+ * 取り返すと X によらず同じ盤面になる。違うのは攻め方の持ち駒に X が加わることだけである。そのため、ある合駒の
+ * 探索で取り返した後の局面が詰むと分かれば、別の駒を s に合駒した局面も、証明駒の優等性によって置換表を1回
+ * 引くだけで詰みと分かることが多い。このような合駒（無駄合）は子局面を展開せずに詰みとして扱う。
+ *
+ * 取り返した後の局面の盤面ハッシュ値は構築時にマスごとに求めておく。盤上の駒を動かす合駒は、取り返した後の
+ * 盤面が動かした駒ごとに異なるので対象外とする。
+ */
+class InterpositionProver {
+ public:
+  /**
+   * @brief 現局面 `n` の合駒を取り返した後の局面を計算しておく
+   * @param tt 置換表
+   * @param n  現局面
+   */
+  InterpositionProver(tt::TranspositionTable& tt, const Node& n) : tt_{tt}, or_hand_{n.OrHand()} {
+    if (n.IsOrNode()) {
+      return;
+    }
+
+    const auto& pos = n.Pos();
+    const auto checkers = pos.checkers();
+    if (checkers.pop_count() != 1) {
+      return;
+    }
+
+    const auto checker_sq = checkers.pop_c();
+    const auto king_sq = n.KingSquare();
+    auto between = between_bb(king_sq, checker_sq);
+    if (!between) {
+      return;
+    }
+
+    // 合駒は取り返されて盤上から消えるので、取り返しが合法かどうかは現局面で判定できる
+    const auto or_color = ~n.Us();
+    if (pos.pinned_pieces(or_color).test(checker_sq) && !aligned(checker_sq, king_sq, pos.king_square(or_color))) {
+      return;
+    }
+
+    const auto checker = pos.piece_on(checker_sq);
+    const auto pt = type_of(checker);
+    while (between) {
+      const auto sq = between.pop();
+      auto& square = squares_[num_squares_++];
+      square.sq = sq;
+      square.num_keys = 0;
+
+      // 成れるなら成る手も調べる。ただし、成香は玉と隣接していなければ王手にならない。
+      if ((pt == ROOK || pt == BISHOP || pt == LANCE) && canPromote(or_color, checker_sq, sq) &&
+          (pt != LANCE || goldEffect(or_color, sq).test(king_sq))) {
+        square.keys[square.num_keys++] = BoardKeyAfterRecapture(n, make_move_promote(checker_sq, sq, checker));
+      }
+      square.keys[square.num_keys++] = BoardKeyAfterRecapture(n, make_move(checker_sq, sq, checker));
+    }
+  }
+
+  /**
+   * @brief 合駒 `move` が取り返した後の局面の置換表エントリから詰みと分かるか調べる
+   * @param move 現局面の合法手
+   * @param len  `move` した後の局面の残り手数
+   * @return 詰みと分かればその探索結果。それ以外なら `std::nullopt`。
+   */
+  std::optional<SearchResult> Prove(Move move, MateLen len) const {
+    if (!is_drop(move) || len < MateLen{2}) {
+      return std::nullopt;
+    }
+
+    const auto* square = Find(to_sq(move));
+    if (square == nullptr) {
+      return std::nullopt;
+    }
+
+    const auto pr = move_dropped_piece(move);
+    auto hand_after_recapture = or_hand_;
+    add_hand(hand_after_recapture, pr);
+
+    for (std::size_t i = 0; i < square->num_keys; ++i) {
+      auto query = tt_.BuildQueryByKey(BoardKeyHandPair{square->keys[i], hand_after_recapture});
+      bool does_have_old_child = false;
+      const auto result = query.LookUp(does_have_old_child, len - 1, []() { return std::make_pair(PnDn{1}, PnDn{1}); });
+      if (result.Pn() == 0) {
+        // 合駒 pr は取り返した手で攻め方の持ち駒になるので、合駒した局面の証明駒には含めなくてよい
+        auto proof_hand = result.GetFinalData().hand;
+        if (hand_exists(proof_hand, pr)) {
+          sub_hand(proof_hand, pr);
+        }
+        return SearchResult::MakeFinal<true>(proof_hand, result.Len() + 1, result.Amount());
+      }
+    }
+
+    return std::nullopt;
+  }
+
+ private:
+  /// 合駒のマスと、そのマスの駒を取り返した後の盤面ハッシュ値の一覧
+  struct InterpositionSquare {
+    Square sq;                                     ///< 合駒のマス
+    std::array<Key, detail::kMaxRecaptures> keys;  ///< 取り返した後の盤面ハッシュ値
+    std::size_t num_keys;                          ///< `keys` の有効な要素数
+  };
+
+  /**
+   * @brief 現局面で合駒をして、王手している駒が `recapture` で取り返した後の盤面ハッシュ値を計算する
+   * @param n         現局面
+   * @param recapture 合駒を取り返す手。移動先は空きマスでなければならない。
+   *
+   * 合駒は取り返されて盤上から消えるので、取り返した後の盤面は現局面で王手している駒を `recapture` で動かしたものに
+   * 等しい。ただし、2手進んでいるので手番は現局面と同じである。`Position::board_key_after()` は手番を反転させるので、
+   * 手番の分のハッシュ値（`Zobrist::side == 1`）を戻す。
+   */
+  static Key BoardKeyAfterRecapture(const Node& n, Move recapture) { return n.BoardKeyAfter(recapture) ^ Key{1}; }
+
+  /// マス `sq` の情報を探す。なければ `nullptr`。
+  const InterpositionSquare* Find(Square sq) const {
+    for (std::size_t i = 0; i < num_squares_; ++i) {
+      if (squares_[i].sq == sq) {
+        return &squares_[i];
+      }
+    }
+    return nullptr;
+  }
+
+  tt::TranspositionTable& tt_;  ///< 置換表
+  const Hand or_hand_;          ///< 現局面の攻め方の持ち駒
+  /// 合駒のマスごとの取り返した後の盤面ハッシュ値
+  std::array<InterpositionSquare, detail::kMaxInterpositionSquares> squares_;
+  std::size_t num_squares_{0};  ///< `squares_` の有効な要素数
+};
+}  // namespace komori
+
+#endif  // KOMORI_INTERPOSITION_HPP_
@@ -0,0 +1,480 @@
+/**
+ * @file known_result_table.hpp
+ */
+#ifndef KOMORI_KNOWN_RESULT_TABLE_HPP_
+#define KOMORI_KNOWN_RESULT_TABLE_HPP_
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif  // !defined(_WIN32)
+
+#include "mate_len.hpp"
+#include "search_result.hpp"
+#include "typedefs.hpp"
+
+namespace komori::tt {
+namespace detail {
+/// 既知結果ファイルのマジックナンバー
+constexpr inline char kKnownResultMagic[4] = {'K', 'H', 'K', 'R'};
+/// 既知結果ファイルのフォーマットバージョン
+constexpr inline std::uint32_t kKnownResultVersion = 1;
+/// 既知結果として保存する探索量の下限。これより軽い結果は探索し直したほうが安い。
+constexpr inline SearchAmount kKnownResultMinAmount{64};
+/// 未整列領域が整列済領域の 1/kKnownResultCompactionRatio を超えたら compaction を行う
+constexpr inline std::size_t kKnownResultCompactionRatio = 8;
+
+/**
+ * @brief 既知結果ファイルのヘッダ
+ */
+struct KnownResultHeader {
+  char magic[4];               ///< `kKnownResultMagic`
+  std::uint32_t version;       ///< `kKnownResultVersion`
+  std::uint64_t sorted_count;  ///< 先頭から何レコードが整列済みか
+};
+
+/**
+ * @brief 既知結果ファイルの 1 レコード
+ */
+struct KnownResultRecord {
+  Key board_key;           ///< 盤面ハッシュ値
+  Hand hand;               ///< 証明駒（詰み）または反証駒（不詰）
+  MateLen16 len;           ///< 詰み手数（詰み）または不詰手数（不詰）
+  std::uint8_t is_proven;  ///< 詰みなら 1、不詰なら 0
+  std::uint8_t or_color;   ///< 攻め方の手番
+};
+
+static_assert(sizeof(KnownResultHeader) == 16, "The size of KnownResultHeader must be 16.");
+static_assert(sizeof(KnownResultRecord) == 16, "The size of KnownResultRecord must be 16.");
+
+/// レコードの並び順。同一盤面・同一攻め方・同一種別のレコードが連続するように並べる。
+inline bool KnownResultLess(const KnownResultRecord& lhs, const KnownResultRecord& rhs) noexcept {
+  return std::make_tuple(lhs.board_key, lhs.or_color, lhs.is_proven, lhs.hand) <
+         std::make_tuple(rhs.board_key, rhs.or_color, rhs.is_proven, rhs.hand);
+}
+
+/**
+ * @brief `lhs` が分かっていれば `rhs` が不要かどうか
+ * @pre `lhs` と `rhs` は同一盤面・同一攻め方・同一種別
+ *
+ * 詰みなら証明駒が少なく詰み手数が短い方が、不詰なら反証駒が多く不詰手数が長い方が強い結果である。
+ */
+inline bool KnownResultDominates(const KnownResultRecord& lhs, const KnownResultRecord& rhs) noexcept {
+  if (lhs.is_proven) {
+    return hand_is_equal_or_superior(rhs.hand, lhs.hand) && lhs.len <= rhs.len;
+  } else {
+    return hand_is_equal_or_superior(lhs.hand, rhs.hand) && lhs.len >= rhs.len;
+  }
+}
+
+/**
+ * @brief `records` を整列し、重複および他のレコードから導けるレコードを取り除く
+ * @param records レコード一覧
+ */
+inline void CompactKnownResults(std::vector<KnownResultRecord>& records) {
+  std::sort(records.begin(), records.end(), KnownResultLess);
+
+  std::vector<KnownResultRecord> compacted;
+  compacted.reserve(records.size());
+  for (auto first = records.begin(); first != records.end();) {
+    auto last = std::find_if(first, records.end(), [&](const KnownResultRecord& record) {
+      return record.board_key != first->board_key || record.or_color != first->or_color ||
+             record.is_proven != first->is_proven;
+    });
+
+    // 同一盤面のレコードはたかだか数個なので愚直に比較する
+    for (auto itr = first; itr != last; ++itr) {
+      const bool is_dominated = std::any_of(first, last, [&](const KnownResultRecord& other) {
+        // 互いに導ける（等価な）レコード同士では先頭のものだけを残す
+        return &other != &*itr && KnownResultDominates(other, *itr) &&
+               (!KnownResultDominates(*itr, other) || &other < &*itr);
+      });
+      if (!is_dominated) {
+        compacted.push_back(*itr);
+      }
+    }
+    first = last;
+  }
+
+  records.swap(compacted);
+}
+}  // namespace detail
+
+/**
+ * @brief 探索をまたいで詰み／不詰の結果を覚えておくための永続化テーブル
+ *
+ * 通常テーブルは容量に限りがあり、GC で final な結果も消えてしまう。また、プロセスを終了すると探索結果はすべて
+ * 失われる。このクラスは、十分な探索量をかけて得た詰み／不詰の結果を (盤面, 証明駒／反証駒, 手数) の組として
+ * ファイルへ追記していき、以後の探索で置換表を引き損ねたときの 2 段目の参照先として用いる。
+ *
+ * ## ファイル形式
+ *
+ * ヘッダ（`detail::KnownResultHeader`）の後ろに `detail::KnownResultRecord` が並ぶ。先頭 `sorted_count` 個は
+ * 整列済み（compaction 済み）で、それ以降は探索終了時に追記された未整列のレコードである。整列済み領域はメモリに
+ * マップして二分探索で参照し、未整列領域は整列したコピーをメモリ上に持つ。未整列領域がある程度大きくなったら
+ * 全体を compaction して書き直す。
+ *
+ * ## スレッド安全性
+ *
+ * `LookUp()` と `Append()` は探索中に複数スレッドから同時に呼び出してよい。`Append()` したレコードは `Flush()` を
+ * 呼ぶまで `LookUp()` の対象にならない。`Open()`, `Close()`, `Flush()` は探索中に呼び出してはならない。
+ */
+class KnownResultTable {
+ public:
+  /// Default constructor(default)
+  KnownResultTable() = default;
+  /// Copy constructor(delete)
+  KnownResultTable(const KnownResultTable&) = delete;
+  /// Move constructor(delete)
+  KnownResultTable(KnownResultTable&&) = delete;
+  /// Copy assign operator(delete)
+  KnownResultTable& operator=(const KnownResultTable&) = delete;
+  /// Move assign operator(delete)
+  KnownResultTable& operator=(KnownResultTable&&) = delete;
+  /// Destructor。書き出していない結果があればファイルへ追記する。
+  ~KnownResultTable() { Close(); }
+
+  /**
+   * @brief ファイル `path` を開く
+   * @param path ファイル名。存在しなければ新規に作成する。
+   * @return 開けたら `true`
+   *
+   * すでに別のファイルを開いている場合、いったん閉じてから開き直す。未整列のレコードが残っている場合は
+   * この時点で compaction を行う。
+   */
+  bool Open(const std::string& path) {
+    Close();
+
+    path_ = path;
+    if (!Map()) {
+      // 既知結果ファイル以外のファイルを上書きしないように、中身があるのに読めないファイルは開かない
+      if (std::ifstream ifs(path_, std::ios::binary | std::ios::ate); ifs && ifs.tellg() > 0) {
+        path_.clear();
+        return false;
+      }
+    }
+
+    if (file_record_count_ != sorted_count_) {
+      std::vector<detail::KnownResultRecord> records(sorted_, sorted_ + file_record_count_);
+      if (!Compact(std::move(records))) {
+        Close();
+        return false;
+      }
+    } else if (mapped_ == nullptr && !Compact({})) {
+      Close();
+      return false;
+    }
+
+    BuildFilter();
+    return true;
+  }
+
+  /**
+   * @brief ファイルを閉じる。書き出していない結果があればファイルへ追記する。
+   */
+  void Close() {
+    if (IsOpen()) {
+      Flush();
+    }
+
+    Unmap();
+    path_.clear();
+    tail_.clear();
+    tail_.shrink_to_fit();
+    filter_.clear();
+    filter_.shrink_to_fit();
+    filter_mask_ = 0;
+  }
+
+  /// ファイルを開いているかどうか
+  bool IsOpen() const noexcept { return !path_.empty(); }
+
+  /**
+   * @brief 新しい探索を始める
+   * @param or_color 攻め方の手番
+   */
+  void NewSearch(Color or_color) noexcept { or_color_ = or_color; }
+
+  /**
+   * @brief 局面 (`board_key`, `hand`) の `len` 手詰めの結果を探す
+   * @param board_key 盤面ハッシュ値
+   * @param hand      攻め方の持ち駒
+   * @param len       探している詰み手数
+   * @return 詰みまたは不詰が分かればその結果。分からなければ `std::nullopt`。
+   */
+  std::optional<SearchResult> LookUp(Key board_key, Hand hand, MateLen len) const noexcept {
+    if (!MayContain(board_key)) {
+      return std::nullopt;
+    }
+
+    if (auto result = LookUpRange(sorted_, sorted_ + sorted_count_, board_key, hand, len)) {
+      return result;
+    }
+    return LookUpRange(tail_.data(), tail_.data() + tail_.size(), board_key, hand, len);
+  }
+
+  /**
+   * @brief 詰みまたは不詰の結果を追記候補に加える
+   * @param board_key 盤面ハッシュ値
+   * @param hand      証明駒（詰み）または反証駒（不詰）
+   * @param len       詰み手数（詰み）または不詰手数（不詰）
+   * @param is_proven 詰みなら `true`
+   * @param amount    結果を得るのにかかった探索量
+   *
+   * 探索量が少ない結果は保存しない。ファイルへの書き出しは `Flush()` で行う。
+   */
+  void Append(Key board_key, Hand hand, MateLen len, bool is_proven, SearchAmount amount) {
+    if (amount < detail::kKnownResultMinAmount) {
+      return;
+    }
+
+    const detail::KnownResultRecord record{board_key, hand, MateLen16{len}, static_cast<std::uint8_t>(is_proven),
+                                           static_cast<std::uint8_t>(or_color_)};
+    const std::lock_guard lock(pending_mutex_);
+    pending_.push_back(record);
+  }
+
+  /**
+   * @brief 追記候補をファイルへ書き出し、`LookUp()` の対象にする
+   * @return 書き出しに成功したら `true`
+   *
+   * 未整列領域が十分大きくなっていたら、追記の代わりに compaction を行ってファイル全体を書き直す。
+   */
+  bool Flush() {
+    std::vector<detail::KnownResultRecord> pending;
+    {
+      const std::lock_guard lock(pending_mutex_);
+      pending.swap(pending_);
+    }
+
+    if (!IsOpen() || pending.empty()) {
+      return true;
+    }
+
+    if ((tail_.size() + pending.size()) * detail::kKnownResultCompactionRatio > sorted_count_) {
+      std::vector<detail::KnownResultRecord> records(sorted_, sorted_ + sorted_count_);
+      records.insert(records.end(), tail_.begin(), tail_.end());
+      records.insert(records.end(), pending.begin(), pending.end());
+      const bool ok = Compact(std::move(records));
+      BuildFilter();
+      return ok;
+    }
+
+    std::ofstream ofs(path_, std::ios::binary | std::ios::app);
+    ofs.write(reinterpret_cast<const char*>(pending.data()),
+              static_cast<std::streamsize>(pending.size() * sizeof(detail::KnownResultRecord)));
+    if (!ofs) {
+      return false;
+    }
+
+    tail_.insert(tail_.end(), pending.begin(), pending.end());
+    std::sort(tail_.begin(), tail_.end(), detail::KnownResultLess);
+    BuildFilter();
+    return true;
+  }
+
+  /// `LookUp()` の対象になっているレコード数
+  std::size_t Size() const noexcept { return sorted_count_ + tail_.size(); }
+
+ private:
+  /**
+   * @brief 整列済み領域 `[begin, end)` から (`board_key`, `hand`) の結果を探す
+   */
+  std::optional<SearchResult> LookUpRange(const detail::KnownResultRecord* begin,
+                                          const detail::KnownResultRecord* end,
+                                          Key board_key,
+                                          Hand hand,
+                                          MateLen len) const noexcept {
+    const auto or_color = static_cast<std::uint8_t>(or_color_);
+    auto itr = std::lower_bound(begin, end, std::make_pair(board_key, or_color),
+                                [](const detail::KnownResultRecord& record, const std::pair<Key, std::uint8_t>& key) {
+                                  return std::make_pair(record.board_key, record.or_color) < key;
+                                });
+
+    for (; itr != end && itr->board_key == board_key && itr->or_color == or_color; ++itr) {
+      const MateLen record_len{itr->len};
+      if (itr->is_proven) {
+        if (len >= record_len && hand_is_equal_or_superior(hand, itr->hand)) {
+          return SearchResult::MakeFinal<true>(itr->hand, record_len, detail::kKnownResultMinAmount);
+        }
+      } else {
+        if (len <= record_len && hand_is_equal_or_superior(itr->hand, hand)) {
+          return SearchResult::MakeFinal<false>(itr->hand, record_len, detail::kKnownResultMinAmount);
+        }
+      }
+    }
+
+    return std::nullopt;
+  }
+
+  /**
+   * @brief `records` を compaction してファイル全体を書き直し、マップし直す
+   * @param records 全レコード
+   * @return 成功したら `true`
+   *
+   * 一時ファイルへ書き出してから置き換えるので、書き出しの途中で中断してもファイルが壊れることはない。
+   */
+  bool Compact(std::vector<detail::KnownResultRecord> records) {
+    detail::CompactKnownResults(records);
+
+    const auto tmp_path = path_ + ".tmp";
+    {
+      detail::KnownResultHeader header{};
+      std::memcpy(header.magic, detail::kKnownResultMagic, sizeof(header.magic));
+      header.version = detail::kKnownResultVersion;
+      header.sorted_count = records.size();
+
+      std::ofstream ofs(tmp_path, std::ios::binary);
+      ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+      ofs.write(reinterpret_cast<const char*>(records.data()),
+                static_cast<std::streamsize>(records.size() * sizeof(detail::KnownResultRecord)));
+      if (!ofs) {
+        return false;
+      }
+    }
+
+    Unmap();
+    tail_.clear();
+    if (std::rename(tmp_path.c_str(), path_.c_str()) != 0) {
+      return false;
+    }
+    return Map();
+  }
+
+  /**
+   * @brief `path_` をメモリにマップする
+   * @return ヘッダが正しく読めたら `true`
+   */
+  bool Map() {
+    Unmap();
+
+    std::size_t file_size = 0;
+#if defined(_WIN32)
+    std::ifstream ifs(path_, std::ios::binary | std::ios::ate);
+    if (!ifs) {
+      return false;
+    }
+    file_size = static_cast<std::size_t>(ifs.tellg());
+    buffer_.resize((file_size + sizeof(detail::KnownResultRecord) - 1) / sizeof(detail::KnownResultRecord));
+    ifs.seekg(0);
+    ifs.read(reinterpret_cast<char*>(buffer_.data()), static_cast<std::streamsize>(file_size));
+    mapped_ = buffer_.data();
+#else
+    const int fd = ::open(path_.c_str(), O_RDONLY);
+    if (fd < 0) {
+      return false;
+    }
+
+    struct stat st {};
+    if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+      file_size = static_cast<std::size_t>(st.st_size);
+      void* const ptr = ::mmap(nullptr, file_size, PROT_READ, MAP_SHARED, fd, 0);
+      if (ptr != MAP_FAILED) {
+        mapped_ = ptr;
+        mapped_bytes_ = file_size;
+      }
+    }
+    ::close(fd);
+#endif  // defined(_WIN32)
+
+    if (mapped_ == nullptr || file_size < sizeof(detail::KnownResultHeader)) {
+      Unmap();
+      return false;
+    }
+
+    const auto* const header = static_cast<const detail::KnownResultHeader*>(mapped_);
+    file_record_count_ = (file_size - sizeof(detail::KnownResultHeader)) / sizeof(detail::KnownResultRecord);
+    if (std::memcmp(header->magic, detail::kKnownResultMagic, sizeof(header->magic)) != 0 ||
+        header->version != detail::kKnownResultVersion || header->sorted_count > file_record_count_) {
+      Unmap();
+      return false;
+    }
+
+    sorted_ = reinterpret_cast<const detail::KnownResultRecord*>(header + 1);
+    sorted_count_ = header->sorted_count;
+    return true;
+  }
+
+  /// マップを解除する
+  void Unmap() {
+#if defined(_WIN32)
+    buffer_.clear();
+    buffer_.shrink_to_fit();
+#else
+    if (mapped_ != nullptr) {
+      ::munmap(mapped_, mapped_bytes_);
+    }
+    mapped_bytes_ = 0;
+#endif  // defined(_WIN32)
+    mapped_ = nullptr;
+    sorted_ = nullptr;
+    sorted_count_ = 0;
+    file_record_count_ = 0;
+  }
+
+  /**
+   * @brief 盤面ハッシュ値のフィルタを作り直す
+   *
+   * 置換表を引き損ねるたびに二分探索をすると遅いので、レコード数の 8 倍程度のビット列で存在しない盤面を先に弾く。
+   */
+  void BuildFilter() {
+    std::uint64_t bits = 64;
+    while (bits < 8 * Size()) {
+      bits *= 2;
+    }
+    filter_.assign(bits / 64, 0);
+    filter_mask_ = bits - 1;
+
+    const auto add = [this](const detail::KnownResultRecord& record) {
+      const auto index = record.board_key & filter_mask_;
+      filter_[index / 64] |= std::uint64_t{1} << (index % 64);
+    };
+    std::for_each(sorted_, sorted_ + sorted_count_, add);
+    std::for_each(tail_.begin(), tail_.end(), add);
+  }
+
+  /// 盤面 `board_key` のレコードが存在する可能性があるかどうか
+  bool MayContain(Key board_key) const noexcept {
+    if (filter_.empty()) {
+      return false;
+    }
+    const auto index = board_key & filter_mask_;
+    return (filter_[index / 64] >> (index % 64)) & 1;
+  }
+
+  std::string path_;       ///< ファイル名。空ならファイルを開いていない。
+  Color or_color_{BLACK};  ///< 現在の探索の攻め方の手番
+
+  void* mapped_{nullptr};  ///< マップしたファイル先頭
+#if defined(_WIN32)
+  std::vector<detail::KnownResultRecord> buffer_;  ///< ファイルの中身（mmap が使えない環境用）
+#else
+  std::size_t mapped_bytes_{0};  ///< マップしたバイト数
+#endif  // defined(_WIN32)
+  const detail::KnownResultRecord* sorted_{nullptr};  ///< 整列済み領域の先頭
+  std::size_t sorted_count_{0};                       ///< 整列済み領域のレコード数
+  std::size_t file_record_count_{0};                  ///< `Map()` 時点のファイル中の全レコード数
+
+  std::vector<detail::KnownResultRecord> tail_;  ///< 未整列領域を整列したもの
+  std::vector<std::uint64_t> filter_;            ///< 盤面ハッシュ値のフィルタ
+  std::uint64_t filter_mask_{0};                 ///< フィルタのビット位置のマスク
+
+  std::mutex pending_mutex_;                        ///< `pending_` を保護する mutex
+  std::vector<detail::KnownResultRecord> pending_;  ///< ファイルへ書き出していない結果
+};
+}  // namespace komori::tt
+
+#endif  // KOMORI_KNOWN_RESULT_TABLE_HPP_
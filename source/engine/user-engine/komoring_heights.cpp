@@ -1,8 +1,23 @@
 ﻿#include "komoring_heights.hpp"
 
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <variant>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif  // defined(__linux__)
+
 #include "../../usi.h"
 #include "mate_len.hpp"
+#include "memory_budget.hpp"
 #include "search_result.hpp"
+#include "thread_initialization.hpp"
 #include "typedefs.hpp"
 
 namespace komori {
@@ -10,11 +25,30 @@ namespace {
 /// GC で削除するエントリの割合
 constexpr double kGcRemovalRatio = 0.5;
 static_assert(kGcRemovalRatio > 0 && kGcRemovalRatio < 1.0, "kGcRemovalRatio must be greater than 0 and less than 1");
+/// 置換表スナップショットの先頭行。エントリのレイアウトを変えたらバージョンを上げること。
+#if defined(USE_32BIT_PNDN)
+/// `Entry` のレイアウトが異なるので、64 bit 版のスナップショットとは区別する
+constexpr char kSnapshotHeader[] = "kh-tt-snapshot 1 pndn32";
+#else
+constexpr char kSnapshotHeader[] = "kh-tt-snapshot 1";
+#endif
+/// クラスタモードで展開する局面数の上限。これを超えたらそれ以上深く展開しない。
+constexpr std::size_t kClusterMaxFrontierSize = 4096;
+
+/**
+ * @brief クラスタモードでワーカーへ配る局面
+ */
+struct ClusterSite {
+  std::string sfen;                ///< 局面
+  BoardKeyHandPair key_hand_pair;  ///< 盤面ハッシュ値と攻め方の持ち駒
+  bool or_node;                    ///< OR node かどうか
+};
 
 // 反復深化のしきい値を適当に伸ばす
 std::pair<PnDn, PnDn> NextPnDnThresholds(PnDn pn, PnDn dn, PnDn curr_thpn, PnDn curr_thdn) {
-  const auto thpn = static_cast<PnDn>(static_cast<double>(pn) * (1.7 + 0.3 * tl_thread_id)) + 1;
-  const auto thdn = static_cast<PnDn>(static_cast<double>(dn) * (1.7 + 0.3 * tl_thread_id)) + 1;
+  // ScalePnDn() は kInfinitePnDn で頭打ちになるので、+1 した後にもう一度丸めないと ClampPnDn() の min > max になる
+  const auto thpn = std::min(ScalePnDn(pn, 1.7 + 0.3 * tl_thread_id) + 1, kInfinitePnDn);
+  const auto thdn = std::min(ScalePnDn(dn, 1.7 + 0.3 * tl_thread_id) + 1, kInfinitePnDn);
 
   return std::make_pair(ClampPnDn(curr_thpn, thpn, kInfinitePnDn), ClampPnDn(curr_thdn, thdn, kInfinitePnDn));
 }
@@ -39,6 +73,56 @@ std::optional<Move> GetEvasion(tt::TranspositionTable& tt, Node& n) {
   return std::nullopt;
 }
 
+/**
+ * @brief 局面 `n` から `ply` 手だけ展開して `frontier` へ追加する
+ * @param tt       置換表
+ * @param n        現局面
+ * @param ply      残り展開手数
+ * @param parent   `n` の親のノード番号
+ * @param init     `n` の pn/dn の初期値
+ * @param frontier 展開先の AND/OR 木
+ * @param sites    `frontier` の各ノードに対応する局面
+ */
+void ExpandClusterFrontier(tt::TranspositionTable& tt,
+                           Node& n,
+                           Depth ply,
+                           std::uint32_t parent,
+                           std::pair<PnDn, PnDn> init,
+                           ClusterFrontier& frontier,
+                           std::vector<ClusterSite>& sites) {
+  const auto add_node = [&](PnDn pn, PnDn dn) {
+    sites.push_back({n.Pos().sfen(), n.GetBoardKeyHandPair(), n.IsOrNode()});
+    return frontier.AddNode(parent, n.IsOrNode(), pn, dn);
+  };
+
+  // 経路上の局面に戻る手は、OR node / AND node のどちらから見ても詰みにつながらない
+  if (n.IsRepetition()) {
+    add_node(kInfinitePnDn, 0);
+    return;
+  }
+
+  MovePicker mp{n};
+  if (mp.empty()) {
+    n.IsOrNode() ? add_node(kInfinitePnDn, 0) : add_node(0, kInfinitePnDn);
+    return;
+  }
+
+  if (ply <= 0 || frontier.Size() >= kClusterMaxFrontierSize) {
+    bool does_have_old_child = false;
+    const auto result = tt.BuildQuery(n).LookUp(does_have_old_child, kDepthMaxMateLen, [&init]() { return init; });
+    add_node(result.Pn(), result.Dn());
+    return;
+  }
+
+  const auto index = add_node(init.first, init.second);
+  for (const auto move : mp) {
+    const auto child_init = InitialPnDn(n, move.move);
+    n.DoMove(move.move);
+    ExpandClusterFrontier(tt, n, ply - 1, index, child_init, frontier, sites);
+    n.UndoMove();
+  }
+}
+
 std::pair<Move, MateLen> LookUpBestMove(tt::TranspositionTable& tt, Node& n, MateLen len) {
   Move best_move = MOVE_NONE;
   MateLen best_len = n.IsOrNode() ? kDepthMaxMateLen : kZeroMateLen;
@@ -118,11 +202,54 @@ std::pair<Move, MateLen> LookUpMaxDisprovenAndNode(tt::TranspositionTable& tt, N
 }
 }  // namespace
 
+KomoringHeights::~KomoringHeights() {
+  StopPreSolve();
+}
+
 void KomoringHeights::Init(const EngineOption& option, std::uint32_t num_threads) {
+  StopPreSolve();
+  checkpoint_thread_.Stop();
+  info_printer_.Stop();
   option_ = option;
-  tt_.Resize(option_.hash_mb);
-  expansion_list_.resize(num_threads);
+  solved_line_ = SolvedLine{};
+  auto hash_mb = option_.hash_mb;
+  max_depth_ = kDepthMax;
+  if (option_.memory_budget_mb > 0) {
+    const auto plan = PlanMemory(option_.memory_budget_mb, num_threads, sizeof(Node), sizeof(LocalExpansion));
+    hash_mb = plan.hash_mb;
+    max_depth_ = plan.max_depth;
+  }
+  tt_.SetPlacement(option_.memory_placement);
+  if (const auto& name = option_.shared_hash_name; name.empty()) {
+    tt_.Resize(hash_mb, num_threads);
+  } else if (tt_.AttachShared(name, hash_mb, num_threads)) {
+    if (!option_.silent) {
+      sync_cout << "info string shared hash: " << name << " (" << tt_.Capacity() << " entries)" << sync_endl;
+    }
+  } else {
+    sync_cout << "info string error: failed to attach shared hash: " << name << sync_endl;
+  }
+
+  tt_.SetKnownResultTable(nullptr);
+  known_results_.Close();
+  if (const auto& path = option_.known_results_path; !path.empty()) {
+    if (known_results_.Open(path)) {
+      tt_.SetKnownResultTable(&known_results_);
+      if (!option_.silent) {
+        sync_cout << "info string known results: " << path << " (" << known_results_.Size() << " entries)"
+                  << sync_endl;
+      }
+    } else {
+      sync_cout << "info string error: failed to open known results: " << path << sync_endl;
+    }
+  }
+  // 先読みスレッドは探索スレッドの後ろの番号を使う
+  expansion_list_.resize(option_.pre_solve_time > 0 ? num_threads + 1 : num_threads);
   expansion_list_.shrink_to_fit();
+#if defined(USE_SEARCH_PROFILER)
+  profiles_.resize(expansion_list_.size());
+#endif  // defined(USE_SEARCH_PROFILER)
+  PrintMemoryUsage("isready");
 
 #if defined(USE_TT_SAVE_AND_LOAD)
   const auto& tt_read_path = option_.tt_read_path;
@@ -137,29 +264,125 @@ void KomoringHeights::Init(const EngineOption& option, std::uint32_t num_threads
 }
 
 void KomoringHeights::Clear() {
-  tt_.Clear();
+  StopPreSolve();
+  solved_line_ = SolvedLine{};
+  if (!tt_.IsShared()) {
+    tt_.Clear();
+  }
 }
 
-void KomoringHeights::NewSearch(const Position& n, bool is_root_or_node) {
+void KomoringHeights::NewSearch(const Position& n, bool is_root_or_node, const SearchContext& context) {
+  StopPreSolve();
   auto& nn = const_cast<Position&>(n);
   const Node node{nn, is_root_or_node};
 
   tt_.NewSearch();
-  monitor_.NewSearch(tt_.Capacity(), option_.pv_interval, option_.nodes_limit);
+  known_results_.NewSearch(node.OrColor());
+  move_history_.Clear();
+  move_history_.SetEnabled(option_.move_history);
+  monitor_.NewSearch(tt_.Capacity(), option_.pv_interval, option_.nodes_limit, context);
+  scheduler_.Start(static_cast<std::uint32_t>(context.threads.size()), option_.deterministic_quantum);
   best_moves_.clear();
   score_ = Score{};
   pv_list_.NewSearch(node);
+  root_sfen_ = n.sfen();
+#if defined(USE_SEARCH_PROFILER)
+  for (auto& profile : profiles_) {
+    profile.Clear();
+  }
+#endif  // defined(USE_SEARCH_PROFILER)
 
   if (tt_.Hashfull() >= kExecuteGcHashfullThreshold) {
     tt_.CollectGarbage(kGcRemovalRatio);
   }
+
+  if (!option_.tt_snapshot_path.empty() && option_.tt_snapshot_interval > 0) {
+    checkpoint_thread_.Start(option_.tt_snapshot_interval, [this]() { SaveSnapshot(); });
+  }
+  if (!option_.silent) {
+    info_printer_.Start();
+  }
+}
+
+void KomoringHeights::RunCluster(const Position& n, bool is_root_or_node) {
+  const auto addresses = ParseClusterWorkers(option_.cluster_workers);
+  if (addresses.empty()) {
+    return;
+  }
+
+  ClusterCoordinator coordinator;
+  for (const auto& address : addresses) {
+    if (!coordinator.Connect(address)) {
+      sync_cout << "info string error: failed to connect to cluster worker: " << address << sync_endl;
+    }
+  }
+  if (coordinator.Size() == 0) {
+    return;
+  }
+
+  auto& nn = const_cast<Position&>(n);
+  const auto node = std::make_unique<Node>(nn, is_root_or_node);
+  ClusterFrontier frontier;
+  std::vector<ClusterSite> sites;
+  ExpandClusterFrontier(tt_, *node, option_.cluster_split_ply, ClusterFrontier::kNoParent,
+                        {kPnDnUnit, kPnDnUnit}, frontier, sites);
+
+  const auto make_job = [&](std::uint32_t leaf, std::uint32_t trial) -> std::variant<ClusterJob, ClusterResult> {
+    // 同じ局面が別の経路ですでに解けていれば配らない
+    const auto& site = sites[leaf];
+    bool does_have_old_child = false;
+    const auto result = tt_.BuildQueryByKey(site.key_hand_pair)
+                            .LookUp(does_have_old_child, kDepthMaxMateLen,
+                                    [&]() { return std::make_pair(frontier.Pn(leaf), frontier.Dn(leaf)); });
+    if (result.GetNodeState() == NodeState::kProven || result.GetNodeState() == NodeState::kDisproven) {
+      return ClusterResult{0, result.Pn(), result.Dn(), result.GetFinalData().hand, result.Len().Len(),
+                           result.Amount()};
+    }
+
+    // 再送のたびに探索時間を倍にするが、時間制限のない探索でも止めやすいように上限を設ける
+    const auto max_time_ms = std::max(option_.cluster_job_time, detail::kClusterMaxRetryTimeMs);
+    const auto time_ms =
+        std::min(option_.cluster_job_time << std::min(trial, detail::kClusterMaxRetryShift), max_time_ms);
+    const auto remaining = static_cast<std::uint64_t>(std::max<TimePoint>(monitor_.RemainingTime(), 1));
+    return ClusterJob{0, std::min(time_ms, remaining), site.or_node, site.sfen};
+  };
+  const auto on_result = [&](std::uint32_t leaf, const ClusterResult& result) {
+    const auto query = tt_.BuildQueryByKey(sites[leaf].key_hand_pair);
+    const MateLen len{result.len};
+    if (result.pn == 0) {
+      query.SetResult(SearchResult::MakeFinal<true>(result.hand, len, result.amount));
+    } else if (result.dn == 0) {
+      query.SetResult(SearchResult::MakeFinal<false>(result.hand, len, result.amount));
+    }
+  };
+  const auto should_stop = [this]() { return monitor_.IsStopRequested() || monitor_.RemainingTime() <= 0; };
+
+  const auto received = coordinator.Run(frontier, make_job, on_result, should_stop);
+  if (!option_.silent) {
+    const auto root_state = frontier.RootState();
+    sync_cout << "info string cluster: " << addresses.size() << " workers, " << frontier.Size() << " nodes, "
+              << received << " results, root "
+              << (root_state == NodeState::kProven      ? "proven"
+                  : root_state == NodeState::kDisproven ? "disproven"
+                                                        : "unknown")
+              << sync_endl;
+  }
 }
 
 NodeState KomoringHeights::Search(const Position& n, bool is_root_or_node) {
   auto& nn = const_cast<Position&>(n);
   Node node{nn, is_root_or_node};
 
+  if (option_.memory_placement.numa != NumaPolicy::kNone) {
+    // 置換表を NUMA ノードへ分散させたので、探索スレッドもノードへ均等に固定する
+    BindThisThreadToNumaNode(tl_thread_id);
+  }
+  scheduler_.Enter(tl_thread_id);
   auto [state, len] = SearchMainLoop(node);
+  if (tl_thread_id == 0) {
+    checkpoint_thread_.Stop();
+    info_printer_.Stop();
+  }
 
 #if defined(USE_TT_SAVE_AND_LOAD)
   const auto tt_write_path = option_.tt_write_path;
@@ -172,21 +395,392 @@ NodeState KomoringHeights::Search(const Position& n, bool is_root_or_node) {
   }
 #endif  // defined(USE_TT_SAVE_AND_LOAD)
 
+  if (tl_thread_id == 0) {
+    solved_line_ = SolvedLine{};
+  }
   if (tl_thread_id == 0 && state == NodeState::kProven) {
     if (best_moves_.size() % 2 != static_cast<int>(is_root_or_node)) {
       sync_cout << "info string Failed to detect PV" << sync_endl;
+    } else {
+      RecordSolvedLine(node, best_moves_);
+    }
+
+    if (const auto& path = option_.proof_tree_path; !path.empty()) {
+      // 余詰探索が中断された場合 len は詰み手数より短くなっているので、見つかった詰み手順の手数を上限とする
+      ProofTree tree{n.sfen(), node.OrColor()};
+      const MateLen mate_len{static_cast<std::uint32_t>(best_moves_.size())};
+      pv_search_ = true;
+      const auto root = ExportProofTree(node, mate_len, tree);
+      pv_search_ = false;
+
+      std::ofstream ofs(path, std::ios::binary);
+      if (root && ofs && tree.Write(ofs)) {
+        sync_cout << "info string proof tree: " << path << " (" << tree.Nodes().size() << " nodes)" << sync_endl;
+      } else {
+        sync_cout << "info string error: failed to export proof tree: " << path << sync_endl;
+      }
     }
   }
 
+  if (tl_thread_id == 0 && scheduler_.IsEnabled()) {
+    // 他のスレッドが順番を得たときにはもう止まっているようにしないと、止まるまでの探索局面数が実行ごとに変わる
+    monitor_.Stop();
+  }
+  scheduler_.Leave(tl_thread_id);
+
   return state;
 }
 
+void KomoringHeights::FinishSearch() {
+  if (known_results_.IsOpen() && !known_results_.Flush()) {
+    sync_cout << "info string error: failed to write known results: " << option_.known_results_path << sync_endl;
+  }
+  PrintMemoryUsage("search");
+
+#if defined(USE_SEARCH_PROFILER)
+  constexpr std::size_t kProfileTopN = 10;
+  for (const auto& line : MakeProfileReport(profiles_, kProfileTopN)) {
+    sync_cout << "info string " << line << sync_endl;
+  }
+#endif  // defined(USE_SEARCH_PROFILER)
+}
+
+bool KomoringHeights::ReuseSolution(const Position& n, bool is_root_or_node) {
+  StopPreSolve();
+  if (solved_line_.moves.empty()) {
+    return false;
+  }
+
+  const auto start_time = std::chrono::steady_clock::now();
+
+  // 詰み手順の途中の局面なら、手順の残りがそのまま最短の詰み手順になる。詰まされた局面（手順の末尾）は除く。
+  // GUI では手順を戻ったり分岐を調べたりもするので、`solved_line_` は書き換えずに次の局面でも使う。
+  const auto& line = solved_line_;
+  const auto itr = std::find(line.keys.begin(), line.keys.end() - 1, n.key());
+  const auto ply = itr - line.keys.begin();
+  if (itr != line.keys.end() - 1 && (line.is_root_or_node == (ply % 2 == 0)) == is_root_or_node) {
+    best_moves_.assign(line.moves.begin() + ply, line.moves.end());
+  } else {
+    // `Node` は大きいので、手順から外れたときだけ作る
+    auto& nn = const_cast<Position&>(n);
+    const auto node = std::make_unique<Node>(nn, is_root_or_node);
+    auto best_moves = LookUpExactMatePath(*node);
+    if (!best_moves) {
+      return false;
+    }
+    best_moves_ = std::move(*best_moves);
+  }
+
+  if (!option_.silent) {
+    const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() -
+                                                                              start_time)
+                             .count();
+    const auto score = Score::MakeProven(option_.score_method, best_moves_.size(), is_root_or_node);
+    UsiInfo usi_output;
+    usi_output.Set(UsiInfoKey::kTime, elapsed / 1000);
+    usi_output.PushPVBack(static_cast<Depth>(best_moves_.size()), score.ToString(), best_moves_);
+    sync_cout << usi_output << sync_endl;
+    sync_cout << "info string reuse solution: mate in " << best_moves_.size() << " (" << elapsed << " us)"
+              << sync_endl;
+  }
+  return true;
+}
+
+void KomoringHeights::StartPreSolve() {
+  StopPreSolve();
+  if (option_.pre_solve_time == 0 || solved_line_.moves.empty()) {
+    return;
+  }
+
+  if (!pre_solve_thread_) {
+    pre_solve_thread_ = std::make_unique<PreSolveThread>(*this);
+  }
+  auto& th = *pre_solve_thread_;
+  th.nodes.store(0, std::memory_order_relaxed);
+  th.rootPos.set(solved_line_.sfen, &th.rootState, &th);
+
+  SearchContext context;
+  context.threads.push_back(&th);
+  context.stop = &pre_solve_stop_;
+  pre_solve_stop_.store(false, std::memory_order_release);
+  monitor_.NewSearch(tt_.Capacity(), std::numeric_limits<std::uint64_t>::max(),
+                     std::numeric_limits<std::uint64_t>::max(), context);
+
+  // 先読みスレッドの ShouldStop() は打ち切りフラグしか見ないので、時間制限はタイマーで打ち切りフラグを立てて実現する
+  pre_solve_timer_.Start(option_.pre_solve_time, [this]() { pre_solve_stop_.store(true, std::memory_order_release); });
+  pre_solving_ = true;
+  th.start_searching();
+}
+
+void KomoringHeights::StopPreSolve() {
+  if (!pre_solving_) {
+    return;
+  }
+
+  pre_solve_stop_.store(true, std::memory_order_release);
+  pre_solve_thread_->wait_for_search_finished();
+  pre_solve_timer_.Stop();
+  pre_solving_ = false;
+}
+
+void KomoringHeights::PrintMemoryUsage(const char* when) const {
+  if (option_.memory_budget_mb == 0 || option_.silent) {
+    return;
+  }
+
+  const auto hash_mb = tt_.Capacity() * tt::RegularTable::kSizePerEntry / 1024 / 1024;
+  const auto resident = GetResidentMemory();
+  std::ostringstream resident_str;
+  if (resident) {
+    resident_str << ", resident " << resident->current_mb << " MB (peak " << resident->peak_mb << " MB)";
+  }
+
+  sync_cout << "info string memory(" << when << "): budget " << option_.memory_budget_mb << " MB, regular table "
+            << hash_mb << " MB, max depth " << max_depth_ << resident_str.str() << sync_endl;
+  if (resident && resident->peak_mb > option_.memory_budget_mb) {
+    sync_cout << "info string error: resident memory exceeds MemoryBudget" << sync_endl;
+  }
+}
+
+std::optional<std::uint32_t> KomoringHeights::ExportProofTree(Node& n, MateLen len, ProofTree& tree) {
+  if (const auto index = tree.Find(n.BoardKey(), n.OrHand())) {
+    return index;
+  }
+
+  ProofTreeNode node{n.BoardKey(), n.OrHand(), HAND_ZERO, {}};
+  if (n.IsOrNode()) {
+    auto [move, next_len] = std::make_pair(CheckMate1Ply(n).first, kZeroMateLen);
+    if (move == MOVE_NONE) {
+      if (len <= kZeroMateLen) {
+        return std::nullopt;
+      }
+      std::tie(move, next_len) = GetBestMoveOrNode(n, len, false);
+      if (move == MOVE_NONE) {
+        return std::nullopt;
+      }
+    }
+
+    n.DoMove(move);
+    const auto child = ExportProofTree(n, next_len, tree);
+    n.UndoMove();
+    if (!child) {
+      return std::nullopt;
+    }
+
+    node.proof_hand = BeforeHand(n.Pos(), move, tree.Nodes()[*child].proof_hand);
+    node.children.emplace_back(Move16{move}, *child);
+  } else {
+    // 玉方の応手はすべて len - 1 手以内に詰むはずなので、すべての子を書き出す
+    HandSet proof_hand{ProofHandTag{}};
+    for (const auto move : MovePicker{n}) {
+      n.DoMove(move.move);
+      const auto child = ExportProofTree(n, len - 1, tree);
+      n.UndoMove();
+      if (!child) {
+        return std::nullopt;
+      }
+
+      proof_hand.Update(tree.Nodes()[*child].proof_hand);
+      node.children.emplace_back(Move16{move.move}, *child);
+    }
+    node.proof_hand = proof_hand.Get(n.Pos());
+  }
+
+  return tree.Add(std::move(node));
+}
+
+SearchResult KomoringHeights::RootResult(const Position& n, bool is_root_or_node) {
+  auto& nn = const_cast<Position&>(n);
+  const auto node = std::make_unique<Node>(nn, is_root_or_node);
+  bool does_have_old_child = false;
+  return tt_.BuildQuery(*node).LookUp(does_have_old_child, kDepthMaxMateLen,
+                                      []() { return std::make_pair(kPnDnUnit, kPnDnUnit); });
+}
+
+std::optional<std::string> KomoringHeights::LoadSnapshot(const std::string& path) {
+  StopPreSolve();
+  if (tt_.IsShared()) {
+    sync_cout << "info string error: snapshot cannot be loaded into a shared hash" << sync_endl;
+    return std::nullopt;
+  }
+
+  std::ifstream ifs(path, std::ios::binary);
+  std::string header;
+  std::string sfen;
+  if (!ifs || !std::getline(ifs, header) || header != kSnapshotHeader || !std::getline(ifs, sfen)) {
+    return std::nullopt;
+  }
+
+  solved_line_ = SolvedLine{};
+  tt_.Clear();
+  tt_.Load(ifs);
+  return {sfen};
+}
+
+void KomoringHeights::SaveSnapshot() {
+  const auto& path = option_.tt_snapshot_path;
+  const auto tmp_path = path + ".tmp";
+  const auto start_time = std::chrono::steady_clock::now();
+
+  {
+    std::ofstream ofs(tmp_path, std::ios::binary);
+    ofs << kSnapshotHeader << '\n' << root_sfen_ << '\n';
+    tt_.Save(ofs);
+    if (!ofs) {
+      sync_cout << "info string error: failed to write snapshot: " << tmp_path << sync_endl;
+      return;
+    }
+  }
+
+  if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+    sync_cout << "info string error: failed to rename snapshot: " << tmp_path << sync_endl;
+    return;
+  }
+
+  if (!option_.silent) {
+    const auto elapsed =
+        std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start_time).count();
+    sync_cout << "info string snapshot: " << path << " (" << elapsed << " ms)" << sync_endl;
+  }
+}
+
+void KomoringHeights::RecordSolvedLine(Node& n, const std::vector<Move>& moves) {
+  solved_line_.sfen = n.Pos().sfen();
+  solved_line_.is_root_or_node = n.IsOrNode();
+  solved_line_.moves = moves;
+  solved_line_.keys.clear();
+  solved_line_.keys.push_back(n.GetKey());
+  for (const auto move : moves) {
+    n.DoMove(move);
+    solved_line_.keys.push_back(n.GetKey());
+  }
+  RollBack(n, moves);
+}
+
+std::optional<std::vector<Move>> KomoringHeights::LookUpExactMatePath(Node& n) {
+  const auto [root_disproven_len, root_proven_len] = tt_.BuildQuery(n).FinalRange();
+  // len - 2 手以下で詰まないと分かっていなければ、最短の詰み手順とは言い切れない
+  if (root_proven_len == kDepthMaxPlus1MateLen || root_disproven_len + 2 < root_proven_len) {
+    return std::nullopt;
+  }
+
+  std::vector<Move> best_moves;
+  for (auto len = root_proven_len; len.Len() > 0; len = len - 1) {
+    Move best_move = MOVE_NONE;
+    for (const auto move : MovePicker{n}) {
+      const auto [disproven_len, proven_len] = tt_.BuildChildQuery(n, move.move).FinalRange();
+      // 親の詰み手数が定まっているので、OR node では len - 1 手で詰む手を選べばよい。AND node では、len - 1 手で
+      // 詰むことに加えて、それより短く詰まないことが分かっている応手を選ぶ。
+      if (proven_len + 1 == len && (n.IsOrNode() || disproven_len + 2 >= proven_len)) {
+        best_move = move.move;
+        break;
+      }
+    }
+
+    if (best_move == MOVE_NONE && n.IsOrNode() && len.Len() == 1) {
+      // 1手詰は置換表に書かれていない可能性がある
+      best_move = CheckMate1Ply(n).first;
+    }
+
+    if (best_move == MOVE_NONE) {
+      RollBack(n, best_moves);
+      return std::nullopt;
+    }
+    n.DoMove(best_move);
+    best_moves.push_back(best_move);
+  }
+
+  const bool is_mated = !n.IsOrNode() && MovePicker{n}.empty();
+  RollBack(n, best_moves);
+  if (!is_mated) {
+    return std::nullopt;
+  }
+  return best_moves;
+}
+
+void KomoringHeights::PreSolve(Thread& th) {
+  // 番号が 0 でないスレッドの ShouldStop() は打ち切りフラグだけを見るので、StopPreSolve() ですぐに止まる
+  const auto thread_id = static_cast<std::uint32_t>(expansion_list_.size() - 1);
+  InitializeThread(thread_id, thread_id + 1);
+#if defined(__linux__)
+  // 先読みは空き時間にだけ行いたいので、USI コマンドを受け付けるスレッドに CPU を譲る
+  const sched_param param{};
+  ::pthread_setschedparam(::pthread_self(), SCHED_IDLE, &param);
+#endif  // defined(__linux__)
+  tt_.NewSearch();
+
+  // 現局面に近い分岐ほど次に検討される可能性が高いので、手順の先頭から順に解く
+  const auto node = std::make_unique<Node>(th.rootPos, solved_line_.is_root_or_node);
+  std::vector<Move> moves;
+  for (const auto line_move : solved_line_.moves) {
+    if (!node->IsOrNode()) {
+      for (const auto move : MovePicker{*node}) {
+        if (monitor_.ShouldStop()) {
+          break;
+        }
+
+        if (move.move != line_move) {
+          node->DoMove(move.move);
+          PreSolveNode(node->Pos());
+          node->UndoMove();
+        }
+      }
+    }
+
+    if (monitor_.ShouldStop()) {
+      break;
+    }
+    node->DoMove(line_move);
+    moves.push_back(line_move);
+  }
+  RollBack(*node, moves);
+}
+
+void KomoringHeights::PreSolveNode(Position& pos) {
+  // GUI からは `pos` が探索開始局面として与えられるので、詰み手順の途中の局面としてではなく root として解く。
+  // そうしないと、手順の前半の局面へ戻る変化が千日手扱いになり、経路に依存しない結果が得られない。
+  const auto node = std::make_unique<Node>(pos, true);
+  auto len = kDepthMaxMateLen;
+  while (!monitor_.ShouldStop()) {
+    expansion_list_[tl_thread_id].Emplace(tt_, move_history_, *node, len, true, option_.frontier_mate_ply,
+                                          BitSet64::Full(), option_.multi_pv);
+    std::uint32_t inc_flag = 0;
+    auto result = SearchImpl(*node, kInfinitePnDn, kInfinitePnDn, len, inc_flag);
+    expansion_list_[tl_thread_id].Pop();
+    if (!result.IsFinal()) {
+      break;
+    }
+
+    if (result.Dn() == 0 && result.GetFinalData().IsRepetition()) {
+      // root へ戻る千日手を除けば len 手以下の詰みはない。最短の詰みが同一局面を経由することはないので、
+      // 経路に依存しない不詰として書いてよい。
+      result = SearchResult::MakeFinal<false>(node->OrHand(), len, result.Amount());
+    }
+    // LookUpExactMatePath() が詰み手数の区間を引けるように、root の結果も書いておく
+    tt_.BuildQuery(*node).SetResult(result);
+    if (result.Pn() != 0 || result.Len().Len() <= 1) {
+      break;
+    }
+    len = result.Len() - 2;
+  }
+}
+
 // NOLINTNEXTLINE(readability-function-cognitive-complexity)
 std::pair<NodeState, MateLen> KomoringHeights::SearchMainLoop(Node& n) {
   NodeState node_state = NodeState::kUnknown;
   auto len{kDepthMaxMateLen};
 
+  // 余詰探索にかかった時間と局面数。比較のために探索終了時に出力する。
+  std::uint32_t post_search_count = 0;
+  auto post_search_start_time = std::chrono::steady_clock::now();
+  std::uint64_t post_search_start_nodes = 0;
+
   for (Depth i = 0; i < kDepthMax; ++i) {
+    if (len != kDepthMaxMateLen && post_search_count++ == 0) {
+      post_search_start_time = std::chrono::steady_clock::now();
+      post_search_start_nodes = monitor_.MoveCount();
+    }
+
     const auto result = SearchEntry(n, len);
     const auto old_score = score_;
     const auto score = Score::Make(option_.score_method, result, n.IsRootOrNode());
@@ -208,6 +802,7 @@ std::pair<NodeState, MateLen> KomoringHeights::SearchMainLoop(Node& n) {
       if (tl_thread_id == 0) {
         best_moves_ = pv_list_.BestMoves();
         if (!option_.silent) {
+          info_printer_.Flush();
           sync_cout << CurrentInfo() << "# " << OrdinalNumber(i + 1) << " result: mate in " << best_moves_.size()
                     << "(upper_bound:" << result.Len() << ")" << sync_endl;
           Print(n);
@@ -227,6 +822,7 @@ std::pair<NodeState, MateLen> KomoringHeights::SearchMainLoop(Node& n) {
       len = result.Len() - 2;
     } else {
       if (tl_thread_id == 0 && result.Dn() == 0 && result.Len() < len) {
+        info_printer_.Flush();
         sync_cout << info << "Failed to detect PV" << sync_endl;
       }
 
@@ -243,6 +839,7 @@ std::pair<NodeState, MateLen> KomoringHeights::SearchMainLoop(Node& n) {
       }
 
       if (tl_thread_id == 0 && !option_.silent) {
+        info_printer_.Flush();
         sync_cout << info << "# " << OrdinalNumber(i + 1) << " result: " << result << sync_endl;
         Print(n);
       }
@@ -250,15 +847,26 @@ std::pair<NodeState, MateLen> KomoringHeights::SearchMainLoop(Node& n) {
     }
   }
 
+  if (tl_thread_id == 0 && !option_.silent && post_search_count > 0) {
+    const auto elapsed = std::chrono::steady_clock::now() - post_search_start_time;
+    sync_cout << "info string post search: " << post_search_count << " iterations, "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count() << " ms, "
+              << monitor_.MoveCount() - post_search_start_nodes << " nodes" << sync_endl;
+  }
+
   return {node_state, len};
 }
 
 SearchResult KomoringHeights::SearchEntry(Node& n, MateLen len) {
   SearchResult result{};
-  PnDn thpn = (len == kDepthMaxMateLen) ? tl_thread_id : kInfinitePnDn;
-  PnDn thdn = (len == kDepthMaxMateLen) ? tl_thread_id : kInfinitePnDn;
-
-  expansion_list_[tl_thread_id].Emplace(tt_, n, len, true, BitSet64::Full(), option_.multi_pv);
+  // 余詰探索（len < kDepthMaxMateLen）でも小さなしきい値から徐々に広げていく。置換表には前回の（手数上限が緩い）
+  // 探索で得た不詰の境界と pn/dn が残っているので、しきい値を絞った浅い反復でそれらを読み直してから深い反復へ
+  // 進むほうが、いきなり無限大のしきい値で木全体を掘り直すよりも展開し直す局面が少なくて済む。
+  PnDn thpn = tl_thread_id;
+  PnDn thdn = tl_thread_id;
+
+  expansion_list_[tl_thread_id].Emplace(tt_, move_history_, n, len, true, option_.frontier_mate_ply, BitSet64::Full(),
+                                        option_.multi_pv);
   if (tl_thread_id == 0 && n.GetDepth() == 0) {
     for (const auto& [move, result] : expansion_list_[0].Root().GetAllResults()) {
       if (!result.IsFinal()) {
@@ -306,7 +914,7 @@ SearchResult KomoringHeights::SearchImplForRoot(Node& n, PnDn thpn, PnDn thdn, M
   auto& local_expansion = expansion_list_[tl_thread_id].Current();
 
   if (tl_thread_id == 0 && monitor_.ShouldPrint()) {
-    Print(n);
+    Print(n, true);
   }
   expansion_list_[tl_thread_id].EliminateDoubleCount(tt_, n);
 
@@ -323,7 +931,10 @@ SearchResult KomoringHeights::SearchImplForRoot(Node& n, PnDn thpn, PnDn thdn, M
     const auto [child_thpn, child_thdn] = local_expansion.FrontPnDnThresholds(thpn, thdn);
 
     n.DoMove(best_move);
-    auto& child_expansion = expansion_list_[tl_thread_id].Emplace(tt_, n, len - 1, is_first_search, sum_mask);
+    Profile(is_first_search ? ProfileEvent::kTtMiss : ProfileEvent::kReexpand, n);
+    auto& child_expansion =
+        expansion_list_[tl_thread_id].Emplace(tt_, move_history_, n, len - 1, is_first_search,
+                                              option_.frontier_mate_ply, sum_mask);
 
     SearchResult child_result;
     if (is_first_search) {
@@ -368,11 +979,13 @@ SearchResult KomoringHeights::SearchImpl(Node& n, PnDn thpn, PnDn thdn, MateLen
 
   auto& local_expansion = expansion_list_[tl_thread_id].Current();
   monitor_.Visit(n.GetDepth());
+  scheduler_.Tick(tl_thread_id);
+  Profile(ProfileEvent::kVisit, n);
   if (tl_thread_id == 0 && monitor_.ShouldPrint()) {
-    Print(n);
+    Print(n, true);
   }
 
-  if (n.GetDepth() >= kDepthMax) {
+  if (n.GetDepth() >= max_depth_) {
     return SearchResult::MakeRepetition(n.OrHand(), len, 1, 0);
   }
 
@@ -383,6 +996,7 @@ SearchResult KomoringHeights::SearchImpl(Node& n, PnDn thpn, PnDn thdn, MateLen
   // Threshold Controlling Algorithm(TCA).
   // 浅い結果を参照している場合、無限ループになる可能性があるので少しだけ探索を延長する
   if (local_expansion.DoesHaveOldChild()) {
+    Profile(ProfileEvent::kTca, n);
     inc_flag++;
   }
 
@@ -397,7 +1011,12 @@ SearchResult KomoringHeights::SearchImpl(Node& n, PnDn thpn, PnDn thdn, MateLen
     monitor_.ResetNextHashfullCheck();
   }
 
+  std::uint32_t loop_count = 0;
   while (!monitor_.ShouldStop() && (curr_result.Pn() < thpn && curr_result.Dn() < thdn)) {
+    if (loop_count++ > 0) {
+      Profile(ProfileEvent::kRetry, n);
+    }
+
     // local_expansion.BestMove() にしたがい子局面を展開する
     // （curr_result.Pn() > 0 && curr_result.Dn() > 0 なので、BestMove が必ず存在する）
     const auto best_move = local_expansion.BestMove();
@@ -406,9 +1025,12 @@ SearchResult KomoringHeights::SearchImpl(Node& n, PnDn thpn, PnDn thdn, MateLen
     const auto [child_thpn, child_thdn] = local_expansion.FrontPnDnThresholds(thpn, thdn);
 
     n.DoMove(best_move);
+    Profile(is_first_search ? ProfileEvent::kTtMiss : ProfileEvent::kReexpand, n);
 
     // 子局面を展開する。展開した expansion は UndoMove() の直前に忘れずに開放しなければならない。
-    auto& child_expansion = expansion_list_[tl_thread_id].Emplace(tt_, n, len - 1, is_first_search, sum_mask);
+    auto& child_expansion =
+        expansion_list_[tl_thread_id].Emplace(tt_, move_history_, n, len - 1, is_first_search,
+                                              option_.frontier_mate_ply, sum_mask);
 
     SearchResult child_result;
     if (is_first_search) {
@@ -492,7 +1114,9 @@ std::pair<Move, MateLen> KomoringHeights::GetBestMoveOrNode(Node& n, MateLen len
     }
   }
 
-  auto& expansion = expansion_list_[tl_thread_id].Emplace(tt_, n, len, true, BitSet64::Full(), option_.multi_pv);
+  auto& expansion =
+      expansion_list_[tl_thread_id].Emplace(tt_, move_history_, n, len, true, option_.frontier_mate_ply,
+                                            BitSet64::Full(), option_.multi_pv);
   std::uint32_t inc_flag = 0;
   SearchImpl(n, kInfinitePnDn, kInfinitePnDn, len, inc_flag);
   // exclude を無視して最善手を取りたいので、expansion.BestMove() は使えないので注意。
@@ -511,7 +1135,9 @@ std::pair<Move, MateLen> KomoringHeights::GetBestMoveOrNode(Node& n, MateLen len
 std::pair<Move, MateLen> KomoringHeights::GetBestMoveAndNode(Node& n, MateLen len, bool exact) {
   KOMORI_PRECONDITION(!n.IsOrNode());
   if (exact) {
-    auto& expansion = expansion_list_[tl_thread_id].Emplace(tt_, n, len - 2, true, BitSet64::Full(), option_.multi_pv);
+    auto& expansion =
+        expansion_list_[tl_thread_id].Emplace(tt_, move_history_, n, len - 2, true, option_.frontier_mate_ply,
+                                              BitSet64::Full(), option_.multi_pv);
     std::uint32_t inc_flag = 0;
     SearchImpl(n, kInfinitePnDn, kInfinitePnDn, len - 2, inc_flag);
     // exclude を無視して最善手を取りたいので、expansion.BestMove() は使えないので注意。
@@ -530,7 +1156,9 @@ std::pair<Move, MateLen> KomoringHeights::GetBestMoveAndNode(Node& n, MateLen le
       return {move, proven_len};
     }
 
-    auto& expansion = expansion_list_[tl_thread_id].Emplace(tt_, n, len, true, BitSet64::Full(), option_.multi_pv);
+    auto& expansion =
+        expansion_list_[tl_thread_id].Emplace(tt_, move_history_, n, len, true, option_.frontier_mate_ply,
+                                              BitSet64::Full(), option_.multi_pv);
     std::uint32_t inc_flag = 0;
     SearchImpl(n, kInfinitePnDn, kInfinitePnDn, len, inc_flag);
     // exclude を無視して最善手を取りたいので、expansion.BestMove() は使えないので注意。
@@ -572,29 +1200,33 @@ void KomoringHeights::UpdateFinalPv(Node& n, Move move, const SearchResult& resu
 }
 
 UsiInfo KomoringHeights::CurrentInfo() const {
-  UsiInfo usi_output = monitor_.GetInfo();
-  usi_output.Set(UsiInfoKey::kHashfull, tt_.Hashfull());
-  usi_output.Set(UsiInfoKey::kScore, score_.ToString());
+  UsiInfo usi_output;
+  CurrentInfo(usi_output);
 
   return usi_output;
 }
 
-void KomoringHeights::Print(const Node& n) {
+void KomoringHeights::CurrentInfo(UsiInfo& usi_output) const {
+  monitor_.GetInfo(usi_output);
+  usi_output.Set(UsiInfoKey::kHashfull, tt_.Hashfull());
+  usi_output.Set(UsiInfoKey::kScore, score_.ToString());
+}
+
+void KomoringHeights::Print(const Node& n, bool async) {
   if (option_.silent) {
     return;
   }
 
-  auto usi_output = CurrentInfo();
+  auto& usi_output = info_printer_.Stage();
+  CurrentInfo(usi_output);
   if (!expansion_list_[0].IsEmpty() && !pv_search_) {
     // 探索中なら現在の探索情報で pv_list_ を更新する
     const auto& root = expansion_list_[0].Root();
     const auto result = root.FrontResult();
-    const auto& moves_from_start = n.MovesFromStart();
-    std::vector<Move> best_moves(moves_from_start.begin(), moves_from_start.end());
-    pv_list_.Update(root.BestMove(), result, n.GetDepth(), std::move(best_moves));
+    pv_list_.Update(root.BestMove(), result, n.GetDepth(), n.MovesFromStart());
 
     usi_output.Set(UsiInfoKey::kCurrMove, USI::move(root.BestMove()));
-    // pv_list_ を昇順に並び替えるために、multi_pv_ の値に関係なくすべての子の探索結果を更新しなければならない
+    // pv_list_ の順位を最新に保つために、multi_pv_ の値に関係なくすべての子の探索結果を更新しなければならない
     for (const auto& [move, result] : root.GetAllResults()) {
       if (move == root.BestMove() || result.IsFinal()) {
         // best_move -> 上で更新済み
@@ -608,12 +1240,17 @@ void KomoringHeights::Print(const Node& n) {
     usi_output.Set(UsiInfoKey::kCurrMove, USI::move(pv_list_.BestMoves()[0]));
   }
 
-  for (const auto& pv_info : Take(pv_list_.GetPvList(), option_.multi_pv)) {
+  const auto pv_count = std::min<std::size_t>(pv_list_.Size(), option_.multi_pv);
+  for (std::size_t rank = 0; rank < pv_count; ++rank) {
+    const auto& pv_info = pv_list_[rank];
     auto score = Score::Make(option_.score_method, pv_info.result, n.IsRootOrNode());
     score.AddOneIfFinal();
-    usi_output.PushPVBack(pv_info.depth, score.ToString(), ToString(pv_info.pv));
+    usi_output.PushPVBack(pv_info.depth, score.ToString(), pv_info.pv);
   }
 
-  sync_cout << usi_output << sync_endl;
+  info_printer_.Post();
+  if (!async) {
+    info_printer_.Flush();
+  }
 }
 }  // namespace komori
@@ -4,16 +4,26 @@
 #ifndef KOMORI_KOMORING_HEIGHTS_HPP_
 #define KOMORI_KOMORING_HEIGHTS_HPP_
 
+#include <atomic>
+#include <memory>
+#include <optional>
+#include <string>
 #include <vector>
 
+#include "checkpoint_thread.hpp"
+#include "cluster.hpp"
+#include "deterministic_scheduler.hpp"
 #include "engine_option.hpp"
 #include "expansion_stack.hpp"
+#include "proof_tree.hpp"
 #include "pv_list.hpp"
 #include "score.hpp"
 #include "search_monitor.hpp"
+#include "search_profiler.hpp"
 #include "search_result.hpp"
 #include "transposition_table.hpp"
 #include "usi_info.hpp"
+#include "usi_info_printer.hpp"
 
 namespace komori {
 /**
@@ -31,8 +41,8 @@ class KomoringHeights {
   KomoringHeights& operator=(const KomoringHeights&) = delete;
   /// Move assign operator(delete)
   KomoringHeights& operator=(KomoringHeights&&) = delete;
-  /// Destructor(default)
-  ~KomoringHeights() = default;
+  /// Destructor。先読みスレッドが動いていれば止める。
+  ~KomoringHeights();
 
   /**
    * @brief エンジンを初期化する
@@ -40,7 +50,8 @@ class KomoringHeights {
    * @param num_threads スレッド数
    */
   void Init(const EngineOption& option, std::uint32_t num_threads);
-  /// 置換表の内容をすべて削除する。ベンチマーク用。
+  /// 置換表の内容をすべて削除する。ベンチマーク用。共有置換表に接続している場合は、他のプロセスの探索結果を
+  /// 消さないように何もしない。
   void Clear();
 
   /**
@@ -54,9 +65,24 @@ class KomoringHeights {
    * @brief Search() の準備を行う。探索開始直前に main_thread から呼び出すこと。
    * @param n 現局面
    * @param is_root_or_node `n` が OR node かどうか
+   * @param context 探索スレッドと探索の打ち切り条件。省略時は YaneuraOu のグローバル変数から作る。
    * @pre メインスレッドから呼び出すこと
    */
-  void NewSearch(const Position& n, bool is_root_or_node);
+  void NewSearch(const Position& n, bool is_root_or_node, const SearchContext& context = MakeUsiSearchContext());
+
+  /**
+   * @brief クラスタモードで root 付近の局面をワーカーへ配って解かせる
+   * @param n 現局面
+   * @param is_root_or_node `n` が OR node かどうか
+   * @pre NewSearch() の後、Search() の前にメインスレッドから呼び出すこと
+   *
+   * `option_.cluster_workers` が空なら何もしない。`n` から `option_.cluster_split_ply` 手だけ展開した局面を
+   * 各ワーカーへ配り、返ってきた詰み／不詰の結果（証明駒／反証駒つき）を置換表へ書き込む。結果が出なかった局面は
+   * ワーカーが返した pn/dn で優先度をつけ直し、探索時間を延ばして配り直す。root の詰み／不詰が分かるか、
+   * 時間切れになるか、配る局面がなくなったら戻る。その後の Search() は、ワーカーの結果を置換表から引きながら
+   * root 付近の探索と詰み手順の構成を行う。
+   */
+  void RunCluster(const Position& n, bool is_root_or_node);
 
   /**
    * @brief 詰め探索を行う。（探索本体）
@@ -66,7 +92,143 @@ class KomoringHeights {
    */
   NodeState Search(const Position& n, bool is_root_or_node);
 
+  /**
+   * @brief 探索の後始末を行う。すべての探索スレッドが Search() を抜けた後に main_thread から呼び出すこと。
+   *
+   * 探索中に得た詰み／不詰の結果を既知結果ファイルへ書き出す。メモリ予算が設定されている場合は、
+   * メモリ使用量を出力する。
+   */
+  void FinishSearch();
+
+  /**
+   * @brief 直前に解いた詰み手順を使って、探索せずに局面 `n` の詰み手順を求める
+   * @param n 現局面
+   * @param is_root_or_node `n` が OR node かどうか
+   * @return 詰み手順が求まったら `true`。このとき BestMoves() で詰み手順を取得できる。
+   * @pre 探索中ではない。メインスレッドから呼び出すこと。
+   *
+   * GUI で詰み手順を1手ずつ進めながら `go` を送ると、そのたびに NewSearch() から探索し直すことになる。`n` が直前に
+   * 解いた詰み手順の途中の局面なら、手順の残りをそのまま返す。手順から外れた局面でも、置換表の詰み／不詰の結果
+   * （`FinalRange()`）だけで最短の詰み手順をたどれればそれを返す。どちらもできなければ `false` を返すので、
+   * 通常どおり NewSearch() から探索すること。
+   *
+   * 先読み（StartPreSolve()）が動いていれば、止めてから置換表を参照する。
+   */
+  bool ReuseSolution(const Position& n, bool is_root_or_node);
+
+  /**
+   * @brief 直前に解いた詰み手順から外れた局面を、バックグラウンドで先読みする
+   * @pre 探索中ではない。メインスレッドから呼び出すこと。
+   *
+   * 詰み手順の AND node で手順以外の応手を指した局面を順に最短手数まで解き、置換表へ書き込む。GUI で手順から
+   * 外れた応手を検討したとき、ReuseSolution() が置換表だけで答えられるようにするためである。
+   * `option_.pre_solve_time` が経過するか、次の探索を始めると止まる。`option_.pre_solve_time` が 0 のとき、
+   * または直前の探索で詰みが見つからなかったときは何もしない。
+   */
+  void StartPreSolve();
+
+  /**
+   * @brief 置換表に書かれている局面 `n` の探索結果を取得する
+   * @param n 局面
+   * @param is_root_or_node `n` が OR node かどうか
+   * @return `n` の探索結果。置換表に `n` がなければ初期値。
+   * @pre 探索中ではない
+   *
+   * クラスタモードのワーカーが、解き終えた局面の証明駒／反証駒をコーディネータへ返すために使う。
+   */
+  SearchResult RootResult(const Position& n, bool is_root_or_node);
+
+  /**
+   * @brief 探索中に書き出した置換表スナップショットを読み込む
+   * @param path スナップショットのファイル名
+   * @return スナップショットを書き出したときの探索開始局面の sfen。読み込みに失敗した場合は `std::nullopt`。
+   * @pre 探索中ではない
+   *
+   * 置換表の内容をすべて削除してから、スナップショットの中身を読み込む。戻り値の局面から探索を再開すれば、
+   * スナップショット時点までの探索結果を引き継いで探索を続けることができる。
+   *
+   * 共有置換表に接続している場合は、他のプロセスの探索結果を消してしまうので読み込まずに失敗する。
+   *
+   * @see SaveSnapshot()
+   */
+  std::optional<std::string> LoadSnapshot(const std::string& path);
+
  private:
+  /// 直前に解いた詰み手順
+  struct SolvedLine {
+    std::string sfen;            ///< 詰み手順の開始局面
+    bool is_root_or_node{true};  ///< 開始局面が OR node かどうか
+    std::vector<Key> keys;       ///< 開始局面から i 手進めた局面のハッシュ値（`keys[0]` は開始局面）
+    std::vector<Move> moves;     ///< 詰み手順
+  };
+
+  /**
+   * @brief 先読みを行うスレッド
+   *
+   * YaneuraOu の `Thread` と同様に `start_searching()` で `search()` を開始し、`wait_for_search_finished()` で
+   * 終了を待つ。`Threads` には登録しない。
+   */
+  class PreSolveThread : public Thread {
+   public:
+    /**
+     * @brief 先読みスレッドを作る
+     * @param kh 先読みを行うエンジン
+     */
+    explicit PreSolveThread(KomoringHeights& kh) : Thread{0}, kh_{kh} {}
+
+    /// 先読み本体
+    void search() override { kh_.PreSolve(*this); }
+
+   private:
+    KomoringHeights& kh_;  ///< 先読みを行うエンジン
+  };
+
+  /**
+   * @brief `n` から `moves` を指した詰み手順を `solved_line_` に記録する
+   * @param n 詰み手順の開始局面
+   * @param moves 詰み手順
+   */
+  void RecordSolvedLine(Node& n, const std::vector<Move>& moves);
+
+  /**
+   * @brief 置換表の詰み／不詰の結果だけを使って、`n` の最短の詰み手順をたどる
+   * @param n 現局面
+   * @return 最短の詰み手順。置換表の情報だけでは最短と言い切れない場合は `std::nullopt`。
+   *
+   * 探索は行わないので、手順のどこかで詰み手数の区間が1点に定まっていなければ失敗する。
+   */
+  std::optional<std::vector<Move>> LookUpExactMatePath(Node& n);
+
+  /**
+   * @brief 先読みスレッドの本体。`solved_line_` の AND node で手順以外の応手を指した局面を順に解く。
+   * @param th 先読みスレッド
+   */
+  void PreSolve(Thread& th);
+
+  /**
+   * @brief OR node `pos` の最短の詰み手数が定まるまで探索し、結果を置換表へ書き込む
+   * @param pos 現局面
+   */
+  void PreSolveNode(Position& pos);
+
+  /// 先読みが動いていれば止める
+  void StopPreSolve();
+
+  /**
+   * @brief 置換表スナップショットを `option_.tt_snapshot_path` へ書き出す
+   *
+   * 探索中にバックグラウンドスレッドから呼び出される。書き出しは一時ファイルに対して行い、完了してから
+   * `option_.tt_snapshot_path` へ置き換える。そのため、書き出し途中でプロセスが終了しても直前のスナップショットは
+   * 失われない。
+   *
+   * スナップショットは以下のような構造になっている。
+   *
+   * - ヘッダ行（テキスト）
+   * - 探索開始局面の sfen（テキスト 1 行）
+   * - 置換表本体（`tt::TranspositionTable::Save()` の出力）
+   */
+  void SaveSnapshot();
+
   /**
    * @brief 詰み手順を探す
    * @param n 現局面
@@ -137,6 +299,19 @@ class KomoringHeights {
    */
   std::pair<Move, MateLen> GetBestMoveAndNode(Node& n, MateLen len, bool exact);
 
+  /**
+   * @brief 置換表から `n` 以下の証明木を取り出して `tree` へ追加する
+   * @param n    現局面
+   * @param len  詰み手数の上限値
+   * @param tree 証明木
+   * @return `n` に対応するノード番号。証明木を構成できなかった場合は `std::nullopt`。
+   * @pre メインスレッドから呼び出すこと
+   *
+   * OR node では `GetBestMoveOrNode()` と同様に詰ませる手を1つ選び、AND node では玉方の合法手をすべて展開する。
+   * 同一局面は `tree` 上で1つのノードにまとめる。置換表に情報が足りない局面は `GetBestMoveOrNode()` の中で追加探索する。
+   */
+  std::optional<std::uint32_t> ExportProofTree(Node& n, MateLen len, ProofTree& tree);
+
   /**
    * @brief `move` に対する PV を構成して `pv_list_` を更新する
    * @param n       現局面
@@ -154,25 +329,72 @@ class KomoringHeights {
   /// 現在の探索情報を取得する
   /// @pre メインスレッドから呼び出すこと
   UsiInfo CurrentInfo() const;
+  /// 現在の探索情報を `usi_output` に書き込む
+  /// @pre メインスレッドから呼び出すこと
+  void CurrentInfo(UsiInfo& usi_output) const;
 
   /**
    * @brief 探索情報を出力する
-   * @param n 現局面
+   * @param n     現局面
+   * @param async `true` なら出力を `info_printer_` に任せ、出力の完了を待たずに返る
    * @pre メインスレッドから呼び出すこと
    */
-  void Print(const Node& n);
+  void Print(const Node& n, bool async = false);
+
+  /**
+   * @brief メモリ予算とプロセスの物理メモリ使用量を info string で出力する
+   * @param when 出力のタイミング（"isready" など）
+   *
+   * メモリ予算が設定されていない場合は何もしない。
+   */
+  void PrintMemoryUsage(const char* when) const;
+
+  /**
+   * @brief 探索プロファイラへ局面 `n` のイベントを記録する
+   * @param event イベント
+   * @param n     イベントが起きた局面
+   *
+   * `USE_SEARCH_PROFILER` が定義されていなければ何もしない。
+   */
+  void Profile([[maybe_unused]] ProfileEvent event, [[maybe_unused]] const Node& n) {
+#if defined(USE_SEARCH_PROFILER)
+    profiles_[tl_thread_id].Record(event, n.GetDepth(), n.RootMove().value_or(MOVE_NONE), n.GetBoardKeyHandPair());
+#endif  // defined(USE_SEARCH_PROFILER)
+  }
 
   tt::TranspositionTable tt_;  ///< 置換表
+  MoveHistory move_history_;   ///< 攻め方の手の履歴。`LocalExpansion` で子を並べるときに使う。
   EngineOption option_;        ///< エンジンオプション
   bool pv_search_{false};      ///< 現在PV探索中かどうか
 
   SearchMonitor monitor_;  ///< 探索モニター
+  /// `option_.deterministic_quantum` が 0 でないとき、探索スレッドを番号順に交代で動かすスケジューラ
+  DeterministicScheduler scheduler_;
+  /// 探索する最大深さ。メモリ予算が設定されている場合、局面展開スタックが予算に収まるように制限する。
+  Depth max_depth_{kDepthMax};
 
   std::vector<Move> best_moves_;                 ///< 詰み手順
   std::deque<ExpansionStack> expansion_list_{};  ///< 局面展開のための一時領域
   Score score_{};  ///< 現在の探索評価値。余詰探索中に CurrentInfo() で取得できるようにここにおいておく
 
   PvList pv_list_;  ///< 各手に対する PV の一覧
+
+  tt::KnownResultTable known_results_;  ///< 探索をまたいで詰み／不詰の結果を保存するテーブル
+  std::string root_sfen_;               ///< 探索開始局面の sfen。スナップショットに書き出す。
+  CheckpointThread checkpoint_thread_;  ///< 置換表スナップショットを定期的に書き出すスレッド
+  /// 探索中の info 出力を探索スレッドの代わりに行うスレッド
+  UsiInfoPrinter info_printer_{[](const UsiInfo& usi_info) { sync_cout << usi_info << sync_endl; }};
+
+  SolvedLine solved_line_;  ///< 直前に解いた詰み手順。ReuseSolution() と先読みで使う。
+  /// 先読みスレッド。初めて StartPreSolve() を呼んだときに作る。
+  std::unique_ptr<PreSolveThread> pre_solve_thread_;
+  std::atomic<bool> pre_solve_stop_{false};  ///< 先読みを打ち切るためのフラグ
+  CheckpointThread pre_solve_timer_;         ///< `option_.pre_solve_time` の経過後に先読みを打ち切るタイマー
+  bool pre_solving_{false};                  ///< 先読みスレッドが動いているかどうか
+
+#if defined(USE_SEARCH_PROFILER)
+  std::vector<ThreadProfile> profiles_;  ///< スレッドごとの探索プロファイル
+#endif  // defined(USE_SEARCH_PROFILER)
 };
 }  // namespace komori
 
@@ -0,0 +1,97 @@
+#include "kh_solver.h"
+
+#include <new>
+#include <string>
+
+#include "solver.hpp"
+
+/// C 言語向けのソルバー。詰み手順の文字列を次の `kh_solver_solve()` まで保持する。
+struct kh_solver {
+  komori::Solver solver;  ///< ソルバー本体
+  std::string pv;         ///< 直前の `kh_solver_solve()` の詰み手順
+};
+
+namespace {
+/// `komori::SolveState` を `kh_solve_state` へ変換する
+kh_solve_state ToCState(komori::SolveState state) {
+  switch (state) {
+    case komori::SolveState::kProven:
+      return KH_SOLVE_PROVEN;
+    case komori::SolveState::kDisproven:
+      return KH_SOLVE_DISPROVEN;
+    default:
+      return KH_SOLVE_UNKNOWN;
+  }
+}
+}  // namespace
+
+extern "C" {
+void kh_solver_options_init(kh_solver_options* options) {
+  if (options == nullptr) {
+    return;
+  }
+
+  const komori::SolverOptions defaults{};
+  options->hash_mb = defaults.hash_mb;
+  options->threads = defaults.threads;
+  options->root_is_and_node_if_checked = defaults.root_is_and_node_if_checked ? 1 : 0;
+  options->post_search_level = nullptr;
+}
+
+kh_solver* kh_solver_create(const kh_solver_options* options) {
+  komori::SolverOptions solver_options{};
+  if (options != nullptr) {
+    solver_options.hash_mb = options->hash_mb;
+    solver_options.threads = options->threads;
+    solver_options.root_is_and_node_if_checked = options->root_is_and_node_if_checked != 0;
+    if (options->post_search_level != nullptr) {
+      solver_options.post_search_level = options->post_search_level;
+    }
+  }
+
+  return new (std::nothrow) kh_solver{komori::Solver{solver_options}, {}};
+}
+
+void kh_solver_destroy(kh_solver* solver) {
+  delete solver;
+}
+
+int kh_solver_solve(kh_solver* solver, const char* sfen, const kh_solve_limits* limits, kh_solve_result* result) {
+  if (solver == nullptr || sfen == nullptr || result == nullptr) {
+    return 1;
+  }
+
+  komori::SolveLimits solve_limits{};
+  if (limits != nullptr) {
+    solve_limits.time_ms = limits->time_ms;
+    solve_limits.nodes = limits->nodes;
+  }
+
+  const auto solve_result = solver->solver.Solve(sfen, solve_limits);
+  solver->pv.clear();
+  for (const auto& move : solve_result.pv) {
+    if (!solver->pv.empty()) {
+      solver->pv += ' ';
+    }
+    solver->pv += move;
+  }
+
+  result->state = ToCState(solve_result.state);
+  result->len = solve_result.len;
+  result->nodes = solve_result.nodes;
+  result->pv = solver->pv.c_str();
+  return 0;
+}
+
+void kh_solver_stop(kh_solver* solver) {
+  if (solver != nullptr) {
+    solver->solver.Stop();
+  }
+}
+
+void kh_solver_clear(kh_solver* solver) {
+  if (solver != nullptr) {
+    solver->solver.Clear();
+  }
+}
+}  // extern "C"
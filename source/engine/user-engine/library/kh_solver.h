@@ -0,0 +1,96 @@
+/**
+ * @file kh_solver.h
+ *
+ * `komori::Solver` の C 言語向けインターフェース。
+ */
+#ifndef KOMORI_KH_SOLVER_H_
+#define KOMORI_KH_SOLVER_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// ソルバー。`kh_solver_create()` で作り、`kh_solver_destroy()` で破棄する。
+typedef struct kh_solver kh_solver;
+
+/// 探索結果。`komori::SolveState` に対応する。
+typedef enum kh_solve_state {
+  KH_SOLVE_UNKNOWN = 0,    ///< 時間切れなどで詰みかどうか分からなかった
+  KH_SOLVE_PROVEN = 1,     ///< 詰み
+  KH_SOLVE_DISPROVEN = 2,  ///< 不詰（千日手による不詰を含む）
+} kh_solve_state;
+
+/// ソルバーの設定。`komori::SolverOptions` に対応する。`kh_solver_options_init()` で初期化してから使うこと。
+typedef struct kh_solver_options {
+  uint64_t hash_mb;                 ///< 置換表サイズ[MB]
+  uint32_t threads;                 ///< 探索スレッド数
+  int root_is_and_node_if_checked;  ///< 開始局面が王手されているとき、玉方手番として扱うかどうか
+  const char* post_search_level;    ///< 余詰探索の度合い（"None", "UpperBound", "MinLength"）
+} kh_solver_options;
+
+/// 1 回の `kh_solver_solve()` の打ち切り条件。0 なら制限なし。
+typedef struct kh_solve_limits {
+  uint64_t time_ms;  ///< 探索時間の上限[ms]
+  uint64_t nodes;    ///< 探索局面数の上限
+} kh_solve_limits;
+
+/// `kh_solver_solve()` の探索結果
+typedef struct kh_solve_result {
+  kh_solve_state state;  ///< 探索結果
+  uint32_t len;          ///< 詰み手数
+  uint64_t nodes;        ///< 探索局面数
+  /// 詰み手順（USI 形式の指し手を空白区切りで並べたもの）。詰みでなければ空文字列。
+  /// ソルバーが所有し、同じソルバーで次に `kh_solver_solve()` を呼ぶか破棄するまで有効。
+  const char* pv;
+} kh_solve_result;
+
+/**
+ * @brief `options` をデフォルト値で初期化する
+ * @param[out] options ソルバーの設定
+ */
+void kh_solver_options_init(kh_solver_options* options);
+
+/**
+ * @brief ソルバーを作る
+ * @param options ソルバーの設定。`NULL` ならデフォルト値を使う。
+ * @return ソルバー。作れなかった場合は `NULL`。
+ */
+kh_solver* kh_solver_create(const kh_solver_options* options);
+
+/**
+ * @brief ソルバーを破棄する
+ * @param solver ソルバー。`NULL` なら何もしない。
+ */
+void kh_solver_destroy(kh_solver* solver);
+
+/**
+ * @brief 局面 `sfen` を解く
+ * @param solver ソルバー
+ * @param sfen 局面（"sfen" や "position" を含まない sfen 文字列）
+ * @param limits 打ち切り条件。`NULL` なら制限なし。
+ * @param[out] result 探索結果
+ * @return 成功したら 0、引数が不正なら 0 以外
+ *
+ * 異なるソルバーに対しては、別々のスレッドから同時に呼び出してよい。
+ */
+int kh_solver_solve(kh_solver* solver, const char* sfen, const kh_solve_limits* limits, kh_solve_result* result);
+
+/**
+ * @brief 実行中の `kh_solver_solve()` を打ち切る。別スレッドから呼び出してよい。
+ * @param solver ソルバー
+ */
+void kh_solver_stop(kh_solver* solver);
+
+/**
+ * @brief 置換表の内容をすべて削除する
+ * @param solver ソルバー
+ */
+void kh_solver_clear(kh_solver* solver);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // KOMORI_KH_SOLVER_H_
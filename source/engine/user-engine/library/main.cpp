@@ -0,0 +1,157 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "service.hpp"
+#include "solver.hpp"
+
+// 標準入力から 1 行 1 局面の sfen を読み込み、複数のソルバーで並列に解くツール。
+//
+// usage: kh-solve [-n <instances>] [-j <threads>] [-t <time_ms>] [-c <nodes>] [-m <hash_mb>] [-l <0|1>]
+//                 [-p <numa_policy>] [-d <quantum>] [-s <retries>] [-M <memory_mb>] < sfens.txt
+//
+// `-l 1` で置換表に Huge Pages を使い、`-p` で置換表の NUMA 配置（None, Interleave, FirstTouch）を指定する。
+// `-d` を指定すると探索スレッドが `quantum` 局面ずつ交代で探索するので、複数スレッドでも探索局面数が実行ごとに
+// 変わらなくなる。
+//
+// `-s` を指定するとサービスモードで解く。各局面を 1 つのジョブとし、探索時間 `-t`、探索局面数 `-c`、置換表サイズ
+// `-m` をジョブごとの予算とする。予算内に結論の出なかったジョブは、置換表を引き継いだまま時間と局面数の予算を
+// 2 倍にして最大 `retries` 回解き直す。`-M` はサービス全体で保持する置換表の上限[MB]。終了時に処理量と応答時間の
+// パーセンタイルを標準エラー出力に表示する。
+//
+// 局面ごとに "<sfen>\t<mate|nomate|timeout>\t<手数>\t<探索局面数>\t<詰み手順>" を出力する。出力の順序は入力の順序と
+// 一致するとは限らない。サービスモードでは、探索局面数は解き直した分を含めた合計を出力する。
+namespace {
+/// 1 局面分の探索結果を出力する
+void PrintResult(const std::string& sfen, const komori::SolveResult& result, std::uint64_t nodes) {
+  std::cout << sfen << "\t"
+            << (result.state == komori::SolveState::kProven      ? "mate"
+                : result.state == komori::SolveState::kDisproven ? "nomate"
+                                                                 : "timeout")
+            << "\t" << result.len << "\t" << nodes << "\t";
+  for (const auto& move : result.pv) {
+    std::cout << move << " ";
+  }
+  std::cout << std::endl;
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::uint32_t num_instances = 1;
+  komori::SolverOptions options{};
+  komori::SolveLimits limits{};
+  bool service_mode = false;
+  std::uint64_t num_retries = 0;
+  std::uint64_t service_memory_mb = komori::ServiceOptions{}.memory_mb;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    const std::string arg = argv[i];
+    const auto value = std::strtoull(argv[i + 1], nullptr, 10);
+    if (arg == "-d") {
+      options.deterministic_quantum = value;
+    } else if (arg == "-p") {
+      options.numa_policy = argv[i + 1];
+    } else if (arg == "-l") {
+      options.large_pages = (value != 0);
+    } else if (arg == "-n") {
+      num_instances = std::max<std::uint32_t>(static_cast<std::uint32_t>(value), 1);
+    } else if (arg == "-j") {
+      options.threads = static_cast<std::uint32_t>(value);
+    } else if (arg == "-t") {
+      limits.time_ms = value;
+    } else if (arg == "-c") {
+      limits.nodes = value;
+    } else if (arg == "-m") {
+      options.hash_mb = value;
+    } else if (arg == "-s") {
+      service_mode = true;
+      num_retries = value;
+    } else if (arg == "-M") {
+      service_memory_mb = value;
+    } else {
+      std::cerr << "usage: " << argv[0]
+                << " [-n <instances>] [-j <threads>] [-t <time_ms>] [-c <nodes>] [-m <hash_mb>] [-l <0|1>]"
+                   " [-p <numa_policy>] [-d <quantum>] [-s <retries>] [-M <memory_mb>]"
+                << std::endl;
+      return 2;
+    }
+  }
+
+  std::vector<std::string> sfens;
+  for (std::string line; std::getline(std::cin, line);) {
+    if (!line.empty()) {
+      sfens.push_back(line);
+    }
+  }
+
+  std::mutex mutex;
+  std::size_t next_index = 0;
+  // 次に解く局面の番号を取り出す。残っていなければ `sfens.size()` を返す。
+  auto next_job = [&]() {
+    const std::lock_guard lock(mutex);
+    return next_index < sfens.size() ? next_index++ : sfens.size();
+  };
+
+  const auto start_time = std::chrono::steady_clock::now();
+  auto worker = [&]() {
+    komori::Solver solver{options};
+    for (auto index = next_job(); index < sfens.size(); index = next_job()) {
+      const auto result = solver.Solve(sfens[index], limits);
+      const std::lock_guard lock(mutex);
+      PrintResult(sfens[index], result, result.nodes);
+    }
+  };
+
+  komori::ServiceOptions service_options{};
+  service_options.solver = options;
+  service_options.memory_mb = service_memory_mb;
+  komori::SolverService service{service_options};
+  auto service_worker = [&]() {
+    for (auto index = next_job(); index < sfens.size(); index = next_job()) {
+      const auto job_id = std::to_string(index);
+      komori::JobBudget budget{limits.time_ms, limits.nodes, options.hash_mb};
+      auto result = service.Submit(job_id, sfens[index], budget);
+      auto nodes = result.nodes;
+      for (std::uint64_t retry = 0; retry < num_retries && result.state == komori::SolveState::kUnknown; ++retry) {
+        budget.time_ms *= 2;
+        budget.nodes *= 2;
+        result = service.Submit(job_id, sfens[index], budget);
+        nodes += result.nodes;
+      }
+      if (result.state == komori::SolveState::kUnknown) {
+        service.Release(job_id);
+      }
+
+      const std::lock_guard lock(mutex);
+      PrintResult(sfens[index], result, nodes);
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for (std::uint32_t i = 0; i < num_instances; ++i) {
+    if (service_mode) {
+      workers.emplace_back(service_worker);
+    } else {
+      workers.emplace_back(worker);
+    }
+  }
+  for (auto& th : workers) {
+    th.join();
+  }
+
+  const auto elapsed =
+      std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start_time).count();
+  std::cerr << sfens.size() << " positions, " << num_instances << " instances, " << elapsed << " ms" << std::endl;
+  if (service_mode) {
+    const auto stats = service.Stats();
+    std::cerr << stats.jobs << " jobs (" << stats.proven << " mate, " << stats.disproven << " nomate, " << stats.unknown
+              << " timeout), " << stats.throughput << " jobs/s, latency p50 " << stats.latency_p50_ms << " ms, p99 "
+              << stats.latency_p99_ms << " ms, max " << stats.latency_max_ms << " ms, " << stats.evicted << " evicted"
+              << std::endl;
+  }
+  return 0;
+}
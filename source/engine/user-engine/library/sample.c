@@ -0,0 +1,42 @@
+#include <stdio.h>
+
+#include "kh_solver.h"
+
+/* C インターフェースの使用例。引数で与えた sfen（省略時は 11 手詰）を解いて結果を表示する。 */
+int main(int argc, char** argv) {
+  const char* sfen = argc > 1 ? argv[1] : "1ss6/9/N1k6/9/2G6/9/9/9/9 b RB 1";
+
+  kh_solver_options options;
+  kh_solver_options_init(&options);
+  options.hash_mb = 64;
+
+  kh_solver* solver = kh_solver_create(&options);
+  if (solver == NULL) {
+    fprintf(stderr, "failed to create a solver\n");
+    return 1;
+  }
+
+  kh_solve_limits limits = {10000, 0};
+  kh_solve_result result;
+  if (kh_solver_solve(solver, sfen, &limits, &result) != 0) {
+    fprintf(stderr, "failed to solve\n");
+    kh_solver_destroy(solver);
+    return 1;
+  }
+
+  switch (result.state) {
+    case KH_SOLVE_PROVEN:
+      printf("mate %u: %s\n", result.len, result.pv);
+      break;
+    case KH_SOLVE_DISPROVEN:
+      printf("nomate\n");
+      break;
+    default:
+      printf("timeout\n");
+      break;
+  }
+  printf("nodes %llu\n", (unsigned long long)result.nodes);
+
+  kh_solver_destroy(solver);
+  return 0;
+}
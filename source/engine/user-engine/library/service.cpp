@@ -0,0 +1,249 @@
+#include "service.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace komori {
+namespace {
+/// 応答時間の計測に使う時計
+using Clock = std::chrono::steady_clock;
+/// 応答時間のパーセンタイルを求めるために保持する標本数の上限
+constexpr std::size_t kLatencySamples = 4096;
+
+/**
+ * @brief 昇順に並んだ `sorted` の `p` パーセンタイル（nearest-rank 法）
+ * @param sorted 昇順に並んだ値
+ * @param p      パーセンタイル（0 < `p` <= 100）
+ * @return `sorted` が空なら 0
+ */
+double Percentile(const std::vector<double>& sorted, double p) {
+  if (sorted.empty()) {
+    return 0.0;
+  }
+
+  const auto rank = static_cast<std::size_t>(std::ceil(p / 100.0 * static_cast<double>(sorted.size())));
+  return sorted[std::clamp<std::size_t>(rank, 1, sorted.size()) - 1];
+}
+}  // namespace
+
+/**
+ * @brief `SolverService` の実装本体
+ */
+class SolverService::Impl {
+ public:
+  /**
+   * @brief サービスを作る
+   * @param options サービスの設定
+   */
+  explicit Impl(const ServiceOptions& options) : options_{options} {}
+
+  /// ジョブ `job_id` として局面 `sfen` を解く
+  SolveResult Submit(const std::string& job_id, const std::string& sfen, const JobBudget& budget) {
+    const auto start_time = Clock::now();
+    const auto hash_mb = std::max<std::uint64_t>(budget.hash_mb, 1);
+    auto slot = Acquire(job_id, hash_mb);
+    if (!slot.solver) {
+      auto solver_options = options_.solver;
+      solver_options.hash_mb = hash_mb;
+      slot.solver = std::make_unique<Solver>(solver_options);
+    } else {
+      slot.solver->Resize(hash_mb);
+    }
+    slot.hash_mb = hash_mb;
+
+    const auto result = slot.solver->Solve(sfen, SolveLimits{budget.time_ms, budget.nodes});
+    if (result.state != SolveState::kUnknown) {
+      slot.solver->Clear();
+    }
+    const auto end_time = Clock::now();
+
+    // ソルバーの破棄はスレッドの終了を待つので、ロックの外で行う
+    std::vector<Slot> garbage;
+    {
+      const std::lock_guard lock(mutex_);
+      Record(result, start_time, end_time);
+      if (result.state == SolveState::kUnknown) {
+        slot.last_used = ++tick_;
+        if (auto itr = retained_.find(job_id); itr != retained_.end()) {
+          // 同じジョブが同時に打ち切られた場合は、後に終わった方の置換表を残す
+          held_mb_ -= itr->second.hash_mb;
+          garbage.push_back(std::move(itr->second));
+          itr->second = std::move(slot);
+        } else {
+          retained_.emplace(job_id, std::move(slot));
+        }
+      } else {
+        idle_.push_back(std::move(slot));
+      }
+      Evict(garbage);
+    }
+
+    return result;
+  }
+
+  /// 打ち切られたジョブ `job_id` の置換表を捨てる
+  void Release(const std::string& job_id) {
+    std::vector<Slot> garbage;
+    const std::lock_guard lock(mutex_);
+    if (auto itr = retained_.find(job_id); itr != retained_.end()) {
+      held_mb_ -= itr->second.hash_mb;
+      garbage.push_back(std::move(itr->second));
+      retained_.erase(itr);
+    }
+  }
+
+  /// これまでに終了したジョブの集計
+  ServiceStats Stats() const {
+    const std::lock_guard lock(mutex_);
+    auto stats = stats_;
+    stats.retained = retained_.size();
+    if (stats.jobs > 0) {
+      stats.elapsed_ms = std::chrono::duration<double, std::milli>(last_end_time_ - first_start_time_).count();
+      if (stats.elapsed_ms > 0.0) {
+        stats.throughput = static_cast<double>(stats.jobs) * 1000.0 / stats.elapsed_ms;
+      }
+
+      auto latencies = latencies_ms_;
+      std::sort(latencies.begin(), latencies.end());
+      stats.latency_p50_ms = Percentile(latencies, 50.0);
+      stats.latency_p99_ms = Percentile(latencies, 99.0);
+    }
+    return stats;
+  }
+
+ private:
+  /// ソルバーとその置換表サイズの組
+  struct Slot {
+    std::unique_ptr<Solver> solver;  ///< ソルバー。まだ作っていなければ `nullptr`。
+    std::uint64_t hash_mb{0};        ///< `solver` の置換表サイズ[MB]
+    std::uint64_t last_used{0};      ///< 最後に打ち切られた時刻（`tick_` の値）
+  };
+
+  /**
+   * @brief ジョブ `job_id` を解くソルバーを取り出す
+   * @param job_id  ジョブ ID
+   * @param hash_mb ジョブの置換表サイズ[MB]
+   * @return 打ち切られたジョブのソルバー、空いているソルバー、`nullptr` の順に優先して返す。
+   *
+   * 取り出したソルバーの置換表サイズは `hash_mb` に変わるものとして、保持しているメモリ量を見積もる。
+   */
+  Slot Acquire(const std::string& job_id, std::uint64_t hash_mb) {
+    std::vector<Slot> garbage;
+    const std::lock_guard lock(mutex_);
+    Slot slot;
+    if (auto itr = retained_.find(job_id); itr != retained_.end()) {
+      slot = std::move(itr->second);
+      retained_.erase(itr);
+    } else if (!idle_.empty()) {
+      // 置換表サイズが同じソルバーがあれば、確保し直さずに済むのでそれを使う
+      auto itr = std::find_if(idle_.begin(), idle_.end(), [&](const Slot& s) { return s.hash_mb == hash_mb; });
+      if (itr == idle_.end()) {
+        itr = std::prev(idle_.end());
+      }
+      slot = std::move(*itr);
+      idle_.erase(itr);
+    }
+
+    held_mb_ = held_mb_ - slot.hash_mb + hash_mb;
+    Evict(garbage);
+    return slot;
+  }
+
+  /**
+   * @brief 保持している置換表の合計が上限を超えていれば、空いているソルバー、最も長い間使われていない
+   *        打ち切られたジョブの順に捨てる
+   * @param garbage 捨てるソルバーの格納先
+   */
+  void Evict(std::vector<Slot>& garbage) {
+    while (held_mb_ > options_.memory_mb) {
+      if (!idle_.empty()) {
+        held_mb_ -= idle_.back().hash_mb;
+        garbage.push_back(std::move(idle_.back()));
+        idle_.pop_back();
+      } else if (!retained_.empty()) {
+        auto lru = std::min_element(retained_.begin(), retained_.end(), [](const auto& lhs, const auto& rhs) {
+          return lhs.second.last_used < rhs.second.last_used;
+        });
+        held_mb_ -= lru->second.hash_mb;
+        garbage.push_back(std::move(lru->second));
+        retained_.erase(lru);
+        stats_.evicted++;
+      } else {
+        // 残りは探索中のジョブなので捨てられない
+        break;
+      }
+    }
+  }
+
+  /// 終了したジョブの探索結果と応答時間を集計に加える
+  void Record(const SolveResult& result, Clock::time_point start_time, Clock::time_point end_time) {
+    if (stats_.jobs == 0 || start_time < first_start_time_) {
+      first_start_time_ = start_time;
+    }
+    last_end_time_ = std::max(last_end_time_, end_time);
+
+    stats_.jobs++;
+    switch (result.state) {
+      case SolveState::kProven:
+        stats_.proven++;
+        break;
+      case SolveState::kDisproven:
+        stats_.disproven++;
+        break;
+      default:
+        stats_.unknown++;
+        break;
+    }
+    stats_.nodes += result.nodes;
+
+    const auto latency_ms = std::chrono::duration<double, std::milli>(end_time - start_time).count();
+    stats_.latency_max_ms = std::max(stats_.latency_max_ms, latency_ms);
+    // 長時間動かしてもメモリが増え続けないよう、標本数が上限に達したら reservoir sampling で一様に入れ替える
+    if (latencies_ms_.size() < kLatencySamples) {
+      latencies_ms_.push_back(latency_ms);
+    } else if (const auto i = std::uniform_int_distribution<std::uint64_t>{0, stats_.jobs - 1}(rng_);
+               i < kLatencySamples) {
+      latencies_ms_[i] = latency_ms;
+    }
+  }
+
+  const ServiceOptions options_;  ///< サービスの設定
+
+  mutable std::mutex mutex_;  ///< 以下のメンバを保護するロック
+  /// 打ち切られたジョブのソルバー。ジョブ ID で引く。
+  std::unordered_map<std::string, Slot> retained_;
+  std::vector<Slot> idle_;              ///< 置換表を消去して空いているソルバー
+  std::uint64_t held_mb_{0};            ///< 探索中のものを含め、保持している置換表の合計[MB]
+  std::uint64_t tick_{0};               ///< ジョブが打ち切られるたびに増える時刻
+  ServiceStats stats_{};                ///< 集計。`retained` と時間に関する値は `Stats()` で計算する。
+  std::vector<double> latencies_ms_;    ///< 終了したジョブの応答時間[ms]の標本。最大 `kLatencySamples` 個。
+  std::mt19937_64 rng_{};               ///< 応答時間の標本を選ぶ乱数
+  Clock::time_point first_start_time_;  ///< 最初のジョブの開始時刻
+  Clock::time_point last_end_time_;     ///< 最後のジョブの終了時刻
+};
+
+SolverService::SolverService(const ServiceOptions& options) : impl_{std::make_unique<Impl>(options)} {}
+SolverService::~SolverService() = default;
+
+SolveResult SolverService::Submit(const std::string& job_id, const std::string& sfen, const JobBudget& budget) {
+  return impl_->Submit(job_id, sfen, budget);
+}
+
+void SolverService::Release(const std::string& job_id) {
+  impl_->Release(job_id);
+}
+
+ServiceStats SolverService::Stats() const {
+  return impl_->Stats();
+}
+}  // namespace komori
@@ -0,0 +1,114 @@
+/**
+ * @file service.hpp
+ */
+#ifndef KOMORI_SERVICE_HPP_
+#define KOMORI_SERVICE_HPP_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "solver.hpp"
+
+namespace komori {
+/**
+ * @brief 1 回の `SolverService::Submit()` に割り当てる予算。`time_ms` と `nodes` は 0 なら制限なし。
+ */
+struct JobBudget {
+  std::uint64_t time_ms{0};   ///< 探索時間の上限[ms]
+  std::uint64_t nodes{0};     ///< 探索局面数の上限
+  std::uint64_t hash_mb{64};  ///< ジョブ専用の置換表サイズ[MB]
+};
+
+/**
+ * @brief サービスの生成時に決める設定
+ */
+struct ServiceOptions {
+  /// 各ジョブのソルバーの設定。`hash_mb` は使わず、ジョブごとの `JobBudget::hash_mb` に従う。
+  SolverOptions solver{};
+  /// サービスが保持する置換表の合計サイズの上限[MB]。探索中のジョブの分は上限を超えても解放しない。
+  std::uint64_t memory_mb{1024};
+};
+
+/**
+ * @brief `SolverService::Stats()` の戻り値
+ */
+struct ServiceStats {
+  std::uint64_t jobs{0};       ///< 終了したジョブ数（追加の予算での呼び出しも 1 回と数える）
+  std::uint64_t proven{0};     ///< 詰みと分かったジョブ数
+  std::uint64_t disproven{0};  ///< 不詰と分かったジョブ数
+  std::uint64_t unknown{0};    ///< 予算内に結論の出なかったジョブ数
+  std::uint64_t nodes{0};      ///< 探索局面数の合計
+  std::uint64_t retained{0};   ///< 置換表を保持している打ち切られたジョブの数
+  std::uint64_t evicted{0};    ///< メモリ上限のために置換表を捨てた打ち切られたジョブの数
+  double elapsed_ms{0.0};      ///< 最初のジョブの開始から最後のジョブの終了までの時間[ms]
+  double throughput{0.0};      ///< 1 秒あたりに終了したジョブ数
+  /// ジョブの応答時間の中央値[ms]。ジョブ数が多い場合は、一様に選んだ 4096 件の標本から求めた推定値。
+  double latency_p50_ms{0.0};
+  double latency_p99_ms{0.0};  ///< ジョブの応答時間の 99 パーセンタイル[ms]。`latency_p50_ms` と同様に推定値。
+  double latency_max_ms{0.0};  ///< ジョブの応答時間の最大値[ms]
+};
+
+/**
+ * @brief ジョブごとに予算を決めて詰将棋を解くサービス
+ *
+ * 各ジョブは専用の置換表を持つソルバーで解く。そのため、探索量の多いジョブが他のジョブの探索結果を置換表から
+ * 追い出すことはない。ソルバーはジョブの終了後に置換表を消去して使い回すので、ジョブごとにスレッドを作り直す
+ * ことはない。
+ *
+ * 予算内に結論の出なかったジョブは、置換表をジョブ ID と対応付けて保持しておく。同じジョブ ID で再び
+ * `Submit()` を呼ぶと、保持しておいた置換表を使って探索を続ける。ジョブの置換表サイズを大きくした場合も、
+ * エントリは引き継ぐ。保持している置換表の合計が `ServiceOptions::memory_mb` を超えた場合は、最も長い間
+ * 使われていないジョブの置換表から捨てる。
+ *
+ * `Submit()` は複数のスレッドから同時に呼び出してよい。同じジョブ ID の `Submit()` を同時に呼び出した場合、
+ * 置換表を引き継げるのはそのうちの 1 つだけである。
+ */
+class SolverService {
+ public:
+  /**
+   * @brief サービスを作る
+   * @param options サービスの設定
+   */
+  explicit SolverService(const ServiceOptions& options = {});
+  /// Copy constructor(delete)
+  SolverService(const SolverService&) = delete;
+  /// Move constructor(delete)
+  SolverService(SolverService&&) = delete;
+  /// Copy assign operator(delete)
+  SolverService& operator=(const SolverService&) = delete;
+  /// Move assign operator(delete)
+  SolverService& operator=(SolverService&&) = delete;
+  /// Destructor
+  ~SolverService();
+
+  /**
+   * @brief ジョブ `job_id` として局面 `sfen` を予算 `budget` の範囲で解く
+   * @param job_id ジョブ ID。打ち切られたジョブを続けるときは前回と同じ ID を渡す。
+   * @param sfen   局面（"sfen" や "position" を含まない sfen 文字列）
+   * @param budget 予算
+   * @return 探索結果
+   * @pre `sfen` は正しい局面を表す
+   *
+   * 結論が出た場合、ジョブの置換表は捨てる。
+   */
+  SolveResult Submit(const std::string& job_id, const std::string& sfen, const JobBudget& budget);
+
+  /**
+   * @brief 打ち切られたジョブ `job_id` の置換表を捨てる
+   * @param job_id ジョブ ID
+   *
+   * 保持していなければ何もしない。
+   */
+  void Release(const std::string& job_id);
+
+  /// これまでに終了したジョブの集計
+  ServiceStats Stats() const;
+
+ private:
+  class Impl;
+  std::unique_ptr<Impl> impl_;  ///< 実装本体
+};
+}  // namespace komori
+
+#endif  // KOMORI_SERVICE_HPP_
@@ -0,0 +1,215 @@
+#include "solver.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "../../../thread.h"
+#include "../../../usi.h"
+#include "../engine_option.hpp"
+#include "../initial_estimation.hpp"
+#include "../komoring_heights.hpp"
+#include "../node.hpp"
+#include "../path_keys.hpp"
+#include "../search_monitor.hpp"
+#include "../thread_initialization.hpp"
+
+namespace komori {
+namespace {
+/// プロセス全体で共有する状態の初期化フラグ
+std::once_flag g_library_init_flag;
+
+/// プロセス全体で共有する状態を初期化する。何度呼び出しても初期化は 1 回しか行わない。
+void InitializeLibrary() {
+  std::call_once(g_library_init_flag, []() {
+    // USI エンジン本体をリンクしないので、詰めエンジン独自のオプションもここで登録する
+    USI::init(Options);
+    EngineOption::Init(Options);
+    Bitboards::init();
+    Position::init();
+    Search::init();
+    PathKeyInit();
+    ResetEstimationParameters();
+  });
+}
+
+/// `NodeState` を `SolveState` へ変換する
+SolveState ToSolveState(NodeState state) {
+  switch (state) {
+    case NodeState::kProven:
+      return SolveState::kProven;
+    case NodeState::kDisproven:
+    case NodeState::kRepetition:
+      return SolveState::kDisproven;
+    default:
+      return SolveState::kUnknown;
+  }
+}
+}  // namespace
+
+/**
+ * @brief `Solver` の実装本体
+ *
+ * USI エンジンでは `Threads` と `user-search.cpp` のグローバル変数が担っている役割を、インスタンスごとに持つ。
+ */
+class Solver::Impl {
+ public:
+  /**
+   * @brief ソルバーを作る
+   * @param options ソルバーの設定
+   */
+  explicit Impl(const SolverOptions& options) {
+    InitializeLibrary();
+
+    const auto num_threads = std::max<std::uint32_t>(options.threads, 1);
+    option_.Reload(Options);
+    option_.hash_mb = options.hash_mb;
+    option_.threads = static_cast<int>(num_threads);
+    option_.root_is_and_node_if_checked = options.root_is_and_node_if_checked;
+    option_.post_search_level = detail::post_search_level.Get(options.post_search_level);
+    option_.memory_placement.huge_pages = options.large_pages;
+    option_.memory_placement.numa = detail::numa_policy_option.Get(options.numa_policy);
+    option_.deterministic_quantum = options.deterministic_quantum;
+    option_.pv_interval = std::numeric_limits<std::uint64_t>::max();
+    option_.silent = true;
+    searcher_.Init(option_, num_threads);
+
+    for (std::uint32_t i = 0; i < num_threads; ++i) {
+      threads_.push_back(std::make_unique<SolverThread>(i, *this));
+    }
+  }
+
+  /// 局面 `sfen` を解く
+  SolveResult Solve(const std::string& sfen, const SolveLimits& limits) {
+    const std::lock_guard lock(solve_mutex_);
+
+    SearchContext context;
+    for (auto& th : threads_) {
+      th->nodes.store(0, std::memory_order_relaxed);
+      th->rootPos.set(sfen, &th->rootState, th.get());
+      context.threads.push_back(th.get());
+    }
+    context.stop = &stop_;
+    if (limits.time_ms > 0) {
+      context.time_limit = static_cast<TimePoint>(limits.time_ms);
+    }
+    if (limits.nodes > 0) {
+      context.nodes_limit = limits.nodes;
+    }
+
+    const auto& root_pos = threads_[0]->rootPos;
+    is_root_or_node_ = IsRootOrNode(root_pos, option_.root_is_and_node_if_checked);
+    search_result_ = NodeState::kUnknown;
+    stop_.store(false, std::memory_order_release);
+
+    searcher_.NewSearch(root_pos, is_root_or_node_, context);
+    for (auto& th : threads_) {
+      th->start_searching();
+    }
+    for (auto& th : threads_) {
+      th->wait_for_search_finished();
+    }
+    searcher_.FinishSearch();
+
+    SolveResult result;
+    result.state = ToSolveState(search_result_);
+    for (const auto* th : context.threads) {
+      result.nodes += th->nodes.load(std::memory_order_relaxed);
+    }
+    if (result.state == SolveState::kProven) {
+      for (const auto move : searcher_.BestMoves()) {
+        result.pv.push_back(to_usi_string(move));
+      }
+      result.len = static_cast<std::uint32_t>(result.pv.size());
+    }
+    return result;
+  }
+
+  /// 実行中の `Solve()` を打ち切る
+  void Stop() { stop_.store(true, std::memory_order_release); }
+
+  /// 置換表の内容をすべて削除する
+  void Clear() {
+    const std::lock_guard lock(solve_mutex_);
+    searcher_.Clear();
+  }
+
+  /// 置換表サイズを変更する
+  void Resize(std::uint64_t hash_mb) {
+    const std::lock_guard lock(solve_mutex_);
+    if (option_.hash_mb == hash_mb) {
+      return;
+    }
+
+    option_.hash_mb = hash_mb;
+    searcher_.Init(option_, static_cast<std::uint32_t>(threads_.size()));
+  }
+
+ private:
+  /**
+   * @brief ソルバー専用の探索スレッド
+   *
+   * YaneuraOu の `Thread` と同様に `start_searching()` で `search()` を開始し、`wait_for_search_finished()` で
+   * 終了を待つ。`Threads` には登録しない。
+   */
+  class SolverThread : public Thread {
+   public:
+    /**
+     * @brief 探索スレッドを作る
+     * @param id スレッド番号
+     * @param impl 探索を行うソルバー
+     */
+    SolverThread(std::size_t id, Impl& impl) : Thread{id}, impl_{impl} {}
+
+    /// 探索本体
+    void search() override { impl_.ThreadSearch(*this); }
+
+   private:
+    Impl& impl_;  ///< 探索を行うソルバー
+  };
+
+  /// 各探索スレッドの探索本体。USI エンジンの `Thread::search()` に対応する。
+  void ThreadSearch(Thread& th) {
+    InitializeThread(static_cast<std::uint32_t>(th.id()), static_cast<std::uint32_t>(threads_.size()));
+    const auto result = searcher_.Search(th.rootPos, is_root_or_node_);
+    if (th.id() == 0) {
+      search_result_ = result;
+      // メインスレッドの探索が終わったら他のスレッドも止める
+      stop_.store(true, std::memory_order_release);
+    }
+  }
+
+  EngineOption option_;          ///< エンジンオプション
+  KomoringHeights searcher_;     ///< 探索本体
+  std::atomic<bool> stop_{};     ///< 探索を打ち切るためのフラグ
+  NodeState search_result_{};    ///< メインスレッドの探索結果
+  bool is_root_or_node_{true};   ///< 探索開始局面が OR node かどうか
+  std::mutex solve_mutex_;       ///< `Solve()` を直列化するためのロック
+  std::vector<std::unique_ptr<SolverThread>> threads_;  ///< 探索スレッド。`searcher_` より先に破棄する。
+};
+
+Solver::Solver(const SolverOptions& options) : impl_{std::make_unique<Impl>(options)} {}
+Solver::Solver(Solver&&) noexcept = default;
+Solver& Solver::operator=(Solver&&) noexcept = default;
+Solver::~Solver() = default;
+
+SolveResult Solver::Solve(const std::string& sfen, const SolveLimits& limits) {
+  return impl_->Solve(sfen, limits);
+}
+
+void Solver::Stop() {
+  impl_->Stop();
+}
+
+void Solver::Clear() {
+  impl_->Clear();
+}
+
+void Solver::Resize(std::uint64_t hash_mb) {
+  impl_->Resize(hash_mb);
+}
+}  // namespace komori
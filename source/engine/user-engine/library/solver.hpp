@@ -0,0 +1,121 @@
+/**
+ * @file solver.hpp
+ */
+#ifndef KOMORI_SOLVER_HPP_
+#define KOMORI_SOLVER_HPP_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace komori {
+/**
+ * @brief `Solver::Solve()` の探索結果
+ */
+enum class SolveState {
+  kUnknown,    ///< 時間切れなどで詰みかどうか分からなかった
+  kProven,     ///< 詰み
+  kDisproven,  ///< 不詰（千日手による不詰を含む）
+};
+
+/**
+ * @brief ソルバーの生成時に決める設定
+ */
+struct SolverOptions {
+  std::uint64_t hash_mb{256};              ///< 置換表サイズ[MB]
+  std::uint32_t threads{1};                ///< 探索スレッド数
+  bool root_is_and_node_if_checked{true};  ///< 開始局面が王手されているとき、玉方手番として扱うかどうか
+  /// 余詰探索の度合い（"None", "UpperBound", "MinLength"）。USI オプション `PostSearchLevel` と同じ。
+  std::string post_search_level{"MinLength"};
+  bool large_pages{false};  ///< 置換表に Huge Pages を使うかどうか
+  /// 置換表の NUMA 配置（"None", "Interleave", "FirstTouch"）。USI オプション `HashNumaPolicy` と同じ。
+  std::string numa_policy{"None"};
+  /// 0 でなければ、探索スレッドがこの局面数ずつ番号順に交代で探索する。USI オプション `DeterministicQuantum` と同じ。
+  std::uint64_t deterministic_quantum{0};
+};
+
+/**
+ * @brief 1 回の `Solver::Solve()` の打ち切り条件。0 なら制限なし。
+ */
+struct SolveLimits {
+  std::uint64_t time_ms{0};  ///< 探索時間の上限[ms]
+  std::uint64_t nodes{0};    ///< 探索局面数の上限
+};
+
+/**
+ * @brief `Solver::Solve()` の戻り値
+ */
+struct SolveResult {
+  SolveState state{SolveState::kUnknown};  ///< 探索結果
+  std::vector<std::string> pv;             ///< 詰み手順（USI 形式）。`state` が `kProven` のときのみ。
+  std::uint32_t len{0};                    ///< 詰み手数。`pv.size()` に等しい。
+  std::uint64_t nodes{0};                  ///< 探索局面数
+};
+
+/**
+ * @brief USI を介さずに詰将棋を解くためのソルバー
+ *
+ * ソルバーはそれぞれ専用の置換表と探索スレッドを持つ。そのため、1 プロセス内で複数のソルバーを作り、
+ * 別々のスレッドから同時に `Solve()` を呼び出すことができる。1 つのソルバーに対する `Solve()` の呼び出しは
+ * 内部で直列化される。
+ *
+ * 最初のソルバーを作るときに、YaneuraOu のテーブル類などプロセス全体で共有する状態を初期化する。
+ * 初期評価パラメータはプロセス全体で共有するため、ソルバーごとに変えることはできない。
+ *
+ * @note USI エンジン本体（`user-search.cpp`）とは同じプロセスにリンクできない。
+ */
+class Solver {
+ public:
+  /**
+   * @brief ソルバーを作る
+   * @param options ソルバーの設定
+   */
+  explicit Solver(const SolverOptions& options = {});
+  /// Copy constructor(delete)
+  Solver(const Solver&) = delete;
+  /// Move constructor(default)
+  Solver(Solver&&) noexcept;
+  /// Copy assign operator(delete)
+  Solver& operator=(const Solver&) = delete;
+  /// Move assign operator(default)
+  Solver& operator=(Solver&&) noexcept;
+  /// Destructor
+  ~Solver();
+
+  /**
+   * @brief 局面 `sfen` を解く
+   * @param sfen 局面（"sfen" や "position" を含まない sfen 文字列）
+   * @param limits 打ち切り条件
+   * @return 探索結果
+   * @pre `sfen` は正しい局面を表す
+   *
+   * 前回までの探索結果は置換表に残っているので、似た局面を続けて解くと速く終わることがある。
+   */
+  SolveResult Solve(const std::string& sfen, const SolveLimits& limits = {});
+
+  /**
+   * @brief 実行中の `Solve()` を打ち切る。別スレッドから呼び出してよい。
+   *
+   * 打ち切られた `Solve()` は `SolveState::kUnknown` を返す。`Solve()` 中でなければ何もしない。
+   */
+  void Stop();
+
+  /// 置換表の内容をすべて削除する
+  void Clear();
+
+  /**
+   * @brief 置換表サイズを `hash_mb`[MB] に変更する
+   * @param hash_mb 置換表サイズ[MB]
+   *
+   * 置換表のエントリはできるだけ引き継ぐ。`Solve()` 中に呼び出した場合は、`Solve()` が終わるまで待つ。
+   */
+  void Resize(std::uint64_t hash_mb);
+
+ private:
+  class Impl;
+  std::unique_ptr<Impl> impl_;  ///< 実装本体
+};
+}  // namespace komori
+
+#endif  // KOMORI_SOLVER_HPP_
@@ -11,10 +11,14 @@
 #include "bitset.hpp"
 #include "board_key_hand_pair.hpp"
 #include "delayed_move_list.hpp"
+#include "delta_tree.hpp"
 #include "double_count_elimination.hpp"
 #include "fixed_size_stack.hpp"
+#include "frontier_mate.hpp"
 #include "hands.hpp"
 #include "initial_estimation.hpp"
+#include "interposition.hpp"
+#include "move_history.hpp"
 #include "move_picker.hpp"
 #include "node.hpp"
 #include "ranges.hpp"
@@ -28,19 +32,26 @@ constexpr PnDn kForceSumPnDn = kInfinitePnDn / 1024;
 /**
  * @brief OR node `n` を `move` した局面が自明な詰み／不詰かどうかを判定する。
  * @param n     現局面
- * @param move  次の手
+ * @param len   現局面の残り手数
+ * @param frontier_mate_ply 奇数手詰めを調べる最大手数
  * @return `n` を `move` で進めた局面が自明な詰みまたは不詰ならその結果を返す。それ以外なら `std::nullopt` を返す。
  *
  * 末端局面における固定深さ探索。詰め探索で必須ではないが、これによって高速化することができる。
  *
  * 高速 1 手詰めルーチンおよび高速 0 手不詰ルーチンにより自明な詰み／不詰を展開することなく検知することができる。
+ * `frontier_mate_ply` が 3 以上なら、`len` 手を超えない範囲で奇数手詰めも調べる。
  */
-inline std::optional<SearchResult> CheckObviousFinalOrNode(Node& n) {
+inline std::optional<SearchResult> CheckObviousFinalOrNode(Node& n,
+                                                           MateLen len = kDepthMaxMateLen,
+                                                           Depth frontier_mate_ply = 1) {
   if (!DoesHaveMatePossibility(n.Pos())) {
     const auto hand = HandSet{DisproofHandTag{}}.Get(n.Pos());
     return SearchResult::MakeFinal<false>(hand, kDepthMaxMateLen, 1);
   } else if (auto [best_move, proof_hand] = CheckMate1Ply(n); proof_hand != kNullHand) {
     return SearchResult::MakeFinal<true>(proof_hand, MateLen{1}, 1);
+  } else if (const auto frontier_mate = CheckFrontierMate(n, len, frontier_mate_ply)) {
+    const auto [frontier_proof_hand, mate_len] = *frontier_mate;
+    return SearchResult::MakeFinal<true>(frontier_proof_hand, mate_len, 1);
   }
   return std::nullopt;
 }
@@ -71,7 +82,7 @@ inline std::optional<SearchResult> CheckObviousFinalOrNode(Node& n) {
  * スタック構造を活かして探索中に `idx_` へ生添字を追加することもできる。これは、
  * 指し手の遅延展開（`delayed_move_list_`）に用いられる。
  *
- * ### δ値の計算（sum_delta_except_best_, max_delta_except_best_, sum_mask）
+ * ### δ値の計算（delta_tree_, sum_mask）
  *
  * 現局面のδ値は、和で計上する子の集合 sum_child と最大値で計上する子の集合 max_child を用いて
  *    δ = Σ_[i in sum_child] δ_i + max_[i in max_child] δ_i
@@ -79,11 +90,11 @@ inline std::optional<SearchResult> CheckObviousFinalOrNode(Node& n) {
  * 「現局面のδしきい値 thdelta をこえるようなδ_i の最大値」により定義される。
  *
  * まともに計算すると、「δ値」と「子のδしきい値」で2回でこの計算が必要になる。この計算は
- * 探索中にとても頻繁に現れる計算であるため、できる限り計算量を削減したい。そのため、
- * 「最善手を除いた sum_child のδ値の和 `sum_delta_except_best_`」と「最善手を除いた max_child の
- * δ値の最大値 `max_delta_except_best_`」を事前に計算しておく。これら2つの変数があれば、
- * 「δ値」と「子のδしきい値」をどちらも短時間で計算できる。また、これらの値は多くの場合において、
- * 差分計算で効率よく更新できることもポイントである。
+ * 探索中にとても頻繁に現れる計算であるため、できる限り計算量を削減したい。そのため、子のδ値を `DeltaTree`
+ * 型の `delta_tree_` に持たせておく。sum_child の子は和の側、max_child の子は最大値の側にδ値を書き、それ以外（後回しに
+ * している子や勝ちになる手）は 0 にしておく。子の探索結果が変わるたびにその子の値だけを O(log n) で書き換えるので、
+ * 子の個数が多い局面でも全ての子を走査し直す必要がない。δ値は木の根から、子のδしきい値は最善手を除いた
+ * 和と最大値から計算できる。
  *
  * δ値を和で計上するか最大値で計上するかは `sum_mask_` で管理している。`sum_mask_` のビットが立っている子は
  * 和で、立っていない子は最大値でδ値を計上する。「和」の方にビットを立てるようにしている理由は、
@@ -111,7 +122,8 @@ class LocalExpansion {
     const SearchResultComparer sr_comparer{or_node_};
     return [this, sr_comparer](std::size_t i_raw, std::size_t j_raw) -> bool {
       // `SearchResultComparer` で大小比較の決着がつくならそれに従う。
-      // `SearchResultComparer` で結論がでなければ、指し手自体の評価値（指し手生成時に付与）で大小を決める。
+      // `SearchResultComparer` で結論がでなければ、探索中に得た手の履歴値、指し手自体の評価値（指し手生成時に付与）の
+      // 順に大小を決める。
       const auto& left_result = results_[i_raw];
       const auto& right_result = results_[j_raw];
       const auto ordering = sr_comparer(left_result, right_result);
@@ -121,6 +133,9 @@ class LocalExpansion {
         return false;
       }
 
+      if (history_[i_raw] != history_[j_raw]) {
+        return history_[i_raw] > history_[j_raw];
+      }
       return mp_[i_raw].value < mp_[j_raw].value;
     };
   }
@@ -129,21 +144,27 @@ class LocalExpansion {
   /**
    * @brief LocalExpansion を構築する。
    * @param tt  置換表
+   * @param move_history 攻め方の手の履歴
    * @param n   現局面
    * @param len 残り詰み手数
    * @param first_search 初回探索なら `true`。`true` なら高速 1 手詰めルーチンを走らせる。
+   * @param frontier_mate_ply 初回探索で調べる奇数手詰めの最大手数（エンジンオプション `FrontierMatePly`）
    * @param sum_mask δ値を和で計算する子の集合
    * @param multi_pv 勝ちになる手をいくつ見つけるか。1以上でなければならない
    */ // NOLINTNEXTLINE(readability-function-cognitive-complexity)
   LocalExpansion(tt::TranspositionTable& tt,
+                 MoveHistory& move_history,
                  const Node& n,
                  MateLen len,
                  bool first_search,
+                 Depth frontier_mate_ply,
                  BitSet64 sum_mask = BitSet64::Full(),
                  std::uint32_t multi_pv = 1)
-      : or_node_{n.IsOrNode()},
+      : move_history_{move_history},
+        or_node_{n.IsOrNode()},
         mp_{n, true},
         delayed_move_list_{n, mp_},
+        interposition_{tt, n},
         len_{len},
         key_hand_pair_{n.GetBoardKeyHandPair()},
         multi_pv_{multi_pv},
@@ -154,6 +175,8 @@ class LocalExpansion {
     for (const auto& [i_raw, move] : WithIndex<std::uint32_t>(mp_)) {
       const auto hand_after = n.OrHandAfter(move.move);
       idx_.Push(i_raw);
+      // 並び替えの途中で順序が変わらないよう、履歴値は構築時の値を使い続ける
+      history_[i_raw] = or_node_ ? move_history_.Get(move.move) : 0;
       auto& result = results_[i_raw];
       auto& query = queries_[i_raw];
 
@@ -173,6 +196,14 @@ class LocalExpansion {
         result =
             query.LookUp(does_have_old_child_, len - 1, [&n, &move = move]() { return InitialPnDn(n, move.move); });
 
+        if (!or_node_ && !result.IsFinal()) {
+          // 同じマスへの別の合駒の探索結果から詰みが分かるなら、子局面を展開せずに済ませる
+          if (auto res = interposition_.Prove(move.move, len - 1); res.has_value()) {
+            result = *res;
+            query.SetResult(*res);
+          }
+        }
+
         if (!result.IsFinal()) {
           if (!IsSumDeltaNode(n, move.move) || result.Delta(or_node_) >= detail::kForceSumPnDn) {
             sum_mask_.Reset(i_raw);
@@ -195,7 +226,7 @@ class LocalExpansion {
 
           if (!i_is_skipped && !or_node_ && first_search && result.GetUnknownData().is_first_visit) {
             nn.DoMove(move.move);
-            if (auto res = detail::CheckObviousFinalOrNode(nn); res.has_value()) {
+            if (auto res = detail::CheckObviousFinalOrNode(nn, len - 1, frontier_mate_ply); res.has_value()) {
               result = *res;
               query.SetResult(*res);
             }
@@ -214,7 +245,12 @@ class LocalExpansion {
     }
 
     std::sort(idx_.begin(), idx_.end(), MakeComparer());
-    RecalcDelta();
+    delta_tree_.Reset(mp_.size());
+    for (const auto i_raw : idx_) {
+      const auto [sum_delta, max_delta] = DeltaOf(i_raw);
+      delta_tree_.SetLeaf(i_raw, sum_delta, max_delta);
+    }
+    delta_tree_.Build();
   }
 
   /// Copy constructor(delete)
@@ -298,9 +334,13 @@ class LocalExpansion {
 
     result = search_result;
     query.SetResult(search_result, key_hand_pair_);
+    if (or_node_ && search_result.IsFinal() && !search_result.GetFinalData().IsRepetition()) {
+      move_history_.Update(mp_[old_i_raw].move, search_result.Pn() == 0);
+    }
     if (!result.IsFinal() && result.Delta(or_node_) >= detail::kForceSumPnDn) {
       sum_mask_.Reset(old_i_raw);
     }
+    UpdateDelta(old_i_raw);
 
     if (search_result.Phi(or_node_) == 0) {
       // 後から見つかった手のほうがいい手かもしれないので、前半部分をソートし直しておく
@@ -326,7 +366,16 @@ class LocalExpansion {
       // curr_i_raw の次に調べるべき子
       auto curr_i_raw = delayed_move_list_.Next(old_i_raw);
       do {
+        // 後回しにしている間に同じマスへの合駒が詰んだなら、取り返した後の局面から詰みが分かるかもしれない
+        if (auto& result = results_[*curr_i_raw]; !or_node_ && !result.IsFinal()) {
+          if (auto res = interposition_.Prove(mp_[*curr_i_raw].move, len_ - 1); res.has_value()) {
+            result = *res;
+            queries_[*curr_i_raw].SetResult(*res, key_hand_pair_);
+          }
+        }
+
         idx_.Push(*curr_i_raw);
+        UpdateDelta(*curr_i_raw);
         ResortBack();
         if (results_[*curr_i_raw].Delta(or_node_) > 0) {
           // まだ結論の出ていない子がいた
@@ -336,32 +385,8 @@ class LocalExpansion {
         // curr_i_raw は結論が出ているので、次の後回しにした手 next_dep を調べる
         curr_i_raw = delayed_move_list_.Next(*curr_i_raw);
       } while (curr_i_raw.has_value());
-
-      RecalcDelta();
-    } else {
-      if (search_result.Phi(or_node_) > 0) {
-        // 現在探索していた手が delta_except_best_ に加わるので差分計算する
-        const bool old_is_sum_delta = sum_mask_[old_i_raw];
-        if (old_is_sum_delta) {
-          sum_delta_except_best_ += result.Delta(or_node_);
-        } else {
-          max_delta_except_best_ = std::max(max_delta_except_best_, result.Delta(or_node_));
-        }
-
-        ResortFront();
-      }
-
-      const auto new_i_raw = idx_[excluded_moves_];
-      const auto new_result = results_[new_i_raw];
-      const bool new_is_sum_delta = sum_mask_[new_i_raw];
-      if (new_is_sum_delta) {
-        sum_delta_except_best_ -= new_result.Delta(or_node_);
-      } else if (new_result.Delta(or_node_) < max_delta_except_best_) {
-        // new_best_child を抜いても max_delta_except_best_ の値は変わらない
-      } else {
-        // max_delta_ の再計算が必要
-        RecalcDelta();
-      }
+    } else if (search_result.Phi(or_node_) > 0) {
+      ResortFront();
     }
   }
 
@@ -396,13 +421,14 @@ class LocalExpansion {
   bool ResolveDoubleCountIfBranchRoot(BranchRootEdge edge) {
     if (edge.branch_root_key_hand_pair == key_hand_pair_) {
       sum_mask_.Reset(idx_.front());
+      UpdateDelta(idx_.front());
       for (const auto i_raw : Skip(idx_, excluded_moves_ + 1)) {
         const auto& query = queries_[i_raw];
         const auto& child_key_hand_pair = query.GetBoardKeyHandPair();
         if (child_key_hand_pair == edge.child_key_hand_pair) {
           if (sum_mask_.Test(i_raw)) {
             sum_mask_.Reset(i_raw);
-            RecalcDelta();
+            UpdateDelta(i_raw);
           }
           break;
         }
@@ -468,15 +494,8 @@ class LocalExpansion {
       return 0;
     }
 
-    const auto& best_result = FrontResult();
-    // 差分計算用の値を予め持っているので、高速に計算できる
-    auto sum_delta = sum_delta_except_best_;
-    auto max_delta = max_delta_except_best_;
-    if (sum_mask_[idx_[excluded_moves_]]) {
-      sum_delta = ClampPnDn(sum_delta + best_result.Delta(or_node_));
-    } else {
-      max_delta = std::max(max_delta, best_result.Delta(or_node_));
-    }
+    // 全ての子のδ値の和と最大値は木の根に入っている
+    auto [sum_delta, max_delta] = delta_tree_.Total();
 
     // 後回しにしている子局面が存在する場合、その値をδ値に加算しないと局面を過大評価してしまう。
     //
@@ -488,7 +507,7 @@ class LocalExpansion {
       sum_delta += std::max<std::size_t>((mp_.size() - idx_.size()) / 8, 1);
     }
 
-    const auto raw_delta = ClampPnDn(sum_delta + max_delta);
+    const auto raw_delta = ClampPnDn(SaturatedAdd(sum_delta, max_delta));
     if (excluded_moves_ > 0 && raw_delta == 0) {
       return kInfinitePnDn;
     }
@@ -509,13 +528,15 @@ class LocalExpansion {
    * @param thdelta 現局面の delta しきい値
    */
   PnDn NewThdeltaForBestMove(PnDn thdelta) const {
-    PnDn delta_except_best = sum_delta_except_best_;
+    const auto best_i_raw = idx_[excluded_moves_];
+    const auto [sum_delta_except_best, max_delta_except_best] = delta_tree_.TotalExcept(best_i_raw);
+    PnDn delta_except_best = sum_delta_except_best;
     if (mp_.size() > idx_.size()) {
       delta_except_best += std::max<std::size_t>((mp_.size() - idx_.size()) / 8, 1);
     }
 
-    if (sum_mask_[idx_[excluded_moves_]]) {
-      delta_except_best = SaturatedAdd(delta_except_best, max_delta_except_best_);
+    if (sum_mask_[best_i_raw]) {
+      delta_except_best = SaturatedAdd(delta_except_best, max_delta_except_best);
     }
 
     // 計算の際はオーバーフローに注意
@@ -528,20 +549,28 @@ class LocalExpansion {
   // </PnDn>
 
   /**
-   * @brief δ値の一時変数 `sum_delta_except_best_`, `max_delta_except_best_` を計算し直す
+   * @brief 子 `i_raw` が現局面のδ値に計上する値
+   * @param i_raw 子の生添字
+   * @return 和で計上するδ値と最大値で計上するδ値の組。勝ちになる手は計上しないので (0, 0) を返す。
    */
-  constexpr void RecalcDelta() {
-    sum_delta_except_best_ = 0;
-    max_delta_except_best_ = 0;
-
-    for (const auto& i_raw : Skip(idx_, excluded_moves_ + 1)) {
-      const auto delta_i = results_[i_raw].Delta(or_node_);
-      if (sum_mask_[i_raw]) {
-        sum_delta_except_best_ = ClampPnDn(sum_delta_except_best_ + delta_i);
-      } else {
-        max_delta_except_best_ = std::max(max_delta_except_best_, delta_i);
-      }
+  std::pair<PnDn, PnDn> DeltaOf(std::uint32_t i_raw) const {
+    const auto& result = results_[i_raw];
+    if (result.Phi(or_node_) == 0) {
+      return {0, 0};
     }
+
+    const auto delta = result.Delta(or_node_);
+    if (sum_mask_[i_raw]) {
+      return {delta, 0};
+    } else {
+      return {0, delta};
+    }
+  }
+
+  /// 子 `i_raw` の探索結果か `sum_mask_` が変わったとき、`delta_tree_` を差分更新する
+  void UpdateDelta(std::uint32_t i_raw) {
+    const auto [sum_delta, max_delta] = DeltaOf(i_raw);
+    delta_tree_.Update(i_raw, sum_delta, max_delta);
   }
 
   /// 探索結果を取得する（手番側から見て勝ち局面）
@@ -684,9 +713,11 @@ class LocalExpansion {
     }
   }
 
+  MoveHistory& move_history_;                ///< 攻め方の手の履歴。探索スレッド間で共有する。
   const bool or_node_;                       ///< 現局面が OR node かどうか
   const MovePicker mp_;                      ///< 現局面の合法手
   const DelayedMoveList delayed_move_list_;  ///< 後回しにしている手のグラフ構造
+  const InterpositionProver interposition_;  ///< 飛び駒の王手に対する合駒をまとめて証明する
   const MateLen len_;                        ///< 現局面における残り探索手数
   const BoardKeyHandPair key_hand_pair_;  ///< 現局面の盤面ハッシュ値と持ち駒。二重カウント対策で用いる。
   const std::uint32_t multi_pv_;  ///< MultiPv の値。1以上でなければならない
@@ -695,12 +726,14 @@ class LocalExpansion {
   std::array<SearchResult, kMaxCheckMovesPerNode> results_;
   /// 子のクエリ一覧。コンストラクト時に作ったクエリを使い回すことで高速化できる
   std::array<tt::Query, kMaxCheckMovesPerNode> queries_;
+  /// 構築時に読んだ子の手の履歴値（`move_history_`）。AND node では常に 0。
+  std::array<std::int16_t, kMaxCheckMovesPerNode> history_;
 
   /// 現局面の評価値が古い探索情報に基づくものかどうか。TCA の探索延長の判断に用いる。
   bool does_have_old_child_{false};
 
-  PnDn sum_delta_except_best_;  ///< 和でδを計上する子のうち最善手・excluded_moves_ を除いたもののδ値の和
-  PnDn max_delta_except_best_;  ///< 最大値でδを計上する子のうち最善手・excluded_moves_ を除いたもののδ値の最大値
+  /// 子のδ値の和と最大値。後回しにしている子と勝ちになる手（excluded_moves_）は 0 として持つ。
+  DeltaTree<kMaxCheckMovesPerNode> delta_tree_;
 
   /// δ値を和で計算すべき子の一覧。ビットが立っている子は和、立っていない子は最大値で計上する。
   BitSet64 sum_mask_;
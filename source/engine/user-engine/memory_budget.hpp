@@ -0,0 +1,111 @@
+/**
+ * @file memory_budget.hpp
+ */
+#ifndef KOMORI_MEMORY_BUDGET_HPP_
+#define KOMORI_MEMORY_BUDGET_HPP_
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <limits>
+#include <optional>
+#include <string>
+
+#include "typedefs.hpp"
+
+namespace komori {
+namespace detail {
+/// 置換表・探索スレッド以外で使うメモリ量の見積もり（実行ファイル、やねうら王本体のテーブル、PV など）
+inline constexpr std::uint64_t kBaseMemoryBytes = std::uint64_t{32} * 1024 * 1024;
+/// 探索スレッドの局面展開スタックに割り当てる予算の上限（全体予算に対する割合）
+inline constexpr double kThreadMemoryRatio = 0.25;
+/// 予算が小さいときでも最低限確保する探索深さ
+inline constexpr Depth kMinBudgetDepth = 256;
+}  // namespace detail
+
+/**
+ * @brief メモリ予算から決めた各領域のサイズ
+ */
+struct MemoryPlan {
+  std::uint64_t hash_mb;  ///< 置換表サイズ[MB]
+  Depth max_depth;        ///< 探索する最大深さ。局面展開スタックの大きさを決める。
+};
+
+/**
+ * @brief メモリ予算 `budget_mb` に収まるように置換表サイズと探索深さを決める
+ * @param budget_mb       プロセス全体のメモリ予算[MB]
+ * @param num_threads     探索スレッド数
+ * @param node_bytes      探索スレッド 1 個あたりの `Node` のサイズ
+ * @param expansion_bytes 局面展開スタック 1 段あたりのサイズ
+ * @return 各領域のサイズ
+ *
+ * 探索スレッドはそれぞれ `Node` を 1 個と、探索深さ分の局面展開スタックを持つ。局面展開スタックの最悪値は
+ * `kDepthMax` 段分にもなるので、スレッド数が多いと無視できない。探索スレッドの使用量が予算の
+ * `detail::kThreadMemoryRatio` に収まるように探索深さを制限し、残りを置換表に割り当てる。
+ *
+ * 予算が小さすぎて置換表を確保できない場合でも、置換表サイズは 1 MB を下回らない。
+ */
+inline MemoryPlan PlanMemory(std::uint64_t budget_mb,
+                             std::uint32_t num_threads,
+                             std::size_t node_bytes,
+                             std::size_t expansion_bytes) {
+  const auto budget = budget_mb * 1024 * 1024;
+  const auto threads = std::max<std::uint64_t>(num_threads, 1);
+
+  // 1 スレッドあたりに割り当てられる局面展開スタックの大きさから探索深さを決める
+  const auto thread_budget = static_cast<std::uint64_t>(static_cast<double>(budget) * detail::kThreadMemoryRatio);
+  const auto per_thread = thread_budget / threads;
+  auto max_depth = kDepthMax;
+  if (per_thread < node_bytes + kDepthMax * expansion_bytes) {
+    const auto depth = per_thread > node_bytes ? (per_thread - node_bytes) / expansion_bytes : 0;
+    max_depth = static_cast<Depth>(std::clamp<std::uint64_t>(depth, detail::kMinBudgetDepth, kDepthMax));
+  }
+
+  const auto thread_bytes = threads * (node_bytes + static_cast<std::uint64_t>(max_depth) * expansion_bytes);
+  const auto used = detail::kBaseMemoryBytes + thread_bytes;
+  const auto hash_bytes = budget > used ? budget - used : 0;
+
+  return {std::max<std::uint64_t>(hash_bytes / 1024 / 1024, 1), max_depth};
+}
+
+/**
+ * @brief プロセスの物理メモリ使用量
+ */
+struct ResidentMemory {
+  std::uint64_t current_mb;  ///< 現在の使用量[MB]
+  std::uint64_t peak_mb;     ///< 起動してからの最大使用量[MB]
+};
+
+/**
+ * @brief プロセスの物理メモリ使用量を取得する
+ * @return 物理メモリ使用量。取得できない環境では `std::nullopt`。
+ *
+ * Linux では `/proc/self/status` の `VmRSS` と `VmHWM` を読む。
+ */
+inline std::optional<ResidentMemory> GetResidentMemory() {
+#if defined(__linux__)
+  std::ifstream ifs("/proc/self/status");
+  std::optional<std::uint64_t> current_kb;
+  std::optional<std::uint64_t> peak_kb;
+  std::string key;
+  while (ifs >> key) {
+    if (key == "VmRSS:" || key == "VmHWM:") {
+      std::uint64_t kb{};
+      if (!(ifs >> kb)) {
+        break;
+      }
+      (key == "VmRSS:" ? current_kb : peak_kb) = kb;
+    }
+    ifs.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+  }
+
+  if (current_kb && peak_kb) {
+    return ResidentMemory{*current_kb / 1024, *peak_kb / 1024};
+  }
+#endif  // defined(__linux__)
+
+  return std::nullopt;
+}
+}  // namespace komori
+
+#endif  // KOMORI_MEMORY_BUDGET_HPP_
@@ -0,0 +1,114 @@
+/**
+ * @file move_history.hpp
+ */
+#ifndef KOMORI_MOVE_HISTORY_HPP_
+#define KOMORI_MOVE_HISTORY_HPP_
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+
+#include "typedefs.hpp"
+
+namespace komori {
+namespace detail {
+/// 履歴値の絶対値の上限
+inline constexpr int kMoveHistoryMax = 8192;
+/// 1 回の更新で履歴値へ加える値
+inline constexpr int kMoveHistoryBonus = 512;
+}  // namespace detail
+
+/**
+ * @brief 探索中に詰み／不詰が分かった攻め方の手の履歴
+ *
+ * OR node の子が詰んだら（不詰になったら）、その手の（移動後の駒, 移動先, 駒打ちかどうか）に対する履歴値を
+ * 増やす（減らす）。兄弟局面でも同じ駒を同じマスへ動かす王手は同じように詰みやすいと考えられるので、
+ * `LocalExpansion` で探索結果が同点の子を並べるときに、履歴値の大きい手を先に調べる。
+ *
+ * `KomoringHeights` ごとに 1 つ持ち、その探索スレッド間で共有する。各要素はロックを取らずに読み書きするので、同時に更新すると片方の更新が失われる
+ * ことがあるが、並び順のヒントにしか使わないので問題ない。
+ *
+ * 更新は `h += bonus - h * |bonus| / kMoveHistoryMax` で行う。こうすると履歴値は
+ * [-kMoveHistoryMax, kMoveHistoryMax] に収まり、古い結果ほど影響が薄れていく。
+ *
+ * 問題によっては並び順が変わることで探索局面数が増えるので、エンジンオプション `MoveHistory` で有効にしたときだけ
+ * 使う。`SetEnabled(false)` の間は履歴を更新せず、`Get()` は常に 0 を返す。
+ */
+class MoveHistory {
+ public:
+  /// Default constructor
+  MoveHistory() { Clear(); }
+  /// Copy constructor(delete)
+  MoveHistory(const MoveHistory&) = delete;
+  /// Move constructor(delete)
+  MoveHistory(MoveHistory&&) = delete;
+  /// Copy assign operator(delete)
+  MoveHistory& operator=(const MoveHistory&) = delete;
+  /// Move assign operator(delete)
+  MoveHistory& operator=(MoveHistory&&) = delete;
+  /// Destructor(default)
+  ~MoveHistory() = default;
+
+  /// 履歴をすべて消す
+  void Clear() {
+    for (auto& value : table_) {
+      value.store(0, std::memory_order_relaxed);
+    }
+  }
+
+  /**
+   * @brief 履歴を使うかどうかを設定する
+   * @param enabled 履歴を使うなら `true`
+   */
+  void SetEnabled(bool enabled) { enabled_ = enabled; }
+  /// 履歴を使うかどうか
+  bool IsEnabled() const { return enabled_; }
+
+  /**
+   * @brief `move` の履歴値を取得する
+   * @param move 攻め方の手
+   * @return 履歴値。大きいほど詰みやすい。履歴を使わない場合は 0。
+   */
+  std::int16_t Get(Move move) const {
+    return enabled_ ? table_[Index(move)].load(std::memory_order_relaxed) : std::int16_t{0};
+  }
+
+  /**
+   * @brief `move` の探索結果を履歴に反映する
+   * @param move   攻め方の手
+   * @param proven `move` で詰んだなら `true`、不詰なら `false`
+   */
+  void Update(Move move, bool proven) {
+    if (!enabled_) {
+      return;
+    }
+
+    auto& entry = table_[Index(move)];
+    const int bonus = proven ? detail::kMoveHistoryBonus : -detail::kMoveHistoryBonus;
+    const int value = entry.load(std::memory_order_relaxed);
+    entry.store(static_cast<std::int16_t>(value + bonus - value * std::abs(bonus) / detail::kMoveHistoryMax),
+                std::memory_order_relaxed);
+  }
+
+ private:
+  /// 駒打ちかどうかの区別の数
+  static constexpr std::size_t kDropNb = 2;
+  /// 履歴の要素数
+  static constexpr std::size_t kTableSize =
+      kDropNb * static_cast<std::size_t>(PIECE_NB) * static_cast<std::size_t>(SQ_NB);
+
+  /// `move` に対応する添字。指し手の上位 16 bit には移動後の駒が入っている。
+  static constexpr std::size_t Index(Move move) {
+    const auto piece = static_cast<std::size_t>(move >> 16) % static_cast<std::size_t>(PIECE_NB);
+    const auto drop = is_drop(move) ? std::size_t{1} : std::size_t{0};
+    return (drop * static_cast<std::size_t>(PIECE_NB) + piece) * static_cast<std::size_t>(SQ_NB) +
+           static_cast<std::size_t>(to_sq(move));
+  }
+
+  std::array<std::atomic<std::int16_t>, kTableSize> table_;  ///< 履歴値
+  bool enabled_{true};                                       ///< 履歴を使うかどうか
+};
+}  // namespace komori
+
+#endif  // KOMORI_MOVE_HISTORY_HPP_
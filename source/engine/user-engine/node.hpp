@@ -230,5 +230,24 @@ inline std::pair<Move, Hand> CheckMate1Ply(Node& n) {
   }
   return {MOVE_NONE, kNullHand};
 }
+
+/**
+ * @brief 探索開始局面 `n` が OR node っぽいかどうかを調べる。困ったら OR node として処理する。
+ * @param n 探索開始局面
+ * @param root_is_and_node_if_checked 王手がかかっているとき、玉方手番（AND node）として扱うかどうか
+ * @return `n` を OR node として探索すべきなら true
+ */
+inline bool IsRootOrNode(const Position& n, bool root_is_and_node_if_checked) {
+  const Color us = n.side_to_move();
+  const Color them = ~us;
+
+  if (n.king_square(us) == SQ_NB) {
+    return true;
+  } else if (n.king_square(them) == SQ_NB) {
+    return false;
+  }
+
+  return !(n.in_check() && root_is_and_node_if_checked);
+}
 }  // namespace komori
 #endif  // KOMORI_NODE_HPP_
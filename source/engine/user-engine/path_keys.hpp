@@ -9,21 +9,80 @@
 namespace komori {
 namespace detail {
 /// 移動元に関する経路ハッシュ値
-inline HASH_KEY g_move_from[SQ_NB_PLUS1][komori::kDepthMax];
+inline Key g_move_from[SQ_NB_PLUS1];
 /// 移動先に関する経路ハッシュ値
-inline HASH_KEY g_move_to[SQ_NB_PLUS1][komori::kDepthMax];
+inline Key g_move_to[SQ_NB_PLUS1];
 /// 成りを区別するための経路ハッシュ値
-inline HASH_KEY g_promote[komori::kDepthMax];
+inline Key g_promote;
 /// 駒打ちに関する経路ハッシュ値
-inline HASH_KEY g_dropped_pr[PIECE_HAND_NB][komori::kDepthMax];
+inline Key g_dropped_pr[PIECE_HAND_NB];
 /// 駒強奪（無駄合防止探索用）に関する経路ハッシュ値
-inline HASH_KEY g_stolen_pr[PIECE_HAND_NB][komori::kDepthMax];
+inline Key g_stolen_pr[PIECE_HAND_NB];
+}  // namespace detail
+
+namespace detail {
+/// 経路ハッシュテーブルの種類。テーブルごとに異なる値を生成するために用いる。
+enum class PathKeyTable : std::uint64_t {
+  kMoveFrom,   ///< `g_move_from`
+  kMoveTo,     ///< `g_move_to`
+  kPromote,    ///< `g_promote`
+  kDroppedPr,  ///< `g_dropped_pr`
+  kStolenPr,   ///< `g_stolen_pr`
+};
+
+/// `PathKeyMix()` の乱数シード
+inline constexpr std::uint64_t kPathKeySeed = 334334;
+/// 深さごとに `PathKeyAtDepth()` の入力をずらす幅（黄金比の 2^64 倍）
+inline constexpr std::uint64_t kPathKeyDepthStep = 0x9e37'79b9'7f4a'7c15ULL;
+
+/**
+ * @brief splitmix64 の出力関数。64 bit 整数上の全単射で、入力の 1 bit の違いが出力全体に広がる。
+ * @param z 入力
+ * @return かき混ぜた値
+ */
+constexpr std::uint64_t SplitMix64(std::uint64_t z) noexcept {
+  z = (z ^ (z >> 30)) * 0xbf58'476d'1ce4'e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d0'49bb'1331'11ebULL;
+  return z ^ (z >> 31);
+}
+
+/**
+ * @brief 経路ハッシュテーブルの 1 要素の値を計算する
+ * @param table テーブルの種類
+ * @param index マス or 駒の種類
+ * @return 経路ハッシュ値
+ *
+ * 引数を重ならないビット位置に詰めたものを `SplitMix64()` でかき混ぜる。全単射なので、異なる要素が同じ値に
+ * なることはない。逐次的な乱数生成器と異なり各要素を独立に計算できるので、コンパイル時にも計算できる。
+ */
+constexpr std::uint64_t PathKeyMix(PathKeyTable table, std::uint64_t index) noexcept {
+  const std::uint64_t z = (static_cast<std::uint64_t>(table) << 56) | index;
+  return SplitMix64((z ^ kPathKeySeed) + kPathKeyDepthStep);
+}
+
+/**
+ * @brief 深さに依存しない手のハッシュ値 `key` を、深さ `depth` 専用の値に変換する
+ * @param key   手のハッシュ値（`g_move_to` などの XOR）
+ * @param depth 探索深さ
+ * @return 経路ハッシュの差分
+ *
+ * マス×深さごとに独立な乱数表を持つと表全体が数 MB になり、`PathKeyAfter()` のたびにキャッシュミスが起きる。
+ * そこで、深さごとにずらした入力を `SplitMix64()` でかき混ぜて、表を引く代わりに深さごとにほぼ独立な値を計算する。
+ * これにより、表は合計 1.5 KB 程度に収まる。
+ *
+ * 回転のような線形な変換だと、同じ手の組を深さを入れ替えて指したときの差分が手によらず一定になり、
+ * 手順前後がまとめて衝突してしまう。`SplitMix64()` は非線形なのでそのような偏りはない。
+ */
+constexpr Key PathKeyAtDepth(Key key, Depth depth) noexcept {
+  return SplitMix64(key + (static_cast<std::uint64_t>(depth) + 1) * kPathKeyDepthStep);
+}
 }  // namespace detail
 
 /**
  * @brief 経路ハッシュのテーブルを初期化する。
  *
- * 探索開始前に1回だけ呼び出す必要がある。
+ * 探索開始前に1回だけ呼び出す必要がある。各要素は `detail::PathKeyMix()` で独立に計算するので、何度呼び出しても
+ * 同じ値になる。
  */
 inline void PathKeyInit() {
   using detail::g_dropped_pr;
@@ -31,25 +90,19 @@ inline void PathKeyInit() {
   using detail::g_move_to;
   using detail::g_promote;
   using detail::g_stolen_pr;
-
-  PRNG rng(334334);
+  using detail::PathKeyMix;
+  using detail::PathKeyTable;
 
   for (const auto sq : SQ) {
-    for (std::size_t depth = 0; depth < kDepthMax; ++depth) {
-      SET_HASH(g_move_from[sq][depth], rng.rand<Key>(), rng.rand<Key>(), rng.rand<Key>(), rng.rand<Key>());
-      SET_HASH(g_move_to[sq][depth], rng.rand<Key>(), rng.rand<Key>(), rng.rand<Key>(), rng.rand<Key>());
-    }
+    g_move_from[sq] = PathKeyMix(PathKeyTable::kMoveFrom, sq);
+    g_move_to[sq] = PathKeyMix(PathKeyTable::kMoveTo, sq);
   }
 
-  for (auto& promote_entry : g_promote) {
-    SET_HASH(promote_entry, rng.rand<Key>(), rng.rand<Key>(), rng.rand<Key>(), rng.rand<Key>());
-  }
+  g_promote = PathKeyMix(PathKeyTable::kPromote, 0);
 
   for (PieceType pr = NO_PIECE_TYPE; pr < PIECE_HAND_NB; ++pr) {
-    for (std::size_t depth = 0; depth < kDepthMax; ++depth) {
-      SET_HASH(g_dropped_pr[pr][depth], rng.rand<Key>(), rng.rand<Key>(), rng.rand<Key>(), rng.rand<Key>());
-      SET_HASH(g_stolen_pr[pr][depth], rng.rand<Key>(), rng.rand<Key>(), rng.rand<Key>(), rng.rand<Key>());
-    }
+    g_dropped_pr[pr] = PathKeyMix(PathKeyTable::kDroppedPr, pr);
+    g_stolen_pr[pr] = PathKeyMix(PathKeyTable::kStolenPr, pr);
   }
 }
 
@@ -64,20 +117,17 @@ inline void PathKeyInit() {
  * 至る経路の間でハッシュ値がかぶらないようにしている。
  */
 inline Key PathKeyAfter(Key path_key, Move move, Depth depth) {
-  const auto to = to_sq(move);
-  path_key ^= detail::g_move_to[to][depth];
+  Key move_key = detail::g_move_to[to_sq(move)];
   if (is_drop(move)) {
-    const auto pr = move_dropped_piece(move);
-    path_key ^= detail::g_dropped_pr[pr][depth];
+    move_key ^= detail::g_dropped_pr[move_dropped_piece(move)];
   } else {
-    const auto from = from_sq(move);
-    path_key ^= detail::g_move_from[from][depth];
+    move_key ^= detail::g_move_from[from_sq(move)];
     if (is_promote(move)) {
-      path_key ^= detail::g_promote[depth];
+      move_key ^= detail::g_promote;
     }
   }
 
-  return path_key;
+  return path_key ^ detail::PathKeyAtDepth(move_key, depth);
 }
 
 /**
@@ -106,7 +156,7 @@ inline Key PathKeyBefore(Key path_key, Move move, Depth depth) {
  * @return 持ち駒を奪った直後のハッシュ値
  */
 inline Key PathKeyAfterSteal(Key path_key, PieceType stolen_pr, Depth depth) {
-  return path_key ^ detail::g_stolen_pr[stolen_pr][depth];
+  return path_key ^ detail::PathKeyAtDepth(detail::g_stolen_pr[stolen_pr], depth);
 }
 
 /**
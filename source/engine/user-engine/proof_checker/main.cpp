@@ -0,0 +1,67 @@
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "../../misc.h"
+#include "../../search.h"
+#include "../../thread.h"
+#include "../../usi.h"
+#include "proof_tree.hpp"
+
+// ProofTreePath オプションで書き出した証明木を、探索部を使わずに検証するツール。
+//
+// usage: kh-proof-checker <proof-tree-file>... [-j <threads>]
+//
+// すべてのファイルが正しい証明木なら 0、そうでなければ 1 を返す。
+int main(int argc, char** argv) {
+  USI::init(Options);
+  Bitboards::init();
+  Position::init();
+  Search::init();
+  Threads.set(1);
+
+  std::uint32_t num_threads = std::max(std::thread::hardware_concurrency(), 1U);
+  std::vector<std::string> paths;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg == "-j" && i + 1 < argc) {
+      num_threads = static_cast<std::uint32_t>(std::max(std::atoi(argv[++i]), 1));
+    } else {
+      paths.push_back(arg);
+    }
+  }
+
+  if (paths.empty()) {
+    std::cerr << "usage: " << argv[0] << " <proof-tree-file>... [-j <threads>]" << std::endl;
+    Threads.set(0);
+    return 2;
+  }
+
+  bool all_ok = true;
+  for (const auto& path : paths) {
+    std::ifstream ifs(path, std::ios::binary);
+    komori::ProofTree tree;
+    if (!ifs || !tree.Read(ifs)) {
+      std::cout << path << ": NG (failed to read)" << std::endl;
+      all_ok = false;
+      continue;
+    }
+
+    const auto start_time = std::chrono::steady_clock::now();
+    const auto error = komori::VerifyProofTree(tree, num_threads);
+    const auto elapsed =
+        std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start_time).count();
+    if (error) {
+      std::cout << path << ": NG (node " << error->node << ": " << error->reason << ")" << std::endl;
+      all_ok = false;
+    } else {
+      std::cout << path << ": OK (" << tree.Nodes().size() << " nodes, " << elapsed << " ms)" << std::endl;
+    }
+  }
+
+  Threads.set(0);
+  return all_ok ? 0 : 1;
+}
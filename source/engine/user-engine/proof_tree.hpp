@@ -0,0 +1,418 @@
+/**
+ * @file proof_tree.hpp
+ */
+#ifndef KOMORI_PROOF_TREE_HPP_
+#define KOMORI_PROOF_TREE_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <istream>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "../../thread.h"
+#include "typedefs.hpp"
+
+namespace komori {
+/**
+ * @brief 証明木のノード
+ *
+ * OR node なら詰ませる手がちょうど1つ、AND node なら玉方の合法手すべてが子として登録される。
+ * 子を持たない AND node は詰み局面を表す。
+ */
+struct ProofTreeNode {
+  // NOLINTBEGIN(misc-non-private-member-variables-in-classes)
+  Key board_key;                                           ///< 盤面のハッシュ値
+  Hand or_hand;                                            ///< 攻め方の持ち駒
+  Hand proof_hand;                                         ///< 証明駒
+  std::vector<std::pair<Move16, std::uint32_t>> children;  ///< 子局面への手と子ノードの番号の組
+  // NOLINTEND(misc-non-private-member-variables-in-classes)
+};
+
+/**
+ * @brief 置換表から取り出した証明木
+ *
+ * 同一局面（盤面と攻め方の持ち駒が一致する局面）は1つのノードにまとめるので、証明木というより証明 DAG である。
+ * ノードは帰りがけ順に追加する。すなわち、子ノードの番号は必ず親ノードの番号より小さく、最後に追加したノードが根となる。
+ *
+ * `Write()` で書き出す情報は以下のような構造になっている。整数はすべてリトルエンディアンである。
+ *
+ * - マジックナンバー "KHPT"(4 bytes)
+ * - バージョン(4 bytes)
+ * - 開始局面の sfen の長さ(4 bytes) + sfen 本体
+ * - 攻め方の手番(1 byte)
+ * - ノード数(4 bytes)
+ * - ノード本体
+ *   - 盤面のハッシュ値(8 bytes)
+ *   - 攻め方の持ち駒(4 bytes)
+ *   - 証明駒(4 bytes)
+ *   - 子の数(2 bytes)
+ *   - 子の情報(6 bytes * 子の数)
+ *     - 手(`Move16`, 2 bytes)
+ *     - 子ノードの番号(4 bytes)
+ */
+class ProofTree {
+ public:
+  /// ファイル先頭のマジックナンバー
+  static constexpr char kMagic[4] = {'K', 'H', 'P', 'T'};
+  /// ファイルフォーマットのバージョン
+  static constexpr std::uint32_t kVersion = 1;
+
+  /// Default constructor(default)
+  ProofTree() = default;
+  /**
+   * @brief 空の証明木を構築する
+   * @param root_sfen 開始局面の sfen
+   * @param or_color  攻め方の手番
+   */
+  ProofTree(std::string root_sfen, Color or_color) : root_sfen_{std::move(root_sfen)}, or_color_{or_color} {}
+
+  /// 開始局面の sfen
+  const std::string& RootSfen() const noexcept { return root_sfen_; }
+  /// 攻め方の手番
+  Color OrColor() const noexcept { return or_color_; }
+  /// 登録済のノード一覧。末尾が根。
+  const std::vector<ProofTreeNode>& Nodes() const noexcept { return nodes_; }
+
+  /**
+   * @brief 局面 (`board_key`, `or_hand`) に対応するノードを探す
+   * @param board_key 盤面のハッシュ値
+   * @param or_hand   攻め方の持ち駒
+   * @return ノード番号。未登録なら `std::nullopt`。
+   */
+  std::optional<std::uint32_t> Find(Key board_key, Hand or_hand) const {
+    if (auto itr = index_.find({board_key, or_hand}); itr != index_.end()) {
+      return {itr->second};
+    }
+    return std::nullopt;
+  }
+
+  /**
+   * @brief ノードを追加する
+   * @param node 追加するノード
+   * @return 追加したノードの番号
+   * @pre `node` の子はすべて追加済み
+   */
+  std::uint32_t Add(ProofTreeNode node) {
+    const auto index = static_cast<std::uint32_t>(nodes_.size());
+    index_.emplace(std::make_pair(node.board_key, node.or_hand), index);
+    nodes_.emplace_back(std::move(node));
+    return index;
+  }
+
+  /**
+   * @brief 証明木をバイナリ出力ストリーム `os` へ書き出す
+   * @param os バイナリ出力ストリーム
+   * @return `os`
+   */
+  std::ostream& Write(std::ostream& os) const {
+    os.write(kMagic, sizeof(kMagic));
+    WriteInt<std::uint32_t>(os, kVersion);
+    WriteInt<std::uint32_t>(os, static_cast<std::uint32_t>(root_sfen_.size()));
+    os.write(root_sfen_.data(), static_cast<std::streamsize>(root_sfen_.size()));
+    WriteInt<std::uint8_t>(os, static_cast<std::uint8_t>(or_color_));
+    WriteInt<std::uint32_t>(os, static_cast<std::uint32_t>(nodes_.size()));
+    for (const auto& node : nodes_) {
+      WriteInt<std::uint64_t>(os, node.board_key);
+      WriteInt<std::uint32_t>(os, static_cast<std::uint32_t>(node.or_hand));
+      WriteInt<std::uint32_t>(os, static_cast<std::uint32_t>(node.proof_hand));
+      WriteInt<std::uint16_t>(os, static_cast<std::uint16_t>(node.children.size()));
+      for (const auto& [move, child] : node.children) {
+        WriteInt<std::uint16_t>(os, move.to_u16());
+        WriteInt<std::uint32_t>(os, child);
+      }
+    }
+    return os;
+  }
+
+  /**
+   * @brief `Write()` で書き出した証明木を読み込む
+   * @param is バイナリ入力ストリーム
+   * @return 読み込みに成功したら `true`
+   *
+   * 読み込みに失敗した場合、証明木の中身は不定となる。
+   */
+  bool Read(std::istream& is) {
+    char magic[sizeof(kMagic)]{};
+    is.read(magic, sizeof(magic));
+    if (!is || !std::equal(std::begin(magic), std::end(magic), std::begin(kMagic)) ||
+        ReadInt<std::uint32_t>(is) != kVersion) {
+      return false;
+    }
+
+    root_sfen_.resize(ReadInt<std::uint32_t>(is));
+    is.read(root_sfen_.data(), static_cast<std::streamsize>(root_sfen_.size()));
+    or_color_ = static_cast<Color>(ReadInt<std::uint8_t>(is));
+
+    const auto node_count = ReadInt<std::uint32_t>(is);
+    nodes_.clear();
+    index_.clear();
+    for (std::uint32_t i = 0; i < node_count && is; ++i) {
+      ProofTreeNode node{};
+      node.board_key = ReadInt<std::uint64_t>(is);
+      node.or_hand = static_cast<Hand>(ReadInt<std::uint32_t>(is));
+      node.proof_hand = static_cast<Hand>(ReadInt<std::uint32_t>(is));
+      const auto child_count = ReadInt<std::uint16_t>(is);
+      node.children.reserve(child_count);
+      for (std::uint16_t j = 0; j < child_count; ++j) {
+        const Move16 move{ReadInt<std::uint16_t>(is)};
+        const auto child = ReadInt<std::uint32_t>(is);
+        node.children.emplace_back(move, child);
+      }
+      Add(std::move(node));
+    }
+
+    return static_cast<bool>(is) && (or_color_ == BLACK || or_color_ == WHITE);
+  }
+
+ private:
+  /// 整数 `val` をリトルエンディアンで書き出す
+  template <typename T>
+  static void WriteInt(std::ostream& os, T val) {
+    char buf[sizeof(T)];
+    for (std::size_t i = 0; i < sizeof(T); ++i) {
+      buf[i] = static_cast<char>((static_cast<std::uint64_t>(val) >> (8 * i)) & 0xff);
+    }
+    os.write(buf, sizeof(buf));
+  }
+
+  /// リトルエンディアンの整数を読み込む。読み込みに失敗したら 0 を返す。
+  template <typename T>
+  static T ReadInt(std::istream& is) {
+    unsigned char buf[sizeof(T)]{};
+    is.read(reinterpret_cast<char*>(buf), sizeof(buf));
+    std::uint64_t val = 0;
+    for (std::size_t i = 0; i < sizeof(T); ++i) {
+      val |= static_cast<std::uint64_t>(buf[i]) << (8 * i);
+    }
+    return static_cast<T>(val);
+  }
+
+  std::string root_sfen_;             ///< 開始局面の sfen
+  Color or_color_{BLACK};             ///< 攻め方の手番
+  std::vector<ProofTreeNode> nodes_;  ///< ノード一覧（帰りがけ順）
+  /// (盤面, 攻め方の持ち駒) -> ノード番号。同一局面のノードを1つにまとめるために用いる。
+  std::map<std::pair<Key, Hand>, std::uint32_t> index_;
+};
+
+/// 証明木の検証に失敗したときのエラー情報
+struct ProofTreeError {
+  // NOLINTBEGIN(misc-non-private-member-variables-in-classes)
+  std::uint32_t node;  ///< 検証に失敗したノード番号
+  std::string reason;  ///< 失敗理由
+  // NOLINTEND(misc-non-private-member-variables-in-classes)
+};
+
+namespace detail {
+/// 証明木の各ノードへ開始局面からたどり着くための手順（親ノードと手）
+struct ProofTreePath {
+  // NOLINTBEGIN(misc-non-private-member-variables-in-classes)
+  std::uint32_t parent;  ///< 親ノードの番号。根なら自分自身。
+  Move16 move;           ///< 親ノードからの手
+  // NOLINTEND(misc-non-private-member-variables-in-classes)
+};
+
+/**
+ * @brief 証明木の形を検証し、各ノードへたどり着く手順を1つずつ求める
+ * @param tree 証明木
+ * @param paths 各ノードへの手順（出力）
+ * @return 検証に失敗した場合、そのエラー情報
+ */
+inline std::optional<ProofTreeError> BuildProofTreePaths(const ProofTree& tree, std::vector<ProofTreePath>& paths) {
+  constexpr auto kNull = std::numeric_limits<std::uint32_t>::max();
+  const auto& nodes = tree.Nodes();
+  if (nodes.empty()) {
+    return ProofTreeError{0, "empty tree"};
+  }
+
+  const auto root = static_cast<std::uint32_t>(nodes.size() - 1);
+  paths.assign(nodes.size(), ProofTreePath{kNull, Move16{}});
+  paths[root] = ProofTreePath{root, Move16{}};
+  // 子の番号は親より小さいので、番号の大きい順に見ていけば親の手順が先に決まる
+  for (std::uint32_t i = root + 1; i-- > 0;) {
+    if (paths[i].parent == kNull) {
+      return ProofTreeError{i, "unreachable node"};
+    }
+
+    for (const auto& [move, child] : nodes[i].children) {
+      if (child >= i) {
+        return ProofTreeError{i, "child index must be less than parent index"};
+      }
+      if (paths[child].parent == kNull) {
+        paths[child] = ProofTreePath{i, move};
+      }
+    }
+  }
+
+  return std::nullopt;
+}
+
+/**
+ * @brief 局面 `pos` に対応するノード `node` が証明木として正しいかを検証する
+ * @param tree 証明木
+ * @param node 検証するノード
+ * @param pos  `node` に対応する局面
+ * @return 検証に失敗した場合、その理由
+ */
+inline std::optional<std::string> VerifyProofTreeNode(const ProofTree& tree, const ProofTreeNode& node, Position& pos) {
+  const auto or_color = tree.OrColor();
+  if (pos.state()->board_key() != node.board_key || pos.hand_of(or_color) != node.or_hand) {
+    return "position mismatch";
+  }
+  if (!hand_is_equal_or_superior(node.or_hand, node.proof_hand)) {
+    return "proof hand exceeds or hand";
+  }
+
+  const auto& nodes = tree.Nodes();
+  auto matches_child = [&](Move move, std::uint32_t child) {
+    StateInfo st;
+    pos.do_move(move, st);
+    const bool ok = pos.state()->board_key() == nodes[child].board_key && pos.hand_of(or_color) == nodes[child].or_hand;
+    pos.undo_move(move);
+    return ok;
+  };
+
+  const MoveList<LEGAL_ALL> move_list{pos};
+  if (pos.side_to_move() == or_color) {
+    if (node.children.size() != 1) {
+      return "or node must have exactly one child";
+    }
+
+    const auto [move16, child] = node.children[0];
+    const auto move = pos.to_move(move16);
+    if (!move_list.contains(move) || !pos.gives_check(move)) {
+      return "or move is not a legal check";
+    }
+    if (!matches_child(move, child)) {
+      return "child position mismatch";
+    }
+  } else {
+    if (!pos.in_check()) {
+      return "and node is not in check";
+    }
+    if (node.children.size() != move_list.size()) {
+      return "and node must have all evasions as children";
+    }
+
+    for (const auto& [move16, child] : node.children) {
+      const auto move = pos.to_move(move16);
+      if (!move_list.contains(move)) {
+        return "and move is not legal";
+      }
+      if (!matches_child(move, child)) {
+        return "child position mismatch";
+      }
+    }
+
+    // 重複した子があると合法手を網羅できていない
+    std::vector<std::uint16_t> moves;
+    moves.reserve(node.children.size());
+    for (const auto& [move16, child] : node.children) {
+      moves.push_back(move16.to_u16());
+    }
+    std::sort(moves.begin(), moves.end());
+    if (std::adjacent_find(moves.begin(), moves.end()) != moves.end()) {
+      return "duplicated evasion";
+    }
+  }
+
+  return std::nullopt;
+}
+}  // namespace detail
+
+/**
+ * @brief 証明木が開始局面の詰みを正しく証明しているかを検証する
+ * @param tree        証明木
+ * @param num_threads 検証に用いるスレッド数
+ * @return 検証に失敗した場合、そのエラー情報。正しい証明木なら `std::nullopt`。
+ *
+ * 証明木の各ノードについて、以下を確認する。
+ *
+ * - ノードの局面が開始局面から手順をたどって得られる局面と一致する
+ * - OR node なら、子への手が王手になる合法手である
+ * - AND node なら、王手がかかっており、すべての合法手が子として登録されている（子がなければ詰み）
+ * - 子への手を指した局面が子ノードの局面と一致する
+ *
+ * 子ノードの番号は親ノードより小さいので、証明木は循環を含まない。よって、上記がすべて成り立てば開始局面は詰みである。
+ * 各ノードの検証は独立に行えるので、ノードを `num_threads` 個のスレッドで分担して検証する。
+ */
+inline std::optional<ProofTreeError> VerifyProofTree(const ProofTree& tree, std::uint32_t num_threads) {
+  std::vector<detail::ProofTreePath> paths;
+  if (auto error = detail::BuildProofTreePaths(tree, paths)) {
+    return error;
+  }
+
+  const auto& nodes = tree.Nodes();
+  const auto node_count = static_cast<std::uint32_t>(nodes.size());
+  constexpr std::uint32_t kChunkSize = 256;
+  std::atomic<std::uint32_t> next_index{0};
+  std::atomic_bool failed{false};
+  std::mutex error_mutex;
+  std::optional<ProofTreeError> error;
+
+  auto worker = [&]() {
+    Position pos;
+    StateInfo root_st;
+    std::vector<StateInfo> states;
+    std::vector<Move16> moves;
+    while (!failed) {
+      const auto begin = next_index.fetch_add(kChunkSize);
+      if (begin >= node_count) {
+        break;
+      }
+
+      const auto end = std::min(begin + kChunkSize, node_count);
+      for (std::uint32_t i = begin; i < end && !failed; ++i) {
+        // 開始局面から i 番目のノードへの手順を復元して局面を作る
+        moves.clear();
+        for (auto j = i; paths[j].parent != j; j = paths[j].parent) {
+          moves.push_back(paths[j].move);
+        }
+
+        pos.set(tree.RootSfen(), &root_st, Threads.main());
+        states.resize(moves.size());
+        bool path_ok = true;
+        for (std::size_t k = 0; k < moves.size(); ++k) {
+          const auto move = pos.to_move(moves[moves.size() - 1 - k]);
+          if (!pos.pseudo_legal(move) || !pos.legal(move)) {
+            path_ok = false;
+            break;
+          }
+          pos.do_move(move, states[k]);
+        }
+
+        auto reason = path_ok ? detail::VerifyProofTreeNode(tree, nodes[i], pos)
+                              : std::optional<std::string>{"illegal path"};
+        if (reason) {
+          const std::lock_guard lock(error_mutex);
+          if (!error || i < error->node) {
+            error = ProofTreeError{i, std::move(*reason)};
+          }
+          failed = true;
+        }
+      }
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (std::uint32_t i = 1; i < std::max<std::uint32_t>(num_threads, 1); ++i) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (auto& th : threads) {
+    th.join();
+  }
+
+  return error;
+}
+}  // namespace komori
+
+#endif  // KOMORI_PROOF_TREE_HPP_
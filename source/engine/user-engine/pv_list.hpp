@@ -4,7 +4,6 @@
 #ifndef KOMORI_PV_LIST_HPP_
 #define KOMORI_PV_LIST_HPP_
 
-#include <algorithm>
 #include <optional>
 #include <unordered_map>
 #include <vector>
@@ -34,6 +33,10 @@ namespace komori {
  *   2. 不明  --> 詰み（探索が進んで詰みだと判明した）
  *   3. 不明  --> 不詰（探索が進んで不詰だと判明した）
  *   4. N手詰 --> M手詰（N>M、探索が進んで短い詰みが判明した）
+ *
+ * 探索情報の出力は探索中に定期的に行われるので、毎回リスト全体を並べ替えるのは無駄が大きい。1 回の更新で順位が
+ * 変わるのは更新した手だけなので、`Update()` のたびにその手を正しい位置まで挿入ソートの要領で移動させ、リストを常に
+ * 整列済みの状態に保つ。
  */
 class PvList {
  public:
@@ -51,9 +54,10 @@ class PvList {
   void Clear() {
     pv_info_.clear();
     idx_.clear();
+    rank_.clear();
     move_to_raw_index_.clear();
 
-    // pv_info_ と idx_ は高々 kDepthMax 要素なので shrink_to_fit() をする必要はない
+    // pv_info_, idx_, rank_ は高々 kDepthMax 要素なので shrink_to_fit() をする必要はない
   }
 
   /**
@@ -67,11 +71,12 @@ class PvList {
     Clear();
 
     comparer_ = SearchResultComparer(n.IsOrNode());
-    is_sorted_ = true;  // 初期状態はすべて同じ評価値なのでソートされた状態である。
 
+    // 初期状態はすべて同じ評価値なので、生成順のままで整列済みである
     MovePicker mp{n};
     pv_info_.reserve(mp.size());
     idx_.reserve(mp.size());
+    rank_.reserve(mp.size());
     for (const auto& [i_raw, move] : WithIndex(mp)) {
       const SearchResult result =
           SearchResult::MakeFirstVisit(kInfinitePnDn / 2, kInfinitePnDn / 2, kDepthMaxMateLen, 1);
@@ -80,6 +85,7 @@ class PvList {
 
       move_to_raw_index_.emplace(move, i_raw);
       idx_.emplace_back(i_raw);
+      rank_.emplace_back(i_raw);
     }
   }
 
@@ -88,16 +94,12 @@ class PvList {
    * @param move   手
    * @param result 探索結果
    * @param depth  探索深さ（optional）
-   * @param pv     PV（optional）
    * @pre `move` は `n` における合法手
    *
-   * 探索深さ `depth` は、`result` の内容に関係なく（値が nullopt でなければ）必ず代入する。一方、`pv` と
-   * `result` については、`info.result.IsFinal()` から `!result.IsFinal()` へ遷移しようとした場合は更新しない。
+   * 探索深さ `depth` は、`result` の内容に関係なく（値が nullopt でなければ）必ず代入する。一方、`result`
+   * については、`info.result.IsFinal()` から `!result.IsFinal()` へ遷移しようとした場合は更新しない。
    */
-  void Update(Move move,
-              const SearchResult& result,
-              std::optional<Depth> depth = std::nullopt,
-              std::optional<std::vector<Move>> pv = std::nullopt) {
+  void Update(Move move, const SearchResult& result, std::optional<Depth> depth = std::nullopt) {
     const auto i_raw = move_to_raw_index_.at(move);
     auto& info = pv_info_[i_raw];
     if (depth) {
@@ -106,11 +108,32 @@ class PvList {
 
     // `result` が final から not final へ遷移しようとしているときは内容を更新しない
     if (result.IsFinal() || !info.result.IsFinal()) {
-      is_sorted_ = false;
       info.result = result;
-      if (pv) {
-        info.pv = std::move(pv.value());
-      }
+      Reorder(i_raw);
+    }
+  }
+
+  /**
+   * @brief 手 `move` に対する探索結果と PV を更新する
+   * @param move   手
+   * @param result 探索結果
+   * @param depth  探索深さ
+   * @param pv     PV（`Move` の列）
+   * @pre `move` は `n` における合法手
+   *
+   * 更新の条件は PV なし版の `Update()` と同じ。PV は `result` を更新したときだけ書き換える。PV の領域は
+   * 使い回すので、手数が伸びない限りヒープ確保は起こらない。
+   */
+  template <typename Range, Constraints<decltype(std::declval<const Range&>().begin())> = nullptr>
+  void Update(Move move, const SearchResult& result, Depth depth, const Range& pv) {
+    const auto i_raw = move_to_raw_index_.at(move);
+    auto& info = pv_info_[i_raw];
+    info.depth = depth;
+
+    if (result.IsFinal() || !info.result.IsFinal()) {
+      info.result = result;
+      info.pv.assign(pv.begin(), pv.end());
+      Reorder(i_raw);
     }
   }
 
@@ -126,57 +149,66 @@ class PvList {
     return info.result.Pn() == 0;
   }
 
+  /// 開始局面における合法手の個数
+  std::size_t Size() const noexcept { return idx_.size(); }
+
   /**
-   * @brief 各手の探索結果とPVをまとめた配列を返す。
-   * @return 探索結果とPVをまとめた配列。（手番側から見て評価値がよい順に並んでいる）
+   * @brief `rank` 番目に良い手の探索結果と PV を返す
+   * @param rank 順位（0 始まり）。手番側から見て評価値が良い順に並んでいる。
+   * @return `rank` 番目に良い手の探索結果と PV
+   * @pre `rank < Size()`
    */
-  std::vector<PvInfo> GetPvList() {
-    SortIfNeeded();
-    std::vector<PvInfo> ret;
-    ret.reserve(pv_info_.size());
-
-    for (const auto i_raw : idx_) {
-      ret.push_back(pv_info_[i_raw]);
-    }
-
-    return ret;
-  }
+  const PvInfo& operator[](std::size_t rank) const { return pv_info_[idx_[rank]]; }
 
   /**
    * @brief 開始局面における PV を返す
    * @return 開始局面における PV
    * @note 開始局面に合法手がないとき、空配列を返す。
    */
-  std::vector<Move> BestMoves() {
+  const std::vector<Move>& BestMoves() const {
+    static const std::vector<Move> kEmpty{};
     if (idx_.empty()) {
-      return {};
+      return kEmpty;
     }
 
-    SortIfNeeded();  // 必要なのは最善手だけだが、いずれ全体の並び替えが必要になる可能性が高いのでここでやっておく。
     return pv_info_[idx_[0]].pv;
   }
 
  private:
+  /// `lhs` の探索結果が `rhs` より真に良いかどうか
+  bool IsBetter(std::uint32_t lhs, std::uint32_t rhs) const {
+    return comparer_(pv_info_[lhs].result, pv_info_[rhs].result) == SearchResultComparer::Ordering::kLess;
+  }
+
   /**
-   * @brief `idx_` を `comparer_` に従って評価値がいい順に並べ替える
+   * @brief 探索結果が更新された手 `i_raw` を正しい順位まで移動させる
+   * @param i_raw 更新された手の添字
+   *
+   * `i_raw` 以外の手は整列済みであることを仮定する。評価値が等しい手同士の順序は変えないので、`idx_` 全体を
+   * `std::stable_sort` し直した場合と同じ結果になる。
    */
-  void SortIfNeeded() {
-    if (!is_sorted_) {
-      std::stable_sort(idx_.begin(), idx_.end(), [this](const auto& lhs, const auto& rhs) {
-        const auto& lhs_info = pv_info_[lhs];
-        const auto& rhs_info = pv_info_[rhs];
-        const auto ordering = comparer_(lhs_info.result, rhs_info.result);
-        return ordering == SearchResultComparer::Ordering::kLess;
-      });
-      is_sorted_ = true;
+  void Reorder(std::uint32_t i_raw) {
+    auto rank = rank_[i_raw];
+    while (rank > 0 && IsBetter(i_raw, idx_[rank - 1])) {
+      idx_[rank] = idx_[rank - 1];
+      rank_[idx_[rank]] = rank;
+      --rank;
+    }
+    while (rank + 1 < idx_.size() && IsBetter(idx_[rank + 1], i_raw)) {
+      idx_[rank] = idx_[rank + 1];
+      rank_[idx_[rank]] = rank;
+      ++rank;
     }
+
+    idx_[rank] = i_raw;
+    rank_[i_raw] = rank;
   }
 
   SearchResultComparer comparer_{true};                        ///< 探索結果の比較器
   std::unordered_map<Move, std::uint32_t> move_to_raw_index_;  ///< 手 move から i_raw への逆引きテーブル
-  std::vector<std::uint32_t> idx_;  ///< i_raw を評価値順（`comparer_` 順）に並べたもの
+  std::vector<std::uint32_t> idx_;   ///< i_raw を評価値順（`comparer_` 順）に並べたもの
+  std::vector<std::uint32_t> rank_;  ///< i_raw から `idx_` における位置への逆引きテーブル
   std::vector<PvInfo> pv_info_;  ///< 各手の探索結果と PV。MovePicker による手の生成結果と同じ順番に並んでいる
-  bool is_sorted_{true};  ///< `idx_` が評価値順に並んでいるかどうか
 };
 }  // namespace komori
 
@@ -5,9 +5,13 @@
 #define KOMORI_REGULAR_TABLE_HPP_
 
 #include <algorithm>
+#include <atomic>
+#include <memory>
 #include <shared_mutex>
+#include <string>
 #include <vector>
 
+#include "table_memory.hpp"
 #include "ttentry.hpp"
 #include "typedefs.hpp"
 
@@ -91,6 +95,8 @@ class CircularEntryPointer {
 namespace detail {
 /// TT をファイルへ書き出す最低の探索量。探索量の小さいエントリを書き出さないことでファイルサイズを小さくする。
 constexpr inline SearchAmount kTTSaveAmountThreshold = 10;
+/// TT をファイルへ書き出すとき、一度にまとめて書き出すエントリ数
+constexpr inline std::size_t kTTSaveChunkEntries = 4096;
 /**
  * @brief Hashfull（ハッシュ使用率）を計算するために仕様するエントリ数。大きすぎると探索性能が低下する。
  *
@@ -119,6 +125,18 @@ constexpr std::size_t kHashfullCalcEntries = 10000;
 
 /// GC で削除する SearchAmount のしきい値を決めるために見るエントリの数
 constexpr std::size_t kGcSamplingEntries = 20000;
+/// GC 中に配列全体を書き換える権利（`LargeArray::RefreshMaintenance()`）を更新する間隔（エントリ数）
+constexpr std::size_t kGcRefreshEntries = std::size_t{1} << 20;
+/// 置換表サイズ変更後に残すエントリ数の上限（新しい要素数に対する割合）。GC を始めるハッシュ使用率と同じ値にしておく。
+constexpr double kRehashMaxLoadFactor = 0.5;
+/**
+ * @brief 共有メモリ上の通常テーブルのレイアウトを表す値
+ *
+ * `USE_32BIT_PNDN` の有無のように、エントリのサイズが同じでも中身の解釈が異なるビルド同士で置換表を共有しないよう、
+ * pn/dn のビット幅とエントリのサイズを埋め込む。`Entry` のメンバ構成を変えたら上位の版数を上げること。
+ */
+constexpr std::uint64_t kSharedEntryLayout =
+    (std::uint64_t{1} << 32) | (std::uint64_t{sizeof(PnDn)} << 16) | std::uint64_t{sizeof(Entry)};
 }  // namespace detail
 
 /**
@@ -147,27 +165,102 @@ class RegularTable {
   /// Destructor(default)
   ~RegularTable() = default;
 
+  /**
+   * @brief テーブルの配置方針を `placement` に変更する
+   * @param placement 新しい配置方針
+   *
+   * 配置方針は次に領域を確保するときに適用する。方針が変わった場合はエントリを捨てるので、続けて `Resize()` か
+   * `AttachShared()` を呼ぶこと。`NumaPolicy::kFirstTouch` では、エントリの構築と `Clear()` を NUMA ノードに
+   * 固定したスレッドで行う。
+   */
+  void SetPlacement(const MemoryPlacement& placement) noexcept { entries_.SetPlacement(placement); }
+
   /**
    * @brief 要素数が `num_entries` 個になるようにメモリの確保・解放を行う
    * @param num_entries 要素数
+   * @param num_threads 初期化・再配置に用いるスレッド数
+   *
+   * 書かれていたエントリは新しい要素数に合わせて再配置し、できるだけ引き継ぐ。ただし、新しいテーブルの使用率が
+   * `detail::kRehashMaxLoadFactor` を超える場合は、探索量の小さいエントリから捨てる。詳しくは `Rehash()` を参照。
+   *
+   * 要素数が変わらない場合は `Clear()` と同じ。共有メモリに接続していた場合は、接続を切って新しい領域を確保する。
    */
-  void Resize(std::uint64_t num_entries) {
+  void Resize(std::uint64_t num_entries, std::uint32_t num_threads = 1) {
     // 通常テーブルに保存する要素数。最低でも 1 以上になるようにする
     num_entries = std::max<std::uint64_t>(num_entries, 1);
+    if (entries_.IsShared()) {
+      entries_.Release();
+    }
+
+    if (entries_.size() == num_entries) {
+      Clear(num_threads);
+      return;
+    }
 
-    entries_.resize(num_entries);
-    entries_.shrink_to_fit();
+    if (entries_.size() == 0) {
+      entries_.Reallocate(num_entries);
+      ConstructEntries(0, num_entries, num_threads);
+      return;
+    }
+
+    Rehash(num_entries, num_threads);
+  }
 
-    Clear();
+  /**
+   * @brief POSIX 共有メモリ `name` 上の通常テーブルに接続する
+   * @param name        共有メモリの名前（`/` から始まる文字列）
+   * @param num_entries 要素数。共有メモリがすでに存在する場合は無視し、既存の要素数を使う。
+   * @param num_threads 初期化に用いるスレッド数
+   * @return 接続に成功したら `true`。失敗した場合、テーブルは空になる。
+   *
+   * 同じ名前で接続したプロセス同士は、1 つの通常テーブルを共有する。ただし、エントリのレイアウトが異なるビルド
+   * （`detail::kSharedEntryLayout` を参照）が作った共有メモリには接続しない。エントリの読み書きはエントリごとのロックで
+   * 排他制御しているので、プロセスをまたいでもスレッド間と同様に安全に読み書きできる。GC は同時に
+   * 1 プロセスしか行わない（`CollectGarbage()` を参照）。`Clear()` は接続中のすべてのプロセスに影響するので注意。
+   *
+   * 共有メモリは最後のプロセスが終了した後も残る。不要になったら `RemoveShared()` で削除すること。
+   */
+  bool AttachShared(const std::string& name, std::uint64_t num_entries, std::uint32_t num_threads = 1) {
+    num_entries = std::max<std::uint64_t>(num_entries, 1);
+    const bool bind_numa = BindNuma();
+    return entries_.AttachShared(
+        name, num_entries,
+        [num_threads, bind_numa](Entry* data, std::size_t size) {
+          ParallelFor(
+              size, num_threads,
+              [data](std::size_t begin, std::size_t end) {
+                std::uninitialized_default_construct(data + begin, data + end);
+              },
+              bind_numa);
+        },
+        detail::kSharedEntryLayout);
   }
 
+  /// 通常テーブルが共有メモリ上にあるかどうか
+  bool IsShared() const noexcept { return entries_.IsShared(); }
+
+  /**
+   * @brief POSIX 共有メモリ `name` 上の通常テーブルを削除する
+   * @param name 共有メモリの名前
+   */
+  static void RemoveShared(const std::string& name) noexcept { LargeArray<Entry>::RemoveShared(name); }
+
   /**
    * @brief 以前の探索結果をすべて消去する。
+   * @param num_threads 消去に用いるスレッド数
+   *
+   * 共有メモリ上のテーブルでは、接続中の他のプロセスの探索結果も消える。他のプロセスが探索中かどうかは考慮しない。
    */
-  void Clear() {
-    for (auto&& entry : entries_) {
-      entry.SetNull();
-    }
+  void Clear(std::uint32_t num_threads = 1) {
+    auto data = entries_.data();
+    ParallelFor(
+        entries_.size(), num_threads,
+        [data](std::size_t begin, std::size_t end) {
+          for (auto entry = data + begin; entry != data + end; ++entry) {
+            entry->SetNull();
+          }
+        },
+        BindNuma());
   }
 
   /**
@@ -180,11 +273,7 @@ class RegularTable {
   CircularEntryPointer PointerOf(Key board_key) {
     static_assert(sizeof(Key) == 8);
 
-    // Stockfish の置換表と同じアイデア。少し工夫をすることで mod 演算を回避できる。
-    // hash_low が [0, 2^32) の一様分布にしたがうと仮定すると、idx はだいたい [0, entries_.size())
-    // の一様分布にしたがう。
-    const Key hash_low = board_key & Key{0xffff'ffffULL};
-    auto idx = (hash_low * entries_.size()) >> 32;
+    const auto idx = HomeIndex(board_key, entries_.size());
     auto data = entries_.data();
     return {data + idx, data, data + entries_.size()};
   }
@@ -222,8 +311,15 @@ class RegularTable {
    * @pre 0 < gc_removal_ratio < 1
    *
    * `entries_` の中から `GcSamplingEntries` 個のエントリの探索量を調べ、下位 `kGcRemovalRatio` のエントリを削除する。
+   *
+   * 共有メモリ上のテーブルでは、同時に GC を行えるのは接続中のプロセスのうち 1 つだけである。他のプロセスが GC 中なら、
+   * 何もせずに返る。
    */
   void CollectGarbage(double gc_removal_ratio) {
+    if (!entries_.TryLockMaintenance()) {
+      return;
+    }
+
     // Amount を kGcSamplingEntries 個だけサンプリングする
     std::size_t counted_num = 0;
     std::size_t idx = 0;
@@ -254,7 +350,12 @@ class RegularTable {
     const auto amount_threshold = *pivot_itr;
 
     // 探索量が amount_threshold を下回っているエントリをすべて削除する
+    std::size_t visited = 0;
     for (auto&& entry : entries_) {
+      if (++visited % detail::kGcRefreshEntries == 0) {
+        entries_.RefreshMaintenance();
+      }
+
       const std::lock_guard lock(entry);
       if (!entry.IsNull() && entry.Amount() <= amount_threshold) {
         entry.SetNull();
@@ -265,6 +366,7 @@ class RegularTable {
 
     // 置換表に歯抜けがあるとエントリにアクセスできないため、コンパクションは必須。
     CompactEntries();
+    entries_.UnlockMaintenance();
   }
 
   /**
@@ -281,20 +383,48 @@ class RegularTable {
    * - 書き出すエントリ数(8 bytes)
    * - エントリ本体(sizeof(Entry) * n bytes)
    *
+   * 探索中に別スレッドから呼び出してもよい。各エントリは共有ロックを取ってコピーしてから書き出すので、
+   * 探索スレッドを待たせるのはエントリ1個をコピーする間だけである。ただし、書き出し中にも置換表は更新され続けるので、
+   * 書き出した内容はある瞬間の置換表と厳密に一致するとは限らない。
+   *
+   * エントリ数は書き出し後に確定するので、`os` はシーク可能である必要がある。
    * なお、`os` がバイナリモードではない場合、書き込みを行わないので注意。
    */
   std::ostream& Save(std::ostream& os) {
     auto should_save = [](const Entry& entry) {
       return !entry.IsNull() && entry.Amount() > detail::kTTSaveAmountThreshold;
     };
-    std::uint64_t used_entries = std::count_if(entries_.begin(), entries_.end(), should_save);
+
+    const auto count_pos = os.tellp();
+    std::uint64_t used_entries = 0;
     os.write(reinterpret_cast<const char*>(&used_entries), sizeof(used_entries));
 
+    std::vector<Entry> buffer;
+    buffer.reserve(detail::kTTSaveChunkEntries);
+    auto flush = [&]() {
+      const auto size = static_cast<std::streamsize>(sizeof(Entry) * buffer.size());
+      os.write(reinterpret_cast<const char*>(buffer.data()), size);
+      used_entries += buffer.size();
+      buffer.clear();
+    };
+
     for (const auto& entry : entries_) {
-      if (should_save(entry)) {
-        os.write(reinterpret_cast<const char*>(&entry), sizeof(Entry));
+      {
+        const std::shared_lock lock(entry);
+        if (should_save(entry)) {
+          buffer.push_back(entry);
+        }
+      }
+
+      if (buffer.size() >= detail::kTTSaveChunkEntries) {
+        flush();
       }
     }
+    flush();
+
+    os.seekp(count_pos);
+    os.write(reinterpret_cast<const char*>(&used_entries), sizeof(used_entries));
+    os.seekp(0, std::ios::end);
 
     return os;
   }
@@ -316,6 +446,10 @@ class RegularTable {
     for (std::uint64_t i = 0; i < loop_count; ++i) {
       Entry entry;
       is.read(reinterpret_cast<char*>(&entry), sizeof(entry));
+      if (!is) {
+        // 書き出し途中で途切れたファイルの場合、読めたところまでで打ち切る
+        break;
+      }
 
       auto ptr = PointerOf(entry.BoardKey());
       for (; !ptr->IsNull(); ++ptr) {
@@ -332,9 +466,9 @@ class RegularTable {
   // <テスト用>
 
   /// 通常テーブルの先頭
-  auto begin() noexcept { return entries_.data(); }
+  auto begin() noexcept { return entries_.begin(); }
   /// 通常テーブルの末尾
-  auto end() noexcept { return entries_.data() + entries_.size(); }
+  auto end() noexcept { return entries_.end(); }
 
   /**
    * @brief エントリをできるだけ手前の方に移動させる（コンパクション）
@@ -343,7 +477,12 @@ class RegularTable {
    */
   void CompactEntries() {
     // entries_ の最初の部分が若干コンパクションしきれない可能性があるが目を瞑る
+    std::size_t visited = 0;
     for (auto&& entry : entries_) {
+      if (++visited % detail::kGcRefreshEntries == 0) {
+        entries_.RefreshMaintenance();
+      }
+
       const std::lock_guard lock(entry);
       if (entry.IsNull()) {
         continue;
@@ -363,10 +502,222 @@ class RegularTable {
   // </テスト用>
 
  private:
+  /**
+   * @brief 盤面ハッシュ値 `board_key` の要素数 `size` のテーブル上でのデフォルト挿入位置
+   *
+   * 挿入位置は盤面ハッシュ値の下位 32 ビットについて単調増加である。`Rehash()` はこの性質を利用している。
+   */
+  static constexpr std::uint64_t HomeIndex(Key board_key, std::uint64_t size) noexcept {
+    // Stockfish の置換表と同じアイデア。少し工夫をすることで mod 演算を回避できる。
+    // hash_low が [0, 2^32) の一様分布にしたがうと仮定すると、idx はだいたい [0, size) の一様分布にしたがう。
+    const Key hash_low = board_key & Key{0xffff'ffffULL};
+    return (hash_low * size) >> 32;
+  }
+
+  /// 初期化を NUMA ノードに固定したスレッドで行うかどうか
+  bool BindNuma() const noexcept { return entries_.Placement().numa == NumaPolicy::kFirstTouch; }
+
+  /// `[begin, end)` のエントリを `num_threads` スレッドで並列に構築する
+  void ConstructEntries(std::size_t begin, std::size_t end, std::uint32_t num_threads) {
+    auto data = entries_.data() + begin;
+    ParallelFor(
+        end - begin, num_threads,
+        [data](std::size_t b, std::size_t e) { std::uninitialized_default_construct(data + b, data + e); }, BindNuma());
+  }
+
+  /**
+   * @brief エントリを引き継いだまま要素数を `new_size` に変更する
+   * @param new_size    新しい要素数
+   * @param num_threads 並列に処理するスレッド数
+   *
+   * 新しいテーブルを別に確保してエントリを挿入し直すと、一時的に新旧 2 つのテーブル分のメモリが必要になってしまう。
+   * そこで、以下の手順でテーブル上のエントリをその場で並べ替える。
+   *
+   * 1. 末尾から先頭へ折り返している可能性がある先頭の連続領域を退避する
+   * 2. 連続領域ごとにエントリを盤面ハッシュ値の下位 32 ビット順にソートする（並列）
+   * 3. エントリを前に詰める。このとき、新しい挿入位置の順に並んでいないエントリは退避する
+   * 4. 詰めたエントリを新しいテーブルの末尾へ移動し、前から順に新しい挿入位置へ移動する
+   * 5. 退避したエントリを挿入し直す
+   *
+   * 2. が終わった時点で、テーブル上のエントリはほぼ挿入位置順に並んでいる。新しい挿入位置も盤面ハッシュ値の
+   * 下位 32 ビットについて単調なので、4. では挿入位置の順にエントリを置いていけばよい。エントリの移動先は常に
+   * 移動元より手前にあるので、まだ移動していないエントリを上書きすることはない。追加で確保するメモリは
+   * 退避したエントリの分だけで済む。
+   *
+   * エントリが `new_size * detail::kRehashMaxLoadFactor` 個を超える場合、探索量の小さいものから捨てる。
+   */
+  void Rehash(std::uint64_t new_size, std::uint32_t num_threads) {
+    const std::uint64_t old_size = entries_.size();
+    const auto max_live = static_cast<std::uint64_t>(static_cast<double>(new_size) * detail::kRehashMaxLoadFactor);
+    auto data = entries_.data();
+
+    // 1. 先頭の連続領域を退避する。テーブル全体が埋まっている場合は先頭のエントリを諦める。
+    std::uint64_t first_null = 0;
+    while (first_null < old_size && !data[first_null].IsNull()) {
+      ++first_null;
+    }
+    if (first_null == old_size) {
+      data[0].SetNull();
+      first_null = 0;
+    }
+    std::vector<Entry> pending(data, data + first_null);
+    for (std::uint64_t i = 0; i < first_null; ++i) {
+      data[i].SetNull();
+    }
+
+    // 2. 連続領域ごとにソートする。区間の先頭をまたぐ連続領域は、その連続領域が始まる区間のスレッドが担当する。
+    std::atomic<std::uint64_t> live_count{pending.size()};
+    ParallelFor(old_size, num_threads, [&](std::size_t begin, std::size_t end) {
+      std::uint64_t count = 0;
+      for (auto i = begin; i < end; ++i) {
+        if (data[i].IsNull() || (i > 0 && !data[i - 1].IsNull())) {
+          continue;
+        }
+
+        auto j = i;
+        for (; j < old_size && !data[j].IsNull(); ++j) {
+        }
+        std::sort(data + i, data + j, [](const Entry& lhs, const Entry& rhs) {
+          return (lhs.BoardKey() & 0xffff'ffffULL) < (rhs.BoardKey() & 0xffff'ffffULL);
+        });
+        count += j - i;
+        i = j;
+      }
+      live_count += count;
+    });
+
+    // 新しいテーブルに収まりきらない場合、探索量が小さいエントリを捨てる
+    const auto amount_threshold = AmountThreshold(live_count, max_live, pending);
+    const auto should_keep = [&](const Entry& entry) { return entry.Amount() >= amount_threshold; };
+
+    // 3. 新しい挿入位置の順にエントリを前に詰める
+    std::uint64_t kept = 0;
+    std::uint64_t max_home = 0;
+    for (std::uint64_t i = 0; i < old_size; ++i) {
+      if (data[i].IsNull() || !should_keep(data[i]) || kept + pending.size() >= max_live) {
+        continue;
+      }
+
+      const auto home = HomeIndex(data[i].BoardKey(), new_size);
+      if (home < max_home) {
+        pending.push_back(data[i]);
+        continue;
+      }
+
+      max_home = home;
+      if (kept != i) {
+        data[kept] = data[i];
+      }
+      ++kept;
+    }
+
+    // 4. 詰めたエントリを新しいテーブルの末尾 [base, new_size) へ移し、前から順に挿入位置へ移動する
+    if (new_size > old_size) {
+      entries_.Reallocate(new_size);
+      data = entries_.data();
+      ConstructEntries(old_size, new_size, num_threads);
+    }
+
+    const auto base = new_size - kept;
+    for (std::uint64_t i = kept; i > 0; --i) {
+      if (base != 0) {
+        data[base + i - 1] = data[i - 1];
+      }
+    }
+    ParallelFor(base, num_threads, [data](std::size_t begin, std::size_t end) {
+      for (auto entry = data + begin; entry != data + end; ++entry) {
+        entry->SetNull();
+      }
+    });
+
+    std::uint64_t next = 0;
+    std::uint64_t placed = 0;
+    for (std::uint64_t i = 0; i < kept; ++i) {
+      auto& entry = data[base + i];
+      const auto dst = std::max(HomeIndex(entry.BoardKey(), new_size), next);
+      if (dst > base + i) {
+        // 末尾からあふれる。残りは退避して後で挿入し直す。
+        for (auto j = i; j < kept; ++j) {
+          pending.push_back(data[base + j]);
+          data[base + j].SetNull();
+        }
+        break;
+      }
+
+      if (dst != base + i) {
+        data[dst] = entry;
+        entry.SetNull();
+      }
+      next = dst + 1;
+      ++placed;
+    }
+
+    if (new_size < old_size) {
+      entries_.Reallocate(new_size);
+      data = entries_.data();
+    }
+
+    // 5. 退避したエントリを挿入し直す
+    for (const auto& entry : pending) {
+      if (placed >= max_live) {
+        break;
+      }
+
+      if (should_keep(entry)) {
+        auto ptr = PointerOf(entry.BoardKey());
+        for (; !ptr->IsNull(); ++ptr) {
+        }
+        *ptr = entry;
+        ++placed;
+      }
+    }
+  }
+
+  /**
+   * @brief 残すエントリの探索量の下限を求める
+   * @param live_count 使用中のエントリ数
+   * @param max_live   残すエントリ数の上限
+   * @param pending    テーブルから退避したエントリ
+   * @return 探索量がこの値以上のエントリを残す
+   *
+   * `CollectGarbage()` と同様に、使用中のエントリから `detail::kGcSamplingEntries` 個程度の探索量を抜き出して
+   * しきい値を決める。
+   */
+  SearchAmount AmountThreshold(std::uint64_t live_count,
+                               std::uint64_t max_live,
+                               const std::vector<Entry>& pending) const {
+    if (live_count <= max_live) {
+      return 0;
+    }
+
+    const auto step = std::max<std::uint64_t>(live_count / detail::kGcSamplingEntries, 1);
+    std::vector<SearchAmount> amounts;
+    amounts.reserve(detail::kGcSamplingEntries + 1);
+    std::uint64_t count = 0;
+    const auto sample = [&](const Entry& entry) {
+      if (!entry.IsNull() && count++ % step == 0) {
+        amounts.push_back(entry.Amount());
+      }
+    };
+    std::for_each(pending.begin(), pending.end(), sample);
+    std::for_each(entries_.begin(), entries_.end(), sample);
+    if (amounts.empty()) {
+      return 0;
+    }
+
+    const auto remove_ratio = 1.0 - static_cast<double>(max_live) / static_cast<double>(live_count);
+    const auto pivot = static_cast<std::size_t>(static_cast<double>(amounts.size()) * remove_ratio);
+    auto pivot_itr = amounts.begin() + std::min(pivot, amounts.size() - 1);
+    std::nth_element(amounts.begin(), pivot_itr, amounts.end());
+    return *pivot_itr;
+  }
+
   /**
    * @brief 通常エントリの本体。
+   *
+   * `Resize()` で内容を保ったまま伸縮させるので、`std::vector` ではなく `LargeArray` で管理する。
    */
-  std::vector<Entry> entries_;
+  LargeArray<Entry> entries_;
 };
 }  // namespace komori::tt
 
@@ -6,17 +6,19 @@
 
 #include <optional>
 #include <shared_mutex>
+#include <type_traits>
 #include <vector>
 
 #include "../../types.h"
 #include "mate_len.hpp"
 #include "shared_exclusive_lock.hpp"
+#include "table_memory.hpp"
 
 namespace komori::tt {
 /**
  * @brief 千日手手順（経路ハッシュ値）を記録する置換表
  *
- * `std::unordered_map<std::pair<Key, Depth>>` のような機能を実装するが、内部はただの配列（std::vector）で
+ * `std::unordered_map<std::pair<Key, Depth>>` のような機能を実装するが、内部はただの配列（`LargeArray`）で
  * 実装されている。ハッシュ値が衝突したときは、線形走査により格納するインデックスを求める。
  *
  * LookUp速度を高速に保つために、置換表の高々 30% しか要素を格納しない。メモリ使用率が 30% を超えた場合、
@@ -61,33 +63,50 @@ class RepetitionTable {
   /// Destructor(default)
   ~RepetitionTable() = default;
 
-  /// 置換表に保存された経路ハッシュ値をすべて削除する。
-  void Clear() {
+  /**
+   * @brief 置換表に保存された経路ハッシュ値をすべて削除する。
+   * @param num_threads 消去に用いるスレッド数
+   *
+   * 空エントリの判定は `key` だけで行うので、テーブル全体を 0 で埋めればよい。巨大なテーブルではページを OS に返して
+   * 遅延ゼロ初期化に任せる（`ZeroFillLazily()`）。
+   */
+  void Clear(std::uint32_t num_threads = 1) {
     generation_ = 0;
     entry_count_ = 0;
 
     next_generation_update_ = entries_per_generation_;
     next_gc_ = kInitialGcDuration;
 
-    const TableEntry initial_entry{kEmptyKey, 0, kMinus1MateLen16, 0};
-    std::fill(hash_table_.begin(), hash_table_.end(), initial_entry);
+    static_assert(kEmptyKey == 0);
+    static_assert(std::is_trivially_copyable_v<TableEntry>);
+    ZeroFillLazily(hash_table_.data(), hash_table_.size() * sizeof(TableEntry), num_threads);
   }
 
+  /**
+   * @brief 置換表の配置方針を `placement` に変更する
+   * @param placement 新しい配置方針
+   *
+   * 配置方針は次に領域を確保するときに適用する。方針が変わった場合は領域を捨てるので、続けて `Resize()` を呼ぶこと。
+   */
+  void SetPlacement(const MemoryPlacement& placement) noexcept { hash_table_.SetPlacement(placement); }
+
   /**
    * @brief 置換表サイズを `table_size` へ変更する。
    *
-   * @param table_size 置換表サイズ
+   * @param table_size  置換表サイズ
+   * @param num_threads 初期化に用いるスレッド数
    *
    * 置換表サイズを `table_size` へと変更する。もし `hash_table_.size() == table_size` ならば、何もしない。
    * `hash_table_.size() != table_size` なら置換表のりサイズと `Clear()` を行う。
    */
-  void Resize(std::size_t table_size) {
+  void Resize(std::size_t table_size, std::uint32_t num_threads = 1) {
     if (hash_table_.size() != table_size) {
       table_size = std::max<decltype(table_size)>(table_size, 1);
       entries_per_generation_ = std::max<std::size_t>(table_size / kGenerationPerTableSize, 1);
-      hash_table_.resize(table_size);
-      hash_table_.shrink_to_fit();
-      Clear();
+      // 新旧の領域が同時に存在しないよう、先に古い領域を解放する。新しい領域の初期化は Clear() に任せる。
+      hash_table_.Release();
+      hash_table_.Reallocate(table_size);
+      Clear(num_threads);
     }
   }
 
@@ -243,7 +262,8 @@ class RepetitionTable {
   std::uint64_t next_generation_update_{};  ///< 次回generation_をインクリメントするタイミング
   Generation next_gc_{};                    ///< 次回GCを行うGeneration
   std::uint64_t entries_per_generation_{};  ///< 1 generationあたりのエントリ数
-  std::vector<TableEntry> hash_table_{};    ///< 置換表本体
+  /// 置換表本体。初期化は `Clear()` で行うので、要素を構築しない `LargeArray` で管理する。
+  LargeArray<TableEntry> hash_table_{};
 };
 }  // namespace komori::tt
 
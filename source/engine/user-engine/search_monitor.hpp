@@ -4,9 +4,12 @@
 #ifndef KOMORI_SEARCH_MONITOR_HPP_
 #define KOMORI_SEARCH_MONITOR_HPP_
 
+#include <algorithm>
 #include <atomic>
 #include <chrono>
 #include <cstdint>
+#include <limits>
+#include <vector>
 
 #include "../../thread.h"
 #include "circular_array.hpp"
@@ -31,6 +34,37 @@ constexpr std::uint64_t HashfullCheckInterval(std::uint64_t capacity) noexcept {
 }
 }  // namespace detail
 
+/**
+ * @brief 探索を行うスレッドと探索の打ち切り条件
+ *
+ * USI エンジンとして動かすときは YaneuraOu のグローバル変数（`Threads`, `Search::Limits`, `Time`）から作る。
+ * ライブラリとして 1 プロセスで複数のソルバーを動かすときは、ソルバーごとに別々の値を渡す。
+ */
+struct SearchContext {
+  std::vector<Thread*> threads;            ///< 探索スレッド。探索局面数はこれらの `nodes` の合計。
+  const std::atomic<bool>* stop{nullptr};  ///< 外部から探索を打ち切るためのフラグ。`nullptr` なら使わない。
+  TimePoint time_limit{std::numeric_limits<TimePoint>::max()};  ///< 探索の時間制限[ms]
+  std::uint64_t nodes_limit{std::numeric_limits<std::uint64_t>::max()};  ///< 探索局面数の上限
+  std::chrono::steady_clock::time_point start_time{std::chrono::steady_clock::now()};  ///< 時間制限の起点
+};
+
+/**
+ * @brief YaneuraOu のグローバル変数から USI エンジン用の `SearchContext` を作る
+ * @return 探索コンテキスト
+ */
+inline SearchContext MakeUsiSearchContext() {
+  SearchContext context;
+  context.threads.assign(Threads.begin(), Threads.end());
+  context.stop = &Threads.stop;
+  if (Search::Limits.mate > 0) {
+    context.time_limit = Search::Limits.mate;
+  } else if (Search::Limits.movetime > 0) {
+    context.time_limit = Search::Limits.movetime;
+  }
+  context.start_time -= std::chrono::milliseconds{Time.elapsed_from_ponderhit()};
+  return context;
+}
+
 /**
  * @brief 探索局面数を観測して nps を計算したり探索中断の判断をしたりするクラス。
  */
@@ -41,8 +75,13 @@ class SearchMonitor {
    * @param tt_capacity 置換表のサイズ
    * @param pv_interval PV出力の間隔[ms]
    * @param move_limit 探索局面数の上限
+   * @param context 探索スレッドと探索の打ち切り条件
    */
-  void NewSearch(std::uint64_t tt_capacity, std::uint64_t pv_interval, std::uint64_t move_limit) {
+  void NewSearch(std::uint64_t tt_capacity,
+                 std::uint64_t pv_interval,
+                 std::uint64_t move_limit,
+                 const SearchContext& context) {
+    context_ = context;
     start_time_ = std::chrono::steady_clock::now();
     max_depth_ = 0;
 
@@ -50,14 +89,7 @@ class SearchMonitor {
     mc_hist_.Clear();
     hist_idx_ = 0;
 
-    move_limit_ = move_limit;
-    if (Search::Limits.mate > 0) {
-      time_limit_ = Search::Limits.mate;
-    } else if (Search::Limits.movetime > 0) {
-      time_limit_ = Search::Limits.movetime;
-    } else {
-      time_limit_ = std::numeric_limits<TimePoint>::max();
-    }
+    move_limit_ = std::min(move_limit, context_.nodes_limit);
 
     hashfull_check_interval_ = detail::HashfullCheckInterval(tt_capacity);
     ResetNextHashfullCheck();
@@ -83,6 +115,16 @@ class SearchMonitor {
    * @return 現在の探索情報
    */
   UsiInfo GetInfo() const {
+    UsiInfo output;
+    GetInfo(output);
+    return output;
+  }
+
+  /**
+   * @brief 現在の探索情報を `output` に書き込む。
+   * @param output 書き込み先
+   */
+  void GetInfo(UsiInfo& output) const {
     const auto curr_time = std::chrono::steady_clock::now();
     const auto time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(curr_time - start_time_).count();
 
@@ -99,17 +141,22 @@ class SearchMonitor {
       }
     }
 
-    UsiInfo output;
     output.Set(UsiInfoKey::kSelDepth, max_depth_.load(std::memory_order_relaxed));
     output.Set(UsiInfoKey::kTime, time_ms);
     output.Set(UsiInfoKey::kNodes, move_count);
     output.Set(UsiInfoKey::kNps, nps);
-
-    return output;
   }
 
   /// 現在の探索局面数
-  std::uint64_t MoveCount() const { return Threads.nodes_searched(); }
+  std::uint64_t MoveCount() const {
+    std::uint64_t sum = 0;
+    for (const auto* th : context_.threads) {
+      sum += th->nodes.load(std::memory_order_relaxed);
+    }
+    return sum;
+  }
+  /// 外部から探索の中断を要求されていれば true
+  bool IsStopRequested() const { return context_.stop != nullptr && context_.stop->load(std::memory_order_relaxed); }
   /// 今すぐ置換表使用率をチェックすべきなら true
   bool ShouldCheckHashfull() {
     hashfull_check_skip_--;
@@ -131,7 +178,7 @@ class SearchMonitor {
   bool ShouldStop() {
     const auto stop = stop_.load(std::memory_order_acquire);
     if (tl_thread_id != 0) {
-      return stop || Threads.stop;
+      return stop || IsStopRequested();
     } else if (stop) {
       // tick 状態に関係なく stop_ なら終了。
       return true;
@@ -140,11 +187,23 @@ class SearchMonitor {
     }
 
     // stop_ かどうか改めて判定し直す
-    const auto elapsed = Time.elapsed_from_ponderhit();
-    stop_.store(MoveCount() >= move_limit_ || elapsed >= time_limit_ || Threads.stop, std::memory_order_release);
+    const auto elapsed = Elapsed();
+    stop_.store(MoveCount() >= move_limit_ || elapsed >= context_.time_limit || IsStopRequested(),
+                std::memory_order_release);
     return stop_;
   }
 
+  /// 探索を打ち切る。番号が 0 でないスレッドは次の `ShouldStop()` ですぐに止まる。
+  void Stop() { stop_.store(true, std::memory_order_release); }
+
+  /// 探索の残り時間[ms]。時間制限がなければ `TimePoint` の最大値。
+  TimePoint RemainingTime() const {
+    if (context_.time_limit == std::numeric_limits<TimePoint>::max()) {
+      return context_.time_limit;
+    }
+    return std::max<TimePoint>(context_.time_limit - Elapsed(), 0);
+  }
+
   /// 今すぐ評価値を出力すべきかどうか。定期的に呼び出す必要がある。
   bool ShouldPrint() {
     if (!print_alarm_.Tick()) {
@@ -159,9 +218,16 @@ class SearchMonitor {
   }
 
  private:
+  /// 時間制限の起点からの経過時間[ms]
+  TimePoint Elapsed() const {
+    const auto elapsed = std::chrono::steady_clock::now() - context_.start_time;
+    return std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count();
+  }
+
   /// nps の計算のために保持する探索局面数の履歴数
   static constexpr inline std::size_t kHistLen = 16;
 
+  SearchContext context_;                             ///< 探索スレッドと探索の打ち切り条件
   std::chrono::steady_clock::time_point start_time_;  ///< 探索開始時刻
 
   CircularArray<std::chrono::steady_clock::time_point, kHistLen> tp_hist_;  ///< mc_hist_ を観測した時刻
@@ -169,7 +235,6 @@ class SearchMonitor {
   std::size_t hist_idx_;  ///< `tp_hist_` と `mc_hist_` の現在の添字
 
   std::uint64_t move_limit_;               ///< 探索局面数の上限
-  TimePoint time_limit_;                   ///< 探索の時間制限[ms]
   std::uint64_t hashfull_check_interval_;  ///< 置換表使用率をチェックする周期[探索局面数]
   std::uint32_t hashfull_check_skip_;      ///< next_hashfull_check_ のチェックをスキップする回数
   std::uint64_t next_hashfull_check_;  ///< 次に置換表使用率をチェックするタイミング[探索局面数]
@@ -0,0 +1,297 @@
+/**
+ * @file search_profiler.hpp
+ */
+#ifndef KOMORI_SEARCH_PROFILER_HPP_
+#define KOMORI_SEARCH_PROFILER_HPP_
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "board_key_hand_pair.hpp"
+#include "typedefs.hpp"
+
+namespace komori {
+/**
+ * @brief 探索プロファイラが数えるイベント
+ */
+enum class ProfileEvent : std::uint32_t {
+  kVisit,     ///< `SearchImpl()` の呼び出し
+  kReexpand,  ///< 探索済みの子局面を置換表から展開し直した
+  kTtMiss,    ///< 子局面が置換表に無く、初期値で展開した
+  kRetry,     ///< 子局面から戻った後、しきい値に収まっているので再び子局面を探索した
+  kTca,       ///< TCA による探索延長を始めた
+  kNb,        ///< イベントの種類数（番兵）
+};
+
+/// イベントの種類数
+inline constexpr std::size_t kProfileEventNb = static_cast<std::size_t>(ProfileEvent::kNb);
+
+/// `event` の名前。レポートで使う。
+inline const char* ToString(ProfileEvent event) {
+  constexpr std::array<const char*, kProfileEventNb> kNames{"visit", "reexpand", "ttmiss", "retry", "tca"};
+  return kNames[static_cast<std::size_t>(event)];
+}
+
+/**
+ * @brief イベントごとの回数
+ */
+struct ProfileCounts {
+  std::array<std::uint64_t, kProfileEventNb> counts{};  ///< イベントごとの回数
+
+  /// `event` の回数
+  constexpr std::uint64_t Get(ProfileEvent event) const { return counts[static_cast<std::size_t>(event)]; }
+  /// `event` を `amount` 回数える
+  constexpr void Add(ProfileEvent event, std::uint64_t amount = 1) { counts[static_cast<std::size_t>(event)] += amount; }
+
+  /// `rhs` の回数を足す
+  constexpr ProfileCounts& operator+=(const ProfileCounts& rhs) {
+    for (std::size_t i = 0; i < kProfileEventNb; ++i) {
+      counts[i] += rhs.counts[i];
+    }
+    return *this;
+  }
+};
+
+/**
+ * @brief 探索が特に集中した局面の情報
+ */
+struct ProfileHotspot {
+  BoardKeyHandPair key{};        ///< 局面
+  Depth depth{};                 ///< 初めて記録したときの深さ
+  Move root_move{MOVE_NONE};     ///< 初めて記録したときの開始局面の指し手
+  ProfileCounts counts{};        ///< サンプリングしたイベントの回数
+  std::uint64_t weight{};        ///< 置き換えの優先度。0 になったスロットは別の局面に明け渡す。
+};
+
+namespace detail {
+/// 深さのヒストグラムの区間数。最後の区間はそれ以上の深さをまとめて数える。
+inline constexpr std::size_t kProfileDepthBuckets = 128;
+/// 局面ごとの集計テーブルの大きさ（2 の冪）
+inline constexpr std::size_t kProfileHotspotTableSize = 4096;
+/// 局面ごとの集計は平均して `kProfileSampleInterval` 回に1回だけ行う（2 の冪）
+inline constexpr std::uint32_t kProfileSampleInterval = 8;
+}  // namespace detail
+
+/**
+ * @brief 探索スレッド1つ分の探索プロファイル
+ *
+ * `SearchImpl()` のイベント（訪問、再展開、置換表ミス、しきい値の再試行、TCA）を、開始局面の指し手、深さ、
+ * 局面（盤面ハッシュ値と攻め方の持ち駒）ごとに数える。スレッドごとに別のインスタンスを使い、探索中は同期しない。
+ *
+ * 開始局面の指し手と深さごとの集計はすべてのイベントを数える。局面ごとの集計は平均して `kProfileSampleInterval`
+ * 回に1回だけサンプリングし、固定サイズのテーブルへ記録する。探索中のイベントの並びには周期性があるので、
+ * サンプリングの間隔は一定にせず乱数で揺らす。テーブルのスロットが別の局面で埋まっている場合は
+ * そのスロットの `weight` を1減らし、0 になったら新しい局面に置き換える。こうすると、何度も現れる局面ほど
+ * テーブルに残りやすい。
+ */
+class ThreadProfile {
+ public:
+  /// 集計結果をすべて消す
+  void Clear() {
+    total_ = ProfileCounts{};
+    std::fill(depth_hist_.begin(), depth_hist_.end(), ProfileCounts{});
+    root_moves_.clear();
+    last_root_idx_ = 0;
+    hotspots_.assign(detail::kProfileHotspotTableSize, ProfileHotspot{});
+    sample_remain_ = detail::kProfileSampleInterval;
+    rng_ = kRngSeed;
+  }
+
+  /**
+   * @brief イベントを1つ記録する
+   * @param event     イベント
+   * @param depth     イベントが起きた局面の深さ
+   * @param root_move 開始局面の指し手。開始局面自身なら `MOVE_NONE`。
+   * @param key       イベントが起きた局面
+   */
+  void Record(ProfileEvent event, Depth depth, Move root_move, BoardKeyHandPair key) {
+    total_.Add(event);
+    depth_hist_[std::min(static_cast<std::size_t>(depth), detail::kProfileDepthBuckets - 1)].Add(event);
+    if (root_move != MOVE_NONE) {
+      RootMoveCounts(root_move).Add(event);
+    }
+
+    if (--sample_remain_ > 0) {
+      return;
+    }
+    sample_remain_ = NextSampleInterval();
+    if (hotspots_.empty()) {
+      hotspots_.assign(detail::kProfileHotspotTableSize, ProfileHotspot{});
+    }
+
+    // 置換表とは別のビットを使いたいので、混ぜた値の上位ビットを添字にする
+    const auto hash = key.board_key ^ (static_cast<Key>(key.hand) * 0x9e3779b97f4a7c15ULL);
+    auto& slot = hotspots_[(hash >> 32) & (detail::kProfileHotspotTableSize - 1)];
+    if (slot.weight > 0 && slot.key != key) {
+      slot.weight--;
+      return;
+    }
+
+    if (slot.weight == 0 && slot.key != key) {
+      slot = ProfileHotspot{key, depth, root_move, {}, 0};
+    }
+    slot.counts.Add(event, detail::kProfileSampleInterval);
+    slot.weight++;
+  }
+
+  /// すべてのイベントの回数
+  const ProfileCounts& Total() const { return total_; }
+  /// 深さごとのイベントの回数
+  const std::array<ProfileCounts, detail::kProfileDepthBuckets>& DepthHistogram() const { return depth_hist_; }
+  /// 開始局面の指し手ごとのイベントの回数
+  const std::vector<std::pair<Move, ProfileCounts>>& RootMoves() const { return root_moves_; }
+  /// 局面ごとの集計テーブル。未使用のスロットは `weight == 0` かつイベントの回数が 0。
+  const std::vector<ProfileHotspot>& Hotspots() const { return hotspots_; }
+
+ private:
+  /// 乱数の初期値
+  static constexpr std::uint64_t kRngSeed = 0x3343'3433'4334'3343ULL;
+
+  /// 次のサンプリングまでのイベント数。1 以上 `2 * kProfileSampleInterval` 未満で、平均は `kProfileSampleInterval`。
+  std::uint32_t NextSampleInterval() {
+    // xorshift64
+    rng_ ^= rng_ << 13;
+    rng_ ^= rng_ >> 7;
+    rng_ ^= rng_ << 17;
+    return 1 + static_cast<std::uint32_t>(rng_ % (2 * detail::kProfileSampleInterval - 1));
+  }
+
+  /// `root_move` の集計領域。開始局面の指し手は少なく、同じ手が続くので線形探索で十分速い。
+  ProfileCounts& RootMoveCounts(Move root_move) {
+    if (last_root_idx_ < root_moves_.size() && root_moves_[last_root_idx_].first == root_move) {
+      return root_moves_[last_root_idx_].second;
+    }
+
+    for (std::size_t i = 0; i < root_moves_.size(); ++i) {
+      if (root_moves_[i].first == root_move) {
+        last_root_idx_ = i;
+        return root_moves_[i].second;
+      }
+    }
+    last_root_idx_ = root_moves_.size();
+    return root_moves_.emplace_back(root_move, ProfileCounts{}).second;
+  }
+
+  ProfileCounts total_{};                                             ///< すべてのイベントの回数
+  std::array<ProfileCounts, detail::kProfileDepthBuckets> depth_hist_{};  ///< 深さごとのイベントの回数
+  std::vector<std::pair<Move, ProfileCounts>> root_moves_;           ///< 開始局面の指し手ごとのイベントの回数
+  std::size_t last_root_idx_{0};                                     ///< 直前に数えた `root_moves_` の添字
+  std::vector<ProfileHotspot> hotspots_;                             ///< 局面ごとの集計テーブル
+  std::uint32_t sample_remain_{detail::kProfileSampleInterval};      ///< 次のサンプリングまでのイベント数
+  std::uint64_t rng_{kRngSeed};                                      ///< サンプリング間隔を決める乱数の状態
+};
+
+/**
+ * @brief スレッドごとの探索プロファイルをまとめて、レポートを作る
+ * @param profiles スレッドごとの探索プロファイル
+ * @param top_n    開始局面の指し手と局面を、それぞれ上位何件まで出力するか
+ * @return レポート（1 要素が 1 行）
+ *
+ * 開始局面の指し手は訪問回数の多い順、局面は再展開の多い順に並べる。局面ごとの回数はサンプリングによる推定値。
+ * 深さのヒストグラムは 0 回の深さを省いて "深さ:回数" の形式で出力する。
+ */
+inline std::vector<std::string> MakeProfileReport(const std::vector<ThreadProfile>& profiles, std::size_t top_n) {
+  ProfileCounts total{};
+  std::array<ProfileCounts, detail::kProfileDepthBuckets> depth_hist{};
+  std::vector<std::pair<Move, ProfileCounts>> root_moves;
+  std::vector<ProfileHotspot> hotspots;
+  for (const auto& profile : profiles) {
+    total += profile.Total();
+    for (std::size_t i = 0; i < detail::kProfileDepthBuckets; ++i) {
+      depth_hist[i] += profile.DepthHistogram()[i];
+    }
+    for (const auto& [move, counts] : profile.RootMoves()) {
+      const auto itr =
+          std::find_if(root_moves.begin(), root_moves.end(), [&](const auto& entry) { return entry.first == move; });
+      if (itr == root_moves.end()) {
+        root_moves.emplace_back(move, counts);
+      } else {
+        itr->second += counts;
+      }
+    }
+    for (const auto& hotspot : profile.Hotspots()) {
+      if (hotspot.weight > 0) {
+        hotspots.push_back(hotspot);
+      }
+    }
+  }
+
+  // 同じ局面が複数のスレッドで記録されていたらまとめる
+  std::sort(hotspots.begin(), hotspots.end(), [](const auto& lhs, const auto& rhs) {
+    return lhs.key.board_key != rhs.key.board_key ? lhs.key.board_key < rhs.key.board_key
+                                                  : lhs.key.hand < rhs.key.hand;
+  });
+  std::vector<ProfileHotspot> merged;
+  for (const auto& hotspot : hotspots) {
+    if (!merged.empty() && merged.back().key == hotspot.key) {
+      merged.back().counts += hotspot.counts;
+      merged.back().depth = std::min(merged.back().depth, hotspot.depth);
+    } else {
+      merged.push_back(hotspot);
+    }
+  }
+
+  const auto by_count = [](ProfileEvent event) {
+    return [event](const auto& lhs, const auto& rhs) { return lhs.counts.Get(event) > rhs.counts.Get(event); };
+  };
+  std::stable_sort(root_moves.begin(), root_moves.end(), [](const auto& lhs, const auto& rhs) {
+    return lhs.second.Get(ProfileEvent::kVisit) > rhs.second.Get(ProfileEvent::kVisit);
+  });
+  std::stable_sort(merged.begin(), merged.end(), by_count(ProfileEvent::kReexpand));
+
+  const auto print_counts = [](std::ostream& os, const ProfileCounts& counts) {
+    for (std::size_t i = 0; i < kProfileEventNb; ++i) {
+      os << " " << ToString(static_cast<ProfileEvent>(i)) << " " << counts.counts[i];
+    }
+  };
+
+  std::vector<std::string> report;
+  {
+    std::ostringstream oss;
+    oss << "profile total";
+    print_counts(oss, total);
+    report.push_back(oss.str());
+  }
+  for (std::size_t i = 0; i < std::min(top_n, root_moves.size()); ++i) {
+    std::ostringstream oss;
+    oss << "profile root " << root_moves[i].first;
+    print_counts(oss, root_moves[i].second);
+    report.push_back(oss.str());
+  }
+  for (std::size_t i = 0; i < std::min(top_n, merged.size()); ++i) {
+    const auto& hotspot = merged[i];
+    std::ostringstream oss;
+    oss << "profile hotspot " << i + 1 << " key " << std::hex << hotspot.key.board_key << std::dec << " hand ";
+    if (hotspot.key.hand == HAND_ZERO) {
+      oss << "-";
+    }
+    // sfen の持ち駒と同じ書式で出力する
+    for (const auto pr : {ROOK, BISHOP, GOLD, SILVER, KNIGHT, LANCE, PAWN}) {
+      if (const auto count = hand_count(hotspot.key.hand, pr); count > 0) {
+        oss << (count > 1 ? std::to_string(count) : "") << PieceToCharBW[make_piece(BLACK, pr)];
+      }
+    }
+    oss << " depth " << hotspot.depth << " root " << hotspot.root_move;
+    print_counts(oss, hotspot.counts);
+    report.push_back(oss.str());
+  }
+  for (const auto event : {ProfileEvent::kVisit, ProfileEvent::kReexpand}) {
+    std::ostringstream oss;
+    oss << "profile depth " << ToString(event);
+    for (std::size_t i = 0; i < detail::kProfileDepthBuckets; ++i) {
+      if (const auto count = depth_hist[i].Get(event); count > 0) {
+        oss << " " << i << (i + 1 == detail::kProfileDepthBuckets ? "+" : "") << ":" << count;
+      }
+    }
+    report.push_back(oss.str());
+  }
+
+  return report;
+}
+}  // namespace komori
+
+#endif  // KOMORI_SEARCH_PROFILER_HPP_
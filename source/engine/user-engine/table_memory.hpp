@@ -0,0 +1,768 @@
+/**
+ * @file table_memory.hpp
+ */
+#ifndef KOMORI_TABLE_MEMORY_HPP_
+#define KOMORI_TABLE_MEMORY_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <new>
+#include <optional>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif  // defined(__linux__)
+
+namespace komori {
+namespace detail {
+/// `ParallelFor()` で 1 スレッドに割り当てる最小の要素数。これより小さい範囲はスレッドを起こさずに処理する。
+inline constexpr std::size_t kParallelForMinChunk = std::size_t{1} << 16;
+/// `ZeroFillLazily()` でページの解放を試みる最小のバイト数
+inline constexpr std::size_t kLazyZeroMinBytes = std::size_t{1} << 24;
+
+/// 共有メモリ上の配列の先頭に置くヘッダの領域サイズ。配列本体がページ境界から始まるようにする。
+inline constexpr std::size_t kSharedHeaderBytes = 4096;
+/// 共有メモリ上の配列の初期化が完了したことを示す値。`SharedHeader` のメンバ構成を変えたら下位の版数を上げること。
+inline constexpr std::uint64_t kSharedReadyMagic = 0x6b68'7368'6d30'0002ULL;
+/// 他プロセスによる共有メモリの初期化を待つ最大時間
+inline constexpr auto kSharedInitTimeout = std::chrono::seconds{60};
+/// 配列全体を書き換える権利の有効期間。この間に権利の更新がなければ、他のプロセスが権利を引き継ぐ。
+inline constexpr auto kMaintenanceLease = std::chrono::milliseconds{30'000};
+/// `SharedHeader::maintenance` のうち pid を格納する下位ビット数。Linux の pid は 2^22 未満。
+inline constexpr int kMaintenancePidBits = 22;
+
+/**
+ * @brief 配列全体を書き換える権利を表す値を作る
+ * @return 上位ビットに現在時刻[ms]、下位 `kMaintenancePidBits` ビットに自身の pid を詰めた値
+ *
+ * 時刻は別のプロセスと比較するので、プロセスごとに異なりうる `steady_clock` ではなく `system_clock` を用いる。
+ * pid は同時刻に権利を取ろうとしたプロセス同士を区別するためだけに使い、生存確認には使わない。
+ */
+inline std::uint64_t MakeMaintenanceClaim() noexcept {
+  const auto now_ms = static_cast<std::uint64_t>(
+      std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch())
+          .count());
+#if defined(__linux__)
+  const auto pid = static_cast<std::uint64_t>(::getpid());
+#else   // defined(__linux__)
+  const std::uint64_t pid = 1;
+#endif  // defined(__linux__)
+  return (now_ms << kMaintenancePidBits) | (pid & ((std::uint64_t{1} << kMaintenancePidBits) - 1));
+}
+
+/**
+ * @brief 権利 `claim` が時刻 `now` の時点で期限切れかどうか
+ * @param claim 権利を表す値
+ * @param now   現在時刻を表す値（`MakeMaintenanceClaim()` の戻り値）
+ * @param lease 権利の有効期間
+ */
+constexpr bool IsMaintenanceExpired(std::uint64_t claim, std::uint64_t now, std::chrono::milliseconds lease) noexcept {
+  const auto claim_ms = claim >> kMaintenancePidBits;
+  const auto now_ms = now >> kMaintenancePidBits;
+  return now_ms >= claim_ms + static_cast<std::uint64_t>(lease.count());
+}
+
+/**
+ * @brief 共有メモリ上の配列の先頭に置くヘッダ
+ *
+ * 最初に共有メモリを作ったプロセスが配列を初期化し、最後に `ready` へ `kSharedReadyMagic` を書き込む。
+ * 後から接続したプロセスは `ready` が書き込まれるまで待ってから配列を使う。
+ *
+ * `layout` は要素の中身の解釈（メンバ構成や pn/dn のビット幅など）を表す値で、`AttachShared()` の呼び出し元が決める。
+ * 要素のサイズが同じでも解釈が異なるビルド同士が同じ配列を読み書きしないよう、値が異なる共有メモリへの接続は拒否する。
+ *
+ * `maintenance` は配列全体を書き換える処理（置換表の GC など）の権利で、そのような処理を同時に 1 プロセスしか
+ * 行わないようにするために使う。権利を持つプロセスは処理中に定期的に時刻を更新し、`kMaintenanceLease` の間
+ * 更新のない権利は他のプロセスが引き継ぐ。pid の再利用や PID 名前空間の違いに左右されないよう、相手のプロセスの
+ * 生存確認は行わない。
+ */
+struct SharedHeader {
+  std::atomic<std::uint64_t> ready;       ///< 初期化が完了していれば `kSharedReadyMagic`
+  std::uint64_t element_size;             ///< 要素 1 個のサイズ
+  std::uint64_t size;                     ///< 要素数
+  std::uint64_t layout;                   ///< 要素のレイアウトを表す値
+  std::atomic<std::uint64_t> maintenance;  ///< 配列全体を書き換える権利（`MakeMaintenanceClaim()`）。なければ 0。
+};
+static_assert(sizeof(SharedHeader) <= kSharedHeaderBytes);
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free, "process-shared atomics must be lock free");
+
+/// NUMA ノードの情報を読む sysfs のディレクトリ
+inline constexpr char kNumaSysfsDir[] = "/sys/devices/system/node/";
+/// `mbind()` の `MPOL_INTERLEAVE`。libnuma に依存しないよう、`<numaif.h>` を使わずに定義する。
+inline constexpr int kMpolInterleave = 3;
+}  // namespace detail
+
+/**
+ * @brief 置換表を NUMA ノードへどのように配置するか
+ */
+enum class NumaPolicy {
+  kNone,        ///< OS に任せる
+  kInterleave,  ///< ページ単位ですべての NUMA ノードへ交互に配置する
+  kFirstTouch,  ///< 各 NUMA ノードに固定したスレッドで初期化し、区間ごとにノードへ配置する
+};
+
+/**
+ * @brief 置換表のような巨大な配列をどのようなメモリに置くか
+ */
+struct MemoryPlacement {
+  bool huge_pages{false};              ///< Transparent Huge Pages を使うよう OS に依頼するかどうか
+  NumaPolicy numa{NumaPolicy::kNone};  ///< NUMA ノードへの配置方法
+
+  /// 等値比較
+  friend bool operator==(const MemoryPlacement& lhs, const MemoryPlacement& rhs) noexcept {
+    return lhs.huge_pages == rhs.huge_pages && lhs.numa == rhs.numa;
+  }
+  /// 非等値比較
+  friend bool operator!=(const MemoryPlacement& lhs, const MemoryPlacement& rhs) noexcept { return !(lhs == rhs); }
+};
+
+namespace detail {
+/**
+ * @brief sysfs の CPU／ノード番号リスト（例: "0-3,8,10-11"）を番号の配列に変換する
+ * @param list 番号リスト
+ * @return 番号の配列。書式が正しくない部分は読み飛ばす。
+ */
+inline std::vector<int> ParseIdList(const std::string& list) {
+  std::vector<int> ids;
+  std::size_t pos = 0;
+  while (pos < list.size()) {
+    auto comma = list.find(',', pos);
+    if (comma == std::string::npos) {
+      comma = list.size();
+    }
+
+    const auto range = list.substr(pos, comma - pos);
+    pos = comma + 1;
+    if (range.empty() || range.find_first_not_of("0123456789-") != std::string::npos) {
+      continue;
+    }
+
+    const auto dash = range.find('-');
+    const int first = std::atoi(range.c_str());
+    const int last = dash == std::string::npos ? first : std::atoi(range.c_str() + dash + 1);
+    for (int id = first; id <= last; ++id) {
+      ids.push_back(id);
+    }
+  }
+  return ids;
+}
+
+/**
+ * @brief NUMA ノード 1 つ分の情報
+ */
+struct NumaNode {
+  int id;                 ///< ノード番号
+  std::vector<int> cpus;  ///< ノードに属する CPU 番号
+};
+
+/**
+ * @brief CPU を持つ NUMA ノードの一覧を返す
+ * @return NUMA ノードの一覧。NUMA の情報が取れない環境では空。
+ *
+ * sysfs を読むのは最初の 1 回だけで、以降はその結果を使い回す。
+ */
+inline const std::vector<NumaNode>& NumaNodes() {
+  static const std::vector<NumaNode> nodes = []() {
+    std::vector<NumaNode> ret;
+#if defined(__linux__)
+    const auto read_line = [](const std::string& path) {
+      std::ifstream ifs(path);
+      std::string line;
+      std::getline(ifs, line);
+      return line;
+    };
+
+    for (const auto id : ParseIdList(read_line(std::string{kNumaSysfsDir} + "online"))) {
+      auto cpus = ParseIdList(read_line(std::string{kNumaSysfsDir} + "node" + std::to_string(id) + "/cpulist"));
+      if (!cpus.empty()) {
+        ret.push_back(NumaNode{id, std::move(cpus)});
+      }
+    }
+#endif  // defined(__linux__)
+    return ret;
+  }();
+  return nodes;
+}
+}  // namespace detail
+
+/**
+ * @brief 呼び出し元のスレッドを `index` 番目の NUMA ノードの CPU に固定する
+ * @param index スレッド番号。NUMA ノードへは番号順に巡回して割り当てる。
+ * @return 固定したら `true`。NUMA ノードが 1 つ以下の環境や Linux 以外の環境では何もせず `false`。
+ *
+ * `ParallelFor()` で NUMA を考慮して初期化した置換表の区間と、探索スレッドの割り当てを揃えるために用いる。
+ */
+inline bool BindThisThreadToNumaNode(std::uint32_t index) {
+  const auto& nodes = detail::NumaNodes();
+  if (nodes.size() <= 1) {
+    return false;
+  }
+
+#if defined(__linux__)
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  for (const auto cpu : nodes[index % nodes.size()].cpus) {
+    if (cpu < CPU_SETSIZE) {
+      CPU_SET(cpu, &cpu_set);
+    }
+  }
+  return ::sched_setaffinity(0, sizeof(cpu_set), &cpu_set) == 0;
+#else   // defined(__linux__)
+  return false;
+#endif  // defined(__linux__)
+}
+
+/**
+ * @brief `[ptr, ptr + bytes)` に `placement` の配置方針を設定する
+ * @param ptr       先頭アドレス（ページ境界）
+ * @param bytes     バイト数
+ * @param placement 配置方針
+ *
+ * 配置方針はまだ触れていないページにのみ効く。すでに割り当て済みのページは移動しない。Linux 以外の環境や、
+ * カーネルが対応していない場合は何もしない。
+ */
+inline void PlaceMemory(void* ptr, std::size_t bytes, const MemoryPlacement& placement) {
+#if defined(__linux__)
+#if defined(MADV_HUGEPAGE)
+  if (placement.huge_pages) {
+    ::madvise(ptr, bytes, MADV_HUGEPAGE);
+  }
+#endif  // defined(MADV_HUGEPAGE)
+
+  const auto& nodes = detail::NumaNodes();
+  if (placement.numa == NumaPolicy::kInterleave && nodes.size() > 1) {
+    constexpr std::size_t kBitsPerWord = 8 * sizeof(unsigned long);  // NOLINT(google-runtime-int)
+    int max_id = 0;
+    for (const auto& node : nodes) {
+      max_id = std::max(max_id, node.id);
+    }
+    std::vector<unsigned long> mask(static_cast<std::size_t>(max_id) / kBitsPerWord + 1);  // NOLINT
+    for (const auto& node : nodes) {
+      const auto id = static_cast<std::size_t>(node.id);
+      mask[id / kBitsPerWord] |= 1UL << (id % kBitsPerWord);
+    }
+    ::syscall(SYS_mbind, ptr, bytes, detail::kMpolInterleave, mask.data(), mask.size() * kBitsPerWord + 1, 0);
+  }
+#else   // defined(__linux__)
+  static_cast<void>(ptr);
+  static_cast<void>(bytes);
+  static_cast<void>(placement);
+#endif  // defined(__linux__)
+}
+
+/**
+ * @brief `[0, size)` を `num_threads` 個の区間に分けて `func(begin, end)` を並列に呼び出す
+ * @param size        要素数
+ * @param num_threads 使用するスレッド数（呼び出し元のスレッドを含む）
+ * @param func        区間 `[begin, end)` を処理する関数
+ * @param bind_numa   `true` なら、`i` 番目の区間を処理するスレッドを `BindThisThreadToNumaNode(i)` で固定する
+ *
+ * 置換表のクリアのように、巨大な配列を一様に処理する用途を想定している。先頭の区間は呼び出し元のスレッドで処理し、
+ * 残りの区間ごとに `std::thread` を起こす。`size` が小さいときはスレッドを起こさない。すべての区間の処理が
+ * 終わるまで返らない。
+ *
+ * `bind_numa` のときは、呼び出し元のスレッドの CPU 割り当てを変えないよう、先頭の区間にもスレッドを起こす。
+ * 初めて触れるページはそのページに書き込んだスレッドの NUMA ノードに割り当てられるので（first touch）、
+ * 同じ番号の探索スレッドを同じノードに固定しておけば、区間とスレッドの配置が揃う。
+ */
+template <typename Func>
+inline void ParallelFor(std::size_t size, std::uint32_t num_threads, Func&& func, bool bind_numa = false) {
+  const auto max_threads = std::max<std::size_t>(size / detail::kParallelForMinChunk, 1);
+  const auto threads = std::clamp<std::size_t>(num_threads, 1, max_threads);
+  const auto chunk = (size + threads - 1) / threads;
+  const std::size_t first_worker = bind_numa ? 0 : 1;
+
+  std::vector<std::thread> workers;
+  workers.reserve(threads - first_worker);
+  for (std::size_t i = first_worker; i < threads; ++i) {
+    const auto begin = std::min(i * chunk, size);
+    const auto end = std::min(begin + chunk, size);
+    workers.emplace_back([&func, begin, end, i, bind_numa]() {
+      if (bind_numa) {
+        BindThisThreadToNumaNode(static_cast<std::uint32_t>(i));
+      }
+      func(begin, end);
+    });
+  }
+
+  if (!bind_numa) {
+    func(std::size_t{0}, std::min(chunk, size));
+  }
+  for (auto& worker : workers) {
+    worker.join();
+  }
+}
+
+/**
+ * @brief `[ptr, ptr + bytes)` を 0 で埋める
+ * @param ptr         先頭アドレス
+ * @param bytes       バイト数
+ * @param num_threads 使用するスレッド数
+ *
+ * Linux では、十分大きい領域についてページ境界の内側を `madvise(MADV_DONTNEED)` で OS に返す。返したページは
+ * 次に触ったときに 0 で初期化されたページとして割り当て直されるので、ここでは書き込みが発生しない。ページ境界の外側や
+ * `madvise()` が使えない環境では、`num_threads` スレッドで並列に `std::memset()` する。
+ *
+ * @pre `[ptr, ptr + bytes)` は `new` などで確保した private な無名メモリ上にある
+ */
+inline void ZeroFillLazily(void* ptr, std::size_t bytes, std::uint32_t num_threads) {
+  auto* const first = static_cast<std::uint8_t*>(ptr);
+  auto* const last = first + bytes;
+  const auto memset_parallel = [num_threads](std::uint8_t* begin, std::uint8_t* end) {
+    ParallelFor(static_cast<std::size_t>(end - begin), num_threads,
+                [begin](std::size_t b, std::size_t e) { std::memset(begin + b, 0, e - b); });
+  };
+
+#if defined(__linux__)
+  if (bytes >= detail::kLazyZeroMinBytes) {
+    const auto page = static_cast<std::uintptr_t>(::sysconf(_SC_PAGESIZE));
+    const auto inner_first = (reinterpret_cast<std::uintptr_t>(first) + page - 1) / page * page;
+    const auto inner_last = reinterpret_cast<std::uintptr_t>(last) / page * page;
+    if (inner_first < inner_last &&
+        ::madvise(reinterpret_cast<void*>(inner_first), inner_last - inner_first, MADV_DONTNEED) == 0) {
+      memset_parallel(first, reinterpret_cast<std::uint8_t*>(inner_first));
+      memset_parallel(reinterpret_cast<std::uint8_t*>(inner_last), last);
+      return;
+    }
+  }
+#endif  // defined(__linux__)
+
+  memset_parallel(first, last);
+}
+
+namespace detail {
+/**
+ * @brief 引数なしの構築を何もしないアロケータ
+ * @tparam T 要素型
+ *
+ * `std::vector<T, NoInitAllocator<T>>::resize()` は要素の初期化を行わずに領域だけを確保する。巨大な置換表を
+ * 1 スレッドで初期化する時間を避け、確保後に `ParallelFor()` で並列に構築するために用いる。
+ */
+template <typename T>
+class NoInitAllocator : public std::allocator<T> {
+ public:
+  /// 別の要素型に対するアロケータ
+  template <typename U>
+  struct rebind {
+    using other = NoInitAllocator<U>;  ///< `U` に対するアロケータ
+  };
+
+  using std::allocator<T>::allocator;
+
+  /// 引数なしの構築は何もしない
+  template <typename U>
+  void construct(U* /* ptr */) noexcept {}
+
+  /// 引数ありの構築は通常通り placement new で行う
+  template <typename U, typename... Args>
+  void construct(U* ptr, Args&&... args) {
+    ::new (static_cast<void*>(ptr)) U(std::forward<Args>(args)...);
+  }
+};
+}  // namespace detail
+
+/**
+ * @brief 置換表のような巨大な配列を、内容を保ったままサイズ変更できるように管理するクラス
+ * @tparam T 要素型
+ *
+ * `std::vector` のサイズ変更は「新しい領域の確保 → 要素のコピー → 古い領域の解放」の順に行われるので、一時的に
+ * 新旧両方の領域が必要になる。置換表のように搭載メモリの大部分を占める配列ではこれが許容できないので、Linux では
+ * `mmap()` で確保した領域を `mremap()` で伸縮させる。`mremap()` はページテーブルを付け替えるだけなので、
+ * 要素のコピーも新旧領域の同時確保も発生しない。それ以外の環境では `std::vector` と同様にコピーする。
+ *
+ * また、`AttachShared()` により名前付きの POSIX 共有メモリ上に配列を置き、複数のプロセスから同じ配列を
+ * 読み書きすることもできる。
+ *
+ * `SetPlacement()` で Huge Pages や NUMA ノードへの配置方針を指定すると、以降に確保する領域に適用する。
+ *
+ * 要素の構築・破棄は行わない。要素はビット単位で移動されるので、`T` は自身のアドレスに依存しない型でなければならない。
+ */
+template <typename T>
+class LargeArray {
+  static_assert(std::is_trivially_destructible_v<T>, "T must be trivially destructible");
+
+ public:
+  /// Default constructor(default)
+  LargeArray() = default;
+  /// Copy constructor(delete)
+  LargeArray(const LargeArray&) = delete;
+  /// Move constructor
+  LargeArray(LargeArray&& rhs) noexcept { Swap(rhs); }
+  /// Copy assign operator(delete)
+  LargeArray& operator=(const LargeArray&) = delete;
+  /// Move assign operator
+  LargeArray& operator=(LargeArray&& rhs) noexcept {
+    LargeArray tmp{std::move(rhs)};
+    Swap(tmp);
+    return *this;
+  }
+  /// Destructor
+  ~LargeArray() { Release(); }
+
+  /// 要素数
+  std::size_t size() const noexcept { return size_; }
+  /// 名前付き共有メモリ上の配列かどうか
+  bool IsShared() const noexcept { return shared_; }
+  /// 領域の配置方針
+  const MemoryPlacement& Placement() const noexcept { return placement_; }
+
+  /**
+   * @brief 領域の配置方針を `placement` に変更する
+   * @param placement 新しい配置方針
+   *
+   * 配置方針は領域を確保するときに適用するので、方針が変わった場合は今の領域を解放する。要素は引き継がない。
+   */
+  void SetPlacement(const MemoryPlacement& placement) noexcept {
+    if (placement_ != placement) {
+      Release();
+      placement_ = placement;
+    }
+  }
+  /// 先頭要素へのポインタ
+  T* data() noexcept { return data_; }
+  /// 先頭要素へのポインタ
+  const T* data() const noexcept { return data_; }
+  /// 先頭要素へのポインタ
+  T* begin() noexcept { return data_; }
+  /// 先頭要素へのポインタ
+  const T* begin() const noexcept { return data_; }
+  /// 末尾要素の次へのポインタ
+  T* end() noexcept { return data_ + size_; }
+  /// 末尾要素の次へのポインタ
+  const T* end() const noexcept { return data_ + size_; }
+  /// `i` 番目の要素
+  T& operator[](std::size_t i) noexcept { return data_[i]; }
+  /// `i` 番目の要素
+  const T& operator[](std::size_t i) const noexcept { return data_[i]; }
+
+  /**
+   * @brief 要素数を `new_size` に変更する
+   * @param new_size 新しい要素数
+   *
+   * 先頭 `min(size(), new_size)` 個の要素はビット単位でそのまま引き継ぐ。増えた要素は構築しないので、
+   * 呼び出し元で構築すること。
+   *
+   * 共有メモリに接続している場合は、接続を切ってから新しい領域を確保する。このとき、要素は引き継がない。
+   */
+  void Reallocate(std::size_t new_size) {
+    if (shared_) {
+      Release();
+    }
+
+    if (new_size == size_) {
+      return;
+    } else if (new_size == 0) {
+      Release();
+      return;
+    }
+
+    const auto old_bytes = size_ * sizeof(T);
+    const auto new_bytes = new_size * sizeof(T);
+#if defined(__linux__)
+    void* ptr = MAP_FAILED;
+    if (data_ == nullptr) {
+      ptr = ::mmap(nullptr, new_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    } else if (mapped_) {
+      ptr = ::mremap(data_, old_bytes, new_bytes, MREMAP_MAYMOVE);
+    }
+
+    if (ptr != MAP_FAILED) {
+      PlaceMemory(ptr, new_bytes, placement_);
+      data_ = static_cast<T*>(ptr);
+      size_ = new_size;
+      mapped_ = true;
+      return;
+    }
+#endif  // defined(__linux__)
+
+    // mmap() が使えない場合は新しい領域へコピーする
+    auto* const new_data = static_cast<T*>(::operator new(new_bytes, std::align_val_t{alignof(T)}));
+    if (data_ != nullptr) {
+      std::memcpy(static_cast<void*>(new_data), static_cast<const void*>(data_), std::min(old_bytes, new_bytes));
+    }
+    Release();
+    data_ = new_data;
+    size_ = new_size;
+  }
+
+  /**
+   * @brief POSIX 共有メモリ `name` 上に要素数 `size` の配列を確保する
+   * @param name 共有メモリの名前（`/` から始まる文字列）
+   * @param size 要素数。すでに他プロセスが共有メモリを作っていた場合は無視し、既存の要素数を使う。
+   * @param init 共有メモリを新しく作ったときに `init(data, size)` で配列を構築する
+   * @param layout 要素のレイアウトを表す値
+   * @return 接続に成功したら `true`
+   *
+   * 同じ名前で接続したプロセス同士は同じ配列を読み書きする。配列の構築は最初に共有メモリを作ったプロセスだけが行い、
+   * 他のプロセスは構築が終わるまで待つ。要素の排他制御は呼び出し元の責任で行うこと。
+   *
+   * 既存の共有メモリの要素のサイズや `layout` が異なる場合は接続しない。
+   *
+   * 共有メモリはすべてのプロセスが接続を切った後も残り続ける。不要になったら `RemoveShared()` で削除すること。
+   * Linux 以外の環境では常に失敗する。
+   */
+  template <typename InitFunc>
+  bool AttachShared(const std::string& name, std::size_t size, InitFunc&& init, std::uint64_t layout = 0) {
+    Release();
+#if defined(__linux__)
+    using detail::SharedHeader;
+    const auto total_bytes = [](std::size_t n) { return detail::kSharedHeaderBytes + n * sizeof(T); };
+
+    int fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    const bool creator = (fd >= 0);
+    if (creator) {
+      if (::ftruncate(fd, static_cast<off_t>(total_bytes(size))) != 0) {
+        ::close(fd);
+        ::shm_unlink(name.c_str());
+        return false;
+      }
+    } else {
+      fd = ::shm_open(name.c_str(), O_RDWR, 0600);
+      if (fd < 0) {
+        return false;
+      }
+
+      // 作成したプロセスが初期化を終えるまで待ち、既存の要素数を読む
+      const auto header = WaitShared(fd, layout);
+      if (!header) {
+        ::close(fd);
+        return false;
+      }
+      size = *header;
+    }
+
+    void* ptr = ::mmap(nullptr, total_bytes(size), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (ptr == MAP_FAILED) {
+      if (creator) {
+        ::shm_unlink(name.c_str());
+      }
+      return false;
+    }
+
+    if (creator) {
+      PlaceMemory(ptr, total_bytes(size), placement_);
+    }
+    auto* const header = static_cast<SharedHeader*>(ptr);
+    data_ = reinterpret_cast<T*>(static_cast<std::uint8_t*>(ptr) + detail::kSharedHeaderBytes);
+    size_ = size;
+    mapped_ = true;
+    shared_ = true;
+    if (creator) {
+      init(data_, size_);
+      header->element_size = sizeof(T);
+      header->size = size_;
+      header->layout = layout;
+      header->maintenance.store(0, std::memory_order_relaxed);
+      header->ready.store(detail::kSharedReadyMagic, std::memory_order_release);
+    }
+    return true;
+#else   // defined(__linux__)
+    static_cast<void>(name);
+    static_cast<void>(size);
+    static_cast<void>(init);
+    static_cast<void>(layout);
+    return false;
+#endif  // defined(__linux__)
+  }
+
+  /**
+   * @brief POSIX 共有メモリ `name` を削除する
+   * @param name 共有メモリの名前
+   *
+   * 接続中のプロセスは削除後も今の配列を使い続けられる。次に `AttachShared()` したプロセスは新しい配列を作る。
+   */
+  static void RemoveShared(const std::string& name) noexcept {
+#if defined(__linux__)
+    ::shm_unlink(name.c_str());
+#else   // defined(__linux__)
+    static_cast<void>(name);
+#endif  // defined(__linux__)
+  }
+
+  /**
+   * @brief 配列全体を書き換える処理の権利を取得する
+   * @param lease 他のプロセスの権利を期限切れとみなすまでの時間
+   * @return 取得できたら `true`
+   *
+   * 共有メモリ上の配列では、接続中のプロセスのうち 1 つだけが権利を取得できる。`lease` の間更新されていない権利は、
+   * 持ち主が終了したか止まっているとみなして引き継ぐ。共有メモリ上の配列でなければ常に `true` を返す。
+   *
+   * 取得できたら、処理中は `lease` より短い間隔で `RefreshMaintenance()` を呼び、処理を終えた後に
+   * `UnlockMaintenance()` を呼ぶこと。
+   */
+  bool TryLockMaintenance(std::chrono::milliseconds lease = detail::kMaintenanceLease) noexcept {
+#if defined(__linux__)
+    if (!shared_) {
+      return true;
+    }
+
+    auto& maintenance = Header()->maintenance;
+    const auto claim = detail::MakeMaintenanceClaim();
+    auto current = maintenance.load(std::memory_order_relaxed);
+    for (;;) {
+      if (current != 0 && !detail::IsMaintenanceExpired(current, claim, lease)) {
+        // 他のプロセスが処理中
+        return false;
+      }
+
+      if (maintenance.compare_exchange_weak(current, claim, std::memory_order_acquire, std::memory_order_relaxed)) {
+        maintenance_claim_ = claim;
+        return true;
+      }
+    }
+#else   // defined(__linux__)
+    static_cast<void>(lease);
+    return true;
+#endif  // defined(__linux__)
+  }
+
+  /**
+   * @brief `TryLockMaintenance()` で取得した権利の時刻を更新し、他のプロセスに引き継がれないようにする
+   * @return 権利を持ち続けていれば `true`。期限切れで他のプロセスに引き継がれていたら `false`。
+   */
+  bool RefreshMaintenance() noexcept {
+#if defined(__linux__)
+    if (!shared_) {
+      return true;
+    } else if (maintenance_claim_ == 0) {
+      return false;
+    }
+
+    const auto claim = detail::MakeMaintenanceClaim();
+    auto expected = maintenance_claim_;
+    if (claim == expected) {
+      return true;
+    } else if (!Header()->maintenance.compare_exchange_strong(expected, claim, std::memory_order_relaxed)) {
+      maintenance_claim_ = 0;
+      return false;
+    }
+    maintenance_claim_ = claim;
+#endif  // defined(__linux__)
+    return true;
+  }
+
+  /// `TryLockMaintenance()` で取得した権利を手放す。他のプロセスに引き継がれていた場合は何もしない。
+  void UnlockMaintenance() noexcept {
+#if defined(__linux__)
+    if (shared_ && maintenance_claim_ != 0) {
+      auto expected = maintenance_claim_;
+      Header()->maintenance.compare_exchange_strong(expected, 0, std::memory_order_release, std::memory_order_relaxed);
+      maintenance_claim_ = 0;
+    }
+#endif  // defined(__linux__)
+  }
+
+  /// 領域を解放する
+  void Release() noexcept {
+    if (data_ == nullptr) {
+      return;
+    }
+
+#if defined(__linux__)
+    if (shared_) {
+      ::munmap(reinterpret_cast<std::uint8_t*>(data_) - detail::kSharedHeaderBytes,
+               detail::kSharedHeaderBytes + size_ * sizeof(T));
+    } else if (mapped_) {
+      ::munmap(data_, size_ * sizeof(T));
+    }
+#endif  // defined(__linux__)
+    if (!mapped_) {
+      ::operator delete(data_, std::align_val_t{alignof(T)});
+    }
+    data_ = nullptr;
+    size_ = 0;
+    mapped_ = false;
+    shared_ = false;
+  }
+
+ private:
+#if defined(__linux__)
+  /// 共有メモリ上の配列のヘッダ
+  detail::SharedHeader* Header() const noexcept {
+    return reinterpret_cast<detail::SharedHeader*>(reinterpret_cast<std::uint8_t*>(data_) - detail::kSharedHeaderBytes);
+  }
+
+  /**
+   * @brief 共有メモリ `fd` の初期化が終わるまで待つ
+   * @param fd     共有メモリ
+   * @param layout 要素のレイアウトを表す値
+   * @return 初期化済みの要素数。タイムアウトした場合や要素のサイズ・レイアウトが異なる場合は `std::nullopt`。
+   */
+  static std::optional<std::size_t> WaitShared(int fd, std::uint64_t layout) {
+    using detail::SharedHeader;
+    const auto deadline = std::chrono::steady_clock::now() + detail::kSharedInitTimeout;
+    const auto wait = [&deadline]() {
+      std::this_thread::sleep_for(std::chrono::milliseconds{1});
+      return std::chrono::steady_clock::now() < deadline;
+    };
+
+    // ftruncate() される前に mmap() するとヘッダに触れた時点で SIGBUS になるので、サイズが確定するまで待つ
+    struct stat st {};
+    while (::fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < detail::kSharedHeaderBytes) {
+      if (!wait()) {
+        return std::nullopt;
+      }
+    }
+
+    void* ptr = ::mmap(nullptr, detail::kSharedHeaderBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (ptr == MAP_FAILED) {
+      return std::nullopt;
+    }
+
+    const auto* header = static_cast<const SharedHeader*>(ptr);
+    std::optional<std::size_t> size;
+    for (;;) {
+      if (header->ready.load(std::memory_order_acquire) == detail::kSharedReadyMagic) {
+        if (header->element_size == sizeof(T) && header->layout == layout) {
+          size = header->size;
+        }
+        break;
+      }
+
+      if (!wait()) {
+        break;
+      }
+    }
+    ::munmap(ptr, detail::kSharedHeaderBytes);
+    return size;
+  }
+#endif  // defined(__linux__)
+
+  /// `rhs` と中身を交換する
+  void Swap(LargeArray& rhs) noexcept {
+    std::swap(data_, rhs.data_);
+    std::swap(size_, rhs.size_);
+    std::swap(mapped_, rhs.mapped_);
+    std::swap(shared_, rhs.shared_);
+    std::swap(placement_, rhs.placement_);
+    std::swap(maintenance_claim_, rhs.maintenance_claim_);
+  }
+
+  T* data_{nullptr};             ///< 先頭要素へのポインタ
+  std::size_t size_{0};          ///< 要素数
+  bool mapped_{false};           ///< `data_` を `mmap()` で確保したかどうか
+  bool shared_{false};           ///< `data_` が名前付き共有メモリ上にあるかどうか
+  MemoryPlacement placement_{};  ///< 領域の配置方針
+  /// `TryLockMaintenance()` で取得した権利の値。権利を持っていなければ 0。
+  std::uint64_t maintenance_claim_{0};
+};
+}  // namespace komori
+
+#endif  // KOMORI_TABLE_MEMORY_HPP_
@@ -0,0 +1,62 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "../checkpoint_thread.hpp"
+
+using komori::CheckpointThread;
+
+TEST(CheckpointThread, RunPeriodically) {
+  CheckpointThread thread{};
+  std::atomic<int> count{0};
+
+  thread.Start(10, [&count]() { count++; });
+  EXPECT_TRUE(thread.IsRunning());
+  std::this_thread::sleep_for(std::chrono::milliseconds(105));
+  thread.Stop();
+  EXPECT_FALSE(thread.IsRunning());
+
+  const auto stopped_count = count.load();
+  EXPECT_GE(stopped_count, 5);
+  EXPECT_LE(stopped_count, 11);
+
+  // Stop() 後は呼ばれない
+  std::this_thread::sleep_for(std::chrono::milliseconds(30));
+  EXPECT_EQ(count.load(), stopped_count);
+}
+
+TEST(CheckpointThread, StopWithoutWaitingInterval) {
+  CheckpointThread thread{};
+  std::atomic<int> count{0};
+
+  thread.Start(100000, [&count]() { count++; });
+  const auto start = std::chrono::steady_clock::now();
+  thread.Stop();
+  const auto elapsed =
+      std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+
+  EXPECT_LT(elapsed, 100);
+  EXPECT_EQ(count.load(), 0);
+}
+
+TEST(CheckpointThread, Restart) {
+  CheckpointThread thread{};
+  std::atomic<int> count1{0};
+  std::atomic<int> count2{0};
+
+  thread.Start(100000, [&count1]() { count1++; });
+  thread.Start(10, [&count2]() { count2++; });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  thread.Stop();
+
+  EXPECT_EQ(count1.load(), 0);
+  EXPECT_GT(count2.load(), 0);
+}
+
+TEST(CheckpointThread, StopNotStarted) {
+  CheckpointThread thread{};
+  EXPECT_FALSE(thread.IsRunning());
+  thread.Stop();
+  EXPECT_FALSE(thread.IsRunning());
+}
@@ -0,0 +1,296 @@
+#include <gtest/gtest.h>
+
+#if !defined(_WIN32)
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <variant>
+#include <vector>
+
+#include "../cluster.hpp"
+#include "test_lib.hpp"
+
+using komori::ClusterCoordinator;
+using komori::ClusterFrontier;
+using komori::ClusterJob;
+using komori::ClusterResult;
+using komori::ClusterWorker;
+using komori::kInfinitePnDn;
+using komori::NodeState;
+
+namespace {
+/// 別スレッドで待ち受けるワーカー
+class TestWorker {
+ public:
+  explicit TestWorker(const std::string& address,
+                      ClusterWorker::SolveFunc solve,
+                      ClusterWorker::CancelFunc cancel = {}) {
+    listening_ = worker_.Listen(address);
+    thread_ = std::thread(
+        [this, solve = std::move(solve), cancel = std::move(cancel)]() { worker_.Serve(solve, cancel); });
+  }
+  TestWorker(const TestWorker&) = delete;
+  TestWorker(TestWorker&&) = delete;
+  TestWorker& operator=(const TestWorker&) = delete;
+  TestWorker& operator=(TestWorker&&) = delete;
+  ~TestWorker() {
+    worker_.Stop();
+    thread_.join();
+  }
+
+  bool IsListening() const { return listening_; }
+  const std::string& Address() const { return worker_.Address(); }
+
+ private:
+  ClusterWorker worker_;
+  bool listening_{false};
+  std::thread thread_;
+};
+
+/// ジョブの sfen 欄に葉番号を入れて、ワーカー側で取り出せるようにする
+ClusterJob MakeTestJob(std::uint32_t leaf, std::uint64_t time_ms) {
+  return ClusterJob{0, time_ms, true, std::to_string(leaf)};
+}
+}  // namespace
+
+TEST(Cluster, JobFormat) {
+  const ClusterJob job{334, 1000, false, "4k4/9/4P4/9/9/9/9/9/9 b G2r2b3g4s4n4l17p 1"};
+  const auto line = komori::FormatClusterJob(job);
+  EXPECT_EQ(line, "job 334 1000 and 4k4/9/4P4/9/9/9/9/9/9 b G2r2b3g4s4n4l17p 1");
+
+  const auto parsed = komori::ParseClusterJob(line);
+  ASSERT_TRUE(parsed.has_value());
+  EXPECT_EQ(parsed->id, 334);
+  EXPECT_EQ(parsed->time_ms, 1000);
+  EXPECT_FALSE(parsed->or_node);
+  EXPECT_EQ(parsed->sfen, job.sfen);
+
+  EXPECT_FALSE(komori::ParseClusterJob("job 334 1000 or").has_value());
+  EXPECT_FALSE(komori::ParseClusterJob("job 334 1000 xor 4k4/9/9/9/9/9/9/9/9 b - 1").has_value());
+  EXPECT_FALSE(komori::ParseClusterJob("result 334 1000 or 4k4/9/9/9/9/9/9/9/9 b - 1").has_value());
+}
+
+TEST(Cluster, ResultFormat) {
+  const ClusterResult result{264, 0, kInfinitePnDn, MakeHand<PAWN, LANCE>(), 13, 2604};
+  const auto parsed = komori::ParseClusterResult(komori::FormatClusterResult(result));
+  ASSERT_TRUE(parsed.has_value());
+  EXPECT_EQ(parsed->id, 264);
+  EXPECT_EQ(parsed->pn, 0);
+  EXPECT_EQ(parsed->dn, kInfinitePnDn);
+  EXPECT_EQ(parsed->hand, (MakeHand<PAWN, LANCE>()));
+  EXPECT_EQ(parsed->len, 13);
+  EXPECT_EQ(parsed->amount, 2604);
+
+  EXPECT_FALSE(komori::ParseClusterResult("result 264 0 1 0 13").has_value());
+  EXPECT_FALSE(komori::ParseClusterResult("job 264 0 1 0 13 2604").has_value());
+}
+
+TEST(Cluster, ParseClusterWorkers) {
+  EXPECT_EQ(komori::ParseClusterWorkers(""), std::vector<std::string>{});
+  EXPECT_EQ(komori::ParseClusterWorkers("4091, localhost:4092,,unix:/tmp/kh.sock "),
+            (std::vector<std::string>{"4091", "localhost:4092", "unix:/tmp/kh.sock"}));
+}
+
+TEST(ClusterFrontier, MostProvingFirst) {
+  // root(OR) -+- a(AND) -+- a0 (pn=2, dn=2)
+  //           |          +- a1 (pn=6, dn=2)
+  //           +- b(AND) -+- b0 (pn=2, dn=2)
+  ClusterFrontier frontier;
+  const auto root = frontier.AddNode(ClusterFrontier::kNoParent, true, 1, 1);
+  const auto a = frontier.AddNode(root, false, 1, 1);
+  const auto a0 = frontier.AddNode(a, true, 2, 2);
+  const auto a1 = frontier.AddNode(a, true, 6, 2);
+  const auto b = frontier.AddNode(root, false, 1, 1);
+  const auto b0 = frontier.AddNode(b, true, 2, 2);
+
+  // b の pn は 2、a の pn は 8 なので b0 が most-proving node
+  EXPECT_EQ(frontier.Next(), b0);
+  EXPECT_EQ(frontier.Pn(root), 2);
+  EXPECT_EQ(frontier.Dn(root), 4);
+  EXPECT_TRUE(frontier.HasInFlight());
+
+  // b0 が配られている間は、次に近い a0 を配る
+  EXPECT_EQ(frontier.Next(), a0);
+  EXPECT_EQ(frontier.Next(), a1);
+  EXPECT_EQ(frontier.Next(), std::nullopt);
+
+  // b0 が不詰なら b も不詰。a の子はどちらも再び配る対象になる。
+  frontier.Update(b0, kInfinitePnDn, 0);
+  frontier.Release(a0);
+  frontier.Release(a1);
+  EXPECT_EQ(frontier.Dn(b), 0);
+  EXPECT_EQ(frontier.RootState(), NodeState::kUnknown);
+  EXPECT_EQ(frontier.Next(), a0);
+
+  frontier.Update(a0, 0, kInfinitePnDn);
+  EXPECT_EQ(frontier.RootState(), NodeState::kUnknown);
+  EXPECT_EQ(frontier.Pn(root), 6);
+  frontier.Update(a1, 0, kInfinitePnDn);
+  EXPECT_EQ(frontier.RootState(), NodeState::kProven);
+  EXPECT_FALSE(frontier.HasInFlight());
+  EXPECT_EQ(frontier.Next(), std::nullopt);
+}
+
+TEST(ClusterFrontier, SkipResolvedSubtree) {
+  ClusterFrontier frontier;
+  const auto root = frontier.AddNode(ClusterFrontier::kNoParent, false, 1, 1);
+  const auto a = frontier.AddNode(root, true, 1, 1);
+  const auto a0 = frontier.AddNode(a, false, 2, 2);
+  frontier.AddNode(a, false, 4, 2);
+  const auto b = frontier.AddNode(root, true, 1, 1);
+  frontier.AddNode(b, false, 0, kInfinitePnDn);
+  frontier.AddNode(root, true, 4, 4);
+
+  // b は最初から詰んでいるので、b 以下は配らない
+  EXPECT_EQ(frontier.Next(), a0);
+  frontier.Update(a0, 0, kInfinitePnDn);
+  EXPECT_EQ(frontier.Pn(b), 0);
+  EXPECT_EQ(frontier.Pn(root), 4);
+}
+
+TEST(ClusterCoordinator, SeveralLocalWorkers) {
+  // 偶数番目の葉はすぐに、奇数番目の葉は探索時間を倍にすると解けるワーカー
+  constexpr std::uint32_t kNumLeaves = 12;
+  constexpr std::uint64_t kJobTime = 100;
+  std::atomic<int> served[4]{};
+  const auto make_solve = [&](int worker) {
+    return [&, worker](const ClusterJob& job) {
+      served[worker]++;
+      std::this_thread::sleep_for(std::chrono::milliseconds{5});
+      const auto leaf = std::stoul(job.sfen);
+      if (leaf % 2 == 1 && job.time_ms < 2 * kJobTime) {
+        return ClusterResult{job.id, 10, 10, HAND_ZERO, 0, 1};
+      }
+      return ClusterResult{job.id, 0, kInfinitePnDn, static_cast<Hand>(leaf), static_cast<std::uint32_t>(leaf), 1};
+    };
+  };
+
+  const auto unix_path = ::testing::TempDir() + "kh-cluster-test-" + std::to_string(::getpid()) + ".sock";
+  std::vector<std::unique_ptr<TestWorker>> workers;
+  for (int i = 0; i < 3; ++i) {
+    workers.push_back(std::make_unique<TestWorker>("127.0.0.1:0", make_solve(i)));
+  }
+  workers.push_back(std::make_unique<TestWorker>("unix:" + unix_path, make_solve(3)));
+
+  ClusterCoordinator coordinator;
+  for (const auto& worker : workers) {
+    ASSERT_TRUE(worker->IsListening());
+    ASSERT_TRUE(coordinator.Connect(worker->Address())) << worker->Address();
+  }
+  EXPECT_FALSE(coordinator.Connect("127.0.0.1:1"));
+  EXPECT_EQ(coordinator.Size(), 4);
+
+  // すべての葉が詰めば root（AND node）も詰む
+  ClusterFrontier frontier;
+  const auto root = frontier.AddNode(ClusterFrontier::kNoParent, false, 1, 1);
+  for (std::uint32_t i = 0; i < kNumLeaves; ++i) {
+    frontier.AddNode(root, true, 2 + i, 2);
+  }
+
+  std::vector<int> solved(frontier.Size());
+  const auto make_job = [&](std::uint32_t leaf, std::uint32_t trial) -> std::variant<ClusterJob, ClusterResult> {
+    return MakeTestJob(leaf - 1, kJobTime << trial);
+  };
+  const auto on_result = [&](std::uint32_t leaf, const ClusterResult& result) {
+    if (result.pn == 0) {
+      EXPECT_EQ(static_cast<std::uint32_t>(result.hand), leaf - 1);
+      solved[leaf]++;
+    }
+  };
+  const auto received = coordinator.Run(frontier, make_job, on_result, []() { return false; });
+
+  EXPECT_EQ(frontier.RootState(), NodeState::kProven);
+  EXPECT_EQ(received, kNumLeaves + kNumLeaves / 2);
+  for (std::uint32_t leaf = 1; leaf <= kNumLeaves; ++leaf) {
+    EXPECT_EQ(solved[leaf], 1) << leaf;
+  }
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_GT(served[i].load(), 0) << i;
+  }
+}
+
+TEST(ClusterCoordinator, KnownResultAndBrokenWorker) {
+  // 1 つ目のワーカーはジョブ番号を取り違えるので切り離され、そのジョブは 2 つ目のワーカーが解き直す
+  std::atomic<int> broken_served{0};
+  TestWorker broken{"127.0.0.1:0", [&](const ClusterJob& job) {
+                      broken_served++;
+                      return ClusterResult{job.id + 1, 0, kInfinitePnDn, HAND_ZERO, 1, 1};
+                    }};
+  TestWorker good{"127.0.0.1:0", [](const ClusterJob& job) {
+                    return ClusterResult{job.id, kInfinitePnDn, 0, HAND_ZERO, 0, 1};
+                  }};
+
+  ClusterCoordinator coordinator;
+  ASSERT_TRUE(coordinator.Connect(broken.Address()));
+  ASSERT_TRUE(coordinator.Connect(good.Address()));
+
+  // root（OR node）の子はすべて不詰。そのうち 1 つは手元で結果が分かっている。
+  ClusterFrontier frontier;
+  const auto root = frontier.AddNode(ClusterFrontier::kNoParent, true, 1, 1);
+  const auto known = frontier.AddNode(root, false, 2, 2);
+  for (int i = 0; i < 3; ++i) {
+    frontier.AddNode(root, false, 4, 4);
+  }
+
+  std::uint64_t jobs = 0;
+  const auto make_job = [&](std::uint32_t leaf, std::uint32_t /* trial */) -> std::variant<ClusterJob, ClusterResult> {
+    if (leaf == known) {
+      return ClusterResult{0, kInfinitePnDn, 0, HAND_ZERO, 0, 1};
+    }
+    jobs++;
+    return MakeTestJob(leaf, 100);
+  };
+  const auto received =
+      coordinator.Run(frontier, make_job, [](std::uint32_t, const ClusterResult&) {}, []() { return false; });
+
+  EXPECT_EQ(frontier.RootState(), NodeState::kDisproven);
+  EXPECT_EQ(received, 3);
+  EXPECT_EQ(jobs, received + broken_served.load());
+  EXPECT_LE(broken_served.load(), 1);
+  EXPECT_EQ(coordinator.Size(), broken_served.load() == 0 ? 2U : 1U);
+}
+
+TEST(ClusterCoordinator, StopWhileWaiting) {
+  // 打ち切られるまで（最大 30 秒）結果を返さないワーカー
+  std::atomic_bool cancelled{false};
+  TestWorker slow{"127.0.0.1:0",
+                  [&](const ClusterJob& job) {
+                    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{30};
+                    while (!cancelled && std::chrono::steady_clock::now() < deadline) {
+                      std::this_thread::sleep_for(std::chrono::milliseconds{10});
+                    }
+                    return ClusterResult{job.id, 10, 10, HAND_ZERO, 0, 1};
+                  },
+                  [&]() { cancelled = true; }};
+
+  ClusterCoordinator coordinator;
+  ASSERT_TRUE(coordinator.Connect(slow.Address()));
+
+  ClusterFrontier frontier;
+  const auto root = frontier.AddNode(ClusterFrontier::kNoParent, true, 1, 1);
+  frontier.AddNode(root, false, 1, 1);
+
+  const auto start = std::chrono::steady_clock::now();
+  const auto should_stop = [&]() { return std::chrono::steady_clock::now() - start > std::chrono::milliseconds{200}; };
+  const auto received = coordinator.Run(
+      frontier, [](std::uint32_t leaf, std::uint32_t) { return MakeTestJob(leaf, 30 * 1000); },
+      [](std::uint32_t, const ClusterResult&) {}, should_stop);
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+
+  EXPECT_EQ(received, 0);
+  EXPECT_EQ(frontier.RootState(), NodeState::kUnknown);
+  EXPECT_LT(elapsed, std::chrono::seconds{5});
+  EXPECT_EQ(coordinator.Size(), 0);
+
+  // コーディネータの cancel がワーカーの探索を打ち切らせる
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{5};
+  while (!cancelled && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds{10});
+  }
+  EXPECT_TRUE(cancelled.load());
+}
+#endif  // !defined(_WIN32)
@@ -0,0 +1,72 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <array>
+#include <random>
+
+#include "../delta_tree.hpp"
+
+using komori::DeltaTree;
+using komori::PnDn;
+
+TEST(DeltaTreeTest, Build) {
+  DeltaTree<10> tree;
+  tree.Reset(5);
+  tree.SetLeaf(0, 3, 0);
+  tree.SetLeaf(1, 0, 34);
+  tree.SetLeaf(3, 4, 0);
+  tree.SetLeaf(4, 0, 26);
+  tree.Build();
+
+  EXPECT_EQ(tree.Total().sum, 7);
+  EXPECT_EQ(tree.Total().max, 34);
+  EXPECT_EQ(tree.TotalExcept(0).sum, 4);
+  EXPECT_EQ(tree.TotalExcept(1).max, 26);
+  EXPECT_EQ(tree.TotalExcept(2).sum, 7);
+  EXPECT_EQ(tree.TotalExcept(2).max, 34);
+}
+
+TEST(DeltaTreeTest, Empty) {
+  DeltaTree<10> tree;
+  tree.Reset(0);
+  tree.Build();
+
+  EXPECT_EQ(tree.Total().sum, 0);
+  EXPECT_EQ(tree.Total().max, 0);
+}
+
+TEST(DeltaTreeTest, RandomUpdate) {
+  constexpr std::size_t kSize = 77;
+  std::array<PnDn, kSize> sums{};
+  std::array<PnDn, kSize> maxs{};
+  DeltaTree<110> tree;
+  tree.Reset(kSize);
+  tree.Build();
+
+  std::mt19937_64 mt(334);
+  for (int t = 0; t < 10000; ++t) {
+    const auto i = mt() % kSize;
+    if (mt() % 2 == 0) {
+      sums[i] = mt() % 1000;
+      maxs[i] = 0;
+    } else {
+      sums[i] = 0;
+      maxs[i] = mt() % 1000;
+    }
+    tree.Update(i, sums[i], maxs[i]);
+
+    const auto j = mt() % kSize;
+    PnDn sum = 0;
+    PnDn max = 0;
+    for (std::size_t k = 0; k < kSize; ++k) {
+      if (k != j) {
+        sum += sums[k];
+        max = std::max(max, maxs[k]);
+      }
+    }
+    ASSERT_EQ(tree.TotalExcept(j).sum, sum);
+    ASSERT_EQ(tree.TotalExcept(j).max, max);
+    ASSERT_EQ(tree.Total().sum, sum + sums[j]);
+    ASSERT_EQ(tree.Total().max, std::max(max, maxs[j]));
+  }
+}
@@ -0,0 +1,78 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include "../deterministic_scheduler.hpp"
+
+using komori::DeterministicScheduler;
+
+namespace {
+/**
+ * @brief `num_threads` 個のスレッドで `DeterministicScheduler` を使い、各スレッドが局面を訪れた順番を返す
+ * @param quantum  1 回の順番で探索する局面数
+ * @param visits   スレッドごとの訪問局面数
+ */
+std::vector<std::uint32_t> RunThreads(std::uint64_t quantum, const std::vector<int>& visits) {
+  DeterministicScheduler scheduler;
+  const auto num_threads = static_cast<std::uint32_t>(visits.size());
+  scheduler.Start(num_threads, quantum);
+
+  // 順番を持つスレッドしか書き込まないので、ロックは要らない
+  std::vector<std::uint32_t> order;
+  std::vector<std::thread> threads;
+  // 番号の大きいスレッドから起動しても順番は変わらない
+  for (std::uint32_t i = num_threads; i-- > 0;) {
+    threads.emplace_back([&, i]() {
+      scheduler.Enter(i);
+      for (int j = 0; j < visits[i]; ++j) {
+        order.push_back(i);
+        scheduler.Tick(i);
+      }
+      scheduler.Leave(i);
+    });
+  }
+  for (auto& th : threads) {
+    th.join();
+  }
+  return order;
+}
+}  // namespace
+
+TEST(DeterministicSchedulerTest, RoundRobin) {
+  const auto order = RunThreads(2, {3, 5, 4});
+  const std::vector<std::uint32_t> expected{0, 0, 1, 1, 2, 2, 0, 1, 1, 2, 2, 1};
+  EXPECT_EQ(order, expected);
+}
+
+TEST(DeterministicSchedulerTest, Reproducible) {
+  const std::vector<int> visits{1000, 700, 1300, 10};
+  const auto order = RunThreads(7, visits);
+  for (int i = 0; i < 5; ++i) {
+    EXPECT_EQ(RunThreads(7, visits), order);
+  }
+}
+
+TEST(DeterministicSchedulerTest, Disabled) {
+  DeterministicScheduler scheduler;
+  scheduler.Start(4, 0);
+  EXPECT_FALSE(scheduler.IsEnabled());
+
+  // 順番を待たずにすぐ返る
+  scheduler.Enter(3);
+  for (int i = 0; i < 100; ++i) {
+    scheduler.Tick(3);
+  }
+  scheduler.Leave(3);
+}
+
+TEST(DeterministicSchedulerTest, OutsideThread) {
+  DeterministicScheduler scheduler;
+  scheduler.Start(2, 1);
+  EXPECT_TRUE(scheduler.IsEnabled());
+
+  // 番号が探索スレッド数以上のスレッドは順番を待たない
+  scheduler.Enter(5);
+  scheduler.Tick(5);
+  scheduler.Leave(5);
+}
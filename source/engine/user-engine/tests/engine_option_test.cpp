@@ -3,6 +3,7 @@
 #include "../engine_option.hpp"
 
 using komori::EngineOption;
+using komori::NumaPolicy;
 using komori::PostSearchLevel;
 using komori::ScoreCalculationMethod;
 
@@ -14,6 +15,17 @@ TEST(EngineOptionTest, Init) {
   EXPECT_NE(o.find("PvInterval"), o.end());
   EXPECT_NE(o.find("RootIsAndNodeIfChecked"), o.end());
   EXPECT_NE(o.find("ScoreCalculation"), o.end());
+  EXPECT_NE(o.find("EstimationParamPath"), o.end());
+  EXPECT_NE(o.find("FrontierMatePly"), o.end());
+  EXPECT_NE(o.find("MoveHistory"), o.end());
+  EXPECT_NE(o.find("TTSnapshotPath"), o.end());
+  EXPECT_NE(o.find("TTSnapshotInterval"), o.end());
+  EXPECT_NE(o.find("ProofTreePath"), o.end());
+  EXPECT_NE(o.find("KnownResultsPath"), o.end());
+  EXPECT_NE(o.find("HashLargePages"), o.end());
+  EXPECT_NE(o.find("HashNumaPolicy"), o.end());
+  EXPECT_NE(o.find("PreSolveTime"), o.end());
+  EXPECT_NE(o.find("DeterministicQuantum"), o.end());
 }
 
 TEST(EngineOptionTest, Default) {
@@ -34,6 +46,17 @@ TEST(EngineOptionTest, Default) {
   EXPECT_EQ(op.post_search_level, PostSearchLevel::kMinLength);
   EXPECT_EQ(op.tt_read_path, std::string{});
   EXPECT_EQ(op.tt_write_path, std::string{});
+  EXPECT_EQ(op.estimation_param_path, std::string{});
+  EXPECT_EQ(op.frontier_mate_ply, 1);
+  EXPECT_EQ(op.move_history, false);
+  EXPECT_EQ(op.tt_snapshot_path, std::string{});
+  EXPECT_EQ(op.tt_snapshot_interval, 0);
+  EXPECT_EQ(op.proof_tree_path, std::string{});
+  EXPECT_EQ(op.known_results_path, std::string{});
+  EXPECT_EQ(op.memory_placement.huge_pages, false);
+  EXPECT_EQ(op.memory_placement.numa, NumaPolicy::kNone);
+  EXPECT_EQ(op.pre_solve_time, 0);
+  EXPECT_EQ(op.deterministic_quantum, 0);
 }
 
 TEST(EngineOptionTest, NoInitialization) {
@@ -5,15 +5,17 @@
 
 using komori::ExpansionStack;
 using komori::kDepthMaxMateLen;
+using komori::MoveHistory;
 using komori::tt::TranspositionTable;
 
 TEST(ExpansionStackTest, Emplace) {
   TestNode n("4k4/9/9/9/9/9/9/9/9 b P2r2b4g4s4n4l17p 1", true);
   TranspositionTable tt;
   tt.Resize(1);
+  MoveHistory move_history;
   ExpansionStack expansion_list;
 
-  auto& expansion = expansion_list.Emplace(tt, *n, kDepthMaxMateLen, false);
+  auto& expansion = expansion_list.Emplace(tt, move_history, *n, kDepthMaxMateLen, false, 1);
   EXPECT_EQ(&expansion, &expansion_list.Current());
 }
 
@@ -21,11 +23,12 @@ TEST(ExpansionStackTest, IsEmpty) {
   TestNode n("4k4/9/9/9/9/9/9/9/9 b P2r2b4g4s4n4l17p 1", true);
   TranspositionTable tt;
   tt.Resize(1);
+  MoveHistory move_history;
   ExpansionStack expansion_list;
 
   EXPECT_TRUE(expansion_list.IsEmpty());
 
-  auto& expansion = expansion_list.Emplace(tt, *n, kDepthMaxMateLen, false);
+  auto& expansion = expansion_list.Emplace(tt, move_history, *n, kDepthMaxMateLen, false, 1);
   EXPECT_FALSE(expansion_list.IsEmpty());
 
   expansion_list.Pop();
@@ -36,12 +39,13 @@ TEST(ExpansionStackTest, Root) {
   TestNode n("4k4/9/9/9/9/9/9/9/9 b P2r2b4g4s4n4l17p 1", true);
   TranspositionTable tt;
   tt.Resize(1);
+  MoveHistory move_history;
   ExpansionStack expansion_list;
 
-  auto& expansion1 = expansion_list.Emplace(tt, *n, kDepthMaxMateLen, false);
+  auto& expansion1 = expansion_list.Emplace(tt, move_history, *n, kDepthMaxMateLen, false, 1);
   EXPECT_EQ(&expansion_list.Root(), &expansion1);
 
-  auto& expansion2 = expansion_list.Emplace(tt, *n, kDepthMaxMateLen, false);
+  auto& expansion2 = expansion_list.Emplace(tt, move_history, *n, kDepthMaxMateLen, false, 1);
   EXPECT_EQ(&expansion_list.Root(), &expansion1);
 }
 
@@ -49,12 +53,13 @@ TEST(ExpansionStackTest, Pop) {
   TestNode n("4k4/9/9/9/9/9/9/9/9 b P2r2b4g4s4n4l17p 1", true);
   TranspositionTable tt;
   tt.Resize(1);
+  MoveHistory move_history;
   ExpansionStack expansion_list;
 
-  auto& e1 = expansion_list.Emplace(tt, *n, kDepthMaxMateLen, false);
+  auto& e1 = expansion_list.Emplace(tt, move_history, *n, kDepthMaxMateLen, false, 1);
 
   n->DoMove(make_move_drop(PAWN, SQ_52, BLACK));
-  auto& e2 = expansion_list.Emplace(tt, *n, kDepthMaxMateLen, false);
+  auto& e2 = expansion_list.Emplace(tt, move_history, *n, kDepthMaxMateLen, false, 1);
   EXPECT_EQ(&e2, &expansion_list.Current());
 
   expansion_list.Pop();
@@ -65,9 +70,10 @@ TEST(ExpansionStackTest, Current) {
   TestNode n("4k4/9/9/9/9/9/9/9/9 b P2r2b4g4s4n4l17p 1", true);
   TranspositionTable tt;
   tt.Resize(1);
+  MoveHistory move_history;
   ExpansionStack expansion_list;
 
-  auto& expansion = expansion_list.Emplace(tt, *n, kDepthMaxMateLen, false);
+  auto& expansion = expansion_list.Emplace(tt, move_history, *n, kDepthMaxMateLen, false, 1);
   EXPECT_EQ(&expansion, &expansion_list.Current());
   EXPECT_EQ(&expansion, &const_cast<const ExpansionStack&>(expansion_list).Current());
 }
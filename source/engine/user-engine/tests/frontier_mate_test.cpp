@@ -0,0 +1,87 @@
+#include <gtest/gtest.h>
+
+#include "../frontier_mate.hpp"
+#include "../local_expansion.hpp"
+#include "test_lib.hpp"
+
+using komori::MateLen;
+using komori::detail::CheckMateOddPly;
+using komori::detail::FrontierMateGate;
+
+namespace {
+constexpr char kMate3Sfen[] = "ln1gkg1nl/6+P2/2sppps1p/2p3p2/p8/P1P1P3P/2NP1PP2/3s1KSR1/L1+b2G1NL w R2Pbgp 42";
+constexpr char kMate5Sfen[] = "l2gkg2l/2s3s2/p1nppp1pp/2p3p2/P4P1P1/4n3P/1PPPG1N2/1BKS2+s2/LN3+r3 w RBgl3p 72";
+}  // namespace
+
+TEST(FrontierMate, Mate3Ply) {
+  TestNode n{kMate3Sfen, true};
+  const auto depth = n->GetDepth();
+
+  EXPECT_FALSE(CheckMateOddPly(*n, 1));
+  const auto result = CheckMateOddPly(*n, 3);
+  ASSERT_TRUE(result);
+  const auto [proof_hand, len] = *result;
+  EXPECT_EQ(len, MateLen{3});
+  EXPECT_TRUE(hand_exists(proof_hand, BISHOP));
+  EXPECT_TRUE(hand_is_equal_or_superior(n->OrHand(), proof_hand));
+  // 探索後に局面が元に戻っている
+  EXPECT_EQ(n->GetDepth(), depth);
+}
+
+TEST(FrontierMate, Mate5Ply) {
+  TestNode n{kMate5Sfen, true};
+
+  EXPECT_FALSE(CheckMateOddPly(*n, 3));
+  const auto result = CheckMateOddPly(*n, 5);
+  ASSERT_TRUE(result);
+  EXPECT_EQ(result->second, MateLen{5});
+  EXPECT_TRUE(hand_is_equal_or_superior(n->OrHand(), result->first));
+}
+
+TEST(FrontierMate, CheckObviousFinalOrNode) {
+  TestNode n{kMate3Sfen, true};
+
+  // 1 手詰めしか調べない
+  EXPECT_FALSE(komori::detail::CheckObviousFinalOrNode(*n, MateLen{3}));
+  // 偶数手は 1 小さい奇数手に切り下げる
+  EXPECT_FALSE(komori::detail::CheckObviousFinalOrNode(*n, MateLen{3}, 2));
+
+  // 残り手数が足りない
+  EXPECT_FALSE(komori::detail::CheckObviousFinalOrNode(*n, MateLen{2}, 3));
+  const auto result = komori::detail::CheckObviousFinalOrNode(*n, MateLen{3}, 4);
+
+  ASSERT_TRUE(result);
+  EXPECT_EQ(result->Pn(), 0);
+  EXPECT_EQ(result->Len(), MateLen{3});
+}
+
+TEST(FrontierMateGate, Adaptive) {
+  FrontierMateGate gate{};
+
+  for (std::uint32_t i = 0; i < FrontierMateGate::kWindow; ++i) {
+    EXPECT_TRUE(gate.ShouldProbe());
+    gate.Record(false);
+  }
+  EXPECT_EQ(gate.Interval(), 2);
+
+  // 2 回に 1 回だけ探索する
+  int probe_count = 0;
+  for (int i = 0; i < 10; ++i) {
+    probe_count += gate.ShouldProbe() ? 1 : 0;
+  }
+  EXPECT_EQ(probe_count, 5);
+
+  for (std::uint32_t i = 0; i < FrontierMateGate::kWindow; ++i) {
+    gate.Record(true);
+  }
+  EXPECT_EQ(gate.Interval(), 1);
+}
+
+TEST(FrontierMateGate, MaxInterval) {
+  FrontierMateGate gate{};
+
+  for (std::uint32_t i = 0; i < 100 * FrontierMateGate::kWindow; ++i) {
+    gate.Record(false);
+  }
+  EXPECT_EQ(gate.Interval(), FrontierMateGate::kMaxInterval + 1);
+}
@@ -1,6 +1,7 @@
 #include <gtest/gtest.h>
 
 #include <memory>
+#include <sstream>
 #include <string>
 
 #define USE_DFPN_PLUS
@@ -83,3 +84,46 @@ TEST(InitialEstimationTest, IsSumNode_OrLance) {
   TestNode n10{"8l/9/9/9/9/8P/8K/9/9 w 2r2b4g4s4n3l17p 1", true};
   EXPECT_TRUE(IsSumDeltaNode(*n10, make_move(SQ_11, SQ_16, W_LANCE)));
 }
+
+TEST(InitialEstimationTest, LoadEstimationParameters) {
+  std::istringstream is{
+      "# comment line\n"
+      "or_pn_base 4\n"
+      "\n"
+      "and_bad_dn 10  # trailing comment\n"
+      "pt_value_5 120\n"};
+
+  EXPECT_TRUE(komori::LoadEstimationParameters(is));
+  EXPECT_EQ(komori::detail::g_dfpn_plus_parameters.or_pn_base, 4);
+  EXPECT_EQ(komori::detail::g_dfpn_plus_parameters.and_bad_dn, 10);
+  EXPECT_EQ(komori::detail::g_dfpn_plus_parameters.or_dn_base, komori::detail::DfpnPlusParameters{}.or_dn_base);
+  EXPECT_EQ(komori::detail::g_pt_values[5], 120);
+  EXPECT_EQ(komori::detail::g_pt_values[6], komori::detail::kDefaultPtValues[6]);
+
+  komori::ResetEstimationParameters();
+  EXPECT_EQ(komori::detail::g_dfpn_plus_parameters.or_pn_base, komori::detail::DfpnPlusParameters{}.or_pn_base);
+  EXPECT_EQ(komori::detail::g_pt_values[5], komori::detail::kDefaultPtValues[5]);
+}
+
+TEST(InitialEstimationTest, LoadEstimationParameters_Invalid) {
+  for (const auto* content : {"unknown_param 3\n", "or_pn_base\n", "or_pn_base 0\n", "or_pn_base 3 4\n",
+                              "pt_value_16 10\n", "pt_value_x 10\n", "pt_value_ 10\n"}) {
+    std::istringstream is{content};
+    EXPECT_FALSE(komori::LoadEstimationParameters(is)) << content;
+    EXPECT_EQ(komori::detail::g_dfpn_plus_parameters.or_pn_base, komori::detail::DfpnPlusParameters{}.or_pn_base);
+  }
+}
+
+TEST(InitialEstimationTest, InitBriefEvaluation) {
+  std::istringstream is{"or_defense 8\n"};
+  EXPECT_TRUE(komori::LoadEstimationParameters(is));
+
+  komori::InitBriefEvaluation(0);
+  EXPECT_EQ(komori::detail::tl_dfpn_plus_parameters.or_defense, 8);
+  komori::InitBriefEvaluation(0);
+  EXPECT_EQ(komori::detail::tl_dfpn_plus_parameters.or_defense, 8);
+
+  komori::ResetEstimationParameters();
+  komori::InitBriefEvaluation(0);
+  EXPECT_EQ(komori::detail::tl_dfpn_plus_parameters.or_defense, komori::detail::DfpnPlusParameters{}.or_defense);
+}
@@ -0,0 +1,79 @@
+#include <gtest/gtest.h>
+
+#include "../interposition.hpp"
+#include "test_lib.hpp"
+
+using komori::InterpositionProver;
+using komori::MateLen;
+using komori::SearchResult;
+
+namespace {
+class InterpositionProverTest : public ::testing::Test {
+ protected:
+  void SetUp() override { tt_.Resize(1); }
+
+  /// `n` で `drop` と `recapture` を指した局面を `proof_hand` で詰みとして置換表に書き込む
+  void SetProven(komori::Node& n, Move drop, Move recapture, Hand proof_hand) {
+    n.DoMove(drop);
+    n.DoMove(recapture);
+    auto query = tt_.BuildQuery(n);
+    query.SetResult(SearchResult::MakeFinal<true>(proof_hand, MateLen{3}, 10));
+    n.UndoMove();
+    n.UndoMove();
+  }
+
+  komori::tt::TranspositionTable tt_;
+};
+}  // namespace
+
+TEST_F(InterpositionProverTest, ProveSiblingDrop) {
+  TestNode n{"4k4/9/9/9/9/9/9/9/4R4 w Gpsnl 1", false};
+  SetProven(*n, make_move_drop(PAWN, SQ_55, WHITE), make_move(SQ_59, SQ_55, B_ROOK), MakeHand<GOLD>());
+
+  const InterpositionProver prover{tt_, *n};
+  const auto res = prover.Prove(make_move_drop(SILVER, SQ_55, WHITE), MateLen{4});
+  ASSERT_TRUE(res.has_value());
+  EXPECT_EQ(res->Pn(), 0);
+  EXPECT_EQ(res->GetFinalData().hand, MakeHand<GOLD>());
+  EXPECT_EQ(res->Len(), MateLen{4});
+
+  // 取り返した後の局面が分からないマスの合駒は証明できない
+  EXPECT_FALSE(prover.Prove(make_move_drop(SILVER, SQ_54, WHITE), MateLen{4}).has_value());
+  // 残り手数が足りなければ証明できない
+  EXPECT_FALSE(prover.Prove(make_move_drop(SILVER, SQ_55, WHITE), MateLen{3}).has_value());
+}
+
+TEST_F(InterpositionProverTest, RemoveDroppedPieceFromProofHand) {
+  TestNode n{"4k4/9/9/9/9/9/9/9/4R4 w Gpsnl 1", false};
+  SetProven(*n, make_move_drop(PAWN, SQ_55, WHITE), make_move(SQ_59, SQ_55, B_ROOK), MakeHand<GOLD, SILVER>());
+
+  const InterpositionProver prover{tt_, *n};
+  // 合駒した銀は取り返すと攻め方の持ち駒になるので、証明駒から除く
+  const auto res = prover.Prove(make_move_drop(SILVER, SQ_55, WHITE), MateLen{4});
+  ASSERT_TRUE(res.has_value());
+  EXPECT_EQ(res->GetFinalData().hand, MakeHand<GOLD>());
+
+  // 証明駒が足りない合駒は証明できない
+  EXPECT_FALSE(prover.Prove(make_move_drop(KNIGHT, SQ_55, WHITE), MateLen{4}).has_value());
+}
+
+TEST_F(InterpositionProverTest, PromotedRecapture) {
+  TestNode n{"4k4/9/9/9/9/9/9/9/4R4 w Gpsnl 1", false};
+  SetProven(*n, make_move_drop(PAWN, SQ_53, WHITE), make_move_promote(SQ_59, SQ_53, B_ROOK), MakeHand<GOLD>());
+
+  const InterpositionProver prover{tt_, *n};
+  const auto res = prover.Prove(make_move_drop(LANCE, SQ_53, WHITE), MateLen{4});
+  ASSERT_TRUE(res.has_value());
+  EXPECT_EQ(res->Pn(), 0);
+}
+
+TEST_F(InterpositionProverTest, NotTarget) {
+  // 王手していない OR node や、合駒のできない王手では何も証明しない
+  TestNode or_node{"4k4/9/9/9/9/9/9/9/4R4 b G 1", true};
+  const InterpositionProver or_prover{tt_, *or_node};
+  EXPECT_FALSE(or_prover.Prove(make_move_drop(GOLD, SQ_52, BLACK), MateLen{4}).has_value());
+
+  TestNode adjacent{"4k4/4R4/9/9/9/9/9/9/9 w G 1", false};
+  const InterpositionProver adjacent_prover{tt_, *adjacent};
+  EXPECT_FALSE(adjacent_prover.Prove(make_move_drop(GOLD, SQ_53, WHITE), MateLen{4}).has_value());
+}
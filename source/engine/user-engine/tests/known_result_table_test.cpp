@@ -0,0 +1,163 @@
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "../known_result_table.hpp"
+#include "test_lib.hpp"
+
+using komori::MateLen;
+using komori::MateLen16;
+using komori::tt::KnownResultTable;
+using komori::tt::detail::KnownResultRecord;
+
+namespace {
+constexpr komori::SearchAmount kAmount = komori::tt::detail::kKnownResultMinAmount;
+
+class KnownResultTableTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    path_ = ::testing::TempDir() + "kh_known_result_table_test.bin";
+    std::remove(path_.c_str());
+  }
+
+  void TearDown() override { std::remove(path_.c_str()); }
+
+  std::string path_;
+};
+}  // namespace
+
+TEST(KnownResultTable, Compact) {
+  std::vector<KnownResultRecord> records{
+      {0x334, MakeHand<PAWN, LANCE>(), MateLen16{5}, 1, BLACK},
+      {0x334, MakeHand<PAWN>(), MateLen16{5}, 1, BLACK},
+      {0x334, MakeHand<PAWN>(), MateLen16{5}, 1, BLACK},
+      {0x334, MakeHand<LANCE>(), MateLen16{3}, 1, BLACK},
+      {0x334, MakeHand<PAWN>(), MateLen16{3}, 0, BLACK},
+      {0x334, MakeHand<PAWN, LANCE>(), MateLen16{7}, 0, BLACK},
+      {0x334, MakeHand<PAWN>(), MateLen16{5}, 1, WHITE},
+      {0x264, MakeHand<PAWN>(), MateLen16{9}, 1, BLACK},
+  };
+  komori::tt::detail::CompactKnownResults(records);
+
+  // 重複（PAWN, 5 手詰）と、PAWN で 5 手詰から導ける PAWN+LANCE の 5 手詰、PAWN+LANCE の 7 手不詰から導ける
+  // PAWN の 3 手不詰が消える
+  ASSERT_EQ(records.size(), 5);
+  EXPECT_EQ(records[0].board_key, 0x264);
+  EXPECT_TRUE(std::is_sorted(records.begin(), records.end(), komori::tt::detail::KnownResultLess));
+  for (const auto& record : records) {
+    if (record.board_key == 0x334 && record.or_color == BLACK && record.is_proven) {
+      EXPECT_NE(record.hand, (MakeHand<PAWN, LANCE>()));
+    }
+    if (record.board_key == 0x334 && record.or_color == BLACK && !record.is_proven) {
+      EXPECT_EQ(record.hand, (MakeHand<PAWN, LANCE>()));
+    }
+  }
+}
+
+TEST_F(KnownResultTableTest, OpenNew) {
+  KnownResultTable table;
+  ASSERT_TRUE(table.Open(path_));
+  EXPECT_TRUE(table.IsOpen());
+  EXPECT_EQ(table.Size(), 0);
+  EXPECT_FALSE(table.LookUp(0x334, MakeHand<PAWN>(), MateLen{334}));
+
+  table.Close();
+  EXPECT_FALSE(table.IsOpen());
+  EXPECT_TRUE(std::ifstream{path_});
+}
+
+TEST_F(KnownResultTableTest, OpenBrokenFile) {
+  {
+    std::ofstream ofs(path_);
+    ofs << "this is not a known result file";
+  }
+
+  KnownResultTable table;
+  EXPECT_FALSE(table.Open(path_));
+  EXPECT_FALSE(table.IsOpen());
+}
+
+TEST_F(KnownResultTableTest, LookUpProven) {
+  KnownResultTable table;
+  ASSERT_TRUE(table.Open(path_));
+  table.NewSearch(BLACK);
+  table.Append(0x334, MakeHand<PAWN>(), MateLen{5}, true, kAmount);
+
+  // Flush() するまでは見えない
+  EXPECT_FALSE(table.LookUp(0x334, MakeHand<PAWN>(), MateLen{5}));
+  ASSERT_TRUE(table.Flush());
+
+  const auto result = table.LookUp(0x334, MakeHand<PAWN, LANCE>(), MateLen{7});
+  ASSERT_TRUE(result);
+  EXPECT_EQ(result->Pn(), 0);
+  EXPECT_EQ(result->Len(), MateLen{5});
+  EXPECT_EQ(result->GetFinalData().hand, MakeHand<PAWN>());
+
+  // 手数が足りない、持ち駒が足りない、盤面や攻め方が違う
+  EXPECT_FALSE(table.LookUp(0x334, MakeHand<PAWN>(), MateLen{3}));
+  EXPECT_FALSE(table.LookUp(0x334, MakeHand<LANCE>(), MateLen{7}));
+  EXPECT_FALSE(table.LookUp(0x264, MakeHand<PAWN>(), MateLen{7}));
+  table.NewSearch(WHITE);
+  EXPECT_FALSE(table.LookUp(0x334, MakeHand<PAWN>(), MateLen{7}));
+}
+
+TEST_F(KnownResultTableTest, LookUpDisproven) {
+  KnownResultTable table;
+  ASSERT_TRUE(table.Open(path_));
+  table.NewSearch(WHITE);
+  table.Append(0x334, MakeHand<PAWN, LANCE>(), MateLen{7}, false, kAmount);
+  ASSERT_TRUE(table.Flush());
+
+  const auto result = table.LookUp(0x334, MakeHand<PAWN>(), MateLen{5});
+  ASSERT_TRUE(result);
+  EXPECT_EQ(result->Dn(), 0);
+  EXPECT_EQ(result->Len(), MateLen{7});
+  EXPECT_EQ(result->GetFinalData().hand, (MakeHand<PAWN, LANCE>()));
+
+  EXPECT_FALSE(table.LookUp(0x334, MakeHand<PAWN>(), MateLen{9}));
+  EXPECT_FALSE(table.LookUp(0x334, MakeHand<PAWN, PAWN>(), MateLen{5}));
+}
+
+TEST_F(KnownResultTableTest, IgnoreSmallAmount) {
+  KnownResultTable table;
+  ASSERT_TRUE(table.Open(path_));
+  table.NewSearch(BLACK);
+  table.Append(0x334, MakeHand<PAWN>(), MateLen{5}, true, kAmount - 1);
+  ASSERT_TRUE(table.Flush());
+
+  EXPECT_EQ(table.Size(), 0);
+  EXPECT_FALSE(table.LookUp(0x334, MakeHand<PAWN>(), MateLen{5}));
+}
+
+TEST_F(KnownResultTableTest, Persistence) {
+  {
+    KnownResultTable table;
+    ASSERT_TRUE(table.Open(path_));
+    table.NewSearch(BLACK);
+    for (Key key = 1; key <= 32; ++key) {
+      table.Append(key, MakeHand<PAWN>(), MateLen{5}, true, kAmount);
+    }
+    ASSERT_TRUE(table.Flush());
+
+    // 整列済み領域に対して十分小さいので、末尾に追記される
+    table.Append(0x334, MakeHand<GOLD>(), MateLen{9}, true, kAmount);
+    ASSERT_TRUE(table.Flush());
+    EXPECT_EQ(table.Size(), 33);
+    EXPECT_TRUE(table.LookUp(0x334, MakeHand<GOLD>(), MateLen{9}));
+
+    // Close() 時にも書き出す
+    table.Append(0x264, MakeHand<GOLD>(), MateLen{11}, true, kAmount);
+  }
+
+  KnownResultTable table;
+  ASSERT_TRUE(table.Open(path_));
+  table.NewSearch(BLACK);
+  EXPECT_EQ(table.Size(), 34);
+  for (Key key = 1; key <= 32; ++key) {
+    EXPECT_TRUE(table.LookUp(key, MakeHand<PAWN>(), MateLen{5})) << key;
+  }
+  EXPECT_TRUE(table.LookUp(0x334, MakeHand<GOLD>(), MateLen{9}));
+  EXPECT_TRUE(table.LookUp(0x264, MakeHand<GOLD>(), MateLen{11}));
+}
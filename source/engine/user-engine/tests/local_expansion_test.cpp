@@ -66,12 +66,13 @@ class LocalExpansionTest : public ::testing::Test {
   void SetUp() override { tt_.Resize(1); }
 
   komori::tt::TranspositionTable tt_;
+  komori::MoveHistory move_history_;
 };
 }  // namespace
 
 TEST_F(LocalExpansionTest, NoLegalMoves) {
   TestNode n{"4k4/9/9/9/9/9/9/9/9 b 2r2b4g4s4n4l18p 1", true};
-  LocalExpansion local_expansion{tt_, *n, MateLen{334}, true};
+  LocalExpansion local_expansion{tt_, move_history_, *n, MateLen{334}, true, 1};
 
   const auto res = local_expansion.CurrentResult(*n);
   EXPECT_EQ(res.Pn(), kInfinitePnDn);
@@ -80,7 +81,7 @@ TEST_F(LocalExpansionTest, NoLegalMoves) {
 
 TEST_F(LocalExpansionTest, DelayExpansion) {
   TestNode n{"6R1k/7lp/9/9/9/9/9/9/9 w r2b4g4s4n3l17p 1", false};
-  LocalExpansion local_expansion{tt_, *n, MateLen{334}, true};
+  LocalExpansion local_expansion{tt_, move_history_, *n, MateLen{334}, true, 1};
 
   const auto [pn, dn] = komori::InitialPnDn(*n, make_move_drop(ROOK, SQ_21, BLACK));
   const auto res = local_expansion.CurrentResult(*n);
@@ -105,7 +106,7 @@ TEST_F(LocalExpansionTest, ObviousRepetition) {
   n->DoMove(make_move(SQ_11, SQ_12, W_KING));
   n->DoMove(make_move_drop(GOLD, SQ_11, BLACK));
   n->DoMove(make_move(SQ_12, SQ_11, W_KING));
-  LocalExpansion local_expansion{tt_, *n, MateLen{334}, true};
+  LocalExpansion local_expansion{tt_, move_history_, *n, MateLen{334}, true, 1};
 
   const auto res = local_expansion.CurrentResult(*n);
   EXPECT_EQ(res.Pn(), kInfinitePnDn);
@@ -114,7 +115,7 @@ TEST_F(LocalExpansionTest, ObviousRepetition) {
 
 TEST_F(LocalExpansionTest, InitialSort) {
   TestNode n{"7k1/6pP1/7LP/8L/9/9/9/9/9 w 2r2b4g4s4n2l15p 1", false};
-  LocalExpansion local_expansion{tt_, *n, MateLen{334}, true};
+  LocalExpansion local_expansion{tt_, move_history_, *n, MateLen{334}, true, 1};
 
   const auto [pn, dn] = komori::InitialPnDn(*n, make_move(SQ_21, SQ_31, W_KING));
   const auto res = local_expansion.CurrentResult(*n);
@@ -124,7 +125,7 @@ TEST_F(LocalExpansionTest, InitialSort) {
 
 TEST_F(LocalExpansionTest, MaxChildren) {
   TestNode n{"6pkp/7PR/7L1/9/9/9/9/9/9 w r2b4g4s4n3l15p 1", false};
-  LocalExpansion local_expansion{tt_, *n, MateLen{334}, true, komori::BitSet64{}};
+  LocalExpansion local_expansion{tt_, move_history_, *n, MateLen{334}, true, 1, komori::BitSet64{}};
 
   const auto [pn1, dn1] = komori::InitialPnDn(*n, make_move(SQ_21, SQ_12, W_KING));
   const auto [pn2, dn2] = komori::InitialPnDn(*n, make_move(SQ_21, SQ_32, W_KING));
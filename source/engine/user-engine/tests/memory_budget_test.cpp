@@ -0,0 +1,46 @@
+#include <gtest/gtest.h>
+
+#include "../memory_budget.hpp"
+
+using komori::PlanMemory;
+
+namespace {
+constexpr std::size_t kNodeBytes = 2 * 1024 * 1024;
+constexpr std::size_t kExpansionBytes = 16 * 1024;
+constexpr std::uint64_t kMiB = 1024 * 1024;
+}  // namespace
+
+TEST(MemoryBudget, LargeBudget) {
+  const auto plan = PlanMemory(4096, 1, kNodeBytes, kExpansionBytes);
+  EXPECT_EQ(plan.max_depth, komori::kDepthMax);
+
+  const auto used = komori::detail::kBaseMemoryBytes + kNodeBytes + komori::kDepthMax * kExpansionBytes;
+  EXPECT_EQ(plan.hash_mb, (4096 * kMiB - used) / kMiB);
+}
+
+TEST(MemoryBudget, LimitDepth) {
+  const auto plan = PlanMemory(1024, 8, kNodeBytes, kExpansionBytes);
+  EXPECT_LT(plan.max_depth, komori::kDepthMax);
+  EXPECT_GE(plan.max_depth, komori::detail::kMinBudgetDepth);
+
+  // スレッドが使う領域は予算の 1/4 以下
+  const auto thread_bytes = 8 * (kNodeBytes + plan.max_depth * kExpansionBytes);
+  EXPECT_LE(thread_bytes, 1024 * kMiB / 4);
+  EXPECT_LE(komori::detail::kBaseMemoryBytes + thread_bytes + plan.hash_mb * kMiB, 1024 * kMiB);
+}
+
+TEST(MemoryBudget, TooSmallBudget) {
+  const auto plan = PlanMemory(1, 4, kNodeBytes, kExpansionBytes);
+  EXPECT_EQ(plan.max_depth, komori::detail::kMinBudgetDepth);
+  EXPECT_EQ(plan.hash_mb, 1);
+}
+
+TEST(MemoryBudget, GetResidentMemory) {
+  const auto resident = komori::GetResidentMemory();
+#if defined(__linux__)
+  ASSERT_TRUE(resident);
+  EXPECT_LE(resident->current_mb, resident->peak_mb);
+#else
+  EXPECT_FALSE(resident);
+#endif
+}
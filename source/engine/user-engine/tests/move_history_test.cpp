@@ -0,0 +1,73 @@
+#include <gtest/gtest.h>
+
+#include "../move_history.hpp"
+
+using komori::MoveHistory;
+
+TEST(MoveHistoryTest, Update) {
+  MoveHistory history;
+  const auto move = make_move_drop(GOLD, SQ_52, BLACK);
+  EXPECT_EQ(history.Get(move), 0);
+
+  history.Update(move, true);
+  const auto proven_value = history.Get(move);
+  EXPECT_GT(proven_value, 0);
+
+  history.Update(move, false);
+  history.Update(move, false);
+  EXPECT_LT(history.Get(move), 0);
+
+  history.Clear();
+  EXPECT_EQ(history.Get(move), 0);
+}
+
+TEST(MoveHistoryTest, Saturate) {
+  MoveHistory history;
+  const auto move = make_move(SQ_53, SQ_52, B_GOLD);
+  for (int i = 0; i < 1000; ++i) {
+    history.Update(move, true);
+  }
+  EXPECT_GT(history.Get(move), komori::detail::kMoveHistoryMax / 2);
+  EXPECT_LE(history.Get(move), komori::detail::kMoveHistoryMax);
+
+  for (int i = 0; i < 1000; ++i) {
+    history.Update(move, false);
+  }
+  EXPECT_LT(history.Get(move), -komori::detail::kMoveHistoryMax / 2);
+  EXPECT_GE(history.Get(move), -komori::detail::kMoveHistoryMax);
+}
+
+TEST(MoveHistoryTest, Disabled) {
+  MoveHistory history;
+  const auto move = make_move_drop(GOLD, SQ_52, BLACK);
+  history.Update(move, true);
+  const auto value = history.Get(move);
+  EXPECT_GT(value, 0);
+
+  // 無効にしている間は 0 を返し、更新もしない
+  history.SetEnabled(false);
+  EXPECT_FALSE(history.IsEnabled());
+  EXPECT_EQ(history.Get(move), 0);
+  history.Update(move, false);
+
+  history.SetEnabled(true);
+  EXPECT_EQ(history.Get(move), value);
+}
+
+TEST(MoveHistoryTest, Key) {
+  MoveHistory history;
+  history.Update(make_move_drop(GOLD, SQ_52, BLACK), true);
+
+  // 移動元が違っても、移動後の駒と移動先が同じなら同じ履歴を使う
+  EXPECT_EQ(history.Get(make_move(SQ_53, SQ_52, B_GOLD)), 0);
+  history.Update(make_move(SQ_53, SQ_52, B_GOLD), true);
+  EXPECT_EQ(history.Get(make_move(SQ_63, SQ_52, B_GOLD)), history.Get(make_move(SQ_53, SQ_52, B_GOLD)));
+
+  // 駒打ちかどうか、駒の種類、移動先が違えば別の履歴を使う
+  history.Clear();
+  history.Update(make_move_drop(GOLD, SQ_52, BLACK), true);
+  EXPECT_EQ(history.Get(make_move(SQ_53, SQ_52, B_GOLD)), 0);
+  EXPECT_EQ(history.Get(make_move_drop(SILVER, SQ_52, BLACK)), 0);
+  EXPECT_EQ(history.Get(make_move_drop(GOLD, SQ_42, BLACK)), 0);
+  EXPECT_EQ(history.Get(make_move_promote(SQ_53, SQ_52, B_SILVER)), 0);
+}
@@ -1,15 +1,135 @@
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <array>
+#include <numeric>
+#include <unordered_set>
+#include <vector>
+
 #include "../path_keys.hpp"
 
+namespace {
+/// `keys` の中で下位 `bits` ビットが一致する組の数を数える
+std::uint64_t CountCollisions(const std::vector<Key>& keys, int bits) {
+  std::vector<Key> masked;
+  masked.reserve(keys.size());
+  const Key mask = bits >= 64 ? ~Key{0} : (Key{1} << bits) - 1;
+  for (const auto key : keys) {
+    masked.push_back(key & mask);
+  }
+  std::sort(masked.begin(), masked.end());
+
+  std::uint64_t collisions = 0;
+  std::uint64_t run = 1;
+  for (std::size_t i = 1; i <= masked.size(); ++i) {
+    if (i < masked.size() && masked[i] == masked[i - 1]) {
+      ++run;
+    } else {
+      collisions += run * (run - 1) / 2;
+      run = 1;
+    }
+  }
+  return collisions;
+}
+}  // namespace
+
 TEST(PathKeysTest, PathKeyAfter_drop) {
   const Key before_key = 0x334334;
   const Key after_key = komori::PathKeyAfter(before_key, make_move_drop(PAWN, SQ_88, BLACK), 264);
 
-  Key expected_key = before_key;
-
-  expected_key ^= komori::detail::g_move_to[SQ_88][264];
-  expected_key ^= komori::detail::g_dropped_pr[PAWN][264];
+  const Key move_key = komori::detail::g_move_to[SQ_88] ^ komori::detail::g_dropped_pr[PAWN];
+  const Key expected_key = before_key ^ komori::detail::PathKeyAtDepth(move_key, 264);
 
   EXPECT_EQ(after_key, expected_key);
+  EXPECT_EQ(komori::PathKeyBefore(after_key, make_move_drop(PAWN, SQ_88, BLACK), 264), before_key);
+}
+
+TEST(PathKeysTest, PathKeyInit) {
+  const auto move_to = komori::detail::g_move_to[SQ_88];
+  const auto stolen = komori::detail::g_stolen_pr[PAWN];
+
+  // 何度初期化しても同じ値になる
+  komori::PathKeyInit();
+  EXPECT_EQ(komori::detail::g_move_to[SQ_88], move_to);
+  EXPECT_EQ(komori::detail::g_stolen_pr[PAWN], stolen);
+
+  // テーブル、添字、深さが異なれば値も異なる
+  EXPECT_NE(komori::detail::g_move_to[SQ_88], komori::detail::g_move_from[SQ_88]);
+  EXPECT_NE(komori::detail::g_move_to[SQ_88], komori::detail::g_move_to[SQ_87]);
+  EXPECT_NE(komori::detail::g_dropped_pr[PAWN], komori::detail::g_stolen_pr[PAWN]);
+  EXPECT_NE(komori::detail::PathKeyAtDepth(move_to, 264), komori::detail::PathKeyAtDepth(move_to, 265));
+}
+
+TEST(PathKeysTest, DistinctMoves) {
+  // 同じ深さで異なる手を指したら、経路ハッシュ値も異なる
+  std::vector<Move> moves;
+  for (const auto to : SQ) {
+    for (const auto from : SQ) {
+      if (from != to) {
+        moves.push_back(make_move(from, to, B_PAWN));
+        moves.push_back(make_move_promote(from, to, B_PAWN));
+      }
+    }
+    for (PieceType pr = PAWN; pr < KING; ++pr) {
+      moves.push_back(make_move_drop(pr, to, BLACK));
+    }
+  }
+
+  for (const Depth depth : {0, 1, 64, 65, komori::kDepthMax - 1}) {
+    std::unordered_set<Key> keys;
+    for (const auto move : moves) {
+      keys.insert(komori::PathKeyAfter(0, move, depth));
+    }
+    EXPECT_EQ(keys.size(), moves.size()) << depth;
+  }
+}
+
+TEST(PathKeysTest, Transpositions) {
+  // 同じ手の集合を異なる順番で指したとき、経路ハッシュ値がすべて異なる
+  const std::array<Move, 8> moves{
+      make_move(SQ_77, SQ_76, B_PAWN),
+      make_move(SQ_33, SQ_34, W_PAWN),
+      make_move(SQ_27, SQ_26, B_PAWN),
+      make_move(SQ_83, SQ_84, W_PAWN),
+      make_move_drop(GOLD, SQ_55, BLACK),
+      make_move_drop(SILVER, SQ_45, WHITE),
+      make_move_promote(SQ_88, SQ_22, B_BISHOP),
+      make_move(SQ_28, SQ_58, B_ROOK),
+  };
+
+  for (const Depth start : {0, 60, 3000}) {
+    std::array<std::size_t, 8> order{};
+    std::iota(order.begin(), order.end(), 0);
+
+    std::vector<Key> keys;
+    do {
+      Key key = 0;
+      for (std::size_t i = 0; i < order.size(); ++i) {
+        key = komori::PathKeyAfter(key, moves[order[i]], start + static_cast<Depth>(i));
+      }
+      keys.push_back(key);
+    } while (std::next_permutation(order.begin(), order.end()));
+
+    // 64 bit 全体では衝突しない
+    EXPECT_EQ(CountCollisions(keys, 64), 0) << start;
+
+    // 下位ビットだけを見ても、一様乱数と同程度の衝突率に収まる
+    constexpr int kBits = 20;
+    const double n = static_cast<double>(keys.size());
+    const double expected = n * (n - 1) / 2 / static_cast<double>(1 << kBits);
+    const auto collisions = static_cast<double>(CountCollisions(keys, kBits));
+    EXPECT_GT(collisions, expected * 0.7) << start;
+    EXPECT_LT(collisions, expected * 1.3) << start;
+  }
+}
+
+TEST(PathKeysTest, SwapDistantDepths) {
+  // 深さが 64 離れた手を入れ替えても、経路ハッシュ値が変わる
+  const auto m1 = make_move(SQ_77, SQ_76, B_PAWN);
+  const auto m2 = make_move_drop(GOLD, SQ_55, BLACK);
+  for (Depth depth = 0; depth < 256; ++depth) {
+    const auto key1 = komori::PathKeyAfter(komori::PathKeyAfter(0, m1, depth), m2, depth + 64);
+    const auto key2 = komori::PathKeyAfter(komori::PathKeyAfter(0, m2, depth), m1, depth + 64);
+    EXPECT_NE(key1, key2) << depth;
+  }
 }
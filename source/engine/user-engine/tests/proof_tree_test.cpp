@@ -0,0 +1,123 @@
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include "../proof_tree.hpp"
+#include "test_lib.hpp"
+
+using komori::ProofTree;
+using komori::ProofTreeNode;
+
+namespace {
+/**
+ * @brief `sfen` から `move` を指した局面を詰み局面（子なしの AND node）とした証明木を作る
+ */
+ProofTree MakeMate1PlyTree(const std::string& sfen, const std::string& move_str) {
+  TestNode n{sfen, true};
+  const auto or_color = n->OrColor();
+  ProofTree tree{sfen, or_color};
+
+  const auto move = USI::to_move(n.Pos(), move_str);
+  n->DoMove(move);
+  const auto child = tree.Add(ProofTreeNode{n->BoardKey(), n->OrHand(), HAND_ZERO, {}});
+  n->UndoMove();
+  tree.Add(ProofTreeNode{n->BoardKey(), n->OrHand(), MakeHand<GOLD>(), {{Move16{move}, child}}});
+
+  return tree;
+}
+}  // namespace
+
+TEST(ProofTreeTest, FindAndAdd) {
+  ProofTree tree{"4k4/9/4G4/9/9/9/9/9/9 b G 1", BLACK};
+
+  EXPECT_FALSE(tree.Find(0x334, MakeHand<PAWN>()));
+  const auto index = tree.Add(ProofTreeNode{0x334, MakeHand<PAWN>(), HAND_ZERO, {}});
+  EXPECT_EQ(tree.Find(0x334, MakeHand<PAWN>()), std::optional<std::uint32_t>{index});
+  EXPECT_FALSE(tree.Find(0x334, MakeHand<LANCE>()));
+  EXPECT_FALSE(tree.Find(0x264, MakeHand<PAWN>()));
+}
+
+TEST(ProofTreeTest, WriteRead) {
+  const auto tree = MakeMate1PlyTree("4k4/9/4G4/9/9/9/9/9/9 b G 1", "G*5b");
+
+  std::stringstream ss;
+  tree.Write(ss);
+
+  ProofTree loaded;
+  ASSERT_TRUE(loaded.Read(ss));
+  EXPECT_EQ(loaded.RootSfen(), tree.RootSfen());
+  EXPECT_EQ(loaded.OrColor(), tree.OrColor());
+  ASSERT_EQ(loaded.Nodes().size(), tree.Nodes().size());
+  for (std::size_t i = 0; i < tree.Nodes().size(); ++i) {
+    EXPECT_EQ(loaded.Nodes()[i].board_key, tree.Nodes()[i].board_key);
+    EXPECT_EQ(loaded.Nodes()[i].or_hand, tree.Nodes()[i].or_hand);
+    EXPECT_EQ(loaded.Nodes()[i].proof_hand, tree.Nodes()[i].proof_hand);
+    EXPECT_EQ(loaded.Nodes()[i].children, tree.Nodes()[i].children);
+  }
+}
+
+TEST(ProofTreeTest, ReadBroken) {
+  const auto tree = MakeMate1PlyTree("4k4/9/4G4/9/9/9/9/9/9 b G 1", "G*5b");
+  std::stringstream ss;
+  tree.Write(ss);
+
+  auto str = ss.str();
+  std::stringstream truncated{str.substr(0, str.size() - 1)};
+  ProofTree loaded;
+  EXPECT_FALSE(loaded.Read(truncated));
+
+  str[0] = 'X';
+  std::stringstream wrong_magic{str};
+  EXPECT_FALSE(loaded.Read(wrong_magic));
+}
+
+TEST(ProofTreeTest, VerifyMate) {
+  const auto tree = MakeMate1PlyTree("4k4/9/4G4/9/9/9/9/9/9 b G 1", "G*5b");
+
+  EXPECT_FALSE(komori::VerifyProofTree(tree, 1));
+  EXPECT_FALSE(komori::VerifyProofTree(tree, 4));
+}
+
+TEST(ProofTreeTest, VerifyNoMate) {
+  // G*4b は王手だが玉に逃げ道がある
+  const auto tree = MakeMate1PlyTree("4k4/9/4G4/9/9/9/9/9/9 b G 1", "G*4b");
+
+  const auto error = komori::VerifyProofTree(tree, 1);
+  ASSERT_TRUE(error);
+  EXPECT_EQ(error->node, 0);
+}
+
+TEST(ProofTreeTest, VerifyNotCheck) {
+  const auto tree = MakeMate1PlyTree("4k4/9/4G4/9/9/9/9/9/9 b G 1", "G*9i");
+
+  const auto error = komori::VerifyProofTree(tree, 1);
+  ASSERT_TRUE(error);
+  EXPECT_EQ(error->node, 0);
+}
+
+TEST(ProofTreeTest, VerifyBrokenStructure) {
+  ProofTree empty{"4k4/9/4G4/9/9/9/9/9/9 b G 1", BLACK};
+  EXPECT_TRUE(komori::VerifyProofTree(empty, 1));
+
+  // 子の番号が親より大きい（循環の可能性がある）
+  ProofTree tree{"4k4/9/4G4/9/9/9/9/9/9 b G 1", BLACK};
+  tree.Add(ProofTreeNode{0x334, HAND_ZERO, HAND_ZERO, {{Move16{}, 1}}});
+  const auto error = komori::VerifyProofTree(tree, 1);
+  ASSERT_TRUE(error);
+  EXPECT_EQ(error->node, 0);
+}
+
+TEST(ProofTreeTest, VerifyProofHand) {
+  TestNode n{"4k4/9/4G4/9/9/9/9/9/9 b G 1", true};
+  ProofTree tree{"4k4/9/4G4/9/9/9/9/9/9 b G 1", BLACK};
+
+  const auto move = USI::to_move(n.Pos(), "G*5b");
+  n->DoMove(move);
+  const auto child = tree.Add(ProofTreeNode{n->BoardKey(), n->OrHand(), HAND_ZERO, {}});
+  n->UndoMove();
+  // 証明駒が持ち駒を超えている
+  tree.Add(ProofTreeNode{n->BoardKey(), n->OrHand(), MakeHand<GOLD, GOLD>(), {{Move16{move}, child}}});
+
+  const auto error = komori::VerifyProofTree(tree, 1);
+  ASSERT_TRUE(error);
+  EXPECT_EQ(error->node, 1);
+}
@@ -44,7 +44,7 @@ TEST(PvList, UpdateFirst) {
   pv_list.Update(move3, result3);
   pv_list.Update(move4, result4);
 
-  const auto& list = pv_list.GetPvList();
+  const auto& list = pv_list;
   const SearchResultComparer comparer{true};
   EXPECT_EQ(comparer(result2, list[0].result), SearchResultComparer::Ordering::kEquivalent);
   EXPECT_EQ(comparer(result1, list[1].result), SearchResultComparer::Ordering::kEquivalent);
@@ -72,17 +72,49 @@ TEST(PvList, UpdateSecond) {
 
   pv_list.Update(move1, result1);
   const SearchResultComparer comparer{true};
-  EXPECT_EQ(comparer(result1, pv_list.GetPvList()[0].result), SearchResultComparer::Ordering::kEquivalent);
+  EXPECT_EQ(comparer(result1, pv_list[0].result), SearchResultComparer::Ordering::kEquivalent);
 
   // unknown -> unknown
   pv_list.Update(move1, result2);
-  EXPECT_EQ(comparer(result2, pv_list.GetPvList()[0].result), SearchResultComparer::Ordering::kEquivalent);
+  EXPECT_EQ(comparer(result2, pv_list[0].result), SearchResultComparer::Ordering::kEquivalent);
 
   // unknown -> final
   pv_list.Update(move1, result3);
-  EXPECT_EQ(comparer(result3, pv_list.GetPvList()[0].result), SearchResultComparer::Ordering::kEquivalent);
+  EXPECT_EQ(comparer(result3, pv_list[0].result), SearchResultComparer::Ordering::kEquivalent);
 
   // final -> unknown
   pv_list.Update(move1, result2);
-  EXPECT_EQ(comparer(result3, pv_list.GetPvList()[0].result), SearchResultComparer::Ordering::kEquivalent);
+  EXPECT_EQ(comparer(result3, pv_list[0].result), SearchResultComparer::Ordering::kEquivalent);
+}
+
+TEST(PvList, KeepSorted) {
+  TestNode n{"4k4/9/4P4/9/9/9/9/9/9 b N2r2b4g4s3n4l17p 1", true};
+
+  PvList pv_list{};
+  pv_list.NewSearch(*n);
+  const std::vector<Move> moves{
+      make_move(SQ_53, SQ_52, B_PAWN),
+      make_move_promote(SQ_53, SQ_52, B_PAWN),
+      make_move_drop(KNIGHT, SQ_43, BLACK),
+      make_move_drop(KNIGHT, SQ_63, BLACK),
+  };
+
+  const SearchResultComparer comparer{true};
+  std::uint32_t seed = 334;
+  for (int i = 0; i < 100; ++i) {
+    seed = seed * 1103515245 + 12345;
+    const auto move = moves[(seed >> 16) % moves.size()];
+    const komori::PnDn pn = 1 + (seed >> 8) % 10;
+    const komori::PnDn dn = 1 + (seed >> 4) % 10;
+    pv_list.Update(move, SearchResult::MakeFirstVisit(pn, dn, MateLen{264}, 1));
+
+    ASSERT_EQ(pv_list.Size(), moves.size());
+    for (std::size_t rank = 0; rank + 1 < pv_list.Size(); ++rank) {
+      EXPECT_NE(comparer(pv_list[rank + 1].result, pv_list[rank].result), SearchResultComparer::Ordering::kLess);
+    }
+  }
+
+  pv_list.Update(moves[2], SearchResult::MakeFinal<true>(MakeHand<PAWN>(), MateLen{3}, 1), 3,
+                 std::vector{moves[2], moves[0]});
+  EXPECT_EQ(pv_list.BestMoves(), (std::vector{moves[2], moves[0]}));
 }
@@ -1,5 +1,8 @@
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <vector>
+
 #include "../regular_table.hpp"
 #include "test_lib.hpp"
 
@@ -54,6 +57,25 @@ class RegularTableTest : public ::testing::Test {
     tt_.Clear();
   }
 
+  /// `Load()` と同じ要領でエントリを挿入する
+  komori::tt::Entry& InsertEntry(Key board_key) {
+    auto ptr = tt_.PointerOf(board_key);
+    for (; !ptr->IsNull(); ++ptr) {
+    }
+    ptr->Init(board_key, HAND_ZERO);
+    return *ptr;
+  }
+
+  /// `board_key` のエントリに挿入位置からたどり着けるかどうか
+  bool FindEntry(Key board_key) {
+    for (auto ptr = tt_.PointerOf(board_key); !ptr->IsNull(); ++ptr) {
+      if (ptr->BoardKey() == board_key) {
+        return true;
+      }
+    }
+    return false;
+  }
+
   komori::tt::RegularTable tt_;
 };
 }  // namespace
@@ -70,11 +92,70 @@ TEST_F(RegularTableTest, Resize_ClearEntries) {
   front.Init(0x334, HAND_ZERO);
 
   EXPECT_FALSE(front.IsNull());
-  tt_.Resize(334);
+  tt_.Resize(2604);
   auto& front2 = *tt_.begin();
   EXPECT_TRUE(front2.IsNull());
 }
 
+TEST_F(RegularTableTest, Resize_KeepEntries) {
+  std::vector<Key> keys;
+  for (Key i = 0; i < 600; ++i) {
+    keys.push_back(i * 0x9e37'79b9'7f4a'7c15ULL + 0x334);
+  }
+  // 末尾から先頭へ折り返すエントリ
+  keys.push_back(0xffff'ffffULL);
+  keys.push_back(0xffff'ffffULL);
+  for (const auto key : keys) {
+    InsertEntry(key);
+  }
+
+  for (const auto new_size : {3000, 6000, 1300}) {
+    tt_.Resize(new_size, 4);
+    ASSERT_EQ(tt_.end() - tt_.begin(), new_size);
+    for (const auto key : keys) {
+      EXPECT_TRUE(FindEntry(key)) << new_size << " " << key;
+    }
+    const auto count = std::count_if(tt_.begin(), tt_.end(), [](const auto& entry) { return !entry.IsNull(); });
+    EXPECT_EQ(count, static_cast<std::ptrdiff_t>(keys.size()));
+  }
+}
+
+TEST_F(RegularTableTest, Resize_KeepEntriesParallel) {
+  const std::size_t num_entries = 4 * komori::detail::kParallelForMinChunk + 334;
+  tt_.Resize(num_entries, 4);
+
+  std::vector<Key> keys;
+  for (Key i = 0; i < num_entries / 3; ++i) {
+    keys.push_back(i * 0x9e37'79b9'7f4a'7c15ULL + 0x334);
+    InsertEntry(keys.back());
+  }
+
+  for (const auto new_size : {num_entries * 3 / 2, num_entries * 3 / 4}) {
+    tt_.Resize(new_size, 4);
+    ASSERT_EQ(tt_.end() - tt_.begin(), new_size);
+    EXPECT_TRUE(std::all_of(keys.begin(), keys.end(), [this](Key key) { return FindEntry(key); }));
+  }
+}
+
+TEST_F(RegularTableTest, Resize_ShrinkKeepsLargeAmount) {
+  for (Key i = 0; i < 1000; ++i) {
+    auto& entry = InsertEntry(i * 0x9e37'79b9'7f4a'7c15ULL);
+    entry.UpdateUnknown(0, 1, 1, static_cast<komori::SearchAmount>(i + 1), komori::BitSet64::Full(), 0, HAND_ZERO);
+  }
+
+  tt_.Resize(1000);
+  std::size_t count = 0;
+  for (const auto& entry : tt_) {
+    if (!entry.IsNull()) {
+      EXPECT_GT(entry.Amount(), 300);
+      EXPECT_TRUE(FindEntry(entry.BoardKey()));
+      ++count;
+    }
+  }
+  EXPECT_LE(count, 500);
+  EXPECT_GT(count, 400);
+}
+
 TEST_F(RegularTableTest, Clear) {
   auto& front = *tt_.begin();
   front.Init(0x334, HAND_ZERO);
@@ -84,6 +165,19 @@ TEST_F(RegularTableTest, Clear) {
   EXPECT_TRUE(front.IsNull());
 }
 
+TEST_F(RegularTableTest, ParallelClear) {
+  const std::size_t num_entries = 4 * komori::detail::kParallelForMinChunk + 334;
+  tt_.Resize(num_entries, 4);
+  ASSERT_EQ(tt_.end() - tt_.begin(), num_entries);
+  EXPECT_TRUE(std::all_of(tt_.begin(), tt_.end(), [](const auto& entry) { return entry.IsNull(); }));
+
+  for (std::size_t i = 0; i < num_entries; i += 334) {
+    tt_.begin()[i].Init(0x334, HAND_ZERO);
+  }
+  tt_.Clear(4);
+  EXPECT_TRUE(std::all_of(tt_.begin(), tt_.end(), [](const auto& entry) { return entry.IsNull(); }));
+}
+
 TEST_F(RegularTableTest, PointerOf) {
   auto p1 = tt_.PointerOf(0);
   auto p2 = tt_.PointerOf(std::numeric_limits<Key>::max() / 2);
@@ -168,6 +262,35 @@ TEST_F(RegularTableTest, SaveLoad) {
   EXPECT_FALSE(p2->IsFor(board_key2, hand2));
 }
 
+TEST_F(RegularTableTest, LoadTruncated) {
+  const auto board_key1{0x334334334334334ull};
+  const auto hand1 = MakeHand<PAWN, LANCE, LANCE>();
+  const auto board_key2{0x264264264264264ull};
+  const auto hand2 = MakeHand<PAWN>();
+
+  auto p1 = tt_.PointerOf(board_key1);
+  p1->Init(board_key1, hand1);
+  p1->UpdateUnknown(334, 1, 1, komori::tt::detail::kTTSaveAmountThreshold + 1, komori::BitSet64::Full(), 0x334,
+                    HAND_ZERO);
+  auto p2 = tt_.PointerOf(board_key2);
+  p2->Init(board_key2, hand2);
+  p2->UpdateUnknown(334, 1, 1, komori::tt::detail::kTTSaveAmountThreshold + 1, komori::BitSet64::Full(), 0x334,
+                    HAND_ZERO);
+
+  std::stringstream ss;
+  tt_.Save(ss);
+  tt_.Clear();
+
+  // 2個目のエントリの途中で途切れたファイルを読み込む
+  auto str = ss.str();
+  str.resize(str.size() - 1);
+  std::stringstream truncated{str};
+  tt_.Load(truncated);
+
+  const auto loaded = std::count_if(tt_.begin(), tt_.end(), [](const auto& entry) { return !entry.IsNull(); });
+  EXPECT_EQ(loaded, 1);
+}
+
 TEST_F(RegularTableTest, Capacity) {
   EXPECT_EQ(tt_.Capacity(), 2604);
 }
@@ -26,6 +26,23 @@ TEST(RepetitionTable, Clear) {
   EXPECT_FALSE(rep_table.Contains(334, MateLen{334}));
 }
 
+TEST(RepetitionTable, ClearLarge) {
+  // ZeroFillLazily() がページを解放するくらい大きいテーブル
+  RepetitionTable rep_table{std::size_t{1} << 21};
+
+  for (Key key = 1; key <= 334; ++key) {
+    rep_table.Insert(key * 0x9e37'79b9'7f4a'7c15ULL, 264, MateLen{334});
+  }
+  EXPECT_TRUE(rep_table.Contains(0x9e37'79b9'7f4a'7c15ULL, MateLen{334}));
+  rep_table.Clear(4);
+  for (Key key = 1; key <= 334; ++key) {
+    EXPECT_FALSE(rep_table.Contains(key * 0x9e37'79b9'7f4a'7c15ULL, MateLen{334}));
+  }
+
+  rep_table.Insert(334, 264, MateLen{334});
+  EXPECT_TRUE(rep_table.Contains(334, MateLen{334}));
+}
+
 TEST(RepetitionTable, Insert) {
   RepetitionTable rep_table(3340);
 
@@ -0,0 +1,93 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "../search_profiler.hpp"
+
+using komori::BoardKeyHandPair;
+using komori::ProfileEvent;
+using komori::ThreadProfile;
+
+namespace {
+const Move kMove1 = make_move(SQ_77, SQ_76, B_PAWN);
+const Move kMove2 = make_move_drop(GOLD, SQ_55, BLACK);
+}  // namespace
+
+TEST(SearchProfilerTest, Record) {
+  ThreadProfile profile;
+  profile.Clear();
+
+  profile.Record(ProfileEvent::kVisit, 0, MOVE_NONE, BoardKeyHandPair{0x334, HAND_ZERO});
+  profile.Record(ProfileEvent::kVisit, 1, kMove1, BoardKeyHandPair{0x264, HAND_ZERO});
+  profile.Record(ProfileEvent::kReexpand, 1, kMove1, BoardKeyHandPair{0x264, HAND_ZERO});
+  profile.Record(ProfileEvent::kTtMiss, 3000, kMove2, BoardKeyHandPair{0x445, HAND_ZERO});
+
+  EXPECT_EQ(profile.Total().Get(ProfileEvent::kVisit), 2);
+  EXPECT_EQ(profile.Total().Get(ProfileEvent::kReexpand), 1);
+  EXPECT_EQ(profile.Total().Get(ProfileEvent::kTtMiss), 1);
+  EXPECT_EQ(profile.Total().Get(ProfileEvent::kRetry), 0);
+
+  // 開始局面自身のイベントは指し手ごとの集計に含めない
+  ASSERT_EQ(profile.RootMoves().size(), 2);
+  EXPECT_EQ(profile.RootMoves()[0].first, kMove1);
+  EXPECT_EQ(profile.RootMoves()[0].second.Get(ProfileEvent::kVisit), 1);
+  EXPECT_EQ(profile.RootMoves()[0].second.Get(ProfileEvent::kReexpand), 1);
+  EXPECT_EQ(profile.RootMoves()[1].first, kMove2);
+
+  // 深い局面は最後の区間にまとめる
+  const auto& hist = profile.DepthHistogram();
+  EXPECT_EQ(hist[0].Get(ProfileEvent::kVisit), 1);
+  EXPECT_EQ(hist[1].Get(ProfileEvent::kVisit), 1);
+  EXPECT_EQ(hist.back().Get(ProfileEvent::kTtMiss), 1);
+
+  profile.Clear();
+  EXPECT_EQ(profile.Total().Get(ProfileEvent::kVisit), 0);
+  EXPECT_TRUE(profile.RootMoves().empty());
+}
+
+TEST(SearchProfilerTest, HotspotSurvivesNoise) {
+  ThreadProfile profile;
+  profile.Clear();
+
+  // 同じ局面の再展開に、毎回異なる局面のイベントを混ぜる
+  const BoardKeyHandPair hot{0x3343343343343340, HAND_ZERO};
+  for (std::uint64_t i = 0; i < 100000; ++i) {
+    profile.Record(ProfileEvent::kReexpand, 5, kMove1, hot);
+    profile.Record(ProfileEvent::kVisit, 6, kMove1, BoardKeyHandPair{i * 0x9e3779b97f4a7c15ULL, HAND_ZERO});
+  }
+
+  const auto report = komori::MakeProfileReport({profile}, 1);
+  ASSERT_GE(report.size(), 3);
+  EXPECT_EQ(report[0], "profile total visit 100000 reexpand 100000 ttmiss 0 retry 0 tca 0");
+  EXPECT_EQ(report[1], "profile root 7g7f visit 100000 reexpand 100000 ttmiss 0 retry 0 tca 0");
+  EXPECT_EQ(report[2].rfind("profile hotspot 1 key 3343343343343340 hand - depth 5 root 7g7f visit ", 0), 0)
+      << report[2];
+}
+
+TEST(SearchProfilerTest, MakeProfileReport) {
+  std::vector<ThreadProfile> profiles(2);
+  for (auto& profile : profiles) {
+    profile.Clear();
+  }
+
+  Hand hand = HAND_ZERO;
+  add_hand(hand, ROOK);
+  add_hand(hand, PAWN, 2);
+  const BoardKeyHandPair key{0x264, hand};
+  for (int i = 0; i < 100; ++i) {
+    profiles[0].Record(ProfileEvent::kReexpand, 2, kMove1, key);
+    profiles[1].Record(ProfileEvent::kReexpand, 2, kMove2, key);
+  }
+  profiles[1].Record(ProfileEvent::kVisit, 1, kMove2, key);
+
+  const auto report = komori::MakeProfileReport(profiles, 10);
+  ASSERT_EQ(report.size(), 6);
+  EXPECT_EQ(report[0], "profile total visit 1 reexpand 200 ttmiss 0 retry 0 tca 0");
+  EXPECT_EQ(report[1], "profile root G*5e visit 1 reexpand 100 ttmiss 0 retry 0 tca 0");
+  EXPECT_EQ(report[2], "profile root 7g7f visit 0 reexpand 100 ttmiss 0 retry 0 tca 0");
+  // 両スレッドの推定値を1つの局面にまとめる
+  EXPECT_EQ(report[3].rfind("profile hotspot 1 key 264 hand R2P depth 2 root ", 0), 0) << report[3];
+  EXPECT_EQ(report[4], "profile depth visit 1:1");
+  EXPECT_EQ(report[5], "profile depth reexpand 2:200");
+}
@@ -0,0 +1,206 @@
+#include <gtest/gtest.h>
+
+#if defined(__linux__)
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../regular_table.hpp"
+#include "test_lib.hpp"
+
+using komori::LargeArray;
+using komori::tt::Entry;
+using komori::tt::RegularTable;
+
+namespace {
+constexpr std::uint64_t kNumEntries = 4 * komori::detail::kParallelForMinChunk;
+constexpr int kNumProcesses = 4;
+constexpr Key kNumCommonKeys = 20000;
+constexpr Key kNumOwnKeys = 5000;
+/// テストで用いる、配列全体を書き換える権利の短い有効期間
+constexpr auto kShortLease = std::chrono::milliseconds{20};
+
+Key CommonKey(Key i) {
+  return i * 0x9e37'79b9'7f4a'7c15ULL + 0x334;
+}
+
+Key OwnKey(int process, Key i) {
+  return CommonKey(kNumCommonKeys + process * kNumOwnKeys + i);
+}
+
+/// `TranspositionTable` のクエリと同じ要領で、エントリを探して見つからなければ作る
+void FindOrCreate(RegularTable& tt, Key board_key) {
+  for (auto itr = tt.PointerOf(board_key);; ++itr) {
+    const std::lock_guard lock(*itr);
+    if (itr->IsNull()) {
+      itr->Init(board_key, HAND_ZERO);
+      return;
+    }
+
+    if (itr->IsFor(board_key, HAND_ZERO)) {
+      return;
+    }
+  }
+}
+
+class SharedTableTest : public ::testing::Test {
+ protected:
+  void SetUp() override { RegularTable::RemoveShared(name_); }
+  void TearDown() override { RegularTable::RemoveShared(name_); }
+
+  const std::string name_{"/kh-test-" + std::to_string(::getpid())};
+};
+}  // namespace
+
+TEST_F(SharedTableTest, AttachExisting) {
+  RegularTable tt1;
+  ASSERT_TRUE(tt1.AttachShared(name_, 334));
+  EXPECT_TRUE(tt1.IsShared());
+  FindOrCreate(tt1, 0x264);
+
+  // 2 個目以降は既存のサイズを使う
+  RegularTable tt2;
+  ASSERT_TRUE(tt2.AttachShared(name_, 2604));
+  EXPECT_EQ(tt2.Capacity(), 334);
+  EXPECT_FALSE(tt2.PointerOf(0x264)->IsNull());
+  EXPECT_EQ(tt2.PointerOf(0x264)->BoardKey(), 0x264);
+
+  // Resize() すると共有をやめる
+  tt2.Resize(334);
+  EXPECT_FALSE(tt2.IsShared());
+  EXPECT_TRUE(tt2.PointerOf(0x264)->IsNull());
+  EXPECT_FALSE(tt1.PointerOf(0x264)->IsNull());
+}
+
+TEST_F(SharedTableTest, LayoutMismatch) {
+  const auto init = [](Entry* data, std::size_t size) { std::uninitialized_default_construct(data, data + size); };
+  LargeArray<Entry> a1;
+  ASSERT_TRUE(a1.AttachShared(name_, 334, init, 1));
+
+  // 要素のサイズが同じでもレイアウトが異なれば接続しない
+  LargeArray<Entry> a2;
+  EXPECT_FALSE(a2.AttachShared(name_, 334, init, 2));
+  EXPECT_FALSE(a2.IsShared());
+  EXPECT_TRUE(a2.AttachShared(name_, 334, init, 1));
+}
+
+TEST_F(SharedTableTest, MaintenanceLock) {
+  const auto init = [](Entry* data, std::size_t size) { std::uninitialized_default_construct(data, data + size); };
+  LargeArray<Entry> local;
+  EXPECT_TRUE(local.TryLockMaintenance());
+  EXPECT_TRUE(local.TryLockMaintenance());
+
+  LargeArray<Entry> a1;
+  LargeArray<Entry> a2;
+  ASSERT_TRUE(a1.AttachShared(name_, 334, init));
+  ASSERT_TRUE(a2.AttachShared(name_, 334, init));
+
+  EXPECT_TRUE(a1.TryLockMaintenance());
+  EXPECT_FALSE(a2.TryLockMaintenance());
+  a1.UnlockMaintenance();
+  EXPECT_TRUE(a2.TryLockMaintenance());
+  a2.UnlockMaintenance();
+
+  // 権利を持ったまま終了したプロセスがいれば、期限が切れた後でその権利を引き継ぐ
+  const auto pid = ::fork();
+  ASSERT_GE(pid, 0);
+  if (pid == 0) {
+    LargeArray<Entry> child;
+    ::_exit(child.AttachShared(name_, 334, init) && child.TryLockMaintenance() ? 0 : 1);
+  }
+  int status = 0;
+  ASSERT_EQ(::waitpid(pid, &status, 0), pid);
+  ASSERT_TRUE(WIFEXITED(status));
+  ASSERT_EQ(WEXITSTATUS(status), 0);
+
+  EXPECT_FALSE(a1.TryLockMaintenance());
+  std::this_thread::sleep_for(kShortLease * 2);
+  EXPECT_TRUE(a1.TryLockMaintenance(kShortLease));
+  EXPECT_FALSE(a2.TryLockMaintenance());
+  a1.UnlockMaintenance();
+}
+
+TEST_F(SharedTableTest, MaintenanceLease) {
+  const auto init = [](Entry* data, std::size_t size) { std::uninitialized_default_construct(data, data + size); };
+  LargeArray<Entry> a1;
+  LargeArray<Entry> a2;
+  ASSERT_TRUE(a1.AttachShared(name_, 334, init));
+  ASSERT_TRUE(a2.AttachShared(name_, 334, init));
+  EXPECT_FALSE(a1.RefreshMaintenance());
+
+  // 更新している間は引き継がれない
+  ASSERT_TRUE(a1.TryLockMaintenance());
+  std::this_thread::sleep_for(kShortLease * 2);
+  EXPECT_TRUE(a1.RefreshMaintenance());
+  EXPECT_FALSE(a2.TryLockMaintenance(kShortLease));
+
+  // 更新が途絶えると引き継がれる。元の持ち主は権利を失ったことを知り、手放すときに新しい持ち主の権利を消さない。
+  std::this_thread::sleep_for(kShortLease * 2);
+  EXPECT_TRUE(a2.TryLockMaintenance(kShortLease));
+  EXPECT_FALSE(a1.RefreshMaintenance());
+  a1.UnlockMaintenance();
+  EXPECT_FALSE(a1.TryLockMaintenance());
+  a2.UnlockMaintenance();
+  EXPECT_TRUE(a1.TryLockMaintenance());
+  a1.UnlockMaintenance();
+}
+
+TEST_F(SharedTableTest, ConcurrentProcesses) {
+  std::vector<pid_t> children;
+  for (int process = 0; process < kNumProcesses; ++process) {
+    const auto pid = ::fork();
+    ASSERT_GE(pid, 0);
+    if (pid == 0) {
+      // 子プロセス。全プロセス共通のキーと自分専用のキーを交互に書き込む。
+      RegularTable tt;
+      if (!tt.AttachShared(name_, kNumEntries, 2)) {
+        ::_exit(1);
+      }
+      for (Key i = 0; i < kNumCommonKeys; ++i) {
+        FindOrCreate(tt, CommonKey((i + process * 1000) % kNumCommonKeys));
+        if (i < kNumOwnKeys) {
+          FindOrCreate(tt, OwnKey(process, i));
+        }
+      }
+      ::_exit(0);
+    }
+    children.push_back(pid);
+  }
+
+  for (const auto pid : children) {
+    int status = 0;
+    ASSERT_EQ(::waitpid(pid, &status, 0), pid);
+    EXPECT_TRUE(WIFEXITED(status));
+    EXPECT_EQ(WEXITSTATUS(status), 0);
+  }
+
+  RegularTable tt;
+  ASSERT_TRUE(tt.AttachShared(name_, 334));
+  ASSERT_EQ(tt.Capacity(), kNumEntries);
+
+  // 競合して同じキーのエントリが 2 つ以上作られていない
+  const auto count_key = [&tt](Key board_key) {
+    int count = 0;
+    for (auto itr = tt.PointerOf(board_key); !itr->IsNull(); ++itr) {
+      count += itr->IsFor(board_key, HAND_ZERO) ? 1 : 0;
+    }
+    return count;
+  };
+  for (Key i = 0; i < kNumCommonKeys; ++i) {
+    ASSERT_EQ(count_key(CommonKey(i)), 1) << i;
+  }
+  for (int process = 0; process < kNumProcesses; ++process) {
+    for (Key i = 0; i < kNumOwnKeys; ++i) {
+      ASSERT_EQ(count_key(OwnKey(process, i)), 1) << process << " " << i;
+    }
+  }
+
+  const auto used = std::count_if(tt.begin(), tt.end(), [](const Entry& entry) { return !entry.IsNull(); });
+  EXPECT_EQ(static_cast<Key>(used), kNumCommonKeys + kNumProcesses * kNumOwnKeys);
+}
+#endif  // defined(__linux__)
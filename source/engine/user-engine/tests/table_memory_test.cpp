@@ -0,0 +1,121 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "../table_memory.hpp"
+
+using komori::LargeArray;
+using komori::MemoryPlacement;
+using komori::NumaPolicy;
+using komori::ParallelFor;
+using komori::ZeroFillLazily;
+using komori::detail::kParallelForMinChunk;
+using komori::detail::ParseIdList;
+
+TEST(TableMemory, ParallelForSmall) {
+  std::vector<int> visited(334);
+  std::atomic<int> call_count{0};
+  ParallelFor(visited.size(), 4, [&](std::size_t begin, std::size_t end) {
+    call_count++;
+    for (std::size_t i = begin; i < end; ++i) {
+      visited[i]++;
+    }
+  });
+
+  // 小さい範囲ではスレッドを起こさない
+  EXPECT_EQ(call_count, 1);
+  EXPECT_TRUE(std::all_of(visited.begin(), visited.end(), [](int v) { return v == 1; }));
+}
+
+TEST(TableMemory, ParallelForLarge) {
+  std::vector<std::uint8_t> visited(4 * kParallelForMinChunk + 334);
+  std::atomic<int> call_count{0};
+  ParallelFor(visited.size(), 3, [&](std::size_t begin, std::size_t end) {
+    call_count++;
+    for (std::size_t i = begin; i < end; ++i) {
+      visited[i]++;
+    }
+  });
+
+  EXPECT_EQ(call_count, 3);
+  EXPECT_TRUE(std::all_of(visited.begin(), visited.end(), [](std::uint8_t v) { return v == 1; }));
+}
+
+TEST(TableMemory, ParallelForEmpty) {
+  int call_count = 0;
+  ParallelFor(0, 4, [&](std::size_t begin, std::size_t end) {
+    call_count++;
+    EXPECT_EQ(begin, end);
+  });
+  EXPECT_EQ(call_count, 1);
+}
+
+TEST(TableMemory, ParallelForBindNuma) {
+  std::vector<std::uint8_t> visited(4 * kParallelForMinChunk + 334);
+  std::atomic<int> call_count{0};
+  ParallelFor(
+      visited.size(), 3,
+      [&](std::size_t begin, std::size_t end) {
+        call_count++;
+        for (std::size_t i = begin; i < end; ++i) {
+          visited[i]++;
+        }
+      },
+      true);
+
+  EXPECT_EQ(call_count, 3);
+  EXPECT_TRUE(std::all_of(visited.begin(), visited.end(), [](std::uint8_t v) { return v == 1; }));
+}
+
+TEST(TableMemory, ParseIdList) {
+  EXPECT_EQ(ParseIdList("0"), (std::vector<int>{0}));
+  EXPECT_EQ(ParseIdList("0-3,8,10-11"), (std::vector<int>{0, 1, 2, 3, 8, 10, 11}));
+  EXPECT_EQ(ParseIdList(""), (std::vector<int>{}));
+  EXPECT_EQ(ParseIdList("1,x,3"), (std::vector<int>{1, 3}));
+}
+
+TEST(TableMemory, LargeArrayPlacement) {
+  LargeArray<std::uint64_t> arr;
+  arr.SetPlacement(MemoryPlacement{true, NumaPolicy::kInterleave});
+  arr.Reallocate(std::size_t{1} << 22);
+  for (std::size_t i = 0; i < arr.size(); ++i) {
+    arr[i] = i;
+  }
+  arr.Reallocate(std::size_t{1} << 23);
+  EXPECT_EQ(arr[334], 334);
+  EXPECT_EQ(arr[(std::size_t{1} << 22) - 1], (std::size_t{1} << 22) - 1);
+
+  // 同じ配置方針なら領域を保つ
+  arr.SetPlacement(MemoryPlacement{true, NumaPolicy::kInterleave});
+  EXPECT_EQ(arr.size(), std::size_t{1} << 23);
+
+  // 配置方針が変わったら領域を捨てる
+  arr.SetPlacement(MemoryPlacement{false, NumaPolicy::kFirstTouch});
+  EXPECT_EQ(arr.size(), 0);
+  EXPECT_EQ(arr.data(), nullptr);
+  EXPECT_EQ(arr.Placement(), (MemoryPlacement{false, NumaPolicy::kFirstTouch}));
+}
+
+TEST(TableMemory, ZeroFillLazily) {
+  // ページ境界をまたぐよう、先頭と末尾を半端な位置にする
+  std::vector<std::uint8_t> buf((std::size_t{1} << 25) + 334, 0xcc);
+  ZeroFillLazily(buf.data() + 33, buf.size() - 33 - 4, 4);
+
+  EXPECT_TRUE(std::all_of(buf.begin(), buf.begin() + 33, [](std::uint8_t v) { return v == 0xcc; }));
+  EXPECT_TRUE(std::all_of(buf.begin() + 33, buf.end() - 4, [](std::uint8_t v) { return v == 0; }));
+  EXPECT_TRUE(std::all_of(buf.end() - 4, buf.end(), [](std::uint8_t v) { return v == 0xcc; }));
+}
+
+TEST(TableMemory, NoInitAllocator) {
+  std::vector<int, komori::detail::NoInitAllocator<int>> vec;
+  vec.push_back(334);
+  vec.emplace_back(264);
+  vec.resize(4);
+
+  EXPECT_EQ(vec.size(), 4);
+  EXPECT_EQ(vec[0], 334);
+  EXPECT_EQ(vec[1], 264);
+}
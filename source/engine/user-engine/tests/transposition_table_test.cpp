@@ -13,6 +13,7 @@ using komori::tt::CircularEntryPointer;
 using komori::tt::RepetitionTable;
 using komori::tt::detail::kRegularRepetitionRatio;
 using komori::tt::detail::TranspositionTableImpl;
+using testing::_;
 using testing::Return;
 
 namespace {
@@ -20,8 +21,8 @@ namespace {
 struct RegularTableMock {
   static constexpr std::size_t kSizePerEntry = 64;
 
-  MOCK_METHOD(void, Resize, (std::uint64_t));
-  MOCK_METHOD(void, Clear, ());
+  MOCK_METHOD(void, Resize, (std::uint64_t, std::uint32_t));
+  MOCK_METHOD(void, Clear, (std::uint32_t));
   MOCK_METHOD(komori::tt::CircularEntryPointer, PointerOf, (Key));
   MOCK_METHOD(double, CalculateHashRate, (), (const));
   MOCK_METHOD(void, CollectGarbage, (double));
@@ -35,8 +36,8 @@ struct RegularTableMock {
 struct RepetitionTableMock {
   static constexpr std::size_t kSizePerEntry = 16;
 
-  MOCK_METHOD(void, Resize, (std::uint64_t));
-  MOCK_METHOD(void, Clear, ());
+  MOCK_METHOD(void, Resize, (std::uint64_t, std::uint32_t));
+  MOCK_METHOD(void, Clear, (std::uint32_t));
   MOCK_METHOD(double, HashRate, (), (const));
 };
 
@@ -47,6 +48,7 @@ struct QueryMock {
   Key board_key;
   Hand hand;
   Depth depth;
+  komori::tt::KnownResultTable* known_table;
 };
 
 class TranspositionTableTest : public ::testing::Test {
@@ -66,24 +68,35 @@ TEST_F(TranspositionTableTest, Resize) {
 
   std::uint64_t n = 1;
   std::uint64_t m = 1;
-  EXPECT_CALL(tt_.GetRegularTable(), Resize).WillOnce([&](std::uint64_t a) { n = a; });
-  EXPECT_CALL(tt_.GetRepetitionTable(), Resize).WillOnce([&](std::uint64_t b) { m = b; });
-  tt_.Resize(usi_hash_mb);
+  EXPECT_CALL(tt_.GetRegularTable(), Resize(_, 4)).WillOnce([&](std::uint64_t a, std::uint32_t) { n = a; });
+  EXPECT_CALL(tt_.GetRepetitionTable(), Resize(_, 4)).WillOnce([&](std::uint64_t b, std::uint32_t) { m = b; });
+  tt_.Resize(usi_hash_mb, 4);
 
   EXPECT_FLOAT_EQ((1 - kRegularRepetitionRatio) * n * sizeof(komori::tt::Entry), kRegularRepetitionRatio * m * 16);
 }
 
 TEST_F(TranspositionTableTest, NewSearch) {
-  EXPECT_CALL(tt_.GetRepetitionTable(), Clear).Times(1);
+  EXPECT_CALL(tt_.GetRepetitionTable(), Clear(1)).Times(1);
   tt_.NewSearch();
 }
 
 TEST_F(TranspositionTableTest, Clear) {
-  EXPECT_CALL(tt_.GetRegularTable(), Clear).Times(1);
-  EXPECT_CALL(tt_.GetRepetitionTable(), Clear).Times(1);
+  EXPECT_CALL(tt_.GetRegularTable(), Clear(1)).Times(1);
+  EXPECT_CALL(tt_.GetRepetitionTable(), Clear(1)).Times(1);
   tt_.Clear();
 }
 
+TEST_F(TranspositionTableTest, ClearWithThreads) {
+  EXPECT_CALL(tt_.GetRegularTable(), Resize(_, 4));
+  EXPECT_CALL(tt_.GetRepetitionTable(), Resize(_, 4));
+  tt_.Resize(1, 4);
+
+  EXPECT_CALL(tt_.GetRegularTable(), Clear(4)).Times(1);
+  EXPECT_CALL(tt_.GetRepetitionTable(), Clear(4)).Times(2);
+  tt_.Clear();
+  tt_.NewSearch();
+}
+
 TEST_F(TranspositionTableTest, BuildQuery) {
   TestNode test_node{"4k4/9/4G4/9/9/9/9/9/9 b P2r2b3g4s4n4l17p 1", true};
 
@@ -96,6 +109,7 @@ TEST_F(TranspositionTableTest, BuildQuery) {
   EXPECT_EQ(query.board_key, test_node->Pos().state()->board_key());
   EXPECT_EQ(query.hand, test_node->OrHand());
   EXPECT_EQ(query.depth, test_node->GetDepth());
+  EXPECT_EQ(query.known_table, nullptr);
 }
 
 TEST_F(TranspositionTableTest, BuildChildQuery) {
@@ -129,6 +143,15 @@ TEST_F(TranspositionTableTest, BuildQueryByKey_Normal) {
   EXPECT_EQ(query.depth, kDepthMax);
 }
 
+TEST_F(TranspositionTableTest, SetKnownResultTable) {
+  komori::tt::KnownResultTable known_table;
+  tt_.SetKnownResultTable(&known_table);
+
+  EXPECT_CALL(tt_.GetRegularTable(), PointerOf).WillOnce(Return(CircularEntryPointer{nullptr, nullptr, nullptr}));
+  const auto query = tt_.BuildQueryByKey({0x334334334334, HAND_ZERO});
+  EXPECT_EQ(query.known_table, &known_table);
+}
+
 TEST_F(TranspositionTableTest, Hashfull) {
   const double r1 = 0.75;
   const double r2 = 0.5;
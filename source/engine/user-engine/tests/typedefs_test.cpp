@@ -8,8 +8,10 @@ using komori::Delta;
 using komori::kInfinitePnDn;
 using komori::OrdinalNumber;
 using komori::Phi;
+using komori::PnDn;
 using komori::SaturatedAdd;
 using komori::SaturatedMultiply;
+using komori::ScalePnDn;
 using komori::ToString;
 
 namespace {
@@ -67,6 +69,21 @@ TEST(PnDnTest, ClampTest) {
   EXPECT_EQ(ClampPnDn(334, 5, 20), 20);
 }
 
+TEST(PnDnTest, ScaleTest) {
+  EXPECT_EQ(ScalePnDn(10, 1.5), 15);
+  EXPECT_EQ(ScalePnDn(0, 1e30), 0);
+  EXPECT_EQ(ScalePnDn(kInfinitePnDn / 2, 2.5), kInfinitePnDn);
+  EXPECT_EQ(ScalePnDn(kInfinitePnDn, 3.2), kInfinitePnDn);
+  EXPECT_EQ(ScalePnDn(1, 1e300), kInfinitePnDn);
+}
+
+TEST(PnDnTest, InfiniteSumTest) {
+  // 2 つの pn/dn の和はオーバーフローしない
+  EXPECT_GT(kInfinitePnDn + kInfinitePnDn, kInfinitePnDn);
+  EXPECT_EQ(ClampPnDn(SaturatedAdd(kInfinitePnDn, kInfinitePnDn)), kInfinitePnDn);
+  EXPECT_EQ(ClampPnDn(SaturatedAdd(std::numeric_limits<PnDn>::max(), PnDn{1})), kInfinitePnDn);
+}
+
 TEST(PnDnTest, PhiTest) {
   EXPECT_EQ(Phi(33, 4, true), 33);
   EXPECT_EQ(Phi(33, 4, false), 4);
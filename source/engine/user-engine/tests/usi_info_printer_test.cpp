@@ -0,0 +1,71 @@
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../usi_info_printer.hpp"
+
+using komori::UsiInfo;
+using komori::UsiInfoKey;
+using komori::UsiInfoPrinter;
+
+namespace {
+std::string ToString(const UsiInfo& info) {
+  std::ostringstream oss;
+  oss << info;
+  return oss.str();
+}
+}  // namespace
+
+TEST(UsiInfoPrinter, PrintWithoutThread) {
+  std::vector<std::string> outputs;
+  UsiInfoPrinter printer{[&](const UsiInfo& info) { outputs.push_back(ToString(info)); }};
+
+  printer.Stage().PushPVBack(33, "4", "hoge");
+  printer.Post();
+  ASSERT_EQ(outputs.size(), 1);
+  EXPECT_EQ(outputs[0], "info score 4 depth 33 pv hoge");
+}
+
+TEST(UsiInfoPrinter, Flush) {
+  std::vector<std::string> outputs;
+  UsiInfoPrinter printer{[&](const UsiInfo& info) { outputs.push_back(ToString(info)); }};
+  printer.Start();
+  EXPECT_TRUE(printer.IsRunning());
+
+  printer.Stage().PushPVBack(33, "4", "hoge");
+  printer.Post();
+  printer.Flush();
+  ASSERT_EQ(outputs.size(), 1);
+  EXPECT_EQ(outputs[0], "info score 4 depth 33 pv hoge");
+
+  // 前回の内容は Stage() で消える
+  auto& info = printer.Stage();
+  info.Set(UsiInfoKey::kNodes, 264);
+  info.PushPVBack(26, "4", "fuga");
+  printer.Post();
+  printer.Flush();
+  ASSERT_EQ(outputs.size(), 2);
+  EXPECT_EQ(outputs[1], "info nodes 264 score 4 depth 26 pv fuga");
+
+  printer.Stop();
+  EXPECT_FALSE(printer.IsRunning());
+}
+
+TEST(UsiInfoPrinter, StopPrintsPending) {
+  std::vector<std::string> outputs;
+  UsiInfoPrinter printer{[&](const UsiInfo& info) { outputs.push_back(ToString(info)); }};
+  printer.Start();
+
+  for (int i = 0; i < 100; ++i) {
+    printer.Stage().PushPVBack(i, "4", "hoge");
+    printer.Post();
+  }
+  printer.Stop();
+
+  // 出力が追いつかなかった分は捨てられるが、最後に Post() したものは必ず出力される
+  ASSERT_FALSE(outputs.empty());
+  EXPECT_LE(outputs.size(), 100);
+  EXPECT_EQ(outputs.back(), "info score 4 depth 99 pv hoge");
+}
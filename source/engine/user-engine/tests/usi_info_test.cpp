@@ -1,6 +1,8 @@
 #include <gtest/gtest.h>
 
+#include <limits>
 #include <string>
+#include <vector>
 
 #include "../score.hpp"
 #include "../usi_info.hpp"
@@ -82,3 +84,37 @@ TEST_F(UsiInfoTest, TwoPV) {
   const auto ret = ss.str();
   EXPECT_EQ(ret, "info score 334 depth 334 multipv 1 pv fuga\ninfo score 4 depth 33 multipv 2 pv hoge");
 }
+
+TEST_F(UsiInfoTest, Clear) {
+  UsiInfo info;
+  info.Set(UsiInfoKey::kNodes, 2640);
+  info.PushPVBack(33, "4", "hoge");
+  info.Clear();
+  info.PushPVBack(26, "4", "fuga");
+
+  std::stringstream ss;
+  ss << info;
+  EXPECT_EQ(ss.str(), "info score 4 depth 26 pv fuga");
+}
+
+TEST_F(UsiInfoTest, PVMoves) {
+  UsiInfo info;
+  info.Set(UsiInfoKey::kCurrMove, "2c2b+");
+  const std::vector<Move> pv{make_move_promote(SQ_23, SQ_22, B_PAWN), make_move(SQ_11, SQ_22, W_KING),
+                             make_move_drop(GOLD, SQ_23, BLACK)};
+  info.PushPVBack(3, "mate 3", pv);
+
+  std::stringstream ss;
+  ss << info;
+  EXPECT_EQ(ss.str(), "info currmove 2c2b+ score mate 3 depth 3 pv 2c2b+ 1a2b G*2c");
+}
+
+TEST_F(UsiInfoTest, LongValue) {
+  UsiInfo info;
+  info.Set(UsiInfoKey::kNodes, std::numeric_limits<std::uint64_t>::max());
+  info.Set(UsiInfoKey::kCurrMove, std::string(100, 'x'));
+
+  std::stringstream ss;
+  ss << info;
+  EXPECT_EQ(ss.str(), "info nodes 18446744073709551615 currmove " + std::string(31, 'x') + " string ");
+}
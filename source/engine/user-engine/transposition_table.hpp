@@ -4,7 +4,11 @@
 #ifndef KOMORI_TRANSPOSITION_TABLE_HPP_
 #define KOMORI_TRANSPOSITION_TABLE_HPP_
 
+#include <string>
+#include <utility>
+
 #include "board_key_hand_pair.hpp"
+#include "known_result_table.hpp"
 #include "node.hpp"
 #include "regular_table.hpp"
 #include "repetition_table.hpp"
@@ -58,26 +62,65 @@ class TranspositionTableImpl {
   ~TranspositionTableImpl() = default;
 
   /**
-   * @brief 置換表サイズを `hash_size_mb` に変更し、書かれていた内容をすべて消去する。
+   * @brief 通常テーブルと千日手テーブルの配置方針を `placement` に変更する
+   * @param placement 新しい配置方針
+   *
+   * 配置方針は次に領域を確保するときに適用する。方針が変わった場合は置換表の内容を捨てるので、続けて `Resize()` か
+   * `AttachShared()` を呼ぶこと。
+   */
+  void SetPlacement(const MemoryPlacement& placement) noexcept {
+    regular_table_.SetPlacement(placement);
+    repetition_table_.SetPlacement(placement);
+  }
+
+  /**
+   * @brief 置換表サイズを `hash_size_mb` に変更する。
    * @param hash_size_mb 新しい置換表サイズ（MB）
+   * @param num_threads  置換表の初期化に用いるスレッド数
    * @pre `hash_size_mb >= 1`
    *
    * 置換表サイズが `hash_size_mb` 以下になるようにする。通常テーブルと千日手テーブルの合計サイズが
    * `hash_size_mb`[MB] を超えないようにする。
+   *
+   * サイズが変わる場合、通常テーブルの内容はできるだけ引き継ぐ（`RegularTable::Resize()` を参照）。サイズが変わらない
+   * 場合は `Clear()` と同じ。千日手テーブルは `NewSearch()` のたびに消去するので、引き継がない。
+   *
+   * `num_threads` は以降の `NewSearch()` や `Clear()` でも用いる。
    */
-  void Resize(std::uint64_t hash_size_mb) {
-    const auto new_bytes = hash_size_mb * 1024 * 1024;
-    const auto regular_bytes = static_cast<std::uint64_t>(static_cast<double>(new_bytes) * kRegularRepetitionRatio);
-    const auto rep_bytes = new_bytes - regular_bytes;
-    // 通常テーブルに保存する要素数
-    const auto new_num_entries = regular_bytes / RegularTable::kSizePerEntry;
-    // 千日手テーブルはキー1個あたり 16 bytes 使用する。
-    const auto rep_table_size = std::max(decltype(rep_bytes){1}, rep_bytes / RepetitionTable::kSizePerEntry);
+  void Resize(std::uint64_t hash_size_mb, std::uint32_t num_threads = 1) {
+    num_threads_ = std::max<std::uint32_t>(num_threads, 1);
+    const auto [new_num_entries, rep_table_size] = TableSizes(hash_size_mb);
+    regular_table_.Resize(new_num_entries, num_threads_);
+    repetition_table_.Resize(rep_table_size, num_threads_);
+  }
 
-    regular_table_.Resize(new_num_entries);
-    repetition_table_.Resize(rep_table_size);
+  /**
+   * @brief 通常テーブルを POSIX 共有メモリ `name` 上に置き、他のプロセスと共有する。
+   * @param name         共有メモリの名前（`/` から始まる文字列）
+   * @param hash_size_mb 置換表サイズ（MB）。共有メモリがすでに存在する場合、通常テーブルのサイズは既存のものを使う。
+   * @param num_threads  置換表の初期化に用いるスレッド数
+   * @return 接続に成功したら `true`。失敗した場合は `Resize()` と同様にプロセス内に通常テーブルを確保する。
+   *
+   * 千日手テーブルは経路に依存する値を記録し、`NewSearch()` のたびに消去するので、プロセスごとに持つ。
+   * 共有した通常テーブルの中身は `Resize()` で引き継がない。
+   *
+   * @see RegularTable::AttachShared
+   */
+  bool AttachShared(const std::string& name, std::uint64_t hash_size_mb, std::uint32_t num_threads = 1) {
+    num_threads_ = std::max<std::uint32_t>(num_threads, 1);
+    const auto [new_num_entries, rep_table_size] = TableSizes(hash_size_mb);
+    repetition_table_.Resize(rep_table_size, num_threads_);
+    if (regular_table_.AttachShared(name, new_num_entries, num_threads_)) {
+      return true;
+    }
+
+    regular_table_.Resize(new_num_entries, num_threads_);
+    return false;
   }
 
+  /// 通常テーブルが共有メモリ上にあるかどうか
+  bool IsShared() const noexcept { return regular_table_.IsShared(); }
+
   /**
    * @brief 新しい探索を始める
    *
@@ -88,16 +131,26 @@ class TranspositionTableImpl {
    *
    * @see Clear
    */
-  void NewSearch() { repetition_table_.Clear(); }
+  void NewSearch() { repetition_table_.Clear(num_threads_); }
 
   /**
    * @brief 以前の探索結果をすべて消去する。
+   *
+   * 通常テーブルが共有メモリ上にある場合は、接続中のすべてのプロセスの探索結果を消してしまう。
    */
   void Clear() {
-    regular_table_.Clear();
-    repetition_table_.Clear();
+    regular_table_.Clear(num_threads_);
+    repetition_table_.Clear(num_threads_);
   }
 
+  /**
+   * @brief 置換表を引き損ねたときに参照する既知結果テーブルを設定する
+   * @param known_table 既知結果テーブル。使わない場合は `nullptr`。
+   *
+   * 既知結果テーブルは置換表の外で管理する。`known_table` は置換表よりも長生きしなければならない。
+   */
+  void SetKnownResultTable(KnownResultTable* known_table) noexcept { known_table_ = known_table; }
+
   /**
    * @brief 局面 `n` のエントリを読み書きするためのクエリを返す
    * @param n 現局面
@@ -110,7 +163,7 @@ class TranspositionTableImpl {
     const auto depth = n.GetDepth();
 
     auto cluster = regular_table_.PointerOf(board_key);
-    return {repetition_table_, cluster, path_key, board_key, hand, depth};
+    return {repetition_table_, cluster, path_key, board_key, hand, depth, known_table_};
   }
 
   /**
@@ -128,7 +181,7 @@ class TranspositionTableImpl {
     const auto depth = n.GetDepth() + 1;
 
     auto cluster = regular_table_.PointerOf(board_key);
-    return {repetition_table_, cluster, path_key, board_key, hand, depth};
+    return {repetition_table_, cluster, path_key, board_key, hand, depth, known_table_};
   }
 
   /**
@@ -142,7 +195,7 @@ class TranspositionTableImpl {
     const auto [board_key, hand] = key_hand_pair;
     auto cluster = regular_table_.PointerOf(board_key);
     const auto depth = kDepthMax;
-    return {repetition_table_, cluster, path_key, board_key, hand, depth};
+    return {repetition_table_, cluster, path_key, board_key, hand, depth, known_table_};
   }
 
   /**
@@ -205,10 +258,30 @@ class TranspositionTableImpl {
   // </テスト用>
 
  private:
+  /**
+   * @brief 置換表サイズ `hash_size_mb` を通常テーブルと千日手テーブルに振り分ける
+   * @return 通常テーブルの要素数と千日手テーブルの要素数
+   */
+  static std::pair<std::uint64_t, std::uint64_t> TableSizes(std::uint64_t hash_size_mb) noexcept {
+    const auto new_bytes = hash_size_mb * 1024 * 1024;
+    const auto regular_bytes = static_cast<std::uint64_t>(static_cast<double>(new_bytes) * kRegularRepetitionRatio);
+    const auto rep_bytes = new_bytes - regular_bytes;
+    // 通常テーブルに保存する要素数
+    const auto new_num_entries = regular_bytes / RegularTable::kSizePerEntry;
+    // 千日手テーブルはキー1個あたり 16 bytes 使用する。
+    const auto rep_table_size = std::max(decltype(rep_bytes){1}, rep_bytes / RepetitionTable::kSizePerEntry);
+
+    return {new_num_entries, rep_table_size};
+  }
+
   /// 通常テーブル
   RegularTable regular_table_{};
   /// 千日手テーブル
   RepetitionTable repetition_table_{};
+  /// 既知結果テーブル。使わない場合は `nullptr`。
+  KnownResultTable* known_table_{nullptr};
+  /// 置換表の初期化・消去に用いるスレッド数
+  std::uint32_t num_threads_{1};
 };
 }  // namespace detail
 
@@ -8,6 +8,7 @@
 #include <shared_mutex>
 
 #include "board_key_hand_pair.hpp"
+#include "known_result_table.hpp"
 #include "mate_len.hpp"
 #include "regular_table.hpp"
 #include "repetition_table.hpp"
@@ -62,19 +63,22 @@ class Query {
    * @param board_key   盤面ハッシュ値
    * @param hand        持ち駒
    * @param depth       探索深さ
+   * @param known_table 既知結果テーブル。使わない場合は `nullptr`。
    */
   constexpr Query(RepetitionTable& rep_table,
                   CircularEntryPointer initial_entry_pointer,
                   Key path_key,
                   Key board_key,
                   Hand hand,
-                  Depth depth)
+                  Depth depth,
+                  KnownResultTable* known_table = nullptr)
       : rep_table_{&rep_table},
         initial_entry_pointer_{initial_entry_pointer},
         path_key_{path_key},
         board_key_{board_key},
         hand_{hand},
         depth_{depth},
+        known_table_{known_table},
         cached_entry_{&*initial_entry_pointer} {};
 
   /**
@@ -164,6 +168,13 @@ class Query {
       return SearchResult::MakeUnknown(pn, dn, len, amount, sum_mask);
     }
 
+    // 置換表になければ、過去の探索で得た既知の結果を探す
+    if (known_table_ != nullptr) {
+      if (auto known_result = known_table_->LookUp(board_key_, hand_, len)) {
+        return *known_result;
+      }
+    }
+
     const auto [init_pn, init_dn] = std::forward<InitialEvalFunc>(eval_func)();
     pn = std::max(pn, init_pn);
     dn = std::max(dn, init_dn);
@@ -293,6 +304,10 @@ class Query {
       entry->UpdateDisproven(len, amount);
     }
     entry->unlock();
+
+    if (known_table_ != nullptr) {
+      known_table_->Append(board_key_, hand, len, kIsProven, amount);
+    }
   }
 
   /**
@@ -329,6 +344,7 @@ class Query {
   Key board_key_;                               ///< 現局面の盤面ハッシュ値
   Hand hand_;                                   ///< 現局面の持ち駒
   Depth depth_;                                 ///< 現局面の探索深さ
+  KnownResultTable* known_table_;               ///< 既知結果テーブル。使わない場合は `nullptr`。
   mutable Entry* cached_entry_;                 ///< 前回アクセスしたエントリ
 };
 }  // namespace komori::tt
@@ -189,11 +189,18 @@ enum class NodeState {
 /**
  * @brief 証明数／反証数を格納する型
  *
- * 32ビット整数だとすぐにオーバーフローしてしまうので、64ビット整数を用いる。
+ * 32ビット整数だと deep df-pn などで値が大きくなったときにすぐ飽和してしまうので、デフォルトでは64ビット整数を
+ * 用いる。`USE_32BIT_PNDN` を定義すると32ビット整数になり、`SearchResult` や局面展開の作業領域が小さくなる。
+ * どちらの場合も pn/dn の演算は `kInfinitePnDn` で飽和させる。
  */
+#if defined(USE_32BIT_PNDN)
+using PnDn = std::uint32_t;
+#else
 using PnDn = std::uint64_t;
+#endif
 /// pn/dn の最大値。オーバーフローを避けるために、max() より少し小さな値を設定する。
 inline constexpr PnDn kInfinitePnDn = std::numeric_limits<PnDn>::max() / 2 - 1;
+static_assert(kInfinitePnDn <= std::numeric_limits<PnDn>::max() / 2, "The sum of two pn/dn values must not overflow");
 /// pn/dn 値の単位。df-pn+ では「評価値0.5」のような小数を扱いたいので1より大きな値を用いれるようにする。
 inline constexpr PnDn kPnDnUnit = 2;
 /**
@@ -207,6 +214,20 @@ constexpr inline PnDn ClampPnDn(PnDn val, PnDn min = 0, PnDn max = kInfinitePnDn
   return std::clamp(val, min, max);
 }
 
+/**
+ * @brief pn/dn の値 `val` を `ratio` 倍する。計算結果が `kInfinitePnDn` を超える場合は `kInfinitePnDn` で丸める。
+ * @param[in] val   pnまたはdn
+ * @param[in] ratio 倍率（0以上）
+ * @return PnDn `val` を `ratio` 倍した値
+ */
+constexpr inline PnDn ScalePnDn(PnDn val, double ratio) {
+  const double scaled = static_cast<double>(val) * ratio;
+  if (scaled >= static_cast<double>(kInfinitePnDn)) {
+    return kInfinitePnDn;
+  }
+  return static_cast<PnDn>(scaled);
+}
+
 /**
  * @brief φ値を計算する。現局面が `or_node` なら `pn`, そうでないなら `dn` を返す。
  * @param[in] pn pn
@@ -1,3 +1,9 @@
+#include <algorithm>
+#include <fstream>
+#include <optional>
+
+#include "cluster.hpp"
+#include "initial_estimation.hpp"
 #include "komoring_heights.hpp"
 #include "path_keys.hpp"
 #include "thread_initialization.hpp"
@@ -11,22 +17,16 @@ komori::EngineOption g_option;
 std::atomic_bool g_path_key_init_flag;
 
 komori::NodeState g_search_result = komori::NodeState::kUnknown;
+/// クラスタモードのワーカーとして解いているジョブが OR node かどうか。ジョブを解いていないときは `std::nullopt`。
+std::optional<bool> g_cluster_job_or_node;
 
 /// 局面が OR node っぽいかどうかを調べる。困ったら OR node として処理する。
 bool IsPosOrNode(const Position& root_pos) {
-  const Color us = root_pos.side_to_move();
-  const Color them = ~us;
-
-  if (root_pos.king_square(us) == SQ_NB) {
-    return true;
-  } else if (root_pos.king_square(them) == SQ_NB) {
-    return false;
+  if (g_cluster_job_or_node) {
+    return *g_cluster_job_or_node;
   }
 
-  if (root_pos.in_check() && g_option.root_is_and_node_if_checked) {
-    return false;
-  }
-  return true;
+  return komori::IsRootOrNode(root_pos, g_option.root_is_and_node_if_checked);
 }
 
 enum class LoseKind {
@@ -51,10 +51,94 @@ void PrintResult(bool is_mate_search, LoseKind kind, const std::string& pv_moves
     // `KomoringHeights::Search()` 内で出力しているはずなので、ここでは何もする必要がない。
   }
 }
+
+/// ワーカーが解いた局面の探索結果 `result` を、ジョブ `id` の結果としてコーディネータへ返す形に変換する
+komori::ClusterResult ToClusterResult(std::uint64_t id, const komori::SearchResult& result) {
+  const auto state = result.GetNodeState();
+  if (state == komori::NodeState::kProven || state == komori::NodeState::kDisproven) {
+    return {id, result.Pn(), result.Dn(), result.GetFinalData().hand, result.Len().Len(), result.Amount()};
+  }
+
+  // 千日手による不詰はワーカーの探索開始局面までの経路に依存するので、結果不明として返す
+  return {id, std::max<komori::PnDn>(result.Pn(), 1), std::max<komori::PnDn>(result.Dn(), 1), HAND_ZERO, 0,
+          result.Amount()};
+}
 }  // namespace
 
+void position_cmd(Position& pos, std::istringstream& is, StateListPtr& states);
+
 // USI拡張コマンド"user"が送られてくるとこの関数が呼び出される。実験に使ってください。
-void user_test(Position& pos, std::istringstream& is) {}
+//
+// - user resume [path]
+//     置換表スナップショット（省略時は TTSnapshotPath）を読み込み、スナップショットを書き出した探索の開始局面を
+//     現局面に設定する。続けて "go mate infinite" などを送ると、中断した探索の続きから探索できる。
+//     isready で置換表が初期化されるので、isready の後に送ること。SharedHashName を設定している場合は、他のプロセスの
+//     探索結果を消してしまうので使えない。
+//
+// - user worker <address>
+//     クラスタモードのワーカーとして address（ポート番号、host:port または unix:path）で待ち受け、
+//     ClusterWorkers にこのワーカーを設定したエンジンから送られてくる局面を解いて結果を返す。
+//     プロセスが終了するまで待ち受けを続ける。isready の後に送ること。
+void user_test(Position& pos, std::istringstream& is, StateListPtr& states) {
+  std::string token;
+  is >> token;
+
+  if (token == "resume") {
+    if (!USI::load_eval_finished) {
+      sync_cout << "info string error: resume before isready" << sync_endl;
+      return;
+    }
+
+    std::string path;
+    if (!(is >> path)) {
+      path = g_option.tt_snapshot_path;
+    }
+
+    const auto sfen = g_searcher.LoadSnapshot(path);
+    if (!sfen) {
+      sync_cout << "info string error: failed to load snapshot: " << path << sync_endl;
+      return;
+    }
+
+    std::istringstream iss("sfen " + *sfen);
+    position_cmd(pos, iss, states);
+    Threads.main()->last_position_cmd_string = "position sfen " + *sfen;
+    sync_cout << "info string resume: " << path << " (sfen " << *sfen << ")" << sync_endl;
+  } else if (token == "worker") {
+    std::string address;
+    if (!USI::load_eval_finished) {
+      sync_cout << "info string error: worker before isready" << sync_endl;
+      return;
+    } else if (!(is >> address)) {
+      sync_cout << "info string error: worker address is not specified" << sync_endl;
+      return;
+    }
+
+    komori::ClusterWorker worker;
+    if (!worker.Listen(address)) {
+      sync_cout << "info string error: failed to listen: " << address << sync_endl;
+      return;
+    }
+    sync_cout << "info string cluster worker: " << worker.Address() << sync_endl;
+
+    const auto solve = [&](const komori::ClusterJob& job) {
+      std::istringstream iss("sfen " + job.sfen);
+      position_cmd(pos, iss, states);
+
+      Search::LimitsType limits;
+      limits.mate = static_cast<int>(std::min<std::uint64_t>(job.time_ms, INT32_MAX));
+      Time.reset();
+      g_cluster_job_or_node = job.or_node;
+      Threads.start_thinking(pos, states, limits);
+      Threads.main()->wait_for_search_finished();
+      g_cluster_job_or_node.reset();
+
+      return ToClusterResult(job.id, g_searcher.RootResult(pos, job.or_node));
+    };
+    // コーディネータの探索が打ち切られたら、解いている局面の探索も打ち切る
+    worker.Serve(solve, []() { Threads.stop = true; });
+  }
+}
 
 // USIに追加オプションを設定したいときは、この関数を定義すること。
 // USI::init()のなかからコールバックされる。
@@ -76,6 +160,19 @@ void Search::clear() {
   }
   g_option.Reload(Options);
 
+  if (g_option.estimation_param_path.empty()) {
+    komori::ResetEstimationParameters();
+  } else {
+    std::ifstream ifs(g_option.estimation_param_path);
+    if (ifs && komori::LoadEstimationParameters(ifs)) {
+      sync_cout << "info string estimation params: " << g_option.estimation_param_path << sync_endl;
+    } else {
+      komori::ResetEstimationParameters();
+      sync_cout << "info string error: failed to load estimation params: " << g_option.estimation_param_path
+                << sync_endl;
+    }
+  }
+
 #if defined(USE_DEEP_DFPN)
   auto d = g_option.deep_dfpn_d_;
   auto e = g_option.deep_dfpn_e_;
@@ -93,11 +190,25 @@ void MainThread::search() {
   const bool is_mate_search = Search::Limits.mate != 0;
   const bool is_root_or_node = IsPosOrNode(rootPos);
 
-  g_searcher.NewSearch(rootPos, is_root_or_node);
-  Threads.start_searching();
-  Thread::search();
-  Threads.stop = true;
-  Threads.wait_for_search_finished();
+  if (!g_cluster_job_or_node && g_searcher.ReuseSolution(rootPos, is_root_or_node)) {
+    // 直前に解いた詰み手順の途中の局面なので、探索せずに答える
+    g_search_result = komori::NodeState::kProven;
+  } else {
+    g_searcher.NewSearch(rootPos, is_root_or_node);
+    if (!g_cluster_job_or_node) {
+      g_searcher.RunCluster(rootPos, is_root_or_node);
+    }
+    Threads.start_searching();
+    Thread::search();
+    Threads.stop = true;
+    Threads.wait_for_search_finished();
+    g_searcher.FinishSearch();
+  }
+
+  if (g_cluster_job_or_node) {
+    // ワーカーとして解いた結果は user_test() がコーディネータへ返すので、ここでは何も出力しない
+    return;
+  }
 
   Move best_move = MOVE_NONE;
   if (g_search_result == komori::NodeState::kProven) {
@@ -114,6 +225,8 @@ void MainThread::search() {
       PrintResult(is_mate_search, LoseKind::kTimeout);
     }
   }
+  // GUI が次に検討しそうな局面を、次のコマンドが来るまでの間に解いておく
+  g_searcher.StartPreSolve();
 
   if (Search::Limits.mate == 0) {
     // "go infinite"に対してはstopが送られてくるまで待つ。
@@ -4,14 +4,17 @@
 #ifndef KOMORI_USI_HPP_
 #define KOMORI_USI_HPP_
 
-#include <map>
-#include <sstream>
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstdint>
 #include <string>
 #include <string_view>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
-#include "ranges.hpp"
+#include "type_traits.hpp"
 #include "typedefs.hpp"
 
 namespace komori {
@@ -28,6 +31,45 @@ enum class UsiInfoKey {
   // depth, multipv, pv は `UsiInfo::Set()` ではなく  `UsiInfo::PushPVFront()` を用いて設定する。
 };
 
+namespace detail {
+/// `UsiInfoKey` の要素数
+inline constexpr std::size_t kUsiInfoKeyNum = static_cast<std::size_t>(UsiInfoKey::kScore) + 1;
+
+/**
+ * @brief USI info の値 1 つ分を保持する固定長の文字列バッファ
+ *
+ * info の値は数値や指し手、評価値などの短い文字列なので、ヒープを使わずに固定長の配列へ格納する。
+ * 容量を超える文字列は切り詰める。
+ */
+class UsiInfoValue {
+ public:
+  /// 格納できる最大文字数
+  static constexpr std::size_t kCapacity = 31;
+
+  /// 文字列 `val` を格納する
+  constexpr void Assign(std::string_view val) noexcept {
+    len_ = static_cast<std::uint8_t>(std::min(val.size(), kCapacity));
+    for (std::size_t i = 0; i < len_; ++i) {
+      data_[i] = val[i];
+    }
+  }
+
+  /// 整数 `val` の 10 進表記を格納する
+  template <typename T>
+  void AssignNumber(const T& val) noexcept {
+    const auto [ptr, ec] = std::to_chars(data_.data(), data_.data() + kCapacity, val);
+    len_ = ec == std::errc{} ? static_cast<std::uint8_t>(ptr - data_.data()) : 0;
+  }
+
+  /// 格納している文字列
+  constexpr std::string_view View() const noexcept { return {data_.data(), len_}; }
+
+ private:
+  std::array<char, kCapacity> data_{};  ///< 文字列の本体
+  std::uint8_t len_{0};                 ///< 文字列の長さ
+};
+}  // namespace detail
+
 /**
  * @brief USIプロトコルに従い探索情報（info）を整形するクラス
  *
@@ -72,45 +114,46 @@ class UsiInfo {
   friend std::ostream& operator<<(std::ostream& os, const UsiInfo& usi_info) {
     constexpr const char* kKeyNames[] = {"seldepth", "time", "nodes", "nps", "hashfull", "currmove", "score"};
 
-    std::ostringstream oss;
-    oss << "info";
-    const auto& options = usi_info.options_;
-    for (const auto& [key, value] : options) {
-      // - seldepth は depth の直後に渡さなければならない
-      //   MultiPV のとき、PV ごとに depth の値が変わるのでここで seldepth を設定することはできない
-      // - MultiPV のときは `multi_pv_` に設定された score を出力したい。よってここでは score の出力を後回しにする。
-      if (key == UsiInfoKey::kSelDepth || key == UsiInfoKey::kScore) {
-        continue;
-      }
+    // - seldepth は depth の直後に渡さなければならない
+    //   MultiPV のとき、PV ごとに depth の値が変わるのでここで seldepth を設定することはできない
+    // - MultiPV のときは `multi_pv_` に設定された score を出力したい。よってここでは score の出力を後回しにする。
+    const auto print_header = [&]() {
+      os << "info";
+      for (std::size_t i = 0; i < detail::kUsiInfoKeyNum; ++i) {
+        const auto key = static_cast<UsiInfoKey>(i);
+        if (key == UsiInfoKey::kSelDepth || key == UsiInfoKey::kScore || !usi_info.Has(key)) {
+          continue;
+        }
 
-      oss << " " << kKeyNames[static_cast<int>(key)] << " " << value;
-    }
+        os << " " << kKeyNames[i] << " " << usi_info.Get(key);
+      }
+    };
 
-    if (usi_info.multi_pv_.empty()) {
-      if (const auto it = options.find(UsiInfoKey::kSelDepth); it != options.end()) {
-        oss << " depth 0 seldepth " << it->second;
+    if (usi_info.pv_count_ == 0) {
+      print_header();
+      if (usi_info.Has(UsiInfoKey::kSelDepth)) {
+        os << " depth 0 seldepth " << usi_info.Get(UsiInfoKey::kSelDepth);
       }
-      if (const auto it = options.find(UsiInfoKey::kScore); it != options.end()) {
-        oss << " score " << it->second;
+      if (usi_info.Has(UsiInfoKey::kScore)) {
+        os << " score " << usi_info.Get(UsiInfoKey::kScore);
       }
-      oss << " string ";
-      os << oss.str();
+      os << " string ";
     } else {
-      const auto str = oss.str();
-      for (const auto [index, pv_info] : WithIndex(usi_info.multi_pv_)) {
-        const auto& [depth, score, pv] = pv_info;
+      for (std::size_t index = 0; index < usi_info.pv_count_; ++index) {
+        const auto& [depth, score, pv] = usi_info.multi_pv_[index];
 
-        os << str << " score " << score << " depth " << depth;
-        if (const auto it = options.find(UsiInfoKey::kSelDepth); it != options.end()) {
-          os << " seldepth " << it->second;
+        print_header();
+        os << " score " << score.View() << " depth " << depth;
+        if (usi_info.Has(UsiInfoKey::kSelDepth)) {
+          os << " seldepth " << usi_info.Get(UsiInfoKey::kSelDepth);
         }
 
-        if (usi_info.multi_pv_.size() > 1) {
+        if (usi_info.pv_count_ > 1) {
           os << " multipv " << index + 1;
         }
         os << " pv " << pv;
 
-        if (index != usi_info.multi_pv_.size() - 1) {
+        if (index != usi_info.pv_count_ - 1) {
           os << "\n";
         }
       }
@@ -132,40 +175,95 @@ class UsiInfo {
   /// Destructor(default)
   ~UsiInfo() = default;
 
+  /**
+   * @brief 設定済の内容を消去する
+   *
+   * PV を格納していた領域は解放せずに残しておくので、同じ `UsiInfo` を使い回せばヒープ確保が起こらない。
+   */
+  void Clear() noexcept {
+    has_ = 0;
+    pv_count_ = 0;
+  }
+
   /// `key` に `val` を設定する。
-  void Set(UsiInfoKey key, std::string_view val) { options_[key] = val; }
+  void Set(UsiInfoKey key, std::string_view val) {
+    options_[static_cast<std::size_t>(key)].Assign(val);
+    has_ |= 1U << static_cast<std::uint32_t>(key);
+  }
 
-  /// `key` に `std::to_string(val)` を設定する。
-  template <typename T, Constraints<std::enable_if_t<std::is_arithmetic_v<T>>> = nullptr>
+  /// `key` に `val` の 10 進表記を設定する。
+  template <typename T, Constraints<std::enable_if_t<std::is_integral_v<T>>> = nullptr>
   void Set(UsiInfoKey key, const T& val) {
-    Set(key, std::to_string(val));
+    options_[static_cast<std::size_t>(key)].AssignNumber(val);
+    has_ |= 1U << static_cast<std::uint32_t>(key);
   }
 
   /**
-   * @brief PV列の先頭（一番いい手）へ手を追加する。
+   * @brief PV列の末尾（一番悪い手）へ手を追加する。
    * @param depth 探索深さ
    * @param score 探索評価値
    * @param pv    PV
    */
   void PushPVBack(Depth depth, std::string_view score, std::string_view pv) {
-    multi_pv_.emplace_back(PVInfo{depth, std::string{score}, std::string{pv}});
+    auto& info = NextPV(depth, score);
+    info.pv.assign(pv);
+  }
+
+  /**
+   * @brief PV列の末尾（一番悪い手）へ手を追加する。
+   * @param depth 探索深さ
+   * @param score 探索評価値
+   * @param moves PV（`Move` の列）
+   *
+   * `moves` はスペース区切りの文字列に変換して格納する。
+   */
+  template <typename Range,
+            Constraints<std::enable_if_t<
+                std::is_same_v<std::decay_t<decltype(*std::declval<const Range&>().begin())>, Move>>> = nullptr>
+  void PushPVBack(Depth depth, std::string_view score, const Range& moves) {
+    auto& info = NextPV(depth, score);
+    info.pv.clear();
+    for (const auto move : moves) {
+      if (!info.pv.empty()) {
+        info.pv += ' ';
+      }
+      info.pv += USI::move(move);
+    }
   }
 
  private:
   /// MultiPV（PV）で出力する情報たち
   struct PVInfo {
-    Depth depth;        ///< 現在の探索深さ
-    std::string score;  ///< 探索評価値
-    std::string pv;     ///< Principal Variation
+    Depth depth;                 ///< 現在の探索深さ
+    detail::UsiInfoValue score;  ///< 探索評価値
+    std::string pv;              ///< Principal Variation
   };
 
   /// 設定済のオプションの中に `key` が含まれているかどうか判定する。
-  bool Has(UsiInfoKey key) const { return options_.find(key) != options_.end(); }
+  bool Has(UsiInfoKey key) const { return (has_ >> static_cast<std::uint32_t>(key)) & 1; }
+  /// `key` の設定値
+  std::string_view Get(UsiInfoKey key) const { return options_[static_cast<std::size_t>(key)].View(); }
+
+  /// PV を 1 つ追加し、その領域を返す。`pv` は呼び出し元で設定する。
+  PVInfo& NextPV(Depth depth, std::string_view score) {
+    if (pv_count_ == multi_pv_.size()) {
+      multi_pv_.emplace_back();
+    }
+
+    auto& info = multi_pv_[pv_count_++];
+    info.depth = depth;
+    info.score.Assign(score);
+    return info;
+  }
 
-  /// オプションと設定値のペア。
-  std::map<UsiInfoKey, std::string> options_;
-  /// 現在のPVたち（良い順）
+  /// オプションの設定値。`UsiInfoKey` の値を添字とする。
+  std::array<detail::UsiInfoValue, detail::kUsiInfoKeyNum> options_{};
+  /// `options_` のうち設定済のもののビットマスク
+  std::uint32_t has_{0};
+  /// 現在のPVたち（良い順）。先頭 `pv_count_` 個だけが有効で、残りは再利用のために確保したままにしている。
   std::vector<PVInfo> multi_pv_;
+  /// `multi_pv_` のうち有効な要素数
+  std::size_t pv_count_{0};
 };
 }  // namespace komori
 
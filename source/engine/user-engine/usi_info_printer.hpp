@@ -0,0 +1,164 @@
+/**
+ * @file usi_info_printer.hpp
+ */
+#ifndef KOMORI_USI_INFO_PRINTER_HPP_
+#define KOMORI_USI_INFO_PRINTER_HPP_
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#include "usi_info.hpp"
+
+namespace komori {
+/**
+ * @brief 探索情報（`UsiInfo`）の整形と出力をバックグラウンドで行うクラス
+ *
+ * 探索中の info 出力を探索スレッドで行うと、文字列の整形や標準出力への書き込み（GUI 側の読み出しが遅いと
+ * ブロックする）の間、探索が止まってしまう。そこで、探索スレッドは `Stage()` で得た `UsiInfo` に情報を詰めて
+ * `Post()` するだけにして、整形と出力は専用スレッドに任せる。
+ *
+ * `UsiInfo` は 3 面（探索スレッドが書き込む面、出力待ちの面、出力中の面）を swap して受け渡すので、
+ * 定常状態ではヒープ確保が起こらない。出力が追いつかないうちに次の `Post()` が来た場合、古い出力待ちの情報は
+ * 捨てて新しい情報で上書きする。
+ *
+ * スレッドが起動していないときは `Post()` の中で直接出力する。
+ */
+class UsiInfoPrinter {
+ public:
+  /**
+   * @brief コンストラクタ
+   * @param sink `UsiInfo` を実際に出力する関数
+   */
+  explicit UsiInfoPrinter(std::function<void(const UsiInfo&)> sink) : sink_{std::move(sink)} {}
+  /// Copy constructor(delete)
+  UsiInfoPrinter(const UsiInfoPrinter&) = delete;
+  /// Move constructor(delete)
+  UsiInfoPrinter(UsiInfoPrinter&&) = delete;
+  /// Copy assign operator(delete)
+  UsiInfoPrinter& operator=(const UsiInfoPrinter&) = delete;
+  /// Move assign operator(delete)
+  UsiInfoPrinter& operator=(UsiInfoPrinter&&) = delete;
+  /// Destructor。スレッドが起動中なら停止させる。
+  ~UsiInfoPrinter() { Stop(); }
+
+  /**
+   * @brief 出力スレッドを起動する
+   *
+   * すでに起動中の場合は何もしない。
+   */
+  void Start() {
+    if (thread_.joinable()) {
+      return;
+    }
+
+    stop_ = false;
+    thread_ = std::thread([this]() { Run(); });
+  }
+
+  /**
+   * @brief 出力待ちの情報をすべて出力してから出力スレッドを停止する
+   *
+   * スレッドが起動していなければ何もしない。
+   */
+  void Stop() {
+    if (!thread_.joinable()) {
+      return;
+    }
+
+    {
+      const std::lock_guard lock(mutex_);
+      stop_ = true;
+    }
+    cv_.notify_all();
+    thread_.join();
+  }
+
+  /// 出力スレッドが起動中かどうか
+  bool IsRunning() const noexcept { return thread_.joinable(); }
+
+  /**
+   * @brief 次に出力する `UsiInfo` を空にして返す
+   * @return 出力する情報を書き込むための `UsiInfo`
+   * @note `Stage()` と `Post()` は同じスレッドから呼び出すこと
+   */
+  UsiInfo& Stage() noexcept {
+    staged_.Clear();
+    return staged_;
+  }
+
+  /**
+   * @brief `Stage()` で得た `UsiInfo` の出力を依頼する
+   *
+   * 出力スレッドが起動中なら、出力を待たずに返る。
+   */
+  void Post() {
+    if (!thread_.joinable()) {
+      sink_(staged_);
+      return;
+    }
+
+    {
+      const std::lock_guard lock(mutex_);
+      std::swap(staged_, pending_);
+      has_pending_ = true;
+    }
+    cv_.notify_all();
+  }
+
+  /**
+   * @brief `Post()` 済の情報がすべて出力されるまで待つ
+   *
+   * 探索スレッドから直接 `sync_cout` で出力する前に呼び出し、出力順序が入れ替わらないようにする。
+   */
+  void Flush() {
+    if (!thread_.joinable()) {
+      return;
+    }
+
+    std::unique_lock lock(mutex_);
+    cv_.wait(lock, [this]() { return !has_pending_ && !printing_now_; });
+  }
+
+ private:
+  /// スレッド本体。`Stop()` が呼ばれるまで、`Post()` された情報を出力し続ける。
+  void Run() {
+    std::unique_lock lock(mutex_);
+    for (;;) {
+      cv_.wait(lock, [this]() { return stop_ || has_pending_; });
+      if (!has_pending_) {
+        // stop_ かつ出力待ちなし
+        break;
+      }
+
+      std::swap(pending_, printing_);
+      has_pending_ = false;
+      printing_now_ = true;
+
+      // 出力中に Post() がブロックしないよう、ロックを外してから出力する
+      lock.unlock();
+      sink_(printing_);
+      lock.lock();
+
+      printing_now_ = false;
+      cv_.notify_all();
+    }
+  }
+
+  std::function<void(const UsiInfo&)> sink_;  ///< `UsiInfo` を出力する関数
+  std::thread thread_;                        ///< 出力スレッド
+  std::mutex mutex_;                          ///< 停止要求フラグ、出力状態、`pending_` を保護する mutex
+  std::condition_variable cv_;                ///< 出力依頼・出力完了・停止要求の通知用
+  bool stop_{false};                          ///< 停止要求フラグ
+  bool has_pending_{false};                   ///< `pending_` が出力待ちかどうか
+  bool printing_now_{false};                  ///< `printing_` を出力中かどうか
+
+  UsiInfo staged_;    ///< 探索スレッドが書き込む面
+  UsiInfo pending_;   ///< 出力待ちの面
+  UsiInfo printing_;  ///< 出力スレッドが出力中の面
+};
+}  // namespace komori
+
+#endif  // KOMORI_USI_INFO_PRINTER_HPP_
@@ -17,7 +17,8 @@ namespace
 	// Solver本体
 	MateDfpnSolver solver(DfpnSolverType::None);
 
-	std::vector<std::string> solver_types = { "32bitNodeSolver" , "64bitNodeSolver" };
+	std::vector<std::string> solver_types = { "32bitNodeSolver" , "64bitNodeSolver" , "32bitNodeSolverWithGC" , "64bitNodeSolverWithGC" ,
+		"32bitNodeParallelSolver" , "64bitNodeParallelSolver" };
 }
 
 // USIに追加オプションを設定したいときは、この関数を定義すること。
@@ -48,9 +49,20 @@ void  Search::clear()
 		solver.ChangeSolverType(Mate::Dfpn::DfpnSolverType::Node32bit);
 	else if (solver_type == solver_types[1])
 		solver.ChangeSolverType(Mate::Dfpn::DfpnSolverType::Node64bit);
+	else if (solver_type == solver_types[2])
+		solver.ChangeSolverType(Mate::Dfpn::DfpnSolverType::Node32bitWithGC);
+	else if (solver_type == solver_types[3])
+		solver.ChangeSolverType(Mate::Dfpn::DfpnSolverType::Node64bitWithGC);
+	else if (solver_type == solver_types[4])
+		solver.ChangeSolverType(Mate::Dfpn::DfpnSolverType::Node32bitParallel);
+	else if (solver_type == solver_types[5])
+		solver.ChangeSolverType(Mate::Dfpn::DfpnSolverType::Node64bitParallel);
 	else
 		solver.ChangeSolverType(Mate::Dfpn::DfpnSolverType::None);
 
+	// 並列探索版のsolverは、"Threads"で指定された数のスレッドで探索する。(それ以外のsolverでは無視される)
+	solver.set_thread_num(Threads.size());
+
 	u64 mem = Options["USI_Hash"];
 	sync_cout << "info string DfPn memory allocation , USI_Hash = " << mem << " [MB]" << sync_endl;
 	solver.alloc(mem);
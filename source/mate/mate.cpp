@@ -388,6 +388,66 @@ namespace {
 	{
 		return std::make_unique<Mate::Dfpn64::MateDfpnPn<u64,true /* 指し手Orderingあり*/, true /* with hash*/>>();
 	}
+
+	std::unique_ptr<Mate::Dfpn::MateDfpnSolverInterface> BuildNode32bitWithGCSolver()
+	{
+		return std::make_unique<Mate::Dfpn32::MateDfpnPn<u32 , false /* 指し手Orderingなし*/, false /* no hash */, true /* with GC */>>();
+	}
+
+	std::unique_ptr<Mate::Dfpn::MateDfpnSolverInterface> BuildNode16bitOrderingWithGCSolver()
+	{
+		return std::make_unique<Mate::Dfpn32::MateDfpnPn<u32, true /* 指し手Orderingあり*/, false /* no hash */, true /* with GC */>>();
+	}
+
+	std::unique_ptr<Mate::Dfpn::MateDfpnSolverInterface> BuildNode64bitWithGCSolver()
+	{
+		return std::make_unique<Mate::Dfpn64::MateDfpnPn<u64 , false /* 指し手Orderingなし*/, false /* no hash */, true /* with GC */>>();
+	}
+
+	std::unique_ptr<Mate::Dfpn::MateDfpnSolverInterface> BuildNode48bitOrderingWithGCSolver()
+	{
+		return std::make_unique<Mate::Dfpn64::MateDfpnPn<u64,true /* 指し手Orderingあり*/, false /* no hash */, true /* with GC */>>();
+	}
+
+	std::unique_ptr<Mate::Dfpn::MateDfpnSolverInterface> BuildNode32bitParallelSolver()
+	{
+		return std::make_unique<Mate::Dfpn32::MateDfpnPn<u32, false /* 指し手Orderingなし*/, false /* no hash */, false /* no GC */, true /* parallel */>>();
+	}
+
+	std::unique_ptr<Mate::Dfpn::MateDfpnSolverInterface> BuildNode16bitOrderingParallelSolver()
+	{
+		return std::make_unique<Mate::Dfpn32::MateDfpnPn<u32, true /* 指し手Orderingあり*/, false /* no hash */, false /* no GC */, true /* parallel */>>();
+	}
+
+	std::unique_ptr<Mate::Dfpn::MateDfpnSolverInterface> BuildNode64bitParallelSolver()
+	{
+		return std::make_unique<Mate::Dfpn64::MateDfpnPn<u64, false /* 指し手Orderingなし*/, false /* no hash */, false /* no GC */, true /* parallel */>>();
+	}
+
+	std::unique_ptr<Mate::Dfpn::MateDfpnSolverInterface> BuildNode48bitOrderingParallelSolver()
+	{
+		return std::make_unique<Mate::Dfpn64::MateDfpnPn<u64, true /* 指し手Orderingあり*/, false /* no hash */, false /* no GC */, true /* parallel */>>();
+	}
+
+	std::unique_ptr<Mate::Dfpn::MateDfpnSolverInterface> BuildNode32bitParallelWithHashSolver()
+	{
+		return std::make_unique<Mate::Dfpn32::MateDfpnPn<u32, false /* 指し手Orderingなし*/, true /* with hash*/, false /* no GC */, true /* parallel */>>();
+	}
+
+	std::unique_ptr<Mate::Dfpn::MateDfpnSolverInterface> BuildNode16bitOrderingParallelWithHashSolver()
+	{
+		return std::make_unique<Mate::Dfpn32::MateDfpnPn<u32, true /* 指し手Orderingあり*/, true /* with hash*/, false /* no GC */, true /* parallel */>>();
+	}
+
+	std::unique_ptr<Mate::Dfpn::MateDfpnSolverInterface> BuildNode64bitParallelWithHashSolver()
+	{
+		return std::make_unique<Mate::Dfpn64::MateDfpnPn<u64, false /* 指し手Orderingなし*/, true /* with hash*/, false /* no GC */, true /* parallel */>>();
+	}
+
+	std::unique_ptr<Mate::Dfpn::MateDfpnSolverInterface> BuildNode48bitOrderingParallelWithHashSolver()
+	{
+		return std::make_unique<Mate::Dfpn64::MateDfpnPn<u64, true /* 指し手Orderingあり*/, true /* with hash*/, false /* no GC */, true /* parallel */>>();
+	}
 }
 
 namespace Mate::Dfpn
@@ -411,6 +471,18 @@ namespace Mate::Dfpn
 		case DfpnSolverType::Node16bitOrderingWithHash: impl = BuildNode16bitOrderingWithHashSolver(); break;
 		case DfpnSolverType::Node64bitWithHash        : impl = BuildNode64bitWithHashSolver();         break;
 		case DfpnSolverType::Node48bitOrderingWithHash: impl = BuildNode48bitOrderingWithHashSolver(); break;
+		case DfpnSolverType::Node32bitWithGC          : impl = BuildNode32bitWithGCSolver();           break;
+		case DfpnSolverType::Node16bitOrderingWithGC  : impl = BuildNode16bitOrderingWithGCSolver();   break;
+		case DfpnSolverType::Node64bitWithGC          : impl = BuildNode64bitWithGCSolver();           break;
+		case DfpnSolverType::Node48bitOrderingWithGC  : impl = BuildNode48bitOrderingWithGCSolver();   break;
+		case DfpnSolverType::Node32bitParallel                : impl = BuildNode32bitParallelSolver();                 break;
+		case DfpnSolverType::Node16bitOrderingParallel        : impl = BuildNode16bitOrderingParallelSolver();         break;
+		case DfpnSolverType::Node64bitParallel                : impl = BuildNode64bitParallelSolver();                 break;
+		case DfpnSolverType::Node48bitOrderingParallel        : impl = BuildNode48bitOrderingParallelSolver();         break;
+		case DfpnSolverType::Node32bitParallelWithHash        : impl = BuildNode32bitParallelWithHashSolver();         break;
+		case DfpnSolverType::Node16bitOrderingParallelWithHash: impl = BuildNode16bitOrderingParallelWithHashSolver(); break;
+		case DfpnSolverType::Node64bitParallelWithHash        : impl = BuildNode64bitParallelWithHashSolver();         break;
+		case DfpnSolverType::Node48bitOrderingParallelWithHash: impl = BuildNode48bitOrderingParallelWithHashSolver(); break;
 		}
 	}
 
@@ -256,6 +256,10 @@ namespace Mate::Dfpn
 		// 0を指定すると制限なし。デフォルトは0。
 		virtual void set_max_game_ply(int max_game_ply) = 0;
 
+		// 探索に用いるスレッド数。
+		// "Parallel"とついているインスタンスに対して有効。それ以外では無視される。デフォルトは1。
+		virtual void set_thread_num(size_t thread_num) = 0;
+
 		// mate_dfpn()がMOVE_NULL,MOVE_NONE以外を返した場合にその手順を取得する。
 		// ※　最短手順である保証はない。
 		virtual std::vector<Move> get_pv() const = 0;
@@ -295,9 +299,23 @@ namespace Mate::Dfpn
 		Node64bitWithHash,
 		Node48bitOrderingWithHash,
 
-		// ガーベジあり
-
-		// 未実装。気が向いたら実装するが、ふかうら王で使わないと思われるのであまり気が進まない…。
+		// ガーベジあり。メモリを使い切ったら、探索に不要な部分木を開放して探索を続ける。
+		Node32bitWithGC,
+		Node16bitOrderingWithGC,
+		Node64bitWithGC,
+		Node48bitOrderingWithGC,
+
+		// ガーベジなし、並列探索。set_thread_num()で指定したスレッド数で、一つの探索木を共有して探索する。
+		Node32bitParallel,
+		Node16bitOrderingParallel,
+		Node64bitParallel,
+		Node48bitOrderingParallel,
+
+		// ガーベジなし、並列探索、Hash対応。Hash Tableも全スレッドで共有する。
+		Node32bitParallelWithHash,
+		Node16bitOrderingParallelWithHash,
+		Node64bitParallelWithHash,
+		Node48bitOrderingParallelWithHash,
 	};
 
 	// MateDfpnSolverInterfaceの入れ物。
@@ -334,6 +352,10 @@ namespace Mate::Dfpn
 		// 0を指定すると制限なし。デフォルトは0。
 		virtual void set_max_game_ply(int max_game_ply) { impl->set_max_game_ply(max_game_ply); }
 
+		// 探索に用いるスレッド数。
+		// "Parallel"とついているインスタンスに対して有効。それ以外では無視される。デフォルトは1。
+		virtual void set_thread_num(size_t thread_num) { impl->set_thread_num(thread_num); }
+
 		// mate_dfpn()がMOVE_NULL,MOVE_NONE以外を返した場合にその手順を取得する。
 		// ※　最短手順である保証はない。
 		virtual std::vector<Move> get_pv() const { return impl->get_pv(); }
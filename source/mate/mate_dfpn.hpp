@@ -32,17 +32,51 @@
 
 	そもそも、Node構造体は無限に増えていくので、そんなところに同期化のためのデータを保持しているのが設計上の誤り。
 	mutex事前に65536個ほどどこかに確保しておいて、Positionのhash keyの下位16bitを使って、そのmutex選んで使うなどすれば良い。
+
+	// →　Parallelを指定したsolverでは、バッファ上のNodeの位置の下位16bitでmutexを選ぶようにして並列化した。(NodeLockTable)
+	//     各スレッドは一つの探索木を共有して、virtual lossで他のスレッドが探索中の子を避けながら探索する。
 */
 
 //#define DFPN64
 
 #if defined(DFPN64) || defined(DFPN32)
 
+#include <array>
+#include <atomic>
 #include <mutex>
+#include <thread>
 #include "../position.h"
 #include "../thread.h"
 #include "mate_move_picker.h"
 
+// このファイルはDFPN64とDFPN32とで2回includeされるので、共通の定義は1回だけにする。
+#if !defined(MATE_DFPN_RELAXED_ATOMIC_DEFINED)
+#define MATE_DFPN_RELAXED_ATOMIC_DEFINED
+namespace Mate::Dfpn
+{
+	// Nodeのpn,dnを保持する型。
+	// 並列探索では、lockを取らずにpn,dnを読んだり(探索の打ち切り判定)、親ノードのlockだけを取って子ノードのpn,dnを
+	// 読んだり(SummarizeNode()など)するので、std::atomicにしておかないとdata raceになる。
+	// 値の大小を比べるのに使うだけで、他の変数との間の順序は問題にならないので、memory_order_relaxedで読み書きする。
+	// (x86ではrelaxedなload/storeは普通のmovになるので、並列探索でないsolverが遅くなることはない)
+	template <typename T>
+	struct RelaxedAtomic
+	{
+		RelaxedAtomic() = default;
+		RelaxedAtomic(const RelaxedAtomic& rhs) : value(rhs.load()) {}
+		RelaxedAtomic& operator=(const RelaxedAtomic& rhs) { store(rhs.load()); return *this; }
+		RelaxedAtomic& operator=(T v) { store(v); return *this; }
+		operator T() const { return load(); }
+
+		T load() const { return value.load(std::memory_order_relaxed); }
+		void store(T v) { value.store(v, std::memory_order_relaxed); }
+
+	private:
+		std::atomic<T> value;
+	};
+}
+#endif
+
 #if defined (DFPN64)
 // Node数が64bitで表現できる数まで扱える版
 namespace Mate::Dfpn64
@@ -75,7 +109,8 @@ namespace Mate::Dfpn64
 		// 
 		//   df-pnでANDノードのdn,pnの役割を入れ替えて考えれば、ORノードとANDノードとで場合分けが無くせるのだが、
 		//   PVを取得する時や、1手詰めを考える時などにそこで場合分けが必要となるから、この実装ではやらない。
-		NodeCountType pn, dn;
+		//   並列探索では複数のスレッドから読み書きされるので、RelaxedAtomicで持つ。
+		Mate::Dfpn::RelaxedAtomic<NodeCountType> pn, dn;
 
 		// このノードに至るための直前の指し手
 		Move lastMove;
@@ -205,7 +240,8 @@ namespace Mate::Dfpn32
 		// 
 		//   df-pnでANDノードのdn,pnの役割を入れ替えて考えれば、ORノードとANDノードとで場合分けが無くせるのだが、
 		//   PVを取得する時や、1手詰めを考える時などにそこで場合分けが必要となるから、この実装ではやらない。
-		NodeCountType pn, dn;
+		//   並列探索では複数のスレッドから読み書きされるので、RelaxedAtomicで持つ。
+		Mate::Dfpn::RelaxedAtomic<NodeCountType> pn, dn;
 
 		// このノードに至るための直前の指し手
 		// Moveは21bitであることが保証されているので、23bitだけ使う。残り1byteは、child_numの格納のために用いる。
@@ -300,14 +336,16 @@ namespace Mate::Dfpn32
 	// ===================================
 
 	// Nodeのためのバッファを表現する。
-	// これは先頭からリニアに使っていく。GCは考えない。
+	// これは先頭からリニアに使っていく。
+	// GCありのsolverでは、free_node()で返却されたブロックをブロックの大きさごとの連結リストで管理しておき、
+	// new_node_recycled()で再利用する。
 	template <typename NodeCountType , bool MoveOrdering>
 	struct NodeManager
 	{
 		// このクラスで扱うノード型
 		typedef Node<NodeCountType,MoveOrdering> NodeType;
 
-		NodeManager() :node_index(0), nodes_num(0) {}
+		NodeManager() :node_index(0), nodes_num(0), free_nodes_num(0) { free_list.fill(nullptr); }
 
 		// メモリ確保。size_個分Nodeが確保される。
 		void alloc(size_t size_) {
@@ -326,23 +364,103 @@ namespace Mate::Dfpn32
 
 		// Nodeをsize個分確保して、その先頭のアドレスを返す。
 		// 確保できない時はnullptrが返る。
+		// 並列探索では複数のスレッドから同時に呼び出されるので、空きがあることを確かめてからcompare_exchangeでnode_indexを進める。
+		// (先にfetch_addで進めてから戻すと、その間node_indexが末尾を超えていて、他のスレッドがout_of_memory()を誤判定する)
 		NodeType* new_node(size_t size = 1)
 		{
-			//std::lock_guard<std::mutex> lk(mutex);
-			// 並列化対応はまたの機会に…。
+			NodeCountType index = node_index.load();
+			do {
+				if (index + MaxCheckMoves >= nodes_num)
+					return nullptr;
+			} while (!node_index.compare_exchange_weak(index, index + (NodeCountType)size));
+
+			return &nodes[index];
+		}
+
+		// Nodeをsize個分確保して、その先頭のアドレスを返す。
+		// free_node()で返却されたブロックがあれば、それを優先して使う。
+		// 同じ大きさのブロックがなければ、それより大きなブロックを切り分けて使う。
+		// 確保できない時はnullptrが返る。
+		NodeType* new_node_recycled(size_t size = 1)
+		{
+			ASSERT_LV3(0 < size && size <= MaxCheckMoves);
+
+			// 同じ大きさのブロックがないなら、なるべく小さなブロックから切り分ける。
+			size_t block_size = size;
+			while (block_size <= MaxCheckMoves && free_list[block_size] == nullptr)
+				++block_size;
+
+			if (block_size > MaxCheckMoves)
+				return new_node(size);
+
+			NodeType* node = free_list[block_size];
+			free_list[block_size] = get_children(node);
+			free_nodes_num -= (NodeCountType)block_size;
 
-			if (is_out_of_memory())
-				return nullptr;
+			// 余った分は、その大きさのブロックとして返却しておく。
+			if (block_size > size)
+				free_node(node + size, block_size - size);
 
-			NodeType* node = &nodes[node_index];
-			node_index += (NodeCountType)size;
 			return node;
 		}
 
+		// new_node()/new_node_recycled()でsize個分確保したブロックを返却する。
+		// 返却したブロックの先頭のNodeのchildrenを、次の空きブロックへのリンクとして使う。
+		void free_node(NodeType* node, size_t size)
+		{
+			ASSERT_LV3(0 < size && size <= MaxCheckMoves);
+
+			set_children(node, free_list[size]);
+			free_list[size] = node;
+			free_nodes_num += (NodeCountType)size;
+		}
+
+		// 返却されたブロックのうち、隣接しているものをつなげて大きなブロックにする。
+		// 返却されたブロックが細切れのままだと、大きなブロックを確保できなくなるので、GCの後に呼び出すと良い。
+		// バッファの末尾の空きは、new_node()で先頭からリニアに使う領域に戻す。
+		void defragment()
+		{
+			std::vector<bool> is_free(node_index);
+			for (size_t size = 1; size <= MaxCheckMoves; ++size)
+				for (NodeType* node = free_list[size]; node != nullptr; node = get_children(node))
+				{
+					size_t index = node - nodes.get();
+					std::fill(is_free.begin() + index, is_free.begin() + index + size, true);
+				}
+
+			free_list.fill(nullptr);
+			free_nodes_num = 0;
+
+			NodeCountType end = node_index;
+			while (end > 0 && is_free[end - 1])
+				--end;
+			node_index = end;
+
+			for (NodeCountType i = 0; i < end; )
+			{
+				if (!is_free[i])
+				{
+					++i;
+					continue;
+				}
+
+				// free_listで扱えるのはMaxCheckMoves個までのブロックなので、それを超える分は分けて返却する。
+				NodeCountType j = i;
+				while (j < end && is_free[j] && j - i < MaxCheckMoves)
+					++j;
+				free_node(&nodes[i], j - i);
+				i = j;
+			}
+		}
+
 		// 内部カウンターのリセット。
 		// 次回のnew_node()でまた1番目の要素が返るようになる。
 		// 新しい局面の探索の開始時に呼び出すと良い。
-		void reset_counter() { node_index = 0; }
+		void reset_counter() {
+			node_index = 0;
+			free_list.fill(nullptr);
+			free_nodes_num = 0;
+		}
 
 		// alloc()で確保されたバッファを使い切ったのか。
 		bool is_out_of_memory() const {
@@ -350,8 +468,11 @@ namespace Mate::Dfpn32
 			return node_index + MaxCheckMoves >= nodes_num;
 		}
 
-		// hash使用率を1000分率で返す。
-		int hashfull() const { return (int)((u64)node_index * 1000 / nodes_num); }
+		// free_node()で返却されて、まだ再利用されていないNodeの数。
+		NodeCountType free_nodes() const { return free_nodes_num; }
+
+		// hash使用率を1000分率で返す。返却されたNodeは使用していないものとして数える。
+		int hashfull() const { return (int)((u64)(node_index - free_nodes_num) * 1000 / nodes_num); }
 
 
 #if defined(DFPN32)
@@ -391,7 +512,7 @@ namespace Mate::Dfpn32
 		// DFPN32の時と同一のinterfaceにするために必要。
 
 		NodeType* get_children(const NodeType* node) const { return node->children; }
-		void set_children(NodeType* node, const NodeType* next) const { node->children = next; }
+		void set_children(NodeType* node, const NodeType* next) const { node->children = const_cast<NodeType*>(next); }
 		NodeType* node_index_to_node(NodeType* n) const { return n; }
 		NodeType* node_to_node_index(NodeType* node) const { return node; }
 #endif
@@ -408,8 +529,48 @@ namespace Mate::Dfpn32
 		// 次に返すべきnode用のカウンター
 		std::atomic<NodeCountType> node_index;
 
-		// ↑を返す時に必要となるlock
-		//std::mutex mutex;
+		// free_node()で返却されたブロックの連結リストの先頭。free_list[size]は大きさがsizeのブロック。
+		std::array<NodeType*, MaxCheckMoves + 1> free_list;
+
+		// free_listにつながっているNodeの総数
+		NodeCountType free_nodes_num;
+	};
+
+	// ===================================
+	//   並列探索用のlock
+	// ===================================
+
+	// 並列探索の時に、Nodeごとのlockとvirtual lossを管理する。
+	// Node構造体にstd::mutexを持たせるとNodeが大きくなりすぎるので、Nodeのアドレスから引く固定サイズのtableに持たせる。
+	// 異なるNodeが同じentryを使うことがあるが、余分に待たされたり、virtual lossが余分に見えたりするだけで探索結果は変わらない。
+	template <typename NodeType>
+	struct NodeLockTable
+	{
+		// entryの数。2の累乗であること。
+		static constexpr size_t Size = 65536;
+
+		struct Entry
+		{
+			// このentryを使うNodeの、子ノードの展開・選択と、pn,dnの集計を排他するためのlock
+			std::mutex mutex;
+
+			// このentryを使うNodeを探索中のスレッドの数
+			std::atomic<u32> virtual_loss{ 0 };
+		};
+
+		// tableを確保する。確保済みなら何もしない。
+		void alloc()
+		{
+			if (!entries)
+				entries = std::make_unique<Entry[]>(Size);
+		}
+
+		// nodeに対応するentryを返す。
+		// 兄弟のNodeは連続したアドレスに並んでいるので、別々のentryになる。
+		Entry& operator[](const NodeType* node) const { return entries[((uintptr_t)node / sizeof(NodeType)) & (Size - 1)]; }
+
+	private:
+		std::unique_ptr<Entry[]> entries;
 	};
 
 
@@ -419,9 +580,14 @@ namespace Mate::Dfpn32
 
 	// df-pn詰将棋ルーチン本体
 	// 事前にメモリ確保やら何やらしないといけないのでクラス化してある。
-	template <typename NodeCountType , bool MoveOrdering , bool WithHash >
+	// WithGC : メモリを使い切った時に、探索に不要な部分木を開放して探索を続けるか。
+	// Parallel : set_thread_num()で指定された数のスレッドで、一つの探索木を共有して探索するか。
+	template <typename NodeCountType , bool MoveOrdering , bool WithHash , bool WithGC = false , bool Parallel = false >
 	class MateDfpnPn : public Mate::Dfpn::MateDfpnSolverInterface
 	{
+		// GCは探索中の全スレッドを止めないとできないので、並列探索とは併用できない。
+		static_assert(!(WithGC && Parallel), "WithGC and Parallel cannot be used together.");
+
 	public:
 		// このクラスで扱うノード型
 		typedef Node<NodeCountType,MoveOrdering> NodeType;
@@ -435,6 +601,9 @@ namespace Mate::Dfpn32
 			// 使っていいメモリサイズ。
 			size_t size = size_mb * 1024 * 1024;
 			node_manager.alloc(size / sizeof(Node<NodeCountType,MoveOrdering>));
+
+			if (Parallel)
+				node_locks.alloc();
 		}
 
 		// 探索ノード数の上限を指定してメモリを確保する。
@@ -445,6 +614,9 @@ namespace Mate::Dfpn32
 			release();
 
 			node_manager.alloc(nodes_limit);
+
+			if (Parallel)
+				node_locks.alloc();
 		}
 
 		// Hash Tableの設定。
@@ -470,6 +642,13 @@ namespace Mate::Dfpn32
 			this->max_game_ply = max_game_ply;
 		}
 
+		// 探索に用いるスレッド数。
+		// 並列探索版(Parallel == true)でなければ無視される。デフォルトは1。
+		virtual void set_thread_num(size_t thread_num)
+		{
+			this->thread_num = std::max(thread_num, (size_t)1);
+		}
+
 		// 詰み探索をしてnodes_limit内のノード数で解ければその初手が返る。
 		// 不詰が証明できれば、MOVE_NULL、解がわからなかった場合は、MOVE_NONEが返る。
 		// nodes_limit : ノード制限。0を指定するとノード制限なし。(ただしメモリの制限から解けないことはある)
@@ -485,12 +664,39 @@ namespace Mate::Dfpn32
 			// カウンターのリセットをしておかないと新しいメモリが使えない。
 			node_manager.reset_counter();
 			out_of_memory = false;
+			search_path.clear();
 
 			// RootNodeを展開する。
 			ExpandRoot(pos);
 
 			// あとはrootから良さげなところを最良優先探索するのを繰り返すだけで解けるのでは…。
-			ParallelSearch(pos);
+			if (Parallel && thread_num > 1)
+			{
+				// 探索を始めるとposは書き換わるので、スレッドごとの局面を作るための情報は先に取り出しておく。
+				auto sfen = pos.sfen();
+				StateInfo root_state = *pos.state();
+				Thread* root_thread = pos.this_thread();
+
+				std::vector<std::thread> helpers;
+				for (size_t i = 1; i < thread_num; ++i)
+					helpers.emplace_back([&]() {
+						// StateInfoをコピーしておけば、rootより前の局面も千日手の判定で遡れる。
+						// (ThreadPool::start_thinking()と同じやり方)
+						Position helper_pos;
+						StateInfo si;
+						helper_pos.set(sfen, &si, root_thread);
+						si = root_state;
+
+						ParallelSearch(helper_pos);
+					});
+
+				ParallelSearch(pos);
+
+				for (auto& th : helpers)
+					th.join();
+			}
+			else
+				ParallelSearch(pos);
 
 			// 詰んだ
 			if (current_root->pn == 0 && current_root->dn >= NodeType::DNPN_MATE)
@@ -539,7 +745,8 @@ namespace Mate::Dfpn32
 		}
 
 		// mate_dfpn()でMOVE_NONE以外が返ってきた時にメモリが不足しているかを返す。
-		virtual bool is_out_of_memory() const { return node_manager.is_out_of_memory(); }
+		// GCありの時は、GCをしてもメモリが確保できなかったかを返す。
+		virtual bool is_out_of_memory() const { return WithGC ? (bool)out_of_memory : node_manager.is_out_of_memory(); }
 
 		// hash使用率を1000分率で返す。
 		virtual int hashfull() const { return node_manager.hashfull(); }
@@ -693,6 +900,10 @@ namespace Mate::Dfpn32
 		{
 			ASSERT_LV3(node->pn <= second_pn && node->dn <= second_dn);
 
+			// GCで探索中の経路上のノードを開放しないように、経路を記録しておく。
+			if (WithGC)
+				search_path.push_back(node);
+
 			// or nodeでpnがsecond_pnを上回ると、２つ上のnodeで、second_pnであった子ノードを選んだほうが良いことになる。
 			// and nodeでdnがsecond_dnを上回ると、以下同様。
 			 while (
@@ -702,12 +913,7 @@ namespace Mate::Dfpn32
 				 && node->dn
 				 && !out_of_memory
 				 //&& (!nodes_limit || nodes_searched < nodes_limit)
-				 && (!nodes_limit ||
-						 ( MoveOrdering && (nodes_limit - nodes_searched > (std::max(current_root->pn, node->pn) >>16) )) ||
-						 (!MoveOrdering && (nodes_limit - nodes_searched > (std::max(current_root->pn, node->pn)))))
-				 // pnはMoveOrdering有りだと 2**16 されていることに注意。
-				 // 残り探索ノード数がpnを上回ると証明不可。不詰は証明できるかもしれないが、不詰の証明はあまり価値がないのでこの状況下ならできなくていいと思う。
-				 // ↑この枝刈りは、やねうらお考案。leaf nodeから呼び出すときに3%ぐらいnps上がる。
+				 && within_nodes_limit(node)
 				 && !Threads.stop // スレッド停止命令が来たら即座に終了する。
 				)
 			{
@@ -716,18 +922,40 @@ namespace Mate::Dfpn32
 				 std::cout << pos << std::endl;
 #endif
 
-				u8 child_num = node->child_num;
-				if (child_num == NodeType::CHILDNUM_NOT_INIT)
+				NodeCountType second_pn2 = second_pn;
+				NodeCountType second_dn2 = second_dn;
+				NodeType* best_child;
 				{
-					ExpandNode<or_node>(pos, node);
-					// 今回はこれを展開しただけで良しとする。
+					// 並列探索の時は、他のスレッドが同じnodeを展開したり、展開中のnodeの子を選んだりしないようにlockしておく。
+					auto lk = lock_node(node);
 
-					continue;
-				}
+					// 並列探索の時は、lockを待っている間に他のスレッドがこのnodeを解いていることがある。
+					// (子のないnodeであれば、child_num == 0なので子を選べない)
+					if (Parallel && (node->pn == 0 || node->dn == 0))
+						break;
 
-				NodeCountType second_pn2 = second_pn;
-				NodeCountType second_dn2 = second_dn;
-				auto best_child = select_the_best_child<or_node>(node, second_pn2, second_dn2);
+					u8 child_num = node->child_num;
+					if (child_num == NodeType::CHILDNUM_NOT_INIT)
+					{
+						ExpandNode<or_node>(pos, node);
+						// 今回はこれを展開しただけで良しとする。
+
+						continue;
+					}
+
+					best_child = select_the_best_child<or_node>(node, second_pn2, second_dn2);
+
+					if (Parallel)
+					{
+						// この子を探索している間は、他のスレッドからはvirtual lossの分だけpn,dnが大きく見えるようにする。
+						node_locks[best_child].virtual_loss++;
+
+						// virtual lossや他のスレッドの探索結果のせいで、選んだ子のpn,dnがすでに閾値を超えていることがある。
+						// そのまま子に行くと何もせずに戻ってくるのを繰り返すことになるので、少なくとも一度は子を探索させる。
+						second_pn2 = std::max(second_pn2, best_child->pn.load());
+						second_dn2 = std::max(second_dn2, best_child->dn.load());
+					}
+				}
 
 				// 一手進めて子ノードに行く
 				StateInfo si;
@@ -738,7 +966,13 @@ namespace Mate::Dfpn32
 				ParallelSearch<!or_node>(pos, best_child ,second_pn2 , second_dn2);
 
 				// 子ノードから返ってきたので、子ノードのdn,pnを集計する。
-				SummarizeNode<or_node>(node);
+				{
+					auto lk = lock_node(node);
+					SummarizeNode<or_node>(node);
+				}
+
+				if (Parallel)
+					node_locks[best_child].virtual_loss--;
 
 				pos.undo_move(m);
 
@@ -763,6 +997,9 @@ namespace Mate::Dfpn32
 				}
 
 			 }
+
+			if (WithGC)
+				search_path.pop_back();
 		}
 
 		// あるnodeの子ノードのなかから、一番良さげなNodeを選択する。
@@ -783,7 +1020,7 @@ namespace Mate::Dfpn32
 			{
 				// 攻め方は、一番詰やすそうな(pn最小)のところを選ぶ。
 				for (u32 i = 1; i < child_num; ++i)
-					if (children[i].pn < children[selected_index].pn)
+					if (virtual_pn(children[i]) < virtual_pn(children[selected_index]))
 						selected_index = i;
 
 				// 2つ目に小さなpnを探す。selected_indexを除いて最小を探す。
@@ -791,8 +1028,8 @@ namespace Mate::Dfpn32
 				for (u32 i = 0; i < child_num; ++i)
 					if (i != selected_index)
 					{
-						if (children[i].pn < pn2)
-							pn2 = children[i].pn;
+						if (virtual_pn(children[i]) < pn2)
+							pn2 = virtual_pn(children[i]);
 
 						// dnは、子ノードのdnの和になるから、次に進む子ノードのdnをdn_nextとして、残りの子ノードのdnの和が dn_sumが
 						// dn_next + dn_sum > second_dn になったら子ノードの探索を終わりたいので、
@@ -812,14 +1049,14 @@ namespace Mate::Dfpn32
 			else {
 				// 受け方は、一番詰みにくそうな(dn最小)のところを選ぶ
 				for (u32 i = 1; i < child_num; ++i)
-					if (children[i].dn < children[selected_index].dn)
+					if (virtual_dn(children[i]) < virtual_dn(children[selected_index]))
 						selected_index = i;
 
 				for (u32 i = 0; i < child_num; ++i)
 					if (i != selected_index)
 					{
-						if (children[i].dn < dn2)
-							dn2 = children[i].dn;
+						if (virtual_dn(children[i]) < dn2)
+							dn2 = virtual_dn(children[i]);
 
 						if (children[i].pn < NodeType::DNPN_MATE)
 							pn2 -= children[i].pn;
@@ -835,6 +1072,51 @@ namespace Mate::Dfpn32
 			return &children[selected_index];
 		}
 
+		// 子ノードを選ぶ時に用いるpn,dn。
+		// 並列探索の時は、他のスレッドが探索中の子ほど選ばれにくくなるように、探索中のスレッド1つにつき
+		// 未展開の子ノード1つ分(VirtualLoss)だけ大きく見せる。詰み/不詰が証明済みの値はそのまま。
+		// 和をとって閾値を求める方(ORノードのdn、ANDノードのpn)は、実際の値を用いる。
+		NodeCountType virtual_pn(const NodeType& child) const { return Parallel ? add_virtual_loss(child, child.pn) : child.pn; }
+		NodeCountType virtual_dn(const NodeType& child) const { return Parallel ? add_virtual_loss(child, child.dn) : child.dn; }
+
+		NodeCountType add_virtual_loss(const NodeType& child, NodeCountType value) const
+		{
+			if (value == 0 || value >= NodeType::DNPN_MATE)
+				return value;
+
+			u32 count = node_locks[&child].virtual_loss.load(std::memory_order_relaxed);
+			if (count == 0)
+				return value;
+
+			// 証明済みの値と区別がつかなくならないように、DNPN_MATE未満で頭打ちにする。
+			NodeCountType loss = (NodeCountType)count * VirtualLoss;
+			return loss < NodeType::DNPN_MATE - value ? value + loss : NodeCountType(NodeType::DNPN_MATE - 1);
+		}
+
+		// 並列探索の時にnodeをlockする。並列探索でなければ何もしない。
+		std::unique_lock<std::mutex> lock_node(const NodeType* node) const
+		{
+			return Parallel ? std::unique_lock<std::mutex>(node_locks[node].mutex) : std::unique_lock<std::mutex>();
+		}
+
+		// 残り探索ノード数で、まだ詰みを証明できる見込みがあるか。
+		bool within_nodes_limit(const NodeType* node) const
+		{
+			if (!nodes_limit)
+				return true;
+
+			// 並列探索の時は、他のスレッドの分で、すでにnodes_limitを超えていることがある。
+			NodeCountType searched = nodes_searched;
+			if (searched >= nodes_limit)
+				return false;
+
+			// pnはMoveOrdering有りだと 2**16 されていることに注意。
+			// 残り探索ノード数がpnを上回ると証明不可。不詰は証明できるかもしれないが、不詰の証明はあまり価値がないのでこの状況下ならできなくていいと思う。
+			// ↑この枝刈りは、やねうらお考案。leaf nodeから呼び出すときに3%ぐらいnps上がる。
+			NodeCountType pn = std::max(current_root->pn, node->pn);
+			return nodes_limit - searched > (MoveOrdering ? pn >> 16 : pn);
+		}
+
 		// あるnodeにぶら下がっている子ノードのpn,dnを集計して、このnodeのpn,dnに反映させる。
 		template <bool or_node>
 		void SummarizeNode(NodeType* node)
@@ -953,7 +1235,7 @@ namespace Mate::Dfpn32
 
 			// 開始局面は or nodeでござる。
 			constexpr bool or_node = true;
-			current_root->child_num = NodeType::CHILDNUM_NOT_INIT;
+			current_root->set_child(NodeType::CHILDNUM_NOT_INIT);
 			ExpandNode<or_node>(pos, current_root);
 
 			root_game_ply =  pos.game_ply();
@@ -1179,7 +1461,8 @@ namespace Mate::Dfpn32
 			}
 
 
-			node->child_num = child_num;
+			// child_numは、子ノードの配列を確保できてから、set_child()でchildrenと一緒に設定する。
+			// (確保に失敗した時に、子があるのにchildrenがnullptrのnodeを残さないため。並列探索では他のスレッドがそれを辿ってしまう)
 
 			if (child_num == 0)
 			{
@@ -1207,16 +1490,146 @@ namespace Mate::Dfpn32
 		}
 
 		// 新しいnodeを一つ確保して返す。確保できない時はnullptrが返る。
+		// GCありの時は、確保できなければGCをしてからもう一度確保を試みる。
 		NodeType* new_node(size_t size = 1) {
-			auto node = node_manager.new_node(size);
+			NodeType* node;
+			if (WithGC)
+			{
+				node = node_manager.new_node_recycled(size);
+				if (node == nullptr)
+				{
+					GarbageCollect();
+					node = node_manager.new_node_recycled(size);
+				}
+			}
+			else
+				node = node_manager.new_node(size);
+
 			if (node == nullptr)
 				out_of_memory = true;
 			return node;
 		}
 
+		// ===================================
+		//   GC
+		// ===================================
+
+		// 探索に不要な部分木を開放する。
+		// 探索中の経路上のノードと、その子ノードの配列は開放しない。(探索部がポインターを保持しているため)
+		// 以下の順に、役に立たなさそうな部分木から開放していき、バッファの1/4が空くか、開放するものがなくなったら終了する。
+		//  level 0 : 詰み/不詰が証明済みのノードの子孫のうち、詰み手順に不要な部分木
+		//            (詰みなら詰み手順の子以外の部分木、不詰なら部分木のすべて)
+		//  level 1 : 未解決のノードの子のうち、次に選ばれる子(ORノードならpn最小、ANDノードならdn最小の子)と比べて
+		//            pn(ORノード)/dn(ANDノード)が4倍より大きい、当分選ばれそうにない子の部分木
+		//  level 2 : 未解決のノードの子のうち、次に選ばれる子以外の部分木
+		//  level 3 : 探索中の経路上のノードの子以外のすべての部分木
+		// level 1～3では、root付近の大きな部分木をいきなり開放しないように、current_rootから遠い部分木から順に
+		// (開放する子の深さの下限を32,16,…,1と下げながら)開放していく。
+		// 最後に、返却されたブロックのうち隣接しているものをつなげておく。
+		// 開放されたノードは未展開のノードに戻り、pn,dnは開放前の値のまま残る。次に選ばれた時にもう一度展開される。
+		// 不詰の手順(get_unproof_pv())は、開放された部分木の手前までしか得られなくなる。
+		void GarbageCollect()
+		{
+			const NodeCountType target = node_manager.size() / 4;
+			CollectChildren<true>(current_root, 0, 0, 0);
+			for (int level = 1; level <= 3; ++level)
+				for (size_t min_depth = 32; min_depth >= 1 && node_manager.free_nodes() < target; min_depth /= 2)
+					CollectChildren<true>(current_root, 0, level, min_depth);
+
+			node_manager.defragment();
+		}
+
+		// 子ノードの配列を残すnodeについて、その子ノードの部分木のうち開放できるものを開放する。
+		// depth : current_rootからの手数。nodeが探索中の経路上にあるかを調べるのに用いる。
+		// min_depth : level 1～3で開放する未解決の子の、current_rootからの手数の下限
+		template <bool or_node>
+		void CollectChildren(NodeType* node, size_t depth, int level, size_t min_depth)
+		{
+			NodeType* children = node_manager.get_children(node);
+			u32 child_num = node->child_num;
+			if (children == nullptr || child_num == 0 || child_num == NodeType::CHILDNUM_NOT_INIT)
+				return;
+
+			// ORノードならpn、ANDノードならdn。未解決のノードでは、これが最小の子が次に選ばれる。
+			auto value = [](const NodeType& child) { return or_node ? child.pn : child.dn; };
+
+			// 残す子ノードの番号。詰みなら詰み手順の子、未解決なら次に選ばれる子。
+			u32 keep_index = child_num;
+			if (node->pn == 0 || node->dn == 0)
+			{
+				// 詰み手順はpick_the_best()で辿るので、それと同じ子を残す。
+				NodeType* best = node;
+				if (node->pn == 0 && pick_the_best<or_node, true, false>(best) != MOVE_NONE)
+					keep_index = u32(best - children);
+			}
+			else
+			{
+				keep_index = 0;
+				for (u32 i = 1; i < child_num; ++i)
+					if (value(children[i]) < value(children[keep_index]))
+						keep_index = i;
+			}
+
+			const bool on_path = depth < search_path.size() && search_path[depth] == node;
+			NodeType* next = on_path && depth + 1 < search_path.size() ? search_path[depth + 1] : nullptr;
+
+			for (u32 i = 0; i < child_num; ++i)
+			{
+				NodeType* child = &children[i];
+
+				bool free_child;
+				if (child == next)
+					free_child = false;
+				else if (node->pn == 0 || node->dn == 0)
+					// 証明済みのノードでは、詰み手順の子以外は不要。
+					free_child = i != keep_index;
+				else if (child->pn == 0)
+					// 未解決のANDノードの詰みの子は、あとで詰み手順を辿れるように残す。
+					// (この子は二度と探索しないので、開放すると詰み手順がわからなくなる)
+					free_child = false;
+				else if (child->dn == 0)
+					// 不詰の子は詰み手順に不要。
+					free_child = true;
+				else if (depth + 1 < min_depth)
+					free_child = false;
+				else
+					switch (level)
+					{
+					case 0 : free_child = false;                                              break;
+					case 1 : free_child = value(*child) / 4 > value(children[keep_index]);    break;
+					case 2 : free_child = i != keep_index;                                    break;
+					default: free_child = true;                                               break;
+					}
+
+				if (free_child)
+					FreeSubtree(child);
+				else
+					CollectChildren<!or_node>(child, depth + 1, level, min_depth);
+			}
+		}
+
+		// nodeの子孫をすべて開放して、nodeを未展開のノードに戻す。
+		void FreeSubtree(NodeType* node)
+		{
+			NodeType* children = node_manager.get_children(node);
+			u32 child_num = node->child_num;
+			if (children == nullptr || child_num == 0 || child_num == NodeType::CHILDNUM_NOT_INIT)
+				return;
+
+			for (u32 i = 0; i < child_num; ++i)
+				FreeSubtree(&children[i]);
+
+			node_manager.free_node(children, child_num);
+			node->set_child(NodeType::CHILDNUM_NOT_INIT);
+		}
+
 	private:
 		// 探索開始局面
 		NodeType* current_root;
+
+		// 探索中の経路。search_path[0]がcurrent_rootで、以下、ParallelSearch()で辿っているノードが順に並ぶ。
+		// GCありの時のみ記録する。
+		std::vector<NodeType*> search_path;
 		Position* root_pos;
 		int root_game_ply; // 探索開始局面のgame_ply。これは、千日手検出の時に必要となる。
 		Color root_color;  // 探索開始局面の手番
@@ -1241,6 +1654,16 @@ namespace Mate::Dfpn32
 		// 詰み/不詰を証明済みの局面をcacheしておくtable
 		MateHashTable* hash_table;
 
+		// 探索に用いるスレッド数。set_thread_num()で設定された値。
+		size_t thread_num = 1;
+
+		// 並列探索の時に、他のスレッドが探索中の子ノードのpn,dnに、スレッド1つあたりに加える値。
+		// 未展開の子ノードのpn,dnの初期値ぐらいにしておく。(MoveOrdering有りなら駒割+30000なので30000)
+		static constexpr NodeCountType VirtualLoss = MoveOrdering ? 30000 : 1;
+
+		// 並列探索の時のNodeごとのlockとvirtual loss
+		NodeLockTable<NodeType> node_locks;
+
 	private:
 		// Node,Childのcustom allocatorみたいなもん。
 		NodeManager<NodeCountType,MoveOrdering> node_manager;
@@ -218,6 +218,9 @@ namespace {
 		// dfpn-hash table用のメモリ[MB]
 		u32 dfpn_hash = 1024;
 
+		// 並列探索版のdfpnのスレッド数
+		size_t dfpn_threads = Threads.size();
+
 		// デバッグ用に、解けなかった問題を出力する。
 		bool verbose = false;
 
@@ -246,6 +249,8 @@ namespace {
 				is >> dfpn_mem;
 			else if (token == "dfpn_hash")
 				is >> dfpn_hash;
+			else if (token == "dfpn_threads")
+				is >> dfpn_threads;
 #endif
 		}
 
@@ -259,6 +264,7 @@ namespace {
 #if defined(USE_MATE_DFPN)
 			<< " dfpn_mem [MB]            = " << dfpn_mem << endl
 			<< " dfpn_hash[MB]            = " << dfpn_hash << endl
+			<< " dfpn_threads             = " << dfpn_threads << endl
 #endif
 			;
 
@@ -283,6 +289,18 @@ namespace {
 		dfpn5.alloc(dfpn_mem);
 		dfpn5.set_hash_table(&mate_hash);
 
+		// 並列探索版。他のsolverとの比較用なので、使う時だけメモリを確保する。
+		Mate::Dfpn::MateDfpnSolver dfpn6(Mate::Dfpn::DfpnSolverType::Node48bitOrderingParallel);
+		dfpn6.set_thread_num(dfpn_threads);
+		if (test_mode & 64)
+			dfpn6.alloc(dfpn_mem);
+
+		Mate::Dfpn::MateDfpnSolver dfpn7(Mate::Dfpn::DfpnSolverType::Node48bitOrderingParallelWithHash);
+		dfpn7.set_thread_num(dfpn_threads);
+		dfpn7.set_hash_table(&mate_hash);
+		if (test_mode & 128)
+			dfpn7.alloc(dfpn_mem);
+
 #endif
 
 		ifstream f(filename);
@@ -407,6 +425,15 @@ namespace {
 			bench([&]() { auto m = dfpn5.mate_dfpn(pos, nodes_limit); nodes_searched += dfpn5.get_nodes_searched(); return m; }, "mate_dfpn5 : Node48bitOrderingWithHash");
 		}
 
+		if (test_mode & 64)
+			bench([&]() { auto m = dfpn6.mate_dfpn(pos, nodes_limit); nodes_searched += dfpn6.get_nodes_searched(); return m; }, "mate_dfpn6 : Node48bitOrderingParallel");
+
+		if (test_mode & 128)
+		{
+			mate_hash.clear();
+			bench([&]() { auto m = dfpn7.mate_dfpn(pos, nodes_limit); nodes_searched += dfpn7.get_nodes_searched(); return m; }, "mate_dfpn7 : Node48bitOrderingParallelWithHash");
+		}
+
 #endif
 
 		// 他にも詰将棋ルーチンを追加(or 改良)した時に、ここに追加していく。
@@ -433,6 +460,12 @@ namespace {
 		size_t mem = 1024;
 		size_t dfpn_hash = 1024;
 
+		// メモリを使い切った時にGCをするか
+		bool gc = false;
+
+		// 並列探索版のsolverで探索する時のスレッド数。0なら並列探索版を使わない。
+		size_t threads = 0;
+
 		string token;
 		while (is >> token)
 		{
@@ -442,16 +475,26 @@ namespace {
 				is >> mem;
 			else if (token == "hash")
 				is >> dfpn_hash;
+			else if (token == "gc")
+				gc = true;
+			else if (token == "threads")
+				is >> threads;
 		}
 
 		cout << "df-pn mate :" << endl
 			 << " nodes = " << nodes << endl
 			 << " mem   = " << mem << "[MB]"<< endl
 			 << " hash  = " << dfpn_hash << "[MB]" << endl
+			 << " gc    = " << gc << endl
+			 << " threads = " << threads << endl
 			;
 
 #if 1
-		Mate::Dfpn::MateDfpnSolver dfpn(Mate::Dfpn::DfpnSolverType::Node64bit);
+		Mate::Dfpn::MateDfpnSolver dfpn(
+			  gc      ? Mate::Dfpn::DfpnSolverType::Node64bitWithGC
+			: threads ? Mate::Dfpn::DfpnSolverType::Node64bitParallel
+			          : Mate::Dfpn::DfpnSolverType::Node64bit);
+		dfpn.set_thread_num(threads);
 		//Mate::Dfpn::MateDfpnSolver dfpn(Mate::Dfpn::DfpnSolverType::Node48bitOrdering);
 #else
 		// 置換表を持っているdfpn solver。テスト用。
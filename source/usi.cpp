@@ -60,7 +60,8 @@ namespace Test
 // ユーザーの実験用に開放している関数。
 // USI拡張コマンドで"user"と入力するとこの関数が呼び出される。
 // "user"コマンドの後続に指定されている文字列はisのほうに渡される。
-void user_test(Position& pos, std::istringstream& is);
+// 局面を差し替えられるように、"position"コマンドと同じくstatesも渡す。
+void user_test(Position& pos, std::istringstream& is, StateListPtr& states);
 
 #if defined(ENABLE_TEST_CMD)
 	void generate_moves_cmd(Position& pos);
@@ -913,7 +914,7 @@ void USI::loop(int argc, char* argv[])
 
 #if defined(USER_ENGINE)
 		// ユーザーによる実験用コマンド。user.cppのuser()が呼び出される。
-		else if (token == "user") user_test(pos, is);
+		else if (token == "user") user_test(pos, is, states);
 #endif
 
 		// ベンチコマンド(これは常に使える)
@@ -0,0 +1,295 @@
+"""KomoringHeights の初期評価パラメータ（df-pn+ パラメータ、駒の価値）をオフラインで調整するツール。
+
+詰将棋の問題集を固定の探索局面数制限（NodesLimit）で解かせ、解けた問題数と解図までの探索局面数が
+良くなるように SPSA または座標探索でパラメータを調整する。調整結果はエンジンオプション
+`EstimationParamPath` で読み込めるパラメータファイルとして出力する。
+
+USAGE:
+    python3 tools/tune_estimation.py -e source/KomoringHeights-by-gcc -c problems.sfen -o params.txt
+
+問題集は 1 行 1 局面の sfen（先頭の "sfen " はあってもなくてもよい）。
+"""
+import argparse
+import concurrent.futures
+import math
+import os
+import random
+import subprocess
+import sys
+import tempfile
+
+# (名前, デフォルト値, 下限, 上限)
+# デフォルト値は initial_estimation.hpp の DfpnPlusParameters / kDefaultPtValues と一致させること
+PNDN_UNIT = 2
+DEFAULT_PARAMS = [
+    ("or_pn_base", PNDN_UNIT, 1, 32),
+    ("or_dn_base", PNDN_UNIT, 1, 32),
+    ("or_defense", PNDN_UNIT, 1, 32),
+    ("or_support", PNDN_UNIT, 1, 32),
+    ("or_capture_gold_silver", PNDN_UNIT, 1, 32),
+    ("or_capture_others", PNDN_UNIT, 1, 32),
+    ("or_others", PNDN_UNIT, 1, 32),
+    ("and_capture_pn", 2 * PNDN_UNIT, 1, 32),
+    ("and_capture_dn", PNDN_UNIT, 1, 32),
+    ("and_king_pn", PNDN_UNIT, 1, 32),
+    ("and_king_dn", PNDN_UNIT, 1, 32),
+    ("and_good_pn", 2 * PNDN_UNIT, 1, 32),
+    ("and_good_dn", PNDN_UNIT, 1, 32),
+    ("and_bad_pn", PNDN_UNIT, 1, 32),
+    ("and_bad_dn", 2 * PNDN_UNIT, 1, 32),
+]
+# 駒の価値。index は PieceType（1: 歩, 2: 香, ..., 14: 龍）
+DEFAULT_PT_VALUES = [0, 10, 20, 20, 30, 50, 50, 50, 80, 50, 50, 50, 50, 80, 80, 80]
+for _pt in range(1, 15):
+    DEFAULT_PARAMS.append(("pt_value_{}".format(_pt), DEFAULT_PT_VALUES[_pt], -200, 400))
+
+
+def write_params(path, params, header=None):
+    """パラメータファイルを書き出す"""
+    with open(path, "w") as f:
+        if header:
+            for line in header.splitlines():
+                f.write("# {}\n".format(line))
+        for (name, _, _, _), value in zip(DEFAULT_PARAMS, params):
+            f.write("{} {}\n".format(name, int(round(value))))
+
+
+def read_params(path):
+    """パラメータファイルを読み込む。ファイルにないパラメータはデフォルト値になる"""
+    values = {name: default for name, default, _, _ in DEFAULT_PARAMS}
+    with open(path) as f:
+        for line in f:
+            line = line.split("#", 1)[0].strip()
+            if not line:
+                continue
+            name, value = line.split()
+            if name not in values:
+                raise ValueError("unknown parameter: {}".format(name))
+            values[name] = int(value)
+    return [values[name] for name, _, _, _ in DEFAULT_PARAMS]
+
+
+def clamp(params):
+    return [min(max(int(round(v)), lo), hi) for v, (_, _, lo, hi) in zip(params, DEFAULT_PARAMS)]
+
+
+class Engine:
+    """USI エンジンを 1 プロセス起動し、問題を順番に解かせる"""
+
+    def __init__(self, path, hash_mb, nodes_limit, param_path):
+        self.proc = subprocess.Popen([path], stdin=subprocess.PIPE, stdout=subprocess.PIPE,
+                                     universal_newlines=True, bufsize=1,
+                                     cwd=os.path.dirname(os.path.abspath(path)))
+        self.send("usi")
+        self.wait_for("usiok")
+        self.send("setoption name Threads value 1")
+        self.send("setoption name USI_Hash value {}".format(hash_mb))
+        self.send("setoption name NodesLimit value {}".format(nodes_limit))
+        self.send("setoption name PvInterval value 0")
+        self.send("setoption name PostSearchLevel value None")
+        self.send("setoption name EstimationParamPath value {}".format(param_path))
+
+    def send(self, line):
+        self.proc.stdin.write(line + "\n")
+        self.proc.stdin.flush()
+
+    def wait_for(self, prefix):
+        lines = []
+        while True:
+            line = self.proc.stdout.readline()
+            if not line:
+                raise RuntimeError("engine terminated unexpectedly")
+            line = line.strip()
+            lines.append(line)
+            if line.startswith(prefix):
+                return lines
+
+    def solve(self, sfen):
+        """(詰みを見つけたか, 探索局面数) を返す"""
+        # 問題ごとに置換表をクリアしないと、前の問題の探索結果を使いまわしてしまう
+        self.send("isready")
+        lines = self.wait_for("readyok")
+        if any("error: failed to load estimation params" in line for line in lines):
+            raise RuntimeError("engine rejected the parameter file")
+        self.send("position sfen {}".format(sfen))
+        self.send("go mate infinite")
+        lines = self.wait_for("checkmate")
+
+        nodes = 0
+        for line in lines:
+            tokens = line.split()
+            if tokens and tokens[0] == "info" and "nodes" in tokens:
+                idx = tokens.index("nodes")
+                if idx + 1 < len(tokens) and tokens[idx + 1].isdigit():
+                    nodes = int(tokens[idx + 1])
+        result = lines[-1].split()
+        solved = len(result) >= 2 and result[1] not in ("timeout", "nomate", "notimplemented")
+        return solved, nodes
+
+    def close(self):
+        self.send("quit")
+        self.proc.wait()
+
+
+def evaluate_chunk(args):
+    engine_path, hash_mb, nodes_limit, param_path, sfens = args
+    engine = Engine(engine_path, hash_mb, nodes_limit, param_path)
+    try:
+        return [engine.solve(sfen) for sfen in sfens]
+    finally:
+        engine.close()
+
+
+class Evaluator:
+    """パラメータを受け取り、問題集全体の損失（小さいほど良い）を計算する"""
+
+    def __init__(self, opts, sfens):
+        self.opts = opts
+        self.sfens = sfens
+        self.executor = concurrent.futures.ProcessPoolExecutor(max_workers=opts.workers)
+        self.tmpdir = tempfile.mkdtemp(prefix="kh-tune-")
+        self.count = 0
+
+    def loss(self, params):
+        self.count += 1
+        param_path = os.path.join(self.tmpdir, "params{}.txt".format(self.count))
+        write_params(param_path, params)
+
+        chunks = [self.sfens[i::self.opts.workers] for i in range(self.opts.workers)]
+        jobs = [(self.opts.engine, self.opts.hash, self.opts.nodes, param_path, chunk) for chunk in chunks if chunk]
+        results = [r for rs in self.executor.map(evaluate_chunk, jobs) for r in rs]
+        os.remove(param_path)
+
+        # 解けなかった問題は NodesLimit の penalty 倍の局面数を要したとみなす。
+        # 局面数は問題ごとに桁が大きく異なるので、対数を取って足し合わせる。
+        unsolved_nodes = self.opts.nodes * self.opts.unsolved_penalty
+        total = 0.0
+        solved = 0
+        for ok, nodes in results:
+            if ok:
+                solved += 1
+                total += math.log(max(nodes, 1))
+            else:
+                total += math.log(unsolved_nodes)
+        return total / len(results), solved
+
+    def close(self):
+        self.executor.shutdown()
+        os.rmdir(self.tmpdir)
+
+
+def log(msg):
+    print(msg, flush=True)
+
+
+def tune_spsa(evaluator, params, opts):
+    """SPSA (Simultaneous Perturbation Stochastic Approximation)"""
+    theta = [float(v) for v in params]
+    best, (best_loss, best_solved) = clamp(theta), evaluator.loss(clamp(theta))
+    log("initial: loss={:.4f} solved={}".format(best_loss, best_solved))
+
+    # ステップ幅はパラメータごとの取りうる範囲に比例させる
+    scales = [max(1.0, (hi - lo) / 16.0) for _, _, lo, hi in DEFAULT_PARAMS]
+    alpha, gamma, big_a = 0.602, 0.101, opts.iterations / 10.0
+    for k in range(opts.iterations):
+        ak = opts.spsa_a / (k + 1 + big_a) ** alpha
+        ck = opts.spsa_c / (k + 1) ** gamma
+        delta = [random.choice((-1, 1)) for _ in theta]
+        plus = clamp([t + ck * s * d for t, s, d in zip(theta, scales, delta)])
+        minus = clamp([t - ck * s * d for t, s, d in zip(theta, scales, delta)])
+        loss_plus, _ = evaluator.loss(plus)
+        loss_minus, _ = evaluator.loss(minus)
+        diff = loss_plus - loss_minus
+        theta = [t - ak * s * diff / (2.0 * ck * d) for t, s, d in zip(theta, scales, delta)]
+        theta = [float(v) for v in clamp(theta)]
+
+        cur_loss, cur_solved = evaluator.loss(clamp(theta))
+        log("iter {}: loss={:.4f} solved={} (+:{:.4f} -:{:.4f})".format(k + 1, cur_loss, cur_solved, loss_plus,
+                                                                      loss_minus))
+        if cur_loss < best_loss:
+            best, best_loss, best_solved = clamp(theta), cur_loss, cur_solved
+            write_params(opts.output, best, "loss={:.4f} solved={}".format(best_loss, best_solved))
+    return best, best_loss, best_solved
+
+
+def tune_coordinate(evaluator, params, opts):
+    """座標探索。パラメータを 1 つずつ ±step 動かし、良くなる方向があれば採用する"""
+    best = clamp(params)
+    best_loss, best_solved = evaluator.loss(best)
+    log("initial: loss={:.4f} solved={}".format(best_loss, best_solved))
+
+    for k in range(opts.iterations):
+        improved = False
+        for i, (name, _, lo, hi) in enumerate(DEFAULT_PARAMS):
+            step = max(1, (hi - lo) // 32)
+            for sign in (1, -1):
+                cand = list(best)
+                cand[i] += sign * step
+                cand = clamp(cand)
+                if cand == best:
+                    continue
+                loss, solved = evaluator.loss(cand)
+                if loss < best_loss:
+                    best, best_loss, best_solved = cand, loss, solved
+                    improved = True
+                    log("iter {}: {}={} loss={:.4f} solved={}".format(k + 1, name, cand[i], loss, solved))
+                    write_params(opts.output, best, "loss={:.4f} solved={}".format(best_loss, best_solved))
+                    break
+        if not improved:
+            log("iter {}: converged".format(k + 1))
+            break
+    return best, best_loss, best_solved
+
+
+def read_corpus(path):
+    sfens = []
+    with open(path) as f:
+        for line in f:
+            line = line.strip()
+            if not line or line.startswith("#"):
+                continue
+            if line.startswith("sfen "):
+                line = line[len("sfen "):]
+            sfens.append(line)
+    return sfens
+
+
+def main():
+    parser = argparse.ArgumentParser(description="tune initial pn/dn estimation parameters of KomoringHeights")
+    parser.add_argument("-e", "--engine", required=True, help="path to the engine binary")
+    parser.add_argument("-c", "--corpus", required=True, help="problem file (one sfen per line)")
+    parser.add_argument("-o", "--output", default="estimation_params.txt", help="output parameter file")
+    parser.add_argument("-i", "--init", default=None, help="initial parameter file (default: built-in values)")
+    parser.add_argument("-m", "--method", choices=("spsa", "coordinate"), default="spsa")
+    parser.add_argument("-n", "--nodes", type=int, default=100000, help="NodesLimit for each problem")
+    parser.add_argument("-j", "--workers", type=int, default=os.cpu_count(), help="number of engine processes")
+    parser.add_argument("--hash", type=int, default=64, help="USI_Hash [MB] for each engine process")
+    parser.add_argument("--iterations", type=int, default=100)
+    parser.add_argument("--unsolved-penalty", type=float, default=2.0,
+                        help="unsolved problems count as (nodes * penalty) nodes")
+    parser.add_argument("--spsa-a", type=float, default=1.0)
+    parser.add_argument("--spsa-c", type=float, default=1.0)
+    parser.add_argument("--seed", type=int, default=334)
+    opts = parser.parse_args()
+
+    random.seed(opts.seed)
+    sfens = read_corpus(opts.corpus)
+    if not sfens:
+        sys.exit("corpus is empty: {}".format(opts.corpus))
+    params = read_params(opts.init) if opts.init else [default for _, default, _, _ in DEFAULT_PARAMS]
+
+    evaluator = Evaluator(opts, sfens)
+    try:
+        if opts.method == "spsa":
+            best, best_loss, best_solved = tune_spsa(evaluator, params, opts)
+        else:
+            best, best_loss, best_solved = tune_coordinate(evaluator, params, opts)
+    finally:
+        evaluator.close()
+
+    write_params(opts.output, best, "loss={:.4f} solved={}/{}".format(best_loss, best_solved, len(sfens)))
+    log("best: loss={:.4f} solved={}/{} -> {}".format(best_loss, best_solved, len(sfens), opts.output))
+
+
+if __name__ == "__main__":
+    main()